@@ -0,0 +1,148 @@
+// phong lighting from the G-buffer, LIGHT_VOLUME shades the volume's light and otherwise every unbounded light,
+// SHADOWS shadows the key light (light 0) with cascaded shadow maps
+#version 330 core
+
+out vec4 FragColor;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+uniform sampler2D albedoSpecularTexture;
+uniform sampler2D normalShininessTexture;
+uniform sampler2D depthTexture;
+
+// two texels per light: position and radius, color
+uniform samplerBuffer lightData;
+
+#ifdef LIGHT_VOLUME
+flat in int lightIndex;
+#endif
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0.0)
+    {
+        normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return normalize(normal);
+}
+
+#ifdef SHADOWS
+layout (std140) uniform Shadows
+{
+    mat4 cascadeMatrices[4];   // world space to shadow map texture coordinates and depth
+    vec4 cascadeSplits;        // view depth at which each cascade ends
+    vec4 cascadeTexelSizes;    // world size of one shadow map texel
+    uvec4 cascadeCount;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+// fraction of the key light reaching a position, from 3x3 bilinear PCF taps of the cascade covering its view depth;
+// the position is pushed along the normal by a texel or so, which keeps lit surfaces from shadowing themselves
+float KeyLightVisibility(vec3 position, vec3 normal, float viewDepth)
+{
+    int cascade = 0;
+    while (cascade < int(cascadeCount.x) - 1 && viewDepth > cascadeSplits[cascade])
+    {
+        ++cascade;
+    }
+    if (viewDepth > cascadeSplits[cascade])
+    {
+        return 1.0;
+    }
+
+    vec4 shadowPos = cascadeMatrices[cascade] * vec4(position + normal * cascadeTexelSizes[cascade] * 1.5, 1.0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            visibility += texture(shadowMap, vec4(shadowPos.xy + vec2(x, y) * texelSize, float(cascade), shadowPos.z));
+        }
+    }
+
+    return visibility / 9.0;
+}
+#endif
+
+// diffuse and specular contribution of one light, bounded lights fade out smoothly at their radius
+vec3 ShadeLight(int index, vec3 position, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininessValue)
+{
+    vec4 lightPosRadius = texelFetch(lightData, 2 * index);
+    vec3 lightColor = texelFetch(lightData, 2 * index + 1).rgb;
+
+    vec3 toLight = lightPosRadius.xyz - position;
+    float attenuation = 1.0;
+    if (lightPosRadius.w > 0.0)
+    {
+        float falloff = clamp(1.0 - pow(length(toLight) / lightPosRadius.w, 4.0), 0.0, 1.0);
+        attenuation = falloff * falloff;
+    }
+
+    vec3 lightDir = normalize(toLight);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = lightColor * diff * diffuseColor;
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininessValue);
+    vec3 specular = lightColor * spec * specularColor;
+
+    return (diffuse + specular) * attenuation;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    float depth = texelFetch(depthTexture, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        discard;  // background
+    }
+
+    vec4 albedoSpecular = texelFetch(albedoSpecularTexture, pixel, 0);
+    vec4 normalShininess = texelFetch(normalShininessTexture, pixel, 0);
+
+    vec4 clipPos = vec4(gl_FragCoord.xy * viewportSize.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPos = inverseViewProjectionMatrix * clipPos;
+    vec3 position = worldPos.xyz / worldPos.w;
+
+    vec3 normal = DecodeOctahedral(normalShininess.xy);
+    vec3 viewDir = normalize(cameraPos.xyz - position);
+    vec3 diffuseColor = albedoSpecular.rgb;
+    vec3 specularColor = vec3(albedoSpecular.a);
+    float shininessValue = exp2(normalShininess.z * 10.0);
+
+    #ifdef LIGHT_VOLUME
+    FragColor = vec4(ShadeLight(lightIndex, position, normal, viewDir, diffuseColor, specularColor, shininessValue), 0.0);
+    #else
+    #ifdef SHADOWS
+    float keyLightVisibility = KeyLightVisibility(position, normal, -(viewMatrix * vec4(position, 1.0)).z);
+    #else
+    float keyLightVisibility = 1.0;
+    #endif
+
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < int(lightCounts.y); ++i)
+    {
+        color += ShadeLight(i, position, normal, viewDir, diffuseColor, specularColor, shininessValue) * (i == 0 ? keyLightVisibility : 1.0);
+    }
+    FragColor = vec4(color, 0.0);
+    #endif
+}
@@ -0,0 +1,36 @@
+// positions a light volume around each bounded light, or with LIGHT_VOLUME undefined covers the screen with one triangle
+#version 330 core
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+#ifdef LIGHT_VOLUME
+layout (location = 0) in vec3 aPos;
+
+uniform samplerBuffer lightData;
+
+flat out int lightIndex;
+#endif
+
+void main()
+{
+    #ifdef LIGHT_VOLUME
+    // instances start after the unbounded lights, which the fullscreen pass handles
+    lightIndex = int(lightCounts.y) + gl_InstanceID;
+
+    vec4 lightPosRadius = texelFetch(lightData, 2 * lightIndex);
+    gl_Position = projectionMatrix * viewMatrix * vec4(lightPosRadius.xyz + aPos * lightPosRadius.w, 1.0);
+    #else
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+    #endif
+}
@@ -0,0 +1,13 @@
+// writes depth only, COUNT_FRAGMENTS outputs 1 so additive blending counts fragments per pixel
+#version 330 core
+
+#ifdef COUNT_FRAGMENTS
+out vec4 fragmentCount;
+#endif
+
+void main()
+{
+    #ifdef COUNT_FRAGMENTS
+    fragmentCount = vec4(1.0);
+    #endif
+}
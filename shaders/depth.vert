@@ -0,0 +1,34 @@
+// transforms positions for depth-only passes, gl_Position must match phong.vert exactly,
+// SHADOW_CASTER transforms them into a shadow map's light space instead
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+uniform mat4 modelMatrix;
+
+#ifdef SHADOW_CASTER
+uniform mat4 lightViewProjectionMatrix;
+#endif
+
+invariant gl_Position;
+
+void main()
+{
+    #ifdef SHADOW_CASTER
+    gl_Position = lightViewProjectionMatrix * modelMatrix * vec4(aPos, 1.0);
+    #else
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+    #endif
+}
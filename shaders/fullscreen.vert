@@ -0,0 +1,12 @@
+// covers the screen with one triangle generated from gl_VertexID
+#version 330 core
+
+out vec2 screenTexCoord;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+    screenTexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
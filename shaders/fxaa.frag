@@ -0,0 +1,58 @@
+// FXAA in the compact form of FXAA 3.11's console variant: pixels whose 2x2 luma neighbourhood
+// has high contrast are blurred along the edge, perpendicular to the luma gradient
+#version 330 core
+
+in vec2 screenTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D sceneTexture;
+
+// contrast below either threshold is left alone, the second one is relative to the brightest neighbour
+const float edgeThresholdMin = 1.0 / 32.0;
+const float edgeThreshold = 1.0 / 8.0;
+
+// keeps the blur short on dark edges and the search within spanMax pixels
+const float reduceMin = 1.0 / 128.0;
+const float reduceScale = 1.0 / 8.0;
+const float spanMax = 8.0;
+
+float Luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(sceneTexture, 0));
+
+    vec3 colorCenter = texture(sceneTexture, screenTexCoord).rgb;
+    float lumaCenter = Luma(colorCenter);
+    float lumaNW = Luma(textureOffset(sceneTexture, screenTexCoord, ivec2(-1, 1)).rgb);
+    float lumaNE = Luma(textureOffset(sceneTexture, screenTexCoord, ivec2(1, 1)).rgb);
+    float lumaSW = Luma(textureOffset(sceneTexture, screenTexCoord, ivec2(-1, -1)).rgb);
+    float lumaSE = Luma(textureOffset(sceneTexture, screenTexCoord, ivec2(1, -1)).rgb);
+
+    float lumaMin = min(lumaCenter, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaCenter, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(edgeThresholdMin, lumaMax * edgeThreshold))
+    {
+        FragColor = vec4(colorCenter, 1.0);
+        return;
+    }
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * reduceScale, reduceMin);
+    float inverseSmallestComponent = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseSmallestComponent, vec2(-spanMax), vec2(spanMax)) * texelSize;
+
+    // two taps close to the pixel, then two more at the ends of the span
+    vec3 colorNear = 0.5 * (texture(sceneTexture, screenTexCoord + direction * (1.0 / 3.0 - 0.5)).rgb +
+                            texture(sceneTexture, screenTexCoord + direction * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 colorWide = colorNear * 0.5 + 0.25 * (texture(sceneTexture, screenTexCoord - direction * 0.5).rgb +
+                                               texture(sceneTexture, screenTexCoord + direction * 0.5).rgb);
+
+    // the wide blur crossed another edge when it leaves the neighbourhood's luma range
+    float lumaWide = Luma(colorWide);
+    FragColor = vec4((lumaWide < lumaMin || lumaWide > lumaMax) ? colorNear : colorWide, 1.0);
+}
@@ -0,0 +1,56 @@
+// writes material and surface data for deferred lighting, HAS_DIFFUSE_TEXTURE modulates the albedo with a texture
+#version 330 core
+
+in vec3 worldVertexPos;
+in vec3 worldVertexNormal;
+in vec2 vertexTexCoord;
+
+layout (location = 0) out vec4 albedoSpecular;   // albedo, specular intensity
+layout (location = 1) out vec4 normalShininess;  // octahedral normal, encoded shininess
+layout (location = 2) out vec4 lightAccumulation;
+
+#ifdef HAS_DIFFUSE_TEXTURE
+uniform sampler2D diffuseTexture;
+#endif
+
+struct MaterialData
+{
+    vec4 ambientColor;   // w holds the metallic factor
+    vec4 diffuseColor;   // w holds the roughness
+    vec4 specularColor;  // w holds the shininess
+};
+
+layout (std140) uniform Materials
+{
+    MaterialData materials[256];
+};
+
+uniform int materialIndex;
+
+// maps a unit vector onto the [0, 1] square, two 10-bit channels keep it within a fraction of a degree
+vec2 EncodeOctahedral(vec3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 encoded = normal.z >= 0.0 ? normal.xy : (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+
+    return encoded * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 ambientColor = materials[materialIndex].ambientColor.rgb;
+    vec3 diffuseColor = materials[materialIndex].diffuseColor.rgb;
+    vec3 specularColor = materials[materialIndex].specularColor.rgb;
+    float shininessValue = materials[materialIndex].specularColor.w;
+
+    #ifdef HAS_DIFFUSE_TEXTURE
+    diffuseColor *= texture(diffuseTexture, vertexTexCoord).rgb;
+    #endif
+
+    // the G-buffer keeps a single specular intensity instead of a color
+    albedoSpecular = vec4(diffuseColor, max(specularColor.r, max(specularColor.g, specularColor.b)));
+    normalShininess = vec4(EncodeOctahedral(normalize(worldVertexNormal)), log2(clamp(shininessValue, 1.0, 1024.0)) / 10.0, 0.0);
+
+    // ambient light is written directly, the light passes add on top of it
+    lightAccumulation = vec4(0.1 * ambientColor, 1.0);
+}
@@ -0,0 +1,38 @@
+// builds one level of the Hi-Z pyramid: each texel keeps the farthest depth of the 2x2 source texels it covers
+#version 330 core
+
+out float maxDepth;
+
+// the occluder depth buffer for the first level, the previous pyramid level (as the texture's base level) after that
+uniform sampler2D sourceTexture;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(sourceTexture, 0);
+    ivec2 destinationSize = max(sourceSize / 2, ivec2(1));
+    ivec2 destination = ivec2(gl_FragCoord.xy);
+
+    ivec2 first = destination * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+
+    // odd sizes leave a row or column over, the last texel of the level folds it in
+    if (destination.x == destinationSize.x - 1)
+    {
+        last.x = sourceSize.x - 1;
+    }
+    if (destination.y == destinationSize.y - 1)
+    {
+        last.y = sourceSize.y - 1;
+    }
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            depth = max(depth, texelFetch(sourceTexture, ivec2(x, y), 0).r);
+        }
+    }
+
+    maxDepth = depth;
+}
@@ -0,0 +1,38 @@
+// maps the fragment count of each pixel to a heat color: 1 blue, 2 green, 3 yellow, 4 red, 8 and more white
+#version 330 core
+
+in vec2 screenTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D fragmentCountTexture;
+
+void main()
+{
+    float count = texture(fragmentCountTexture, screenTexCoord).r;
+    if (count < 0.5)
+    {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    vec3 color;
+    if (count < 2.0)
+    {
+        color = mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), count - 1.0);
+    }
+    else if (count < 3.0)
+    {
+        color = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), count - 2.0);
+    }
+    else if (count < 4.0)
+    {
+        color = mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), count - 3.0);
+    }
+    else
+    {
+        color = mix(vec3(1.0, 0.0, 0.0), vec3(1.0), clamp((count - 4.0) / 4.0, 0.0, 1.0));
+    }
+
+    FragColor = vec4(color, 1.0);
+}
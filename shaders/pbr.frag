@@ -0,0 +1,216 @@
+// metallic-roughness shading with the GGX BRDF for every light of the frame and the precomputed environment for the
+// ambient term; HAS_DIFFUSE_TEXTURE modulates the base color with a texture, CLUSTERED_LIGHTS limits the bounded lights
+// to those binned into the fragment's cluster, SHADOWS shadows the key light (light 0) with cascaded shadow maps and
+// AMBIENT_OCCLUSION darkens the environment lighting with the screen-space occlusion
+#version 330 core
+
+in vec3 worldVertexPos;
+in vec3 worldVertexNormal;
+in vec2 vertexTexCoord;
+
+out vec4 FragColor;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+#ifdef HAS_DIFFUSE_TEXTURE
+uniform sampler2D diffuseTexture;
+#endif
+
+// two texels per light: position and radius, color
+uniform samplerBuffer lightData;
+
+#ifdef CLUSTERED_LIGHTS
+uniform usamplerBuffer clusterData;          // offset and count of each cluster's light indices
+uniform usamplerBuffer clusterLightIndices;
+#endif
+
+struct MaterialData
+{
+    vec4 ambientColor;   // w holds the metallic factor
+    vec4 diffuseColor;   // w holds the roughness
+    vec4 specularColor;  // w holds the shininess
+};
+
+layout (std140) uniform Materials
+{
+    MaterialData materials[256];
+};
+
+uniform int materialIndex;
+
+uniform samplerCube irradianceMap;   // cosine-weighted average radiance around the normal
+uniform samplerCube prefilteredMap;  // radiance convolved with the GGX lobe, roughness grows with the mip level
+uniform sampler2D brdfLut;           // scale and bias of F0 by NdotV and roughness
+
+#ifdef AMBIENT_OCCLUSION
+uniform sampler2D ambientOcclusion;  // full resolution, one texel per pixel
+#endif
+
+#ifdef SHADOWS
+layout (std140) uniform Shadows
+{
+    mat4 cascadeMatrices[4];   // world space to shadow map texture coordinates and depth
+    vec4 cascadeSplits;        // view depth at which each cascade ends
+    vec4 cascadeTexelSizes;    // world size of one shadow map texel
+    uvec4 cascadeCount;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+// fraction of the key light reaching a position, from 3x3 bilinear PCF taps of the cascade covering its view depth;
+// the position is pushed along the normal by a texel or so, which keeps lit surfaces from shadowing themselves
+float KeyLightVisibility(vec3 position, vec3 normal, float viewDepth)
+{
+    int cascade = 0;
+    while (cascade < int(cascadeCount.x) - 1 && viewDepth > cascadeSplits[cascade])
+    {
+        ++cascade;
+    }
+    if (viewDepth > cascadeSplits[cascade])
+    {
+        return 1.0;
+    }
+
+    vec4 shadowPos = cascadeMatrices[cascade] * vec4(position + normal * cascadeTexelSizes[cascade] * 1.5, 1.0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            visibility += texture(shadowMap, vec4(shadowPos.xy + vec2(x, y) * texelSize, float(cascade), shadowPos.z));
+        }
+    }
+
+    return visibility / 9.0;
+}
+#endif
+
+const float Pi = 3.14159265;
+
+// the prefiltered map ends at 4x4 texels, which is the mip level of roughness 1
+float MaxPrefilteredLod()
+{
+    return log2(float(textureSize(prefilteredMap, 0).x)) - 2.0;
+}
+
+float DistributionGgx(float NdotH, float roughness)
+{
+    float alpha = roughness * roughness;
+    float alphaSquared = alpha * alpha;
+    float denominator = NdotH * NdotH * (alphaSquared - 1.0) + 1.0;
+    return alphaSquared / (Pi * denominator * denominator);
+}
+
+// Smith's shadowing-masking with Schlick's approximation and the k of analytic lights
+float GeometrySmith(float NdotV, float NdotL, float roughness)
+{
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    return (NdotV / (NdotV * (1.0 - k) + k)) * (NdotL / (NdotL * (1.0 - k) + k));
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 f0)
+{
+    return f0 + (1.0 - f0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// radiance reflected towards the viewer from one light, bounded lights fade out smoothly at their radius;
+// light colors are scaled by pi so a white light on a white diffuse surface matches the Phong shader
+vec3 ShadeLight(int index, vec3 position, vec3 normal, vec3 viewDir, vec3 baseColor, float metallic, float roughness, vec3 f0)
+{
+    vec4 lightPosRadius = texelFetch(lightData, 2 * index);
+    vec3 lightColor = texelFetch(lightData, 2 * index + 1).rgb;
+
+    vec3 toLight = lightPosRadius.xyz - position;
+    float attenuation = 1.0;
+    if (lightPosRadius.w > 0.0)
+    {
+        float falloff = clamp(1.0 - pow(length(toLight) / lightPosRadius.w, 4.0), 0.0, 1.0);
+        attenuation = falloff * falloff;
+    }
+
+    vec3 lightDir = normalize(toLight);
+    vec3 halfDir = normalize(lightDir + viewDir);
+    float NdotL = max(dot(normal, lightDir), 0.0);
+    float NdotV = max(dot(normal, viewDir), 0.0001);
+    float NdotH = max(dot(normal, halfDir), 0.0);
+
+    vec3 fresnel = FresnelSchlick(max(dot(halfDir, viewDir), 0.0), f0);
+    vec3 specular = DistributionGgx(NdotH, roughness) * GeometrySmith(NdotV, NdotL, roughness) * fresnel / (4.0 * NdotV * max(NdotL, 0.0001));
+    vec3 diffuse = (1.0 - fresnel) * (1.0 - metallic) * baseColor / Pi;
+
+    return (diffuse + specular) * lightColor * Pi * NdotL * attenuation;
+}
+
+void main()
+{
+    vec3 baseColor = materials[materialIndex].diffuseColor.rgb;
+    float metallic = clamp(materials[materialIndex].ambientColor.w, 0.0, 1.0);
+    float roughness = clamp(materials[materialIndex].diffuseColor.w, 0.04, 1.0);
+
+    vec3 normal = normalize(worldVertexNormal);
+
+    #ifdef HAS_DIFFUSE_TEXTURE
+    baseColor *= texture(diffuseTexture, vertexTexCoord).rgb;
+    #endif
+
+    vec3 viewDir = normalize(cameraPos.xyz - worldVertexPos);
+    float viewDepth = -(viewMatrix * vec4(worldVertexPos, 1.0)).z;
+    float NdotV = max(dot(normal, viewDir), 0.0);
+
+    // dielectrics reflect 4% head-on, metals tint the reflection with their base color and have no diffuse part
+    vec3 f0 = mix(vec3(0.04), baseColor, metallic);
+
+    // split-sum environment lighting: the prefiltered radiance times the BRDF's scale and bias of F0
+    vec3 fresnel = f0 + (max(vec3(1.0 - roughness), f0) - f0) * pow(1.0 - NdotV, 5.0);
+    vec3 diffuseEnvironment = (1.0 - fresnel) * (1.0 - metallic) * baseColor * texture(irradianceMap, normal).rgb;
+    vec3 reflectedRadiance = textureLod(prefilteredMap, reflect(-viewDir, normal), roughness * MaxPrefilteredLod()).rgb;
+    vec2 brdf = texture(brdfLut, vec2(NdotV, roughness)).rg;
+    vec3 color = diffuseEnvironment + reflectedRadiance * (f0 * brdf.x + brdf.y);
+    #ifdef AMBIENT_OCCLUSION
+    color *= texelFetch(ambientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+    #endif
+
+    #ifdef SHADOWS
+    float keyLightVisibility = KeyLightVisibility(worldVertexPos, normal, viewDepth);
+    #else
+    float keyLightVisibility = 1.0;
+    #endif
+
+    #ifdef CLUSTERED_LIGHTS
+    for (int i = 0; i < int(lightCounts.y); ++i)
+    {
+        color += ShadeLight(i, worldVertexPos, normal, viewDir, baseColor, metallic, roughness, f0) * (i == 0 ? keyLightVisibility : 1.0);
+    }
+
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * viewportSize.zw * vec2(clusterCounts.xy)),
+                          uint(max(log(viewDepth) * clusterDepthParams.x - clusterDepthParams.y, 0.0)));
+    cluster = min(cluster, clusterCounts.xyz - 1u);
+
+    uvec2 lightRange = texelFetch(clusterData, int((cluster.z * clusterCounts.y + cluster.y) * clusterCounts.x + cluster.x)).xy;
+    for (uint i = 0u; i < lightRange.y; ++i)
+    {
+        int lightIndex = int(texelFetch(clusterLightIndices, int(lightRange.x + i)).r);
+        color += ShadeLight(lightIndex, worldVertexPos, normal, viewDir, baseColor, metallic, roughness, f0);
+    }
+    #else
+    // forward shading pays for every light on every fragment
+    for (int i = 0; i < int(lightCounts.x); ++i)
+    {
+        color += ShadeLight(i, worldVertexPos, normal, viewDir, baseColor, metallic, roughness, f0) * (i == 0 ? keyLightVisibility : 1.0);
+    }
+    #endif
+
+    FragColor = vec4(color, 1);
+}
@@ -0,0 +1,172 @@
+// implements phong lighting model for every light of the frame, HAS_DIFFUSE_TEXTURE modulates the diffuse color with a texture
+// and CLUSTERED_LIGHTS limits the bounded lights to those binned into the fragment's cluster, SHADOWS shadows the key light
+// (light 0) with cascaded shadow maps and AMBIENT_OCCLUSION darkens the ambient term with the screen-space occlusion
+#version 330 core
+
+in vec3 worldVertexPos;
+in vec3 worldVertexNormal;
+in vec2 vertexTexCoord;
+
+out vec4 FragColor;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+#ifdef HAS_DIFFUSE_TEXTURE
+uniform sampler2D diffuseTexture;
+#endif
+
+// two texels per light: position and radius, color
+uniform samplerBuffer lightData;
+
+#ifdef CLUSTERED_LIGHTS
+uniform usamplerBuffer clusterData;          // offset and count of each cluster's light indices
+uniform usamplerBuffer clusterLightIndices;
+#endif
+
+struct MaterialData
+{
+    vec4 ambientColor;   // w holds the metallic factor
+    vec4 diffuseColor;   // w holds the roughness
+    vec4 specularColor;  // w holds the shininess
+};
+
+layout (std140) uniform Materials
+{
+    MaterialData materials[256];
+};
+
+uniform int materialIndex;
+
+#ifdef AMBIENT_OCCLUSION
+uniform sampler2D ambientOcclusion;  // full resolution, one texel per pixel
+#endif
+
+#ifdef SHADOWS
+layout (std140) uniform Shadows
+{
+    mat4 cascadeMatrices[4];   // world space to shadow map texture coordinates and depth
+    vec4 cascadeSplits;        // view depth at which each cascade ends
+    vec4 cascadeTexelSizes;    // world size of one shadow map texel
+    uvec4 cascadeCount;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+// fraction of the key light reaching a position, from 3x3 bilinear PCF taps of the cascade covering its view depth;
+// the position is pushed along the normal by a texel or so, which keeps lit surfaces from shadowing themselves
+float KeyLightVisibility(vec3 position, vec3 normal, float viewDepth)
+{
+    int cascade = 0;
+    while (cascade < int(cascadeCount.x) - 1 && viewDepth > cascadeSplits[cascade])
+    {
+        ++cascade;
+    }
+    if (viewDepth > cascadeSplits[cascade])
+    {
+        return 1.0;
+    }
+
+    vec4 shadowPos = cascadeMatrices[cascade] * vec4(position + normal * cascadeTexelSizes[cascade] * 1.5, 1.0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            visibility += texture(shadowMap, vec4(shadowPos.xy + vec2(x, y) * texelSize, float(cascade), shadowPos.z));
+        }
+    }
+
+    return visibility / 9.0;
+}
+#endif
+
+// diffuse and specular contribution of one light, bounded lights fade out smoothly at their radius
+vec3 ShadeLight(int index, vec3 position, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininessValue)
+{
+    vec4 lightPosRadius = texelFetch(lightData, 2 * index);
+    vec3 lightColor = texelFetch(lightData, 2 * index + 1).rgb;
+
+    vec3 toLight = lightPosRadius.xyz - position;
+    float attenuation = 1.0;
+    if (lightPosRadius.w > 0.0)
+    {
+        float falloff = clamp(1.0 - pow(length(toLight) / lightPosRadius.w, 4.0), 0.0, 1.0);
+        attenuation = falloff * falloff;
+    }
+
+    vec3 lightDir = normalize(toLight);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = lightColor * diff * diffuseColor;
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininessValue);
+    vec3 specular = lightColor * spec * specularColor;
+
+    return (diffuse + specular) * attenuation;
+}
+
+void main()
+{
+    vec3 ambientColor = materials[materialIndex].ambientColor.rgb;
+    vec3 diffuseColor = materials[materialIndex].diffuseColor.rgb;
+    vec3 specularColor = materials[materialIndex].specularColor.rgb;
+    float shininessValue = materials[materialIndex].specularColor.w;
+
+    vec3 normal = normalize(worldVertexNormal);
+
+    #ifdef HAS_DIFFUSE_TEXTURE
+    diffuseColor *= texture(diffuseTexture, vertexTexCoord).rgb;
+    #endif
+
+    vec3 color = 0.1 * ambientColor;
+    #ifdef AMBIENT_OCCLUSION
+    color *= texelFetch(ambientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+    #endif
+
+    vec3 viewDir = normalize(cameraPos.xyz - worldVertexPos);
+    float viewDepth = -(viewMatrix * vec4(worldVertexPos, 1.0)).z;
+
+    #ifdef SHADOWS
+    float keyLightVisibility = KeyLightVisibility(worldVertexPos, normal, viewDepth);
+    #else
+    float keyLightVisibility = 1.0;
+    #endif
+
+    #ifdef CLUSTERED_LIGHTS
+    for (int i = 0; i < int(lightCounts.y); ++i)
+    {
+        color += ShadeLight(i, worldVertexPos, normal, viewDir, diffuseColor, specularColor, shininessValue) * (i == 0 ? keyLightVisibility : 1.0);
+    }
+
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * viewportSize.zw * vec2(clusterCounts.xy)),
+                          uint(max(log(viewDepth) * clusterDepthParams.x - clusterDepthParams.y, 0.0)));
+    cluster = min(cluster, clusterCounts.xyz - 1u);
+
+    uvec2 lightRange = texelFetch(clusterData, int((cluster.z * clusterCounts.y + cluster.y) * clusterCounts.x + cluster.x)).xy;
+    for (uint i = 0u; i < lightRange.y; ++i)
+    {
+        int lightIndex = int(texelFetch(clusterLightIndices, int(lightRange.x + i)).r);
+        color += ShadeLight(lightIndex, worldVertexPos, normal, viewDir, diffuseColor, specularColor, shininessValue);
+    }
+    #else
+    // forward shading pays for every light on every fragment
+    for (int i = 0; i < int(lightCounts.x); ++i)
+    {
+        color += ShadeLight(i, worldVertexPos, normal, viewDir, diffuseColor, specularColor, shininessValue) * (i == 0 ? keyLightVisibility : 1.0);
+    }
+    #endif
+
+    FragColor = vec4(color, 1);
+}
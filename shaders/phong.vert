@@ -0,0 +1,40 @@
+// transforms vertices to clip space and passes data to fragment shader
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+
+out vec3 worldVertexPos;
+out vec3 worldVertexNormal;
+out vec2 vertexTexCoord;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+uniform mat4 modelMatrix;
+
+// the depth pre-pass computes the same position, GL_EQUAL needs bit-identical depth
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldPos = modelMatrix * vec4(aPos, 1.0);
+    vec3 worldNormal = transpose(inverse(mat3(modelMatrix))) * aNormal;
+
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+
+    worldVertexPos = worldPos.xyz;
+    worldVertexNormal = worldNormal;
+    vertexTexCoord = aTexCoord;
+}
+
@@ -0,0 +1,225 @@
+// screen-space ambient occlusion at a reduced resolution: by default estimates occlusion from cosine-weighted hemisphere
+// samples around the depth buffer's surface, GBUFFER_NORMALS takes the normals from the G-buffer instead of reconstructing
+// them, TEMPORAL_ACCUMULATION blends the estimate into the reprojected history and BILATERAL_UPSAMPLE brings the result
+// to full resolution; the reduced resolution passes write occlusion and view depth
+#version 330 core
+
+out vec4 FragColor;
+
+layout (std140) uniform Frame
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 inverseViewProjectionMatrix;
+    vec4 cameraPos;
+    vec4 viewportSize;
+    uvec4 lightCounts;
+    vec4 clusterDepthParams;
+    uvec4 clusterCounts;
+};
+
+// full resolution depth, every pixel of the reduced resolution reads the centre of the block it covers
+uniform sampler2D depthTexture;
+uniform int resolutionDivisor;
+
+// written for the background, far beyond anything the depth comparisons accept
+const float BackgroundDepth = 60000.0;
+
+float ViewDepth(float depth)
+{
+    return projectionMatrix[3][2] / (depth * 2.0 - 1.0 + projectionMatrix[2][2]);
+}
+
+vec3 WorldPosition(ivec2 pixel, float depth)
+{
+    vec4 clipPos = vec4((vec2(pixel) + 0.5) * viewportSize.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPos = inverseViewProjectionMatrix * clipPos;
+    return worldPos.xyz / worldPos.w;
+}
+
+ivec2 BlockCenter(ivec2 reducedPixel)
+{
+    return min(reducedPixel * resolutionDivisor + resolutionDivisor / 2, textureSize(depthTexture, 0) - 1);
+}
+
+#if defined(TEMPORAL_ACCUMULATION)
+
+uniform sampler2D occlusionTexture;
+uniform sampler2D historyTexture;
+uniform mat4 previousViewProjectionMatrix;
+uniform bool historyValid;
+
+// share of the new estimate, the history averages about the last ten frames
+const float EstimateWeight = 0.1;
+
+void main()
+{
+    ivec2 reducedPixel = ivec2(gl_FragCoord.xy);
+    vec2 estimate = texelFetch(occlusionTexture, reducedPixel, 0).rg;
+
+    FragColor = vec4(estimate, 0.0, 1.0);
+    if (!historyValid || estimate.y >= BackgroundDepth)
+    {
+        return;
+    }
+
+    ivec2 pixel = BlockCenter(reducedPixel);
+    vec4 previousClipPos = previousViewProjectionMatrix * vec4(WorldPosition(pixel, texelFetch(depthTexture, pixel, 0).r), 1.0);
+    vec2 previousTexCoord = previousClipPos.xy / previousClipPos.w * 0.5 + 0.5;
+    if (any(lessThan(previousTexCoord, vec2(0.0))) || any(greaterThanEqual(previousTexCoord, vec2(1.0))))
+    {
+        return;
+    }
+
+    // the history belongs to this surface when the depth it stored is where this position was last frame
+    vec2 history = texelFetch(historyTexture, ivec2(previousTexCoord * vec2(textureSize(historyTexture, 0))), 0).rg;
+    if (abs(history.y - previousClipPos.w) < 0.05 * previousClipPos.w)
+    {
+        FragColor.r = mix(history.x, estimate.x, EstimateWeight);
+    }
+}
+
+#elif defined(BILATERAL_UPSAMPLE)
+
+uniform sampler2D occlusionTexture;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(depthTexture, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        FragColor = vec4(1.0);
+        return;
+    }
+
+    float viewDepth = ViewDepth(depth);
+
+    // the four reduced resolution pixels whose block centres surround this pixel
+    ivec2 reducedSize = textureSize(occlusionTexture, 0);
+    vec2 reducedPos = (vec2(pixel) - float(resolutionDivisor / 2)) / float(resolutionDivisor);
+    ivec2 base = ivec2(floor(reducedPos));
+    vec2 fraction = reducedPos - vec2(base);
+
+    float occlusion = 0.0;
+    float totalWeight = 0.0;
+    for (int y = 0; y <= 1; ++y)
+    {
+        for (int x = 0; x <= 1; ++x)
+        {
+            vec2 neighbour = texelFetch(occlusionTexture, clamp(base + ivec2(x, y), ivec2(0), reducedSize - 1), 0).rg;
+            float bilinearWeight = (x == 0 ? 1.0 - fraction.x : fraction.x) * (y == 0 ? 1.0 - fraction.y : fraction.y);
+            float depthWeight = 1.0 / (0.001 + abs(neighbour.y - viewDepth) / viewDepth);
+
+            occlusion += neighbour.x * bilinearWeight * depthWeight;
+            totalWeight += bilinearWeight * depthWeight;
+        }
+    }
+
+    occlusion = totalWeight > 0.0 ? occlusion / totalWeight : 1.0;
+    FragColor = vec4(vec3(occlusion), 1.0);
+}
+
+#else
+
+#ifdef GBUFFER_NORMALS
+uniform sampler2D normalShininessTexture;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0.0)
+    {
+        normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return normalize(normal);
+}
+#endif
+
+uniform float radius;
+uniform uint frameIndex;
+
+const int SampleCount = 12;
+const float GoldenAngle = 2.39996323;
+
+// the neighbour on the side with the smaller depth step, which keeps silhouettes from bending the normal
+vec3 NeighbourDelta(ivec2 pixel, vec3 position, ivec2 offset)
+{
+    ivec2 maxPixel = textureSize(depthTexture, 0) - 1;
+    ivec2 forwardPixel = clamp(pixel + offset, ivec2(0), maxPixel);
+    ivec2 backwardPixel = clamp(pixel - offset, ivec2(0), maxPixel);
+    vec3 forward = WorldPosition(forwardPixel, texelFetch(depthTexture, forwardPixel, 0).r) - position;
+    vec3 backward = position - WorldPosition(backwardPixel, texelFetch(depthTexture, backwardPixel, 0).r);
+
+    return dot(forward, forward) < dot(backward, backward) ? forward : backward;
+}
+
+void main()
+{
+    ivec2 reducedPixel = ivec2(gl_FragCoord.xy);
+    ivec2 pixel = BlockCenter(reducedPixel);
+
+    float depth = texelFetch(depthTexture, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        FragColor = vec4(1.0, BackgroundDepth, 0.0, 1.0);
+        return;
+    }
+
+    vec3 position = WorldPosition(pixel, depth);
+    vec3 toCamera = cameraPos.xyz - position;
+
+    #ifdef GBUFFER_NORMALS
+    vec3 normal = DecodeOctahedral(texelFetch(normalShininessTexture, pixel, 0).xy);
+    #else
+    vec3 normal = normalize(cross(NeighbourDelta(pixel, position, ivec2(1, 0)), NeighbourDelta(pixel, position, ivec2(0, 1))));
+    #endif
+    if (dot(normal, toCamera) < 0.0)
+    {
+        normal = -normal;
+    }
+
+    vec3 tangent = normalize(abs(normal.y) < 0.99 ? cross(normal, vec3(0.0, 1.0, 0.0)) : cross(normal, vec3(1.0, 0.0, 0.0)));
+    vec3 bitangent = cross(normal, tangent);
+
+    // interleaved gradient noise rotates the spiral per pixel, the frame index turns it on so the history sees new directions
+    float noise = fract(52.9829189 * fract(dot(vec2(reducedPixel), vec2(0.06711056, 0.00583715))));
+    float rotation = 6.28318531 * fract(noise + float(frameIndex % 64u) * 0.618034);
+
+    mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+    float viewDepth = ViewDepth(depth);
+
+    // offset along the normal by a fraction of the radius so flat surfaces don't occlude themselves
+    vec3 origin = position + normal * radius * 0.02;
+
+    float occlusion = 0.0;
+    for (int i = 0; i < SampleCount; ++i)
+    {
+        // a golden angle spiral over the disc, lifted onto the hemisphere, is cosine-weighted
+        float discRadius = sqrt((float(i) + 0.5) / float(SampleCount));
+        float angle = float(i) * GoldenAngle + rotation;
+        vec3 direction = tangent * (discRadius * cos(angle)) + bitangent * (discRadius * sin(angle)) + normal * sqrt(1.0 - discRadius * discRadius);
+        float sampleDistance = radius * (0.25 + 0.75 * fract(noise + float(i) * 0.618034));
+
+        vec4 sampleClipPos = viewProjectionMatrix * vec4(origin + direction * sampleDistance, 1.0);
+        vec2 sampleTexCoord = sampleClipPos.xy / sampleClipPos.w * 0.5 + 0.5;
+        if (any(lessThan(sampleTexCoord, vec2(0.0))) || any(greaterThanEqual(sampleTexCoord, vec2(1.0))))
+        {
+            continue;
+        }
+
+        float sceneDepth = texelFetch(depthTexture, ivec2(sampleTexCoord * vec2(textureSize(depthTexture, 0))), 0).r;
+        float sceneViewDepth = ViewDepth(sceneDepth);
+
+        // only geometry within the radius occludes, a wall far in front of the sample fades out
+        float rangeWeight = smoothstep(0.0, 1.0, radius / abs(viewDepth - sceneViewDepth));
+        occlusion += (sceneDepth < 1.0 && sceneViewDepth < sampleClipPos.w - 0.01 * radius) ? rangeWeight : 0.0;
+    }
+
+    FragColor = vec4(1.0 - occlusion / float(SampleCount), viewDepth, 0.0, 1.0);
+}
+
+#endif
@@ -0,0 +1,319 @@
+#include "ambient_occlusion.h"
+
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "frame_uniforms.h"
+
+namespace
+{
+
+// inputs of the occlusion passes, bound again by every pass that reads them
+const int DepthTextureUnit = 2;
+const int NormalTextureUnit = 3;
+const int HistoryTextureUnit = 3;
+const int OcclusionInputTextureUnit = 4;
+
+unsigned int CreateTargetTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture;
+}
+
+unsigned int CreateFramebuffer(GLenum attachment, unsigned int texture, const char* name)
+{
+    unsigned int framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+
+    if (attachment == GL_DEPTH_ATTACHMENT)
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{std::string{name} + " framebuffer is incomplete"};
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return framebuffer;
+}
+
+void BindTexture(int textureUnit, unsigned int texture)
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+} // namespace
+
+AmbientOcclusionPass::AmbientOcclusionPass(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                           int width, int height, int resolutionDivisor, float radius)
+    : width{width},
+      height{height},
+      resolutionDivisor{resolutionDivisor},
+      radius{radius},
+      enabled{true},
+      outputCleared{false},
+      historyValid{false},
+      frameIndex{0},
+      previousViewProjectionMatrix{1.0f},
+      currentHistory{0}
+{
+    const std::vector<UniformBlockBinding> uniformBlockBindings{{"Frame", FrameBlockBinding}};
+    const std::vector<SamplerBinding> samplerBindings{{"depthTexture", DepthTextureUnit},
+                                                      {"normalShininessTexture", NormalTextureUnit},
+                                                      {"historyTexture", HistoryTextureUnit},
+                                                      {"occlusionTexture", OcclusionInputTextureUnit}};
+
+    occlusionShaders.reset(new ShaderPermutationSet{shaderCache, vertexShaderSource, fragmentShaderSource, uniformBlockBindings, samplerBindings});
+    estimatePermutation = occlusionShaders->Add({});
+    gBufferEstimatePermutation = occlusionShaders->Add({"GBUFFER_NORMALS"});
+    temporalPermutation = occlusionShaders->Add({"TEMPORAL_ACCUMULATION"});
+    upsamplePermutation = occlusionShaders->Add({"BILATERAL_UPSAMPLE"});
+    occlusionShaders->CompileAll();
+
+    glGenVertexArrays(1, &emptyVertexArray);
+
+    CreateTargets();
+}
+
+AmbientOcclusionPass::~AmbientOcclusionPass()
+{
+    DestroyTargets();
+
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+void AmbientOcclusionPass::Resize(int width, int height)
+{
+    if ((width == this->width && height == this->height) || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DestroyTargets();
+    CreateTargets();
+}
+
+void AmbientOcclusionPass::SetEnabled(bool enabled)
+{
+    this->enabled = enabled;
+
+    historyValid = false;
+    outputCleared = false;
+}
+
+bool AmbientOcclusionPass::IsEnabled() const
+{
+    return enabled;
+}
+
+int AmbientOcclusionPass::GetResolutionDivisor() const
+{
+    return resolutionDivisor;
+}
+
+void AmbientOcclusionPass::RenderDepth(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass, const DrawVisibility& visibility)
+{
+    if (enabled == false)
+    {
+        return;
+    }
+
+    const float clearDepth = 1.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+    glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+    depthPrepass.SubmitDepth(drawList, visibility);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void AmbientOcclusionPass::Render(const glm::mat4& viewProjectionMatrix)
+{
+    if (enabled)
+    {
+        Upsample(RenderOcclusion(viewProjectionMatrix, depthTexture, 0), depthTexture);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, occlusionFramebuffer);
+        glDisable(GL_DEPTH_TEST);
+        DrawFullscreen(upsamplePermutation);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    else if (outputCleared == false)
+    {
+        const float clearOne[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+        glBindFramebuffer(GL_FRAMEBUFFER, occlusionFramebuffer);
+        glClearBufferfv(GL_COLOR, 0, clearOne);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        outputCleared = true;
+    }
+
+    BindTexture(AmbientOcclusionTextureUnit, occlusionTexture);
+}
+
+void AmbientOcclusionPass::RenderFromGBuffer(const glm::mat4& viewProjectionMatrix, unsigned int depthTexture, unsigned int normalTexture,
+                                             unsigned int targetFramebuffer)
+{
+    if (enabled == false)
+    {
+        return;
+    }
+
+    Upsample(RenderOcclusion(viewProjectionMatrix, depthTexture, normalTexture), depthTexture);
+
+    // the target holds only the ambient term so far, multiplying it leaves the lights unoccluded
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+
+    DrawFullscreen(upsamplePermutation);
+
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void AmbientOcclusionPass::ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    occlusionShaders->Reload(vertexShaderSource, fragmentShaderSource);
+}
+
+bool AmbientOcclusionPass::UpdateShaders()
+{
+    return occlusionShaders->Update();
+}
+
+void AmbientOcclusionPass::CreateTargets()
+{
+    const int reducedWidth = (width + resolutionDivisor - 1) / resolutionDivisor;
+    const int reducedHeight = (height + resolutionDivisor - 1) / resolutionDivisor;
+
+    depthTexture = CreateTargetTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    estimateTexture = CreateTargetTexture(GL_RG16F, GL_RG, GL_HALF_FLOAT, reducedWidth, reducedHeight);
+    historyTextures[0] = CreateTargetTexture(GL_RG16F, GL_RG, GL_HALF_FLOAT, reducedWidth, reducedHeight);
+    historyTextures[1] = CreateTargetTexture(GL_RG16F, GL_RG, GL_HALF_FLOAT, reducedWidth, reducedHeight);
+    occlusionTexture = CreateTargetTexture(GL_R8, GL_RED, GL_UNSIGNED_BYTE, width, height);
+
+    depthFramebuffer = CreateFramebuffer(GL_DEPTH_ATTACHMENT, depthTexture, "ambient occlusion depth");
+    estimateFramebuffer = CreateFramebuffer(GL_COLOR_ATTACHMENT0, estimateTexture, "ambient occlusion estimate");
+    historyFramebuffers[0] = CreateFramebuffer(GL_COLOR_ATTACHMENT0, historyTextures[0], "ambient occlusion history");
+    historyFramebuffers[1] = CreateFramebuffer(GL_COLOR_ATTACHMENT0, historyTextures[1], "ambient occlusion history");
+    occlusionFramebuffer = CreateFramebuffer(GL_COLOR_ATTACHMENT0, occlusionTexture, "ambient occlusion");
+
+    historyValid = false;
+    outputCleared = false;
+}
+
+void AmbientOcclusionPass::DestroyTargets()
+{
+    glDeleteFramebuffers(1, &depthFramebuffer);
+    glDeleteFramebuffers(1, &estimateFramebuffer);
+    glDeleteFramebuffers(2, historyFramebuffers);
+    glDeleteFramebuffers(1, &occlusionFramebuffer);
+
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &estimateTexture);
+    glDeleteTextures(2, historyTextures);
+    glDeleteTextures(1, &occlusionTexture);
+}
+
+unsigned int AmbientOcclusionPass::RenderOcclusion(const glm::mat4& viewProjectionMatrix, unsigned int depthTexture, unsigned int normalTexture)
+{
+    const int reducedWidth = (width + resolutionDivisor - 1) / resolutionDivisor;
+    const int reducedHeight = (height + resolutionDivisor - 1) / resolutionDivisor;
+
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glViewport(0, 0, reducedWidth, reducedHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    BindTexture(DepthTextureUnit, depthTexture);
+
+    const ShaderPermutation estimate = (normalTexture != 0) ? gBufferEstimatePermutation : estimatePermutation;
+    if (normalTexture != 0)
+    {
+        BindTexture(NormalTextureUnit, normalTexture);
+    }
+
+    const unsigned int estimateProgram = occlusionShaders->GetProgram(estimate);
+    glUseProgram(estimateProgram);
+    glUniform1i(glGetUniformLocation(estimateProgram, "resolutionDivisor"), resolutionDivisor);
+    glUniform1f(glGetUniformLocation(estimateProgram, "radius"), radius);
+    glUniform1ui(glGetUniformLocation(estimateProgram, "frameIndex"), frameIndex);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, estimateFramebuffer);
+    DrawFullscreen(estimate);
+
+    // the estimate is blended into last frame's history, reprojected with last frame's camera
+    const unsigned int previousHistory = currentHistory;
+    currentHistory ^= 1u;
+
+    BindTexture(OcclusionInputTextureUnit, estimateTexture);
+    BindTexture(HistoryTextureUnit, historyTextures[previousHistory]);
+
+    const unsigned int temporalProgram = occlusionShaders->GetProgram(temporalPermutation);
+    glUseProgram(temporalProgram);
+    glUniform1i(glGetUniformLocation(temporalProgram, "resolutionDivisor"), resolutionDivisor);
+    glUniform1i(glGetUniformLocation(temporalProgram, "historyValid"), historyValid ? 1 : 0);
+    glUniformMatrix4fv(glGetUniformLocation(temporalProgram, "previousViewProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(previousViewProjectionMatrix));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFramebuffers[currentHistory]);
+    DrawFullscreen(temporalPermutation);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_DEPTH_TEST);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+    previousViewProjectionMatrix = viewProjectionMatrix;
+    historyValid = true;
+    ++frameIndex;
+
+    return historyTextures[currentHistory];
+}
+
+void AmbientOcclusionPass::Upsample(unsigned int occlusionTexture, unsigned int depthTexture)
+{
+    BindTexture(DepthTextureUnit, depthTexture);
+    BindTexture(OcclusionInputTextureUnit, occlusionTexture);
+
+    const unsigned int program = occlusionShaders->GetProgram(upsamplePermutation);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "resolutionDivisor"), resolutionDivisor);
+}
+
+void AmbientOcclusionPass::DrawFullscreen(ShaderPermutation permutation)
+{
+    glUseProgram(occlusionShaders->GetProgram(permutation));
+    glBindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
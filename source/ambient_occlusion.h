@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "depth_prepass.h"
+
+// texture unit of the full resolution occlusion the forward scene shaders read, programs name the sampler ambientOcclusion
+const int AmbientOcclusionTextureUnit = 9;
+
+// Screen-space ambient occlusion of the ambient term. Occlusion is estimated
+// at half or quarter resolution from the depth buffer, with normals from the
+// G-buffer when there is one and reconstructed from depth otherwise: a
+// cosine-weighted hemisphere of samples around each pixel is projected back
+// onto the screen and compared with the depth found there. The sample pattern
+// rotates every frame and the estimates are accumulated over frames, each
+// pixel reprojected into the previous frame's history with the previous
+// camera and restarted where the depth there doesn't match. A bilateral
+// upsample then weighs the four nearest low resolution pixels by how close
+// their depth is to the full resolution pixel's, so occlusion doesn't bleed
+// across silhouettes. The result is either kept in a full resolution texture
+// for the forward shaders or multiplied into the deferred renderer's light
+// accumulation target while it only holds the ambient term. Each pass writes
+// the view depth next to the occlusion for the next one to compare with.
+class AmbientOcclusionPass
+{
+public:
+    // resolutionDivisor is 2 for half and 4 for quarter resolution, radius is the sampled distance in world units
+    AmbientOcclusionPass(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, int width, int height,
+                         int resolutionDivisor, float radius);
+    ~AmbientOcclusionPass();
+
+    AmbientOcclusionPass(const AmbientOcclusionPass&) = delete;
+    AmbientOcclusionPass& operator=(const AmbientOcclusionPass&) = delete;
+
+    // reallocates the targets when the framebuffer size changed
+    void Resize(int width, int height);
+
+    // a disabled pass leaves the occlusion texture at 1 and the deferred light accumulation alone
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    int GetResolutionDivisor() const;
+
+    // forward shading: draws the scene's depth into the pass's own depth target for Render
+    void RenderDepth(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass, const DrawVisibility& visibility = DrawVisibility{});
+
+    // forward shading: computes occlusion from the depth drawn by RenderDepth and binds the full resolution
+    // result to AmbientOcclusionTextureUnit for the scene pass
+    void Render(const glm::mat4& viewProjectionMatrix);
+
+    // deferred shading: computes occlusion from the G-buffer and multiplies it into the colour of targetFramebuffer
+    void RenderFromGBuffer(const glm::mat4& viewProjectionMatrix, unsigned int depthTexture, unsigned int normalTexture, unsigned int targetFramebuffer);
+
+    void ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool UpdateShaders();
+
+private:
+    void CreateTargets();
+    void DestroyTargets();
+
+    // estimate and temporal accumulation at the reduced resolution, returns the accumulated texture
+    unsigned int RenderOcclusion(const glm::mat4& viewProjectionMatrix, unsigned int depthTexture, unsigned int normalTexture);
+    void Upsample(unsigned int occlusionTexture, unsigned int depthTexture);
+    void DrawFullscreen(ShaderPermutation permutation);
+
+    std::unique_ptr<ShaderPermutationSet> occlusionShaders;
+    ShaderPermutation estimatePermutation;
+    ShaderPermutation gBufferEstimatePermutation;
+    ShaderPermutation temporalPermutation;
+    ShaderPermutation upsamplePermutation;
+
+    int width;
+    int height;
+    int resolutionDivisor;
+    float radius;
+    bool enabled;
+    bool outputCleared;  // the occlusion texture holds 1 everywhere since the pass was disabled
+
+    // accumulation restarts when the history doesn't belong to the previous frame
+    bool historyValid;
+    unsigned int frameIndex;
+    glm::mat4 previousViewProjectionMatrix;
+
+    unsigned int depthTexture;                // forward shading only
+    unsigned int estimateTexture;             // GL_RG16F occlusion and view depth at the reduced resolution
+    unsigned int historyTextures[2];          // the same, accumulated, ping-ponged between frames
+    unsigned int occlusionTexture;            // GL_R8 at full resolution, forward shading only
+    unsigned int depthFramebuffer;
+    unsigned int estimateFramebuffer;
+    unsigned int historyFramebuffers[2];
+    unsigned int occlusionFramebuffer;
+    unsigned int currentHistory;
+    unsigned int emptyVertexArray;
+};
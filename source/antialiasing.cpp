@@ -0,0 +1,215 @@
+#include "antialiasing.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+const int SceneTextureUnit = 2;
+
+} // namespace
+
+AntialiasingPass::AntialiasingPass(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, int width,
+                                   int height)
+    : mode{Antialiasing::Off},
+      sampleCount{1},
+      width{width},
+      height{height},
+      colorTexture{0},
+      colorRenderbuffer{0},
+      depthRenderbuffer{0},
+      framebuffer{0}
+{
+    const std::vector<SamplerBinding> samplerBindings{{"sceneTexture", SceneTextureUnit}};
+
+    fxaaShaders.reset(new ShaderPermutationSet{shaderCache, vertexShaderSource, fragmentShaderSource, {}, samplerBindings});
+    fxaaPermutation = fxaaShaders->Add({});
+    fxaaShaders->CompileAll();
+
+    glGenVertexArrays(1, &emptyVertexArray);
+}
+
+AntialiasingPass::~AntialiasingPass()
+{
+    DestroyTargets();
+
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+int AntialiasingPass::GetMaxSamples()
+{
+    int maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+
+    return maxSamples;
+}
+
+void AntialiasingPass::SetMode(Antialiasing mode, int sampleCount)
+{
+    sampleCount = (mode == Antialiasing::Msaa) ? std::max(1, std::min(sampleCount, GetMaxSamples())) : 1;
+    if (mode == this->mode && sampleCount == this->sampleCount)
+    {
+        return;
+    }
+
+    DestroyTargets();
+
+    this->mode = mode;
+    this->sampleCount = sampleCount;
+
+    CreateTargets();
+}
+
+Antialiasing AntialiasingPass::GetMode() const
+{
+    return mode;
+}
+
+int AntialiasingPass::GetSampleCount() const
+{
+    return sampleCount;
+}
+
+std::string AntialiasingPass::GetDescription() const
+{
+    switch (mode)
+    {
+    case Antialiasing::Msaa:
+        return "msaa " + std::to_string(sampleCount) + "x";
+    case Antialiasing::MsaaWindow:
+        return "msaa window";
+    case Antialiasing::Fxaa:
+        return "fxaa";
+    default:
+        return "off";
+    }
+}
+
+void AntialiasingPass::Resize(int width, int height)
+{
+    if ((width == this->width && height == this->height) || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DestroyTargets();
+    CreateTargets();
+}
+
+unsigned int AntialiasingPass::GetFramebuffer() const
+{
+    return framebuffer;
+}
+
+void AntialiasingPass::Begin(const glm::vec4& clearColor)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void AntialiasingPass::Resolve()
+{
+    if (mode == Antialiasing::Msaa)
+    {
+        // a multisample resolve needs equal rectangles and GL_NEAREST
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    else if (mode == Antialiasing::Fxaa)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glDisable(GL_DEPTH_TEST);
+
+        glActiveTexture(GL_TEXTURE0 + SceneTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glUseProgram(fxaaShaders->GetProgram(fxaaPermutation));
+        glBindVertexArray(emptyVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void AntialiasingPass::ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    fxaaShaders->Reload(vertexShaderSource, fragmentShaderSource);
+}
+
+bool AntialiasingPass::UpdateShaders()
+{
+    return fxaaShaders->Update();
+}
+
+void AntialiasingPass::CreateTargets()
+{
+    if (mode != Antialiasing::Msaa && mode != Antialiasing::Fxaa)
+    {
+        return;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    if (mode == Antialiasing::Msaa)
+    {
+        glGenRenderbuffers(1, &colorRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+    }
+    else
+    {
+        // FXAA samples between pixels along the edge, so the scene texture is filtered
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    }
+
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, (mode == Antialiasing::Msaa) ? sampleCount : 0, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{"antialiasing framebuffer is incomplete"};
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void AntialiasingPass::DestroyTargets()
+{
+    // deleting name 0 is ignored, so unused targets need no checks
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteTextures(1, &colorTexture);
+
+    framebuffer = 0;
+    depthRenderbuffer = 0;
+    colorRenderbuffer = 0;
+    colorTexture = 0;
+}
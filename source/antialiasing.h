@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "options.h"
+#include "shader_permutations.h"
+
+// Antialiasing of the lit scene through an offscreen framebuffer. With MSAA
+// the scene is drawn into multisampled colour and depth renderbuffers and
+// resolved into the default framebuffer with glBlitFramebuffer. With FXAA it is
+// drawn into a single-sampled texture, and fxaa.frag blurs the pixels on
+// high-contrast edges along the edge direction on the way to the default
+// framebuffer. Off and MsaaWindow draw straight to the default framebuffer:
+// the window's samples are resolved by the driver on swap.
+class AntialiasingPass
+{
+public:
+    AntialiasingPass(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, int width, int height);
+    ~AntialiasingPass();
+
+    AntialiasingPass(const AntialiasingPass&) = delete;
+    AntialiasingPass& operator=(const AntialiasingPass&) = delete;
+
+    // GL_MAX_SAMPLES of the context
+    static int GetMaxSamples();
+
+    // reallocates the targets for the mode, sampleCount is clamped to GetMaxSamples() and only used by Msaa
+    void SetMode(Antialiasing mode, int sampleCount);
+    Antialiasing GetMode() const;
+    int GetSampleCount() const;  // 1 unless the mode is Msaa
+
+    // "off", "fxaa" or "msaa 4x"
+    std::string GetDescription() const;
+
+    // reallocates the targets when the framebuffer size changed
+    void Resize(int width, int height);
+
+    // framebuffer the scene is drawn into, 0 when there is no offscreen target
+    unsigned int GetFramebuffer() const;
+
+    // binds and clears the framebuffer the scene is drawn into
+    void Begin(const glm::vec4& clearColor);
+
+    // resolves or filters the scene into the default framebuffer, which stays bound
+    void Resolve();
+
+    void ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool UpdateShaders();
+
+private:
+    void CreateTargets();
+    void DestroyTargets();
+
+    std::unique_ptr<ShaderPermutationSet> fxaaShaders;
+    ShaderPermutation fxaaPermutation;
+
+    Antialiasing mode;
+    int sampleCount;
+
+    int width;
+    int height;
+
+    unsigned int colorTexture;       // FXAA input
+    unsigned int colorRenderbuffer;  // multisampled colour
+    unsigned int depthRenderbuffer;
+    unsigned int framebuffer;
+    unsigned int emptyVertexArray;
+};
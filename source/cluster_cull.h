@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+// what the cull test found for a cluster
+const unsigned char ClusterVisible = 0;
+const unsigned char ClusterOutsideFrustum = 1;
+const unsigned char ClusterBackFacing = 2;
+
+// Bounding spheres and normal cones of clusters as one array per component,
+// padded to a multiple of 8 entries. Every triangle normal of a cluster lies
+// within coneCutoff of coneAxis: coneCutoff is the sine of the cone's half
+// angle, 1 for cones that can never face away from the camera.
+struct ClusterBounds
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* radius;
+    const float* coneAxisX;
+    const float* coneAxisY;
+    const float* coneAxisZ;
+    const float* coneCutoff;
+};
+
+struct ClusterCullView
+{
+    // world-space planes (a, b, c, d) with normalized (a, b, c) pointing into the frustum
+    float frustumPlanes[6][4];
+    float cameraPosition[3];
+};
+
+// Writes ClusterVisible, ClusterOutsideFrustum or ClusterBackFacing for clusters
+// [first, first + count). A sphere is outside when it lies entirely behind one
+// plane. A cluster faces away when the direction from the camera to every point
+// of its sphere is within 90 degrees minus the cone's half angle of the axis:
+// dot(center - camera, axis) >= coneCutoff * |center - camera| + radius.
+void CullClustersScalar(const ClusterBounds& bounds, const ClusterCullView& view, std::size_t first, std::size_t count, unsigned char* results);
+
+// Same tests 8 clusters at a time, first and count must be multiples of 8. Built with AVX2 and
+// FMA enabled in a translation unit of its own (x86-64 only, RASTER_AVX2), call it only when the CPU supports both.
+void CullClustersAvx2(const ClusterBounds& bounds, const ClusterCullView& view, std::size_t first, std::size_t count, unsigned char* results);
@@ -0,0 +1,63 @@
+#include "cluster_cull.h"
+
+#include <immintrin.h>
+
+// This file is compiled with AVX2 enabled. It must not call inline functions from
+// other headers: the linker may keep this file's AVX2 copy for the whole program.
+
+void CullClustersAvx2(const ClusterBounds& bounds, const ClusterCullView& view, std::size_t first, std::size_t count, unsigned char* results)
+{
+    __m256 planes[6][4];
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        for (int component = 0; component < 4; ++component)
+        {
+            planes[plane][component] = _mm256_set1_ps(view.frustumPlanes[plane][component]);
+        }
+    }
+
+    const __m256 cameraX = _mm256_set1_ps(view.cameraPosition[0]);
+    const __m256 cameraY = _mm256_set1_ps(view.cameraPosition[1]);
+    const __m256 cameraZ = _mm256_set1_ps(view.cameraPosition[2]);
+
+    for (std::size_t i = first; i < first + count; i += 8)
+    {
+        const __m256 centerX = _mm256_loadu_ps(bounds.centerX + i);
+        const __m256 centerY = _mm256_loadu_ps(bounds.centerY + i);
+        const __m256 centerZ = _mm256_loadu_ps(bounds.centerZ + i);
+        const __m256 radius = _mm256_loadu_ps(bounds.radius + i);
+        const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            __m256 distance = _mm256_fmadd_ps(planes[plane][0], centerX, planes[plane][3]);
+            distance = _mm256_fmadd_ps(planes[plane][1], centerY, distance);
+            distance = _mm256_fmadd_ps(planes[plane][2], centerZ, distance);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+        }
+
+        const __m256 toCenterX = _mm256_sub_ps(centerX, cameraX);
+        const __m256 toCenterY = _mm256_sub_ps(centerY, cameraY);
+        const __m256 toCenterZ = _mm256_sub_ps(centerZ, cameraZ);
+
+        __m256 distanceSquared = _mm256_mul_ps(toCenterX, toCenterX);
+        distanceSquared = _mm256_fmadd_ps(toCenterY, toCenterY, distanceSquared);
+        distanceSquared = _mm256_fmadd_ps(toCenterZ, toCenterZ, distanceSquared);
+
+        __m256 alongAxis = _mm256_mul_ps(toCenterX, _mm256_loadu_ps(bounds.coneAxisX + i));
+        alongAxis = _mm256_fmadd_ps(toCenterY, _mm256_loadu_ps(bounds.coneAxisY + i), alongAxis);
+        alongAxis = _mm256_fmadd_ps(toCenterZ, _mm256_loadu_ps(bounds.coneAxisZ + i), alongAxis);
+
+        const __m256 limit = _mm256_fmadd_ps(_mm256_loadu_ps(bounds.coneCutoff + i), _mm256_sqrt_ps(distanceSquared), radius);
+        const __m256 backFacing = _mm256_cmp_ps(alongAxis, limit, _CMP_GE_OQ);
+
+        const int outsideMask = _mm256_movemask_ps(outside);
+        const int backFacingMask = _mm256_movemask_ps(backFacing);
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            results[i + lane] = ((outsideMask >> lane) & 1) != 0 ? ClusterOutsideFrustum
+                                                                  : (((backFacingMask >> lane) & 1) != 0 ? ClusterBackFacing : ClusterVisible);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#include "cpu_features.h"
+
+#if defined(RASTER_AVX2) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+bool IsAvx2Supported()
+{
+#if defined(RASTER_AVX2) && defined(_MSC_VER)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    const bool fma = (cpuInfo[2] & (1 << 12)) != 0;
+    const bool osSavesYmm = (cpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    __cpuidex(cpuInfo, 7, 0);
+    const bool avx2 = (cpuInfo[1] & (1 << 5)) != 0;
+
+    return avx2 && fma && osSavesYmm;
+#elif defined(RASTER_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
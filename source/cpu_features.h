@@ -0,0 +1,5 @@
+#pragma once
+
+// True when the CPU supports AVX2 and FMA and the OS saves the YMM registers.
+// Always false in builds without the AVX2 code paths (RASTER_AVX2, x86-64 only).
+bool IsAvx2Supported();
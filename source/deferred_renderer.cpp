@@ -0,0 +1,266 @@
+#include "deferred_renderer.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "frame_uniforms.h"
+#include "shadow_maps.h"
+
+namespace
+{
+
+// G-buffer textures are read by the light passes on the units after the light buffer
+const int AlbedoSpecularTextureUnit = 2;
+const int NormalShininessTextureUnit = 3;
+const int DepthTextureUnit = 4;
+
+// icosahedron with outward counter-clockwise faces, scaled so its faces touch the unit sphere
+const int volumeIndexCount = 60;
+
+std::vector<glm::vec3> MakeVolumeVertices()
+{
+    const float t = 1.6180340f;  // golden ratio
+    const float insphereScale = 1.0f / 0.7946545f;
+
+    std::vector<glm::vec3> vertices{
+        {-1.0f, t, 0.0f}, {1.0f, t, 0.0f}, {-1.0f, -t, 0.0f}, {1.0f, -t, 0.0f},
+        {0.0f, -1.0f, t}, {0.0f, 1.0f, t}, {0.0f, -1.0f, -t}, {0.0f, 1.0f, -t},
+        {t, 0.0f, -1.0f}, {t, 0.0f, 1.0f}, {-t, 0.0f, -1.0f}, {-t, 0.0f, 1.0f}};
+
+    for (auto& vertex : vertices)
+    {
+        vertex = glm::normalize(vertex) * insphereScale;
+    }
+
+    return vertices;
+}
+
+const unsigned short volumeIndices[volumeIndexCount] = {
+    0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+    1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+    3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+    4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1};
+
+unsigned int CreateTargetTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture;
+}
+
+void CheckFramebufferComplete(const char* name)
+{
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{std::string{name} + " framebuffer is incomplete"};
+    }
+}
+
+} // namespace
+
+DeferredRenderer::DeferredRenderer(ShaderCache& shaderCache, const std::string& lightVertexShaderSource, const std::string& lightFragmentShaderSource,
+                                   int width, int height, bool shadows)
+    : width{width},
+      height{height}
+{
+    const std::vector<UniformBlockBinding> uniformBlockBindings{{"Frame", FrameBlockBinding}, {"Shadows", ShadowBlockBinding}};
+    const std::vector<SamplerBinding> samplerBindings{{"lightData", LightBufferTextureUnit},
+                                                      {"albedoSpecularTexture", AlbedoSpecularTextureUnit},
+                                                      {"normalShininessTexture", NormalShininessTextureUnit},
+                                                      {"depthTexture", DepthTextureUnit},
+                                                      {"shadowMap", ShadowMapTextureUnit}};
+
+    // only the key light casts shadows, and it is shaded by the fullscreen pass
+    lightShaders.reset(new ShaderPermutationSet{shaderCache, lightVertexShaderSource, lightFragmentShaderSource, uniformBlockBindings, samplerBindings});
+    fullscreenPermutation = shadows ? lightShaders->Add({"SHADOWS"}) : lightShaders->Add({});
+    volumePermutation = lightShaders->Add({"LIGHT_VOLUME"});
+    lightShaders->CompileAll();
+
+    const std::vector<glm::vec3> volumeVertices = MakeVolumeVertices();
+
+    glGenVertexArrays(1, &volumeVertexArray);
+    glBindVertexArray(volumeVertexArray);
+
+    glGenBuffers(1, &volumeVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, volumeVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, volumeVertices.size() * sizeof(glm::vec3), volumeVertices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &volumeIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(volumeIndices), volumeIndices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+
+    glGenVertexArrays(1, &emptyVertexArray);
+
+    CreateTargets();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    DestroyTargets();
+
+    glDeleteVertexArrays(1, &emptyVertexArray);
+    glDeleteVertexArrays(1, &volumeVertexArray);
+    glDeleteBuffers(1, &volumeVertexBuffer);
+    glDeleteBuffers(1, &volumeIndexBuffer);
+}
+
+void DeferredRenderer::Resize(int width, int height)
+{
+    // minimized windows report a zero size, keep the old targets until it comes back
+    if ((width == this->width && height == this->height) || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DestroyTargets();
+    CreateTargets();
+}
+
+void DeferredRenderer::BeginGeometryPass(const glm::vec4& clearColor)
+{
+    const float clearZero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const float clearDepth = 1.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, geometryFramebuffer);
+
+    glClearBufferfv(GL_COLOR, 0, clearZero);
+    glClearBufferfv(GL_COLOR, 1, clearZero);
+    glClearBufferfv(GL_COLOR, 2, &clearColor.x);
+    glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+}
+
+void DeferredRenderer::ShadeLights(const LightBuffer& lightBuffer, unsigned int unboundedLightCount)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFramebuffer);
+
+    // the light passes read depth from a texture, testing against the same depth
+    // attachment would be a feedback loop, so the volumes are drawn without depth test
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    glActiveTexture(GL_TEXTURE0 + AlbedoSpecularTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, albedoSpecularTexture);
+    glActiveTexture(GL_TEXTURE0 + NormalShininessTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, normalShininessTexture);
+    glActiveTexture(GL_TEXTURE0 + DepthTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    if (unboundedLightCount > 0)
+    {
+        glUseProgram(lightShaders->GetProgram(fullscreenPermutation));
+        glBindVertexArray(emptyVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // back faces only, so every covered pixel is shaded once even with the camera inside a volume
+    if (lightBuffer.lightCount > unboundedLightCount)
+    {
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+
+        glUseProgram(lightShaders->GetProgram(volumePermutation));
+        glBindVertexArray(volumeVertexArray);
+        glDrawElementsInstanced(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_SHORT, (void*)0,
+                                static_cast<GLsizei>(lightBuffer.lightCount - unboundedLightCount));
+
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+    }
+
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+unsigned int DeferredRenderer::GetDepthTexture() const
+{
+    return depthTexture;
+}
+
+unsigned int DeferredRenderer::GetNormalShininessTexture() const
+{
+    return normalShininessTexture;
+}
+
+unsigned int DeferredRenderer::GetLightAccumulationFramebuffer() const
+{
+    return lightFramebuffer;
+}
+
+void DeferredRenderer::Present(unsigned int targetFramebuffer)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, lightFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::ReloadShaders(const std::string& lightVertexShaderSource, const std::string& lightFragmentShaderSource)
+{
+    lightShaders->Reload(lightVertexShaderSource, lightFragmentShaderSource);
+}
+
+bool DeferredRenderer::UpdateShaders()
+{
+    return lightShaders->Update();
+}
+
+void DeferredRenderer::CreateTargets()
+{
+    albedoSpecularTexture = CreateTargetTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalShininessTexture = CreateTargetTexture(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, width, height);
+    lightAccumulationTexture = CreateTargetTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+    depthTexture = CreateTargetTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+
+    glGenFramebuffers(1, &geometryFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, geometryFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecularTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalShininessTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, lightAccumulationTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+    const GLenum geometryDrawBuffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, geometryDrawBuffers);
+    CheckFramebufferComplete("G-buffer");
+
+    glGenFramebuffers(1, &lightFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lightAccumulationTexture, 0);
+    CheckFramebufferComplete("light accumulation");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::DestroyTargets()
+{
+    glDeleteFramebuffers(1, &geometryFramebuffer);
+    glDeleteFramebuffers(1, &lightFramebuffer);
+
+    const unsigned int textures[4] = {albedoSpecularTexture, normalShininessTexture, lightAccumulationTexture, depthTexture};
+    glDeleteTextures(4, textures);
+}
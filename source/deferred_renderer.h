@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "light_buffer.h"
+#include "shader_permutations.h"
+
+// Deferred shading for scenes with many lights. The geometry pass writes a
+// G-buffer of
+//   albedo and specular intensity   GL_RGBA8
+//   octahedral normal, shininess    GL_RGB10_A2
+//   depth                           GL_DEPTH_COMPONENT24 (positions are reconstructed from it)
+// plus the ambient term into a GL_RGBA16F light accumulation target. Unbounded
+// lights are then added with one fullscreen pass and every bounded light with an
+// instanced light volume that only touches the pixels within its radius, so the
+// lighting cost grows with the screen area the lights cover rather than with
+// lights times fragments.
+class DeferredRenderer
+{
+public:
+    // shadows shades the key light with the cascaded shadow maps bound for the frame
+    DeferredRenderer(ShaderCache& shaderCache, const std::string& lightVertexShaderSource, const std::string& lightFragmentShaderSource,
+                     int width, int height, bool shadows = false);
+    ~DeferredRenderer();
+
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    // reallocates the G-buffer when the framebuffer size changed
+    void Resize(int width, int height);
+
+    // binds and clears the G-buffer, the scene is then drawn with programs writing the G-buffer outputs
+    void BeginGeometryPass(const glm::vec4& clearColor);
+
+    // adds every light of the buffer on top of the ambient term, the first unboundedLightCount lights
+    // are shaded at every pixel and the remaining ones with light volumes
+    void ShadeLights(const LightBuffer& lightBuffer, unsigned int unboundedLightCount);
+
+    // G-buffer depth and octahedral normals, and the framebuffer of the light accumulation target,
+    // for passes that work on the G-buffer between the geometry pass and ShadeLights
+    unsigned int GetDepthTexture() const;
+    unsigned int GetNormalShininessTexture() const;
+    unsigned int GetLightAccumulationFramebuffer() const;
+
+    // copies the lit image to the target framebuffer, the default one unless an antialiasing pass filters it
+    void Present(unsigned int targetFramebuffer = 0);
+
+    // light shaders are permutations of one source pair and reload like the scene shaders
+    void ReloadShaders(const std::string& lightVertexShaderSource, const std::string& lightFragmentShaderSource);
+    bool UpdateShaders();
+
+private:
+    void CreateTargets();
+    void DestroyTargets();
+
+    std::unique_ptr<ShaderPermutationSet> lightShaders;
+    ShaderPermutation fullscreenPermutation;
+    ShaderPermutation volumePermutation;
+
+    int width;
+    int height;
+
+    unsigned int albedoSpecularTexture;
+    unsigned int normalShininessTexture;
+    unsigned int lightAccumulationTexture;
+    unsigned int depthTexture;
+    unsigned int geometryFramebuffer;
+    unsigned int lightFramebuffer;
+
+    unsigned int volumeVertexArray;
+    unsigned int volumeVertexBuffer;
+    unsigned int volumeIndexBuffer;
+    unsigned int emptyVertexArray;  // the fullscreen triangle is generated from gl_VertexID
+};
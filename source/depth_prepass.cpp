@@ -0,0 +1,155 @@
+#include "depth_prepass.h"
+
+#include <glad/glad.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "frame_uniforms.h"
+
+DepthPrepass::DepthPrepass(ShaderCache& shaderCache, GpuBufferPool& geometryPool, const std::string& vertexShaderSource,
+                           const std::string& fragmentShaderSource, const std::vector<Vertex>& vertices)
+    : geometryPool(geometryPool),
+      positionAllocation{0}
+{
+    const std::vector<UniformBlockBinding> uniformBlockBindings{{"Frame", FrameBlockBinding}};
+
+    depthShaders.reset(new ShaderPermutationSet{shaderCache, vertexShaderSource, fragmentShaderSource, uniformBlockBindings, {}});
+    depthPermutation = depthShaders->Add({});
+    countPermutation = depthShaders->Add({"COUNT_FRAGMENTS"});
+    shadowPermutation = depthShaders->Add({"SHADOW_CASTER"});
+    depthShaders->CompileAll();
+
+    glGenVertexArrays(1, &positionVertexArray);
+    glBindVertexArray(positionVertexArray);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    SetVertices(vertices);
+}
+
+DepthPrepass::~DepthPrepass()
+{
+    glDeleteVertexArrays(1, &positionVertexArray);
+    geometryPool.Free(positionAllocation);
+}
+
+void DepthPrepass::SetVertices(const std::vector<Vertex>& vertices)
+{
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& vertex : vertices)
+    {
+        positions.push_back(vertex.position);
+    }
+
+    geometryPool.Free(positionAllocation);
+    positionAllocation = geometryPool.Allocate(positions.size() * sizeof(glm::vec3));
+    geometryPool.Upload(positionAllocation, positions.data(), positions.size() * sizeof(glm::vec3));
+
+    RebindPositions();
+}
+
+void DepthPrepass::RebindPositions()
+{
+    const GpuBufferRange range = geometryPool.GetRange(positionAllocation);
+
+    glBindVertexArray(positionVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), reinterpret_cast<void*>(range.offset));
+    glBindVertexArray(0);
+}
+
+void DepthPrepass::Submit(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility)
+{
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    SubmitDepth(drawList, visibility);
+
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+}
+
+void DepthPrepass::SubmitDepth(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility)
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    Draw(drawList, visibility, depthShaders->GetProgram(depthPermutation));
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void DepthPrepass::EndShadingPass()
+{
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+void DepthPrepass::SubmitFragmentCount(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility)
+{
+    Draw(drawList, visibility, depthShaders->GetProgram(countPermutation));
+}
+
+void DepthPrepass::SubmitShadowCasters(const std::vector<DrawCommand>& drawList, const glm::mat4& lightViewProjectionMatrix,
+                                       const DrawVisibility& visibility)
+{
+    const unsigned int program = depthShaders->GetProgram(shadowPermutation);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "lightViewProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(lightViewProjectionMatrix));
+
+    Draw(drawList, visibility, program);
+}
+
+void DepthPrepass::ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    depthShaders->Reload(vertexShaderSource, fragmentShaderSource);
+}
+
+bool DepthPrepass::UpdateShaders()
+{
+    return depthShaders->Update();
+}
+
+void DepthPrepass::Draw(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility, unsigned int program)
+{
+    glUseProgram(program);
+    glBindVertexArray(positionVertexArray);
+
+    if (visibility.indirectBuffer != 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, visibility.indirectBuffer);
+    }
+
+    const int modelMatrixLocation = glGetUniformLocation(program, "modelMatrix");
+
+    // materials do not matter for depth, only the model matrix changes between draws
+    bool firstDraw = true;
+    glm::mat4 currentModelMatrix{1.0f};
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        const DrawCommand& drawCommand = drawList[drawIndex];
+
+        if (IsDrawVisible(visibility, drawIndex) == false)
+        {
+            continue;
+        }
+
+        if (firstDraw || drawCommand.modelMatrix != currentModelMatrix)
+        {
+            currentModelMatrix = drawCommand.modelMatrix;
+            glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(currentModelMatrix));
+        }
+
+        IssueDraw(drawList, drawIndex, visibility);
+
+        firstDraw = false;
+    }
+
+    if (visibility.indirectBuffer != 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    glBindVertexArray(0);
+}
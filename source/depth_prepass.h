@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "draw_list.h"
+#include "gpu_buffer_pool.h"
+#include "model.h"
+#include "shader_permutations.h"
+
+// Depth-only pass drawn before the shading pass so expensive fragment shading
+// runs once per pixel instead of once per overlapping surface. The positions
+// of the model are copied into a tightly packed stream of their own, so the
+// pre-pass fetches 12 bytes per vertex instead of a whole Vertex. The stream is
+// allocated from the geometry pool next to the model's vertices. Draw commands
+// index this stream exactly like the full vertex buffer, and the depth vertex
+// shader computes gl_Position with the same invariant expression as the scene
+// shaders, which keeps the GL_EQUAL test of the shading pass exact.
+class DepthPrepass
+{
+public:
+    DepthPrepass(ShaderCache& shaderCache, GpuBufferPool& geometryPool, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                 const std::vector<Vertex>& vertices);
+    ~DepthPrepass();
+
+    DepthPrepass(const DepthPrepass&) = delete;
+    DepthPrepass& operator=(const DepthPrepass&) = delete;
+
+    // lays down depth with colour writes off, then leaves the depth test at
+    // GL_EQUAL without depth writes for the shading pass
+    void Submit(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility = DrawVisibility{});
+
+    // draws depth with colour writes off into the bound framebuffer, leaving the depth state alone
+    void SubmitDepth(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility = DrawVisibility{});
+
+    // restores the GL_LESS depth test with depth writes after the shading pass
+    void EndShadingPass();
+
+    // draws the position stream with a program writing 1 to every fragment, blending
+    // additively into a single channel target counts the fragments per pixel
+    void SubmitFragmentCount(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility = DrawVisibility{});
+
+    // draws depth into the bound shadow map as seen from a light, the Frame block's matrices are not used
+    void SubmitShadowCasters(const std::vector<DrawCommand>& drawList, const glm::mat4& lightViewProjectionMatrix,
+                             const DrawVisibility& visibility = DrawVisibility{});
+
+    // replaces the position stream, after the model changed
+    void SetVertices(const std::vector<Vertex>& vertices);
+
+    // points the vertex array at the position stream again, after the geometry pool moved it
+    void RebindPositions();
+
+    void ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool UpdateShaders();
+
+private:
+    void Draw(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility, unsigned int program);
+
+    std::unique_ptr<ShaderPermutationSet> depthShaders;
+    ShaderPermutation depthPermutation;
+    ShaderPermutation countPermutation;
+    ShaderPermutation shadowPermutation;
+
+    GpuBufferPool& geometryPool;
+    unsigned int positionVertexArray;
+    unsigned int positionAllocation;
+};
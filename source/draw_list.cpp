@@ -0,0 +1,164 @@
+#include "draw_list.h"
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+DrawCommand MakeDrawCommand(unsigned int program, unsigned int meshIndex, unsigned int vertexArray, unsigned int materialIndex,
+                            TextureHandle diffuseTexture, int firstVertex, int vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    DrawCommand drawCommand;
+    drawCommand.sortKey = (static_cast<std::uint64_t>(program & 0xFFFF) << 48)
+                        | (static_cast<std::uint64_t>(materialIndex & 0xFFFFFF) << 24)
+                        | static_cast<std::uint64_t>(meshIndex & 0xFFFFFF);
+    drawCommand.program = program;
+    drawCommand.vertexArray = vertexArray;
+    drawCommand.materialIndex = materialIndex;
+    drawCommand.diffuseTexture = diffuseTexture;
+    drawCommand.firstVertex = firstVertex;
+    drawCommand.vertexCount = vertexCount;
+    drawCommand.modelMatrix = glm::mat4{1.0f};
+    drawCommand.boundsMin = boundsMin;
+    drawCommand.boundsMax = boundsMax;
+
+    return drawCommand;
+}
+
+void SortDrawList(std::vector<DrawCommand>& drawList)
+{
+    std::sort(drawList.begin(), drawList.end(), [](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+}
+
+bool IsDrawVisible(const DrawVisibility& visibility, std::size_t drawIndex)
+{
+    if (visibility.visibleDraws != nullptr && (*visibility.visibleDraws)[drawIndex] == 0)
+    {
+        return false;
+    }
+
+    return visibility.drawRanges == nullptr || visibility.drawRanges->drawOffsets[drawIndex] != visibility.drawRanges->drawOffsets[drawIndex + 1];
+}
+
+void IssueDraw(const std::vector<DrawCommand>& drawList, std::size_t drawIndex, const DrawVisibility& visibility)
+{
+    if (visibility.indirectBuffer != 0)
+    {
+        glDrawArraysIndirect(GL_TRIANGLES, (void*)(drawIndex * sizeof(DrawArraysIndirectCommand)));
+    }
+    else if (visibility.drawRanges != nullptr)
+    {
+        const DrawRanges& ranges = *visibility.drawRanges;
+        const unsigned int firstRange = ranges.drawOffsets[drawIndex];
+        glMultiDrawArrays(GL_TRIANGLES, ranges.firstVertices.data() + firstRange, ranges.vertexCounts.data() + firstRange,
+                          static_cast<int>(ranges.drawOffsets[drawIndex + 1] - firstRange));
+    }
+    else
+    {
+        glDrawArrays(GL_TRIANGLES, drawList[drawIndex].firstVertex, drawList[drawIndex].vertexCount);
+    }
+}
+
+DrawStats SubmitDrawList(const std::vector<DrawCommand>& drawList, const MaterialBuffer& materialBuffer, TextureCache& textureCache,
+                         const DrawVisibility& visibility)
+{
+    DrawStats stats;
+
+    unsigned int currentProgram = 0;
+    unsigned int currentVertexArray = 0;
+    unsigned int currentTexture = 0;
+    unsigned int currentMaterial = 0;
+    unsigned int currentMaterialWindow = 0;
+    glm::mat4 currentModelMatrix{1.0f};
+    int materialIndexLocation = -1;
+    int modelMatrixLocation = -1;
+
+    bool firstDraw = true;
+
+    glActiveTexture(GL_TEXTURE0 + DiffuseTextureUnit);
+
+    if (visibility.indirectBuffer != 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, visibility.indirectBuffer);
+    }
+
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        const DrawCommand& drawCommand = drawList[drawIndex];
+
+        // skipped draws leave the bound state alone, the next visible draw compares against it
+        if (IsDrawVisible(visibility, drawIndex) == false)
+        {
+            ++stats.culledDraws;
+            continue;
+        }
+
+        const bool programChanged = firstDraw || drawCommand.program != currentProgram;
+        if (programChanged)
+        {
+            currentProgram = drawCommand.program;
+            glUseProgram(currentProgram);
+
+            // the material index and model matrix are per-program state, force them to be set again
+            materialIndexLocation = glGetUniformLocation(currentProgram, "materialIndex");
+            modelMatrixLocation = glGetUniformLocation(currentProgram, "modelMatrix");
+
+            ++stats.programChanges;
+        }
+
+        if (firstDraw || drawCommand.vertexArray != currentVertexArray)
+        {
+            currentVertexArray = drawCommand.vertexArray;
+            glBindVertexArray(currentVertexArray);
+
+            ++stats.vertexArrayChanges;
+        }
+
+        const unsigned int materialWindow = drawCommand.materialIndex / MaterialsPerWindow;
+        if (firstDraw || materialWindow != currentMaterialWindow)
+        {
+            currentMaterialWindow = materialWindow;
+            BindMaterialWindow(materialBuffer, drawCommand.materialIndex);
+
+            ++stats.materialWindowChanges;
+        }
+
+        if (programChanged || drawCommand.materialIndex != currentMaterial)
+        {
+            currentMaterial = drawCommand.materialIndex;
+            glUniform1i(materialIndexLocation, static_cast<int>(currentMaterial % MaterialsPerWindow));
+
+            ++stats.materialChanges;
+        }
+
+        const unsigned int texture = textureCache.Use(drawCommand.diffuseTexture);
+        if (firstDraw || texture != currentTexture)
+        {
+            currentTexture = texture;
+            glBindTexture(GL_TEXTURE_2D, currentTexture);
+
+            ++stats.textureChanges;
+        }
+
+        if (programChanged || drawCommand.modelMatrix != currentModelMatrix)
+        {
+            currentModelMatrix = drawCommand.modelMatrix;
+            glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(currentModelMatrix));
+        }
+
+        IssueDraw(drawList, drawIndex, visibility);
+        ++stats.drawCalls;
+
+        firstDraw = false;
+    }
+
+    glBindVertexArray(0);
+
+    if (visibility.indirectBuffer != 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    return stats;
+}
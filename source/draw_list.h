@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "material_buffer.h"
+#include "texture_cache.h"
+
+// texture unit the diffuse texture of every draw is bound to
+const int DiffuseTextureUnit = 0;
+
+struct DrawCommand
+{
+    std::uint64_t sortKey;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int materialIndex;
+    TextureHandle diffuseTexture;
+
+    int firstVertex;
+    int vertexCount;
+
+    glm::mat4 modelMatrix;
+
+    // world-space bounds of the drawn vertices, used for culling
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+// GL state changes issued while submitting one frame's draw list
+struct DrawStats
+{
+    unsigned int drawCalls = 0;
+    unsigned int programChanges = 0;
+    unsigned int vertexArrayChanges = 0;
+    unsigned int materialChanges = 0;
+    unsigned int textureChanges = 0;
+    unsigned int materialWindowChanges = 0;
+    unsigned int culledDraws = 0;  // skipped on the CPU, draws culled on the GPU still count as draw calls
+};
+
+// Layout of glDrawArraysIndirect commands, the GPU culling path writes instanceCount.
+struct DrawArraysIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int first;
+    unsigned int baseInstance;
+};
+
+// vertex ranges left of each draw after cluster culling (meshlets.h), drawn with glMultiDrawArrays
+struct DrawRanges
+{
+    std::vector<int> firstVertices;
+    std::vector<int> vertexCounts;
+
+    // the ranges of draw i are [drawOffsets[i], drawOffsets[i + 1]), one more entry than draws
+    std::vector<unsigned int> drawOffsets;
+};
+
+// which draws of a list are submitted, by default all of them
+struct DrawVisibility
+{
+    // one entry per draw, zero skips the draw, null submits every draw
+    const std::vector<unsigned char>* visibleDraws = nullptr;
+
+    // when set, a draw only submits its ranges and is skipped when it has none
+    const DrawRanges* drawRanges = nullptr;
+
+    // GL_DRAW_INDIRECT_BUFFER holding one DrawArraysIndirectCommand per draw, when
+    // non-zero every draw is issued with glDrawArraysIndirect so the GPU decides
+    unsigned int indirectBuffer = 0;
+};
+
+// packs (program, material, mesh) into the sort key so sorted draws share as much state as possible,
+// the model matrix starts out as identity
+DrawCommand MakeDrawCommand(unsigned int program, unsigned int meshIndex, unsigned int vertexArray, unsigned int materialIndex,
+                            TextureHandle diffuseTexture, int firstVertex, int vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+void SortDrawList(std::vector<DrawCommand>& drawList);
+
+// false when the visibility skips the draw
+bool IsDrawVisible(const DrawVisibility& visibility, std::size_t drawIndex);
+
+// issues the draw call of one draw with the state already bound: indirect, its ranges, or its whole vertex range
+void IssueDraw(const std::vector<DrawCommand>& drawList, std::size_t drawIndex, const DrawVisibility& visibility);
+
+// issues the draws in order, only touching GL state that differs from the previous draw
+DrawStats SubmitDrawList(const std::vector<DrawCommand>& drawList, const MaterialBuffer& materialBuffer, TextureCache& textureCache,
+                         const DrawVisibility& visibility = DrawVisibility{});
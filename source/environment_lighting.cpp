@@ -0,0 +1,699 @@
+#include "environment_lighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <stb_image.h>
+
+#include "file_utility.h"
+#include "hash.h"
+#include "job_system.h"
+
+namespace
+{
+
+const std::uint32_t cacheFileMagic = 0x4C424943;  // "CIBL"
+const std::uint32_t cacheFileVersion = 1;
+
+// the prefiltered map starts at the source size and ends at 4 texels, the shader derives its lod range from that
+const int SourceFaceSize = 128;
+const int IrradianceFaceSize = 32;
+const int PrefilteredLevelCount = 6;
+const int BrdfLutSize = 128;
+const unsigned int PrefilterSampleCount = 128;
+const unsigned int BrdfLutSampleCount = 256;
+
+const float Pi = 3.14159265f;
+
+// header written in front of the precomputed maps, whose sizes follow from the version
+struct CacheFileHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t key;
+};
+
+// one mip level of a cube map, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X order with rows from t = 0
+struct CubeLevel
+{
+    int size;
+    std::vector<glm::vec3> texels;
+};
+
+struct PrecomputedEnvironment
+{
+    CubeLevel irradiance;
+    std::vector<CubeLevel> prefilteredLevels;
+    std::vector<glm::vec2> brdfLut;  // NdotV along x, roughness along y
+};
+
+// equirectangular radiance, empty for the built-in sky
+struct EnvironmentImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<glm::vec3> texels;  // rows from the bottom up
+};
+
+glm::vec3 FaceDirection(int face, float s, float t)
+{
+    const float u = 2.0f * s - 1.0f;
+    const float v = 2.0f * t - 1.0f;
+
+    switch (face)
+    {
+    case 0:
+        return glm::normalize(glm::vec3{1.0f, -v, -u});
+    case 1:
+        return glm::normalize(glm::vec3{-1.0f, -v, u});
+    case 2:
+        return glm::normalize(glm::vec3{u, 1.0f, v});
+    case 3:
+        return glm::normalize(glm::vec3{u, -1.0f, -v});
+    case 4:
+        return glm::normalize(glm::vec3{u, -v, 1.0f});
+    default:
+        return glm::normalize(glm::vec3{-u, -v, -1.0f});
+    }
+}
+
+// the face a direction points at and its texture coordinates there, as the GL cube map lookup picks them
+void CubeCoordinates(const glm::vec3& direction, int& face, float& s, float& t)
+{
+    const glm::vec3 magnitude = glm::abs(direction);
+
+    float majorAxis;
+    float sc;
+    float tc;
+    if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+    {
+        face = (direction.x > 0.0f) ? 0 : 1;
+        majorAxis = magnitude.x;
+        sc = (direction.x > 0.0f) ? -direction.z : direction.z;
+        tc = -direction.y;
+    }
+    else if (magnitude.y >= magnitude.z)
+    {
+        face = (direction.y > 0.0f) ? 2 : 3;
+        majorAxis = magnitude.y;
+        sc = direction.x;
+        tc = (direction.y > 0.0f) ? direction.z : -direction.z;
+    }
+    else
+    {
+        face = (direction.z > 0.0f) ? 4 : 5;
+        majorAxis = magnitude.z;
+        sc = (direction.z > 0.0f) ? direction.x : -direction.x;
+        tc = -direction.y;
+    }
+
+    s = 0.5f * (sc / majorAxis + 1.0f);
+    t = 0.5f * (tc / majorAxis + 1.0f);
+}
+
+// bilinear within one face, the lighting maps are too smooth for seams between faces to show
+glm::vec3 SampleCubeLevel(const CubeLevel& level, const glm::vec3& direction)
+{
+    int face;
+    float s;
+    float t;
+    CubeCoordinates(direction, face, s, t);
+
+    const float x = s * level.size - 0.5f;
+    const float y = t * level.size - 0.5f;
+    const float floorX = std::floor(x);
+    const float floorY = std::floor(y);
+    const float fractionX = x - floorX;
+    const float fractionY = y - floorY;
+
+    const int x0 = glm::clamp(static_cast<int>(floorX), 0, level.size - 1);
+    const int x1 = glm::clamp(static_cast<int>(floorX) + 1, 0, level.size - 1);
+    const int y0 = glm::clamp(static_cast<int>(floorY), 0, level.size - 1);
+    const int y1 = glm::clamp(static_cast<int>(floorY) + 1, 0, level.size - 1);
+
+    const glm::vec3* texels = &level.texels[static_cast<std::size_t>(face) * level.size * level.size];
+    const glm::vec3 bottom = glm::mix(texels[y0 * level.size + x0], texels[y0 * level.size + x1], fractionX);
+    const glm::vec3 top = glm::mix(texels[y1 * level.size + x0], texels[y1 * level.size + x1], fractionX);
+
+    return glm::mix(bottom, top, fractionY);
+}
+
+// trilinear over the mip chain
+glm::vec3 SampleCube(const std::vector<CubeLevel>& levels, const glm::vec3& direction, float lod)
+{
+    lod = glm::clamp(lod, 0.0f, static_cast<float>(levels.size() - 1));
+
+    const int lowerLevel = static_cast<int>(lod);
+    const int upperLevel = std::min(lowerLevel + 1, static_cast<int>(levels.size()) - 1);
+
+    return glm::mix(SampleCubeLevel(levels[lowerLevel], direction), SampleCubeLevel(levels[upperLevel], direction), lod - lowerLevel);
+}
+
+// a blue sky brightening towards the horizon over a darker ground; the key light stands in for the sun.
+// Changing it needs a new cacheFileVersion, cached maps of the built-in sky are keyed by the version alone
+glm::vec3 SampleSky(const glm::vec3& direction)
+{
+    const glm::vec3 zenithColor{0.25f, 0.4f, 0.75f};
+    const glm::vec3 horizonColor{0.8f, 0.85f, 0.9f};
+    const glm::vec3 groundColor{0.3f, 0.27f, 0.24f};
+
+    if (direction.y >= 0.0f)
+    {
+        return glm::mix(zenithColor, horizonColor, std::pow(1.0f - direction.y, 4.0f));
+    }
+
+    return glm::mix(groundColor, horizonColor, std::pow(1.0f + direction.y, 16.0f));
+}
+
+glm::vec3 SampleEnvironment(const EnvironmentImage& image, const glm::vec3& direction)
+{
+    if (image.texels.empty())
+    {
+        return SampleSky(direction);
+    }
+
+    const float longitude = std::atan2(direction.z, direction.x);
+    const float latitude = std::asin(glm::clamp(direction.y, -1.0f, 1.0f));
+
+    const float x = (longitude / (2.0f * Pi) + 0.5f) * image.width - 0.5f;
+    const float y = (latitude / Pi + 0.5f) * image.height - 0.5f;
+    const float floorX = std::floor(x);
+    const float floorY = std::floor(y);
+    const float fractionX = x - floorX;
+    const float fractionY = y - floorY;
+
+    // longitude wraps around, latitude stops at the poles
+    const int x0 = (static_cast<int>(floorX) % image.width + image.width) % image.width;
+    const int x1 = (x0 + 1) % image.width;
+    const int y0 = glm::clamp(static_cast<int>(floorY), 0, image.height - 1);
+    const int y1 = glm::clamp(static_cast<int>(floorY) + 1, 0, image.height - 1);
+
+    const glm::vec3 bottom = glm::mix(image.texels[y0 * image.width + x0], image.texels[y0 * image.width + x1], fractionX);
+    const glm::vec3 top = glm::mix(image.texels[y1 * image.width + x0], image.texels[y1 * image.width + x1], fractionX);
+
+    return glm::mix(bottom, top, fractionY);
+}
+
+EnvironmentImage LoadEnvironmentImage(const std::string& filepath)
+{
+    // the flag is global to stb_image, the texture cache sets the same value for its decode threads
+    stbi_set_flip_vertically_on_load(true);
+
+    EnvironmentImage image;
+    int channelCount;
+    float* pixels = stbi_loadf(filepath.c_str(), &image.width, &image.height, &channelCount, 3);
+    if (pixels == nullptr)
+    {
+        const char* failureReason = stbi_failure_reason();
+        throw std::runtime_error{"Failed to load environment image " + filepath + ": " + (failureReason != nullptr ? failureReason : "unknown error")};
+    }
+
+    image.texels.resize(static_cast<std::size_t>(image.width) * image.height);
+    for (std::size_t i = 0; i < image.texels.size(); ++i)
+    {
+        image.texels[i] = glm::vec3{pixels[i * 3], pixels[i * 3 + 1], pixels[i * 3 + 2]};
+    }
+    stbi_image_free(pixels);
+
+    return image;
+}
+
+// solid angle a texel of a cube face subtends, u and v are its centre in [-1, 1]
+float TexelSolidAngle(float u, float v, int size)
+{
+    const float texelArea = (2.0f / size) * (2.0f / size);
+    return texelArea / std::pow(1.0f + u * u + v * v, 1.5f);
+}
+
+// the first nine real spherical harmonics
+void EvaluateShBasis(const glm::vec3& direction, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * direction.y;
+    basis[2] = 0.488603f * direction.z;
+    basis[3] = 0.488603f * direction.x;
+    basis[4] = 1.092548f * direction.x * direction.y;
+    basis[5] = 1.092548f * direction.y * direction.z;
+    basis[6] = 0.315392f * (3.0f * direction.z * direction.z - 1.0f);
+    basis[7] = 1.092548f * direction.x * direction.z;
+    basis[8] = 0.546274f * (direction.x * direction.x - direction.y * direction.y);
+}
+
+glm::vec2 Hammersley(unsigned int index, unsigned int count)
+{
+    std::uint32_t bits = index;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+
+    return glm::vec2{static_cast<float>(index) / count, static_cast<float>(bits) * 2.3283064365386963e-10f};
+}
+
+// half vector around the normal, distributed like the GGX normal distribution of the roughness
+glm::vec3 ImportanceSampleGgx(const glm::vec2& random, const glm::vec3& normal, float roughness)
+{
+    const float alpha = roughness * roughness;
+    const float phi = 2.0f * Pi * random.x;
+    const float cosTheta = std::sqrt((1.0f - random.y) / (1.0f + (alpha * alpha - 1.0f) * random.y));
+    const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+    const glm::vec3 up = (std::fabs(normal.z) < 0.999f) ? glm::vec3{0.0f, 0.0f, 1.0f} : glm::vec3{1.0f, 0.0f, 0.0f};
+    const glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+    const glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    return glm::normalize(tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) + normal * cosTheta);
+}
+
+float DistributionGgx(float NdotH, float roughness)
+{
+    const float alpha = roughness * roughness;
+    const float alphaSquared = alpha * alpha;
+    const float denominator = NdotH * NdotH * (alphaSquared - 1.0f) + 1.0f;
+
+    return alphaSquared / (Pi * denominator * denominator);
+}
+
+// Smith's shadowing-masking with Schlick's approximation and the k of image-based lighting
+float GeometrySmithIbl(float NdotV, float NdotL, float roughness)
+{
+    const float k = roughness * roughness * 0.5f;
+    return (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+}
+
+void PrecomputeIrradiance(const CubeLevel& source, CubeLevel& irradiance)
+{
+    // the radiance is projected onto nine spherical harmonics per face, which is all a cosine lobe keeps of it
+    std::vector<glm::vec3> faceCoefficients(6 * 9, glm::vec3{0.0f});
+    std::vector<float> faceWeights(6, 0.0f);
+    GetSharedJobSystem().ParallelFor(6, [&source, &faceCoefficients, &faceWeights](unsigned int face)
+    {
+        float basis[9];
+        for (int y = 0; y < source.size; ++y)
+        {
+            for (int x = 0; x < source.size; ++x)
+            {
+                const float s = (x + 0.5f) / source.size;
+                const float t = (y + 0.5f) / source.size;
+                const float weight = TexelSolidAngle(2.0f * s - 1.0f, 2.0f * t - 1.0f, source.size);
+                const glm::vec3& radiance = source.texels[(static_cast<std::size_t>(face) * source.size + y) * source.size + x];
+
+                EvaluateShBasis(FaceDirection(face, s, t), basis);
+                for (int i = 0; i < 9; ++i)
+                {
+                    faceCoefficients[face * 9 + i] += radiance * (basis[i] * weight);
+                }
+                faceWeights[face] += weight;
+            }
+        }
+    });
+
+    // the texel solid angles sum to 4 pi up to discretisation, the remainder is normalised away
+    glm::vec3 coefficients[9];
+    float totalWeight = 0.0f;
+    for (int i = 0; i < 9; ++i)
+    {
+        coefficients[i] = glm::vec3{0.0f};
+        for (int face = 0; face < 6; ++face)
+        {
+            coefficients[i] += faceCoefficients[face * 9 + i];
+        }
+    }
+    for (int face = 0; face < 6; ++face)
+    {
+        totalWeight += faceWeights[face];
+    }
+
+    // convolution with the clamped cosine scales each band, the result is irradiance over pi
+    const float bandScales[9] = {Pi, 2.0f * Pi / 3.0f, 2.0f * Pi / 3.0f, 2.0f * Pi / 3.0f, Pi / 4.0f, Pi / 4.0f, Pi / 4.0f, Pi / 4.0f, Pi / 4.0f};
+    for (int i = 0; i < 9; ++i)
+    {
+        coefficients[i] *= bandScales[i] * (4.0f * Pi / totalWeight) / Pi;
+    }
+
+    irradiance.size = IrradianceFaceSize;
+    irradiance.texels.resize(static_cast<std::size_t>(6) * irradiance.size * irradiance.size);
+    GetSharedJobSystem().ParallelFor(6 * irradiance.size, [&irradiance, &coefficients](unsigned int row)
+    {
+        const int face = row / irradiance.size;
+        const int y = row % irradiance.size;
+
+        float basis[9];
+        for (int x = 0; x < irradiance.size; ++x)
+        {
+            EvaluateShBasis(FaceDirection(face, (x + 0.5f) / irradiance.size, (y + 0.5f) / irradiance.size), basis);
+
+            glm::vec3 value{0.0f};
+            for (int i = 0; i < 9; ++i)
+            {
+                value += coefficients[i] * basis[i];
+            }
+            irradiance.texels[row * irradiance.size + x] = glm::max(value, 0.0f);
+        }
+    });
+}
+
+void PrefilterLevel(const std::vector<CubeLevel>& source, CubeLevel& level, float roughness)
+{
+    const float sourceTexelSolidAngle = 4.0f * Pi / (6.0f * SourceFaceSize * SourceFaceSize);
+
+    GetSharedJobSystem().ParallelFor(6 * level.size, [&source, &level, roughness, sourceTexelSolidAngle](unsigned int row)
+    {
+        const int face = row / level.size;
+        const int y = row % level.size;
+
+        for (int x = 0; x < level.size; ++x)
+        {
+            // the lobe is sampled as seen head-on, which drops the stretching at grazing angles
+            const glm::vec3 normal = FaceDirection(face, (x + 0.5f) / level.size, (y + 0.5f) / level.size);
+
+            glm::vec3 radiance{0.0f};
+            float totalWeight = 0.0f;
+            for (unsigned int i = 0; i < PrefilterSampleCount; ++i)
+            {
+                const glm::vec3 halfVector = ImportanceSampleGgx(Hammersley(i, PrefilterSampleCount), normal, roughness);
+                const float NdotH = glm::dot(normal, halfVector);
+                const glm::vec3 lightDirection = halfVector * (2.0f * NdotH) - normal;
+                const float NdotL = glm::dot(normal, lightDirection);
+                if (NdotL <= 0.0f)
+                {
+                    continue;
+                }
+
+                // samples of a wide lobe read a blurrier level instead of aliasing on bright texels
+                const float pdf = DistributionGgx(NdotH, roughness) * 0.25f;
+                const float sampleSolidAngle = 1.0f / (PrefilterSampleCount * pdf + 0.0001f);
+                const float lod = 0.5f * std::log2(sampleSolidAngle / sourceTexelSolidAngle) + 1.0f;
+
+                radiance += SampleCube(source, lightDirection, lod) * NdotL;
+                totalWeight += NdotL;
+            }
+
+            level.texels[row * level.size + x] = radiance / std::max(totalWeight, 0.0001f);
+        }
+    });
+}
+
+void PrecomputeBrdfLut(std::vector<glm::vec2>& brdfLut)
+{
+    brdfLut.resize(static_cast<std::size_t>(BrdfLutSize) * BrdfLutSize);
+
+    GetSharedJobSystem().ParallelFor(BrdfLutSize, [&brdfLut](unsigned int row)
+    {
+        const float roughness = (row + 0.5f) / BrdfLutSize;
+        const glm::vec3 normal{0.0f, 0.0f, 1.0f};
+
+        for (int x = 0; x < BrdfLutSize; ++x)
+        {
+            const float NdotV = (x + 0.5f) / BrdfLutSize;
+            const glm::vec3 viewDirection{std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV};
+
+            float scale = 0.0f;
+            float bias = 0.0f;
+            for (unsigned int i = 0; i < BrdfLutSampleCount; ++i)
+            {
+                const glm::vec3 halfVector = ImportanceSampleGgx(Hammersley(i, BrdfLutSampleCount), normal, roughness);
+                const float VdotH = std::max(glm::dot(viewDirection, halfVector), 0.0f);
+                const glm::vec3 lightDirection = halfVector * (2.0f * VdotH) - viewDirection;
+                const float NdotL = lightDirection.z;
+                const float NdotH = std::max(halfVector.z, 0.0f);
+                if (NdotL <= 0.0f)
+                {
+                    continue;
+                }
+
+                const float visibility = GeometrySmithIbl(NdotV, NdotL, roughness) * VdotH / (NdotH * NdotV);
+                const float fresnel = std::pow(1.0f - VdotH, 5.0f);
+                scale += (1.0f - fresnel) * visibility;
+                bias += fresnel * visibility;
+            }
+
+            brdfLut[row * BrdfLutSize + x] = glm::vec2{scale, bias} / static_cast<float>(BrdfLutSampleCount);
+        }
+    });
+}
+
+PrecomputedEnvironment Precompute(const EnvironmentImage& image)
+{
+    // resample the environment into a cube map with 2x2 samples per texel, then box filter it down to one texel
+    std::vector<CubeLevel> source(1);
+    source[0].size = SourceFaceSize;
+    source[0].texels.resize(static_cast<std::size_t>(6) * SourceFaceSize * SourceFaceSize);
+    GetSharedJobSystem().ParallelFor(6 * SourceFaceSize, [&image, &source](unsigned int row)
+    {
+        const int face = row / SourceFaceSize;
+        const int y = row % SourceFaceSize;
+
+        for (int x = 0; x < SourceFaceSize; ++x)
+        {
+            glm::vec3 radiance{0.0f};
+            for (int sample = 0; sample < 4; ++sample)
+            {
+                const float s = (x + 0.25f + 0.5f * (sample & 1)) / SourceFaceSize;
+                const float t = (y + 0.25f + 0.5f * (sample >> 1)) / SourceFaceSize;
+                radiance += SampleEnvironment(image, FaceDirection(face, s, t));
+            }
+            source[0].texels[row * SourceFaceSize + x] = radiance * 0.25f;
+        }
+    });
+
+    while (source.back().size > 1)
+    {
+        const CubeLevel& previous = source.back();
+
+        CubeLevel level;
+        level.size = previous.size / 2;
+        level.texels.resize(static_cast<std::size_t>(6) * level.size * level.size);
+        for (int face = 0; face < 6; ++face)
+        {
+            for (int y = 0; y < level.size; ++y)
+            {
+                for (int x = 0; x < level.size; ++x)
+                {
+                    const glm::vec3* texels = &previous.texels[(static_cast<std::size_t>(face) * previous.size + 2 * y) * previous.size + 2 * x];
+                    level.texels[(static_cast<std::size_t>(face) * level.size + y) * level.size + x] =
+                        (texels[0] + texels[1] + texels[previous.size] + texels[previous.size + 1]) * 0.25f;
+                }
+            }
+        }
+
+        source.push_back(std::move(level));
+    }
+
+    PrecomputedEnvironment environment;
+
+    const auto irradianceSource = std::find_if(source.begin(), source.end(), [](const CubeLevel& level) { return level.size == IrradianceFaceSize; });
+    PrecomputeIrradiance(*irradianceSource, environment.irradiance);
+
+    // the first level reflects like a mirror, each further one is rougher
+    environment.prefilteredLevels.push_back(source[0]);
+    for (int levelIndex = 1; levelIndex < PrefilteredLevelCount; ++levelIndex)
+    {
+        CubeLevel level;
+        level.size = SourceFaceSize >> levelIndex;
+        level.texels.resize(static_cast<std::size_t>(6) * level.size * level.size);
+        PrefilterLevel(source, level, static_cast<float>(levelIndex) / (PrefilteredLevelCount - 1));
+
+        environment.prefilteredLevels.push_back(std::move(level));
+    }
+
+    PrecomputeBrdfLut(environment.brdfLut);
+
+    return environment;
+}
+
+// the environment image's contents and every size that shapes the maps
+unsigned long long CalculateKey(const std::string& environmentPath)
+{
+    char parameters[128];
+    std::snprintf(parameters, sizeof(parameters), "ibl %u %d %d %d %d %u %u", cacheFileVersion, SourceFaceSize, IrradianceFaceSize, PrefilteredLevelCount,
+                  BrdfLutSize, PrefilterSampleCount, BrdfLutSampleCount);
+    const unsigned long long hash = HashString(parameters);
+
+    if (environmentPath.empty())
+    {
+        return HashString("built-in sky", hash);
+    }
+
+    std::ifstream file{environmentPath, std::ios::binary};
+    if (file.is_open() == false)
+    {
+        throw std::runtime_error{"Failed to open environment image " + environmentPath};
+    }
+
+    const std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    return HashString(contents, hash);
+}
+
+std::string GetCachePath(const std::string& directory, unsigned long long key)
+{
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.ibl", key);
+
+    return directory + "/" + fileName;
+}
+
+bool LoadCachedEnvironment(const std::string& filepath, unsigned long long key, PrecomputedEnvironment& environment)
+{
+    std::ifstream file{filepath, std::ios::binary};
+    if (file.is_open() == false)
+    {
+        return false;
+    }
+
+    CacheFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.good() == false || header.magic != cacheFileMagic || header.version != cacheFileVersion || header.key != key)
+    {
+        return false;
+    }
+
+    const auto readLevel = [&file](CubeLevel& level, int size)
+    {
+        level.size = size;
+        level.texels.resize(static_cast<std::size_t>(6) * size * size);
+        file.read(reinterpret_cast<char*>(level.texels.data()), level.texels.size() * sizeof(glm::vec3));
+    };
+
+    readLevel(environment.irradiance, IrradianceFaceSize);
+    environment.prefilteredLevels.resize(PrefilteredLevelCount);
+    for (int levelIndex = 0; levelIndex < PrefilteredLevelCount; ++levelIndex)
+    {
+        readLevel(environment.prefilteredLevels[levelIndex], SourceFaceSize >> levelIndex);
+    }
+
+    environment.brdfLut.resize(static_cast<std::size_t>(BrdfLutSize) * BrdfLutSize);
+    file.read(reinterpret_cast<char*>(environment.brdfLut.data()), environment.brdfLut.size() * sizeof(glm::vec2));
+
+    return file.good();
+}
+
+void SaveCachedEnvironment(const std::string& filepath, unsigned long long key, const PrecomputedEnvironment& environment)
+{
+    CacheFileHeader header;
+    header.magic = cacheFileMagic;
+    header.version = cacheFileVersion;
+    header.key = key;
+
+    std::vector<unsigned char> entry;
+    const auto append = [&entry](const void* data, std::size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        entry.insert(entry.end(), bytes, bytes + size);
+    };
+
+    append(&header, sizeof(header));
+    append(environment.irradiance.texels.data(), environment.irradiance.texels.size() * sizeof(glm::vec3));
+    for (const auto& level : environment.prefilteredLevels)
+    {
+        append(level.texels.data(), level.texels.size() * sizeof(glm::vec3));
+    }
+    append(environment.brdfLut.data(), environment.brdfLut.size() * sizeof(glm::vec2));
+
+    // a short write keeps the temporary file out of the cache
+    WriteFileAtomically(filepath, entry);
+}
+
+unsigned int CreateCubeMap(const std::vector<CubeLevel>& levels)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+    for (std::size_t level = 0; level < levels.size(); ++level)
+    {
+        const int size = levels[level].size;
+        for (int face = 0; face < 6; ++face)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, static_cast<GLint>(level), GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT,
+                         &levels[level].texels[static_cast<std::size_t>(face) * size * size]);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, (levels.size() > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    return texture;
+}
+
+} // namespace
+
+EnvironmentLighting::EnvironmentLighting(const EnvironmentLightingSettings& settings)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    stats.threadCount = GetSharedJobSystem().GetThreadCount();
+
+    const unsigned long long key = CalculateKey(settings.environmentPath);
+    const std::string cachePath = settings.cacheDirectory.empty() ? std::string{} : GetCachePath(settings.cacheDirectory, key);
+
+    PrecomputedEnvironment environment;
+    stats.loadedFromCache = cachePath.empty() == false && LoadCachedEnvironment(cachePath, key, environment);
+    if (stats.loadedFromCache == false)
+    {
+        const EnvironmentImage image = settings.environmentPath.empty() ? EnvironmentImage{} : LoadEnvironmentImage(settings.environmentPath);
+        environment = Precompute(image);
+
+        if (cachePath.empty() == false)
+        {
+            CreateDirectoryIfMissing(settings.cacheDirectory);
+            SaveCachedEnvironment(cachePath, key, environment);
+        }
+    }
+
+    // filtering across cube faces is off by default, the rough levels would show their edges
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    irradianceTexture = CreateCubeMap(std::vector<CubeLevel>{environment.irradiance});
+    prefilteredTexture = CreateCubeMap(environment.prefilteredLevels);
+
+    glGenTextures(1, &brdfLutTexture);
+    glBindTexture(GL_TEXTURE_2D, brdfLutTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BrdfLutSize, BrdfLutSize, 0, GL_RG, GL_FLOAT, environment.brdfLut.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+EnvironmentLighting::~EnvironmentLighting()
+{
+    const unsigned int textures[3] = {irradianceTexture, prefilteredTexture, brdfLutTexture};
+    glDeleteTextures(3, textures);
+}
+
+void EnvironmentLighting::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + IrradianceTextureUnit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceTexture);
+    glActiveTexture(GL_TEXTURE0 + PrefilteredEnvironmentTextureUnit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredTexture);
+    glActiveTexture(GL_TEXTURE0 + BrdfLutTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, brdfLutTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+const EnvironmentLightingStats& EnvironmentLighting::GetStats() const
+{
+    return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+// texture units of the precomputed image-based lighting, programs name the samplers
+// irradianceMap, prefilteredMap and brdfLut
+const int IrradianceTextureUnit = 10;
+const int PrefilteredEnvironmentTextureUnit = 11;
+const int BrdfLutTextureUnit = 12;
+
+struct EnvironmentLightingSettings
+{
+    // equirectangular image (Radiance .hdr or any format stb_image reads), empty for the built-in sky
+    std::string environmentPath;
+
+    // directory of precomputed maps, an empty directory disables the cache
+    std::string cacheDirectory;
+};
+
+struct EnvironmentLightingStats
+{
+    bool loadedFromCache = false;
+    unsigned int threadCount = 0;  // of the job system the maps were precomputed on
+    double milliseconds = 0.0;  // precomputation or cache load, including the upload
+};
+
+// Image-based lighting for the physically based shader, split into the three
+// parts of the split-sum approximation:
+//   irradianceMap   GL_RGB16F cube map, cosine-weighted average radiance around each normal
+//   prefilteredMap  GL_RGB16F cube map, radiance convolved with the GGX lobe, one roughness per mip level
+//   brdfLut         GL_RG16F, scale and bias of F0 indexed by NdotV and roughness
+// Everything is computed once on the CPU at startup, one job per row on the
+// shared job system: the environment is resampled into a cube
+// map with a box-filtered mip chain, the irradiance comes from its projection
+// onto nine spherical harmonics, and every prefiltered texel importance-samples
+// the GGX lobe from the mip level matching each sample's solid angle. The
+// result is stored in the cache directory keyed by a hash of the environment
+// image and the map sizes, so later runs only read and upload it.
+class EnvironmentLighting
+{
+public:
+    explicit EnvironmentLighting(const EnvironmentLightingSettings& settings);
+    ~EnvironmentLighting();
+
+    EnvironmentLighting(const EnvironmentLighting&) = delete;
+    EnvironmentLighting& operator=(const EnvironmentLighting&) = delete;
+
+    // binds the three maps to their texture units for the shading pass
+    void Bind() const;
+
+    const EnvironmentLightingStats& GetStats() const;
+
+private:
+    unsigned int irradianceTexture;
+    unsigned int prefilteredTexture;
+    unsigned int brdfLutTexture;
+
+    EnvironmentLightingStats stats;
+};
@@ -0,0 +1,59 @@
+#include "file_utility.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::string GetLowerCaseExtension(const std::string& filepath)
+{
+    const std::size_t dot = filepath.find_last_of('.');
+    if (dot == std::string::npos || filepath.find_first_of("/\\", dot) != std::string::npos)
+    {
+        return "";
+    }
+
+    std::string extension = filepath.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    return extension;
+}
+
+void CreateDirectoryIfMissing(const std::string& directory)
+{
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
+
+bool WriteFileAtomically(const std::string& filepath, const std::vector<unsigned char>& bytes)
+{
+    const std::string temporaryPath = filepath + ".tmp";
+    {
+        std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        file.close();
+        if (file.good() == false)
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    // rename does not replace an existing file on Windows
+    std::remove(filepath.c_str());
+    return std::rename(temporaryPath.c_str(), filepath.c_str()) == 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// the extension after the file name's last dot in lower case, without the dot; empty when there is none
+std::string GetLowerCaseExtension(const std::string& filepath);
+
+// creates the directory when it does not exist yet, its parent must exist
+void CreateDirectoryIfMissing(const std::string& directory);
+
+// Replaces the file with bytes. They are written to a temporary file first, so a
+// crash never leaves a truncated file behind. False when the file couldn't be
+// written completely, the previous file is kept then.
+bool WriteFileAtomically(const std::string& filepath, const std::vector<unsigned char>& bytes);
@@ -0,0 +1,207 @@
+#include "file_watcher.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+
+#ifdef __linux__
+
+std::string GetDirectory(const std::string& filepath)
+{
+    const std::size_t separatorIndex = filepath.find_last_of("/\\");
+    if (separatorIndex == std::string::npos)
+    {
+        return ".";
+    }
+
+    return filepath.substr(0, separatorIndex);
+}
+
+std::string GetFileName(const std::string& filepath)
+{
+    const std::size_t separatorIndex = filepath.find_last_of("/\\");
+    if (separatorIndex == std::string::npos)
+    {
+        return filepath;
+    }
+
+    return filepath.substr(separatorIndex + 1);
+}
+
+#else
+
+long long GetModificationTime(const std::string& filepath)
+{
+    struct stat fileStatus;
+    if (stat(filepath.c_str(), &fileStatus) != 0)
+    {
+        return 0;
+    }
+
+    return static_cast<long long>(fileStatus.st_mtime);
+}
+
+#endif
+
+} // namespace
+
+FileWatcher::FileWatcher(const std::vector<std::string>& filepaths)
+    : filepaths{filepaths},
+      stopWatching{false}
+{
+#ifdef __linux__
+    wakeupPipe[0] = -1;
+    wakeupPipe[1] = -1;
+
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor < 0 || pipe(wakeupPipe) != 0)
+    {
+        std::cerr << "inotify is unavailable, file changes will not be detected" << std::endl;
+        return;
+    }
+#endif
+
+    watchThread = std::thread{&FileWatcher::WatchThreadMain, this};
+}
+
+FileWatcher::~FileWatcher()
+{
+    stopWatching = true;
+
+#ifdef __linux__
+    if (watchThread.joinable())
+    {
+        const char wakeup = 0;
+        if (write(wakeupPipe[1], &wakeup, 1) < 0)
+        {
+            std::cerr << "failed to wake the file watcher thread" << std::endl;
+        }
+    }
+#endif
+
+    if (watchThread.joinable())
+    {
+        watchThread.join();
+    }
+
+#ifdef __linux__
+    for (const int descriptor : {inotifyDescriptor, wakeupPipe[0], wakeupPipe[1]})
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::ConsumeChangedFiles()
+{
+    std::lock_guard<std::mutex> lock{changedMutex};
+
+    std::vector<std::string> files{changedFiles.begin(), changedFiles.end()};
+    changedFiles.clear();
+
+    return files;
+}
+
+#ifdef __linux__
+
+void FileWatcher::WatchThreadMain()
+{
+    // one watch per directory, events name the file inside it
+    std::map<int, std::string> directoriesByWatch;
+    for (const auto& filepath : filepaths)
+    {
+        const std::string directory = GetDirectory(filepath);
+
+        const int watch = inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch < 0)
+        {
+            std::cerr << "failed to watch " << directory << std::endl;
+            continue;
+        }
+
+        directoriesByWatch[watch] = directory;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (stopWatching == false)
+    {
+        pollfd descriptors[2] = {{inotifyDescriptor, POLLIN, 0}, {wakeupPipe[0], POLLIN, 0}};
+        if (poll(descriptors, 2, -1) <= 0 || (descriptors[1].revents & POLLIN) != 0)
+        {
+            continue;
+        }
+
+        const ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            const auto directoryIt = directoriesByWatch.find(event->wd);
+            if (directoryIt == directoriesByWatch.end())
+            {
+                continue;
+            }
+
+            const std::string fileName = event->name;
+            for (const auto& filepath : filepaths)
+            {
+                if (GetDirectory(filepath) == directoryIt->second && GetFileName(filepath) == fileName)
+                {
+                    std::lock_guard<std::mutex> lock{changedMutex};
+                    changedFiles.insert(filepath);
+                }
+            }
+        }
+    }
+}
+
+#else
+
+void FileWatcher::WatchThreadMain()
+{
+    std::map<std::string, long long> modificationTimes;
+    for (const auto& filepath : filepaths)
+    {
+        modificationTimes[filepath] = GetModificationTime(filepath);
+    }
+
+    while (stopWatching == false)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{500});
+
+        for (const auto& filepath : filepaths)
+        {
+            const long long modificationTime = GetModificationTime(filepath);
+            if (modificationTime != modificationTimes[filepath])
+            {
+                modificationTimes[filepath] = modificationTime;
+
+                std::lock_guard<std::mutex> lock{changedMutex};
+                changedFiles.insert(filepath);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reports files that were modified on disk. On Linux a background thread
+// blocks on inotify events for the files' directories (catching editors that
+// save by writing a temporary file and renaming it over the original),
+// elsewhere the thread polls modification times twice per second.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::vector<std::string>& filepaths);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // returns the watched files changed since the last call, never blocks
+    std::vector<std::string> ConsumeChangedFiles();
+
+private:
+    void WatchThreadMain();
+
+    std::vector<std::string> filepaths;
+
+    std::mutex changedMutex;
+    std::set<std::string> changedFiles;
+
+    std::atomic<bool> stopWatching;
+    std::thread watchThread;
+
+#ifdef __linux__
+    int inotifyDescriptor;
+    int wakeupPipe[2];  // written by the destructor to interrupt the blocking read
+#endif
+};
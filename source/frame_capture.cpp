@@ -0,0 +1,310 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <stb_image_write.h>
+
+#include "file_utility.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace
+{
+
+bool IsVideoPath(const std::string& path)
+{
+    const std::size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    return extension == "mp4" || extension == "mkv" || extension == "mov" || extension == "webm" || extension == "avi";
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(const FrameCaptureSettings& settings)
+    : settings{settings},
+      video{IsVideoPath(settings.outputPath)},
+      width{0},
+      height{0},
+      nextReadback{0},
+      frameIndex{0},
+      nextSequenceNumber{0},
+      latencySamples{0},
+      latencyMilliseconds{0.0},
+      latencyFrames{0.0},
+      videoPipe{nullptr},
+      writeFailed{false},
+      encodedFrames{0},
+      stopEncoder{false}
+{
+    this->settings.readbackRingSize = std::max(2u, settings.readbackRingSize);
+    this->settings.maxQueuedFrames = std::max(1u, settings.maxQueuedFrames);
+
+    if (video == false)
+    {
+        CreateDirectoryIfMissing(settings.outputPath);
+    }
+
+    encoderThread = std::thread{&FrameCapture::EncoderMain, this};
+}
+
+FrameCapture::~FrameCapture()
+{
+    CollectFinishedReadbacks(true);
+
+    {
+        std::lock_guard<std::mutex> lock{queueMutex};
+        stopEncoder = true;
+    }
+    queueChanged.notify_all();
+    encoderThread.join();
+
+    if (videoPipe != nullptr)
+    {
+        pclose(videoPipe);
+    }
+
+    for (auto& readback : readbacks)
+    {
+        glDeleteBuffers(1, &readback.buffer);
+    }
+}
+
+void FrameCapture::CaptureFrame(int width, int height)
+{
+    if (this->width == 0)
+    {
+        CreateReadbacks(width, height);
+    }
+
+    ++frameIndex;
+    CollectFinishedReadbacks(false);
+
+    // the ring's buffers, the encoded video and the numbered images all have the first frame's size
+    if (width != this->width || height != this->height)
+    {
+        ++stats.droppedFrames;
+        return;
+    }
+
+    // readbacks finish in order, the next buffer is the oldest one and still in flight when the GPU is that far behind
+    Readback& readback = readbacks[nextReadback];
+    if (readback.fence != nullptr)
+    {
+        ++stats.droppedFrames;
+        return;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.frameIndex = frameIndex;
+    readback.queueTime = std::chrono::steady_clock::now();
+
+    nextReadback = (nextReadback + 1) % settings.readbackRingSize;
+}
+
+bool FrameCapture::IsVideo() const
+{
+    return video;
+}
+
+FrameCaptureStats FrameCapture::ConsumeStats()
+{
+    FrameCaptureStats result = stats;
+    result.encodedFrames = encodedFrames;
+    result.averageLatencyMilliseconds = (latencySamples > 0) ? latencyMilliseconds / latencySamples : 0.0;
+    result.averageLatencyFrames = (latencySamples > 0) ? latencyFrames / latencySamples : 0.0;
+
+    stats = FrameCaptureStats{};
+    latencySamples = 0;
+    latencyMilliseconds = 0.0;
+    latencyFrames = 0.0;
+
+    return result;
+}
+
+void FrameCapture::CreateReadbacks(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    readbacks.resize(settings.readbackRingSize);
+    for (auto& readback : readbacks)
+    {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+
+        readback.fence = nullptr;
+        readback.frameIndex = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (video)
+    {
+        // odd sizes are cropped by a pixel, yuv420p needs even ones
+        char command[1024];
+        std::snprintf(command, sizeof(command),
+                      "ffmpeg -loglevel error -y -f rawvideo -pixel_format rgba -video_size %dx%d -framerate %u -i - "
+                      "-vf \"crop=trunc(iw/2)*2:trunc(ih/2)*2\" -pix_fmt yuv420p \"%s\"",
+                      width, height, settings.videoFrameRate, settings.outputPath.c_str());
+
+#ifdef _WIN32
+        videoPipe = popen(command, "wb");
+#else
+        videoPipe = popen(command, "w");
+#endif
+        if (videoPipe == nullptr)
+        {
+            throw std::runtime_error{"Failed to start ffmpeg for " + settings.outputPath};
+        }
+    }
+}
+
+void FrameCapture::CollectFinishedReadbacks(bool wait)
+{
+    const std::size_t frameBytes = static_cast<std::size_t>(width) * height * 4;
+    const std::size_t rowBytes = static_cast<std::size_t>(width) * 4;
+
+    for (unsigned int i = 0; i < readbacks.size(); ++i)
+    {
+        Readback& readback = readbacks[(nextReadback + i) % readbacks.size()];
+        if (readback.fence == nullptr)
+        {
+            continue;
+        }
+
+        const GLenum waitResult = wait ? glClientWaitSync(static_cast<GLsync>(readback.fence), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull)
+                                       : glClientWaitSync(static_cast<GLsync>(readback.fence), 0, 0);
+        if (waitResult == GL_TIMEOUT_EXPIRED || waitResult == GL_WAIT_FAILED)
+        {
+            // the later reads were queued after this one
+            break;
+        }
+
+        glDeleteSync(static_cast<GLsync>(readback.fence));
+        readback.fence = nullptr;
+
+        latencyMilliseconds += MillisecondsSince(readback.queueTime);
+        latencyFrames += static_cast<double>(frameIndex - readback.frameIndex);
+        ++latencySamples;
+
+        EncodedFrame frame;
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            if (queuedFrames.size() >= settings.maxQueuedFrames)
+            {
+                ++stats.droppedFrames;
+                continue;
+            }
+
+            if (freePixelBuffers.empty() == false)
+            {
+                frame.pixels = std::move(freePixelBuffers.back());
+                freePixelBuffers.pop_back();
+            }
+        }
+        frame.pixels.resize(frameBytes);
+
+        // GL rows start at the bottom, images and video at the top
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const unsigned char* pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT));
+        if (pixels != nullptr)
+        {
+            for (int row = 0; row < height; ++row)
+            {
+                std::memcpy(&frame.pixels[row * rowBytes], pixels + (height - 1 - row) * rowBytes, rowBytes);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (pixels == nullptr)
+        {
+            ++stats.droppedFrames;
+            continue;
+        }
+
+        frame.sequenceNumber = nextSequenceNumber++;
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            queuedFrames.push_back(std::move(frame));
+        }
+        queueChanged.notify_one();
+        ++stats.capturedFrames;
+    }
+}
+
+void FrameCapture::EncoderMain()
+{
+    for (;;)
+    {
+        EncodedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock{queueMutex};
+            queueChanged.wait(lock, [this]() { return queuedFrames.empty() == false || stopEncoder; });
+
+            // frames queued before the stop are still written
+            if (queuedFrames.empty())
+            {
+                return;
+            }
+
+            frame = std::move(queuedFrames.front());
+            queuedFrames.pop_front();
+        }
+
+        WriteFrame(frame);
+        ++encodedFrames;
+
+        std::lock_guard<std::mutex> lock{queueMutex};
+        freePixelBuffers.push_back(std::move(frame.pixels));
+    }
+}
+
+void FrameCapture::WriteFrame(const EncodedFrame& frame)
+{
+    bool written;
+    if (video)
+    {
+        written = std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), videoPipe) == frame.pixels.size();
+    }
+    else
+    {
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "/frame_%06llu.png", frame.sequenceNumber);
+
+        written = stbi_write_png((settings.outputPath + fileName).c_str(), width, height, 4, frame.pixels.data(), width * 4) != 0;
+    }
+
+    if (written == false && writeFailed == false)
+    {
+        writeFailed = true;
+        std::cerr << "failed to write captured frames to " << settings.outputPath << std::endl;
+    }
+}
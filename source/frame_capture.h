@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FrameCaptureSettings
+{
+    // a video file (.mp4, .mkv, .mov, .webm, .avi) is encoded by an ffmpeg process found on the PATH,
+    // anything else is a directory that receives frame_000000.png, frame_000001.png...
+    std::string outputPath;
+
+    // frame rate written into the video, independent of how fast the viewer renders
+    unsigned int videoFrameRate = 60;
+
+    // pixel buffer objects in flight, a frame is read back this many frames after it was drawn at the latest
+    unsigned int readbackRingSize = 3;
+
+    // read back frames waiting for the encoder, frames arriving while it is full are dropped
+    unsigned int maxQueuedFrames = 8;
+};
+
+struct FrameCaptureStats
+{
+    unsigned int capturedFrames = 0;          // handed to the encoder
+    unsigned int droppedFrames = 0;           // no free pixel buffer, a full encoder queue or a resized window
+    unsigned int encodedFrames = 0;           // written to disk or to ffmpeg so far
+    double averageLatencyMilliseconds = 0.0;  // from the read being queued until its pixels were mapped
+    double averageLatencyFrames = 0.0;
+};
+
+// Records the viewer's frames without slowing it down. Every frame the back
+// buffer is read into the next pixel buffer object of a small ring with
+// glReadPixels, which only queues the copy on the GPU, and a fence is placed
+// behind it. Buffers whose fence has signalled by a later frame are mapped
+// without waiting, copied flipped to top-down rows and handed to an encoder
+// thread, which writes PNG files with stb_image_write or pipes raw RGBA
+// frames into ffmpeg. When every buffer of the ring is still in flight or the
+// encoder has fallen too far behind, the frame is dropped and counted rather
+// than stalling the render loop. The capture size is fixed by the first frame.
+class FrameCapture
+{
+public:
+    explicit FrameCapture(const FrameCaptureSettings& settings);
+
+    // finishes the reads in flight, lets the encoder write every queued frame and closes the video
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // queues the read of the default framebuffer's back buffer, call after the frame is drawn and before the swap
+    void CaptureFrame(int width, int height);
+
+    bool IsVideo() const;
+
+    // counts since the last call, the encoded count is cumulative
+    FrameCaptureStats ConsumeStats();
+
+private:
+    struct Readback
+    {
+        unsigned int buffer;
+        void* fence;  // GLsync of the glReadPixels into the buffer, null while the buffer is free
+        unsigned long long frameIndex;
+        std::chrono::steady_clock::time_point queueTime;
+    };
+
+    struct EncodedFrame
+    {
+        unsigned long long sequenceNumber;  // numbers the files of a PNG sequence without gaps
+        std::vector<unsigned char> pixels;  // RGBA, top row first
+    };
+
+    void CreateReadbacks(int width, int height);
+    void CollectFinishedReadbacks(bool wait);
+    void EncoderMain();
+    void WriteFrame(const EncodedFrame& frame);
+
+    FrameCaptureSettings settings;
+    bool video;
+    int width;
+    int height;
+
+    std::vector<Readback> readbacks;
+    unsigned int nextReadback;
+    unsigned long long frameIndex;
+    unsigned long long nextSequenceNumber;
+
+    FrameCaptureStats stats;
+    unsigned int latencySamples;
+    double latencyMilliseconds;
+    double latencyFrames;
+
+    std::FILE* videoPipe;
+    bool writeFailed;  // encoder thread only, reports the first failed write
+
+    std::thread encoderThread;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<EncodedFrame> queuedFrames;
+    std::vector<std::vector<unsigned char>> freePixelBuffers;  // recycled between the two threads
+    std::atomic<unsigned int> encodedFrames;
+    bool stopEncoder;
+};
@@ -0,0 +1,11 @@
+#include "frame_uniforms.h"
+
+#include <glad/glad.h>
+
+static_assert(sizeof(FrameUniforms) == 272, "FrameUniforms must match the std140 Frame block layout");
+
+void UploadFrameUniforms(StreamingBuffer& streamingBuffer, const FrameUniforms& frameUniforms)
+{
+    const StreamingRange range = streamingBuffer.Write(&frameUniforms, sizeof(FrameUniforms), streamingBuffer.GetUniformAlignment());
+    glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, range.buffer, static_cast<GLintptr>(range.offset), sizeof(FrameUniforms));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "streaming_buffer.h"
+
+// uniform block binding point of the Frame block in every shader program
+const unsigned int FrameBlockBinding = 1;
+
+// std140 layout of the Frame uniform block, shared by every program drawn in a frame
+struct FrameUniforms
+{
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::mat4 inverseViewProjectionMatrix;  // reconstructs world positions from depth
+    glm::vec4 cameraPos;
+    glm::vec4 viewportSize;                 // width, height, 1 / width, 1 / height
+    glm::uvec4 lightCounts;                 // lights in the light buffer, unbounded lights among them
+    glm::vec4 clusterDepthParams;           // scale and bias from log(view depth) to a cluster depth slice
+    glm::uvec4 clusterCounts;               // clusters along x, y and depth
+};
+
+// streams the uniforms of a frame and binds them to FrameBlockBinding
+void UploadFrameUniforms(StreamingBuffer& streamingBuffer, const FrameUniforms& frameUniforms);
@@ -0,0 +1,842 @@
+#include "gltf_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "job_system.h"
+#include "json.h"
+#include "mapped_file.h"
+
+namespace
+{
+
+const std::uint32_t GlbMagic = 0x46546c67;        // "glTF"
+const std::uint32_t GlbJsonChunk = 0x4e4f534a;    // "JSON"
+const std::uint32_t GlbBinaryChunk = 0x004e4942;  // "BIN\0"
+
+const int ByteComponent = 5120;
+const int UnsignedByteComponent = 5121;
+const int ShortComponent = 5122;
+const int UnsignedShortComponent = 5123;
+const int UnsignedIntComponent = 5125;
+const int FloatComponent = 5126;
+
+const int TrianglesMode = 4;
+
+// triangles gathered by one task, small enough to balance a single huge mesh over every thread
+const unsigned int TrianglesPerTask = 64 * 1024;
+
+// a buffer's bytes and the file they are in, so embedded images can be loaded from that file later
+struct GltfBuffer
+{
+    const unsigned char* data;
+    std::size_t size;
+    std::string filepath;
+    std::size_t fileOffset;
+};
+
+// one attribute or the indices of a primitive, data is null when the primitive doesn't have it
+struct Accessor
+{
+    const unsigned char* data;
+    std::size_t count;
+    std::size_t stride;
+    int componentType;
+    int componentCount;
+    bool normalized;
+};
+
+// a primitive placed by a node, its triangles fill model vertices [firstVertex, firstVertex + vertexCount)
+struct PrimitiveInstance
+{
+    Accessor positions;
+    Accessor normals;
+    Accessor texCoords;
+    Accessor indices;
+
+    // the whole vertex is one 32 byte copy when the three attributes interleave like Vertex
+    bool vertexLayout;
+
+    glm::mat4 transform;
+    glm::mat3 normalTransform;
+    bool identityTransform;
+    bool mirrored;  // negative determinant, two corners are swapped to keep the winding
+
+    unsigned int materialIndex;
+    unsigned int firstVertex;
+    unsigned int vertexCount;
+};
+
+struct GatherTask
+{
+    unsigned int instance;
+    unsigned int firstTriangle;
+    unsigned int triangleCount;
+
+    // bounds of the vertices this task wrote, merged into the submesh bounds afterwards
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+std::string GetDirectory(const std::string& filepath)
+{
+    const std::size_t separatorIndex = filepath.find_last_of("/\\");
+    if (separatorIndex == std::string::npos)
+    {
+        return "";
+    }
+
+    return filepath.substr(0, separatorIndex + 1);
+}
+
+// URIs of external files are relative paths with %-escapes
+std::string DecodeUri(const std::string& uri)
+{
+    std::string path;
+    for (std::size_t i = 0; i < uri.size(); ++i)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size())
+        {
+            path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            path += uri[i];
+        }
+    }
+
+    return path;
+}
+
+// index into a top-level array, out of range of every array when the value is missing or negative
+std::size_t GetIndex(const JsonValue& value)
+{
+    const double index = value.GetNumber(-1.0);
+    if (!(index >= 0.0) || index >= static_cast<double>(std::numeric_limits<std::size_t>::max()))
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    return static_cast<std::size_t>(index);
+}
+
+// non-negative integer property such as a count or byte offset, defaultValue when missing
+std::size_t GetUnsigned(const JsonValue& value, std::size_t defaultValue, const std::string& name)
+{
+    if (value.IsNull())
+    {
+        return defaultValue;
+    }
+
+    const double number = value.GetNumber(-1.0);
+    if (!(number >= 0.0) || number >= static_cast<double>(std::numeric_limits<std::size_t>::max()) || number != std::floor(number))
+    {
+        throw std::runtime_error{"glTF " + name + " is not a non-negative integer"};
+    }
+
+    return static_cast<std::size_t>(number);
+}
+
+// true when [offset, offset + length) lies within size bytes, without overflowing
+bool IsRangeInside(std::size_t offset, std::size_t length, std::size_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+std::size_t GetComponentSize(int componentType)
+{
+    switch (componentType)
+    {
+    case ByteComponent:
+    case UnsignedByteComponent:
+        return 1;
+    case ShortComponent:
+    case UnsignedShortComponent:
+        return 2;
+    case UnsignedIntComponent:
+    case FloatComponent:
+        return 4;
+    default:
+        throw std::runtime_error{"unknown glTF component type " + std::to_string(componentType)};
+    }
+}
+
+int GetComponentCount(const std::string& type)
+{
+    if (type == "SCALAR")
+    {
+        return 1;
+    }
+    if (type == "VEC2")
+    {
+        return 2;
+    }
+    if (type == "VEC3")
+    {
+        return 3;
+    }
+    if (type == "VEC4")
+    {
+        return 4;
+    }
+
+    throw std::runtime_error{"unsupported glTF accessor type " + type};
+}
+
+std::vector<GltfBuffer> LoadBuffers(const JsonValue& document, const std::string& filepath, const unsigned char* glbBinary, std::size_t glbBinarySize,
+                                    std::size_t glbBinaryOffset, std::vector<std::unique_ptr<MappedFile>>& mappedFiles)
+{
+    const std::string directory = GetDirectory(filepath);
+    const JsonValue& bufferList = document["buffers"];
+
+    std::vector<GltfBuffer> buffers;
+    for (std::size_t i = 0; i < bufferList.GetSize(); ++i)
+    {
+        const std::string& uri = bufferList[i]["uri"].GetString();
+
+        GltfBuffer buffer;
+        if (uri.empty())
+        {
+            // the buffer without a URI is the GLB's binary chunk
+            if (glbBinary == nullptr)
+            {
+                throw std::runtime_error{"glTF buffer has neither a URI nor a GLB binary chunk"};
+            }
+
+            buffer.data = glbBinary;
+            buffer.size = glbBinarySize;
+            buffer.filepath = filepath;
+            buffer.fileOffset = glbBinaryOffset;
+        }
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            throw std::runtime_error{"glTF buffers in data URIs are not supported"};
+        }
+        else
+        {
+            buffer.filepath = directory + DecodeUri(uri);
+            mappedFiles.emplace_back(new MappedFile{buffer.filepath});
+            buffer.data = mappedFiles.back()->GetData();
+            buffer.size = mappedFiles.back()->GetSize();
+            buffer.fileOffset = 0;
+        }
+
+        const std::size_t byteLength = GetUnsigned(bufferList[i]["byteLength"], 0, "buffer byteLength");
+        if (byteLength > buffer.size)
+        {
+            throw std::runtime_error{"glTF buffer " + std::to_string(i) + " is shorter than its byteLength"};
+        }
+        buffer.size = byteLength;
+
+        buffers.push_back(buffer);
+    }
+
+    return buffers;
+}
+
+Accessor ResolveAccessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, const JsonValue& accessorIndex)
+{
+    Accessor result{nullptr, 0, 0, FloatComponent, 0, false};
+    if (accessorIndex.IsNull())
+    {
+        return result;
+    }
+
+    const JsonValue& accessor = document["accessors"][GetIndex(accessorIndex)];
+    if (accessor.IsNull())
+    {
+        throw std::runtime_error{"glTF primitive references a missing accessor"};
+    }
+    if (accessor["sparse"].IsNull() == false)
+    {
+        throw std::runtime_error{"sparse glTF accessors are not supported"};
+    }
+
+    const JsonValue& bufferView = document["bufferViews"][GetIndex(accessor["bufferView"])];
+    if (bufferView.IsNull())
+    {
+        throw std::runtime_error{"glTF accessor without a buffer view"};
+    }
+
+    const std::size_t bufferIndex = GetIndex(bufferView["buffer"]);
+    if (bufferIndex >= buffers.size())
+    {
+        throw std::runtime_error{"glTF buffer view references a missing buffer"};
+    }
+    const GltfBuffer& buffer = buffers[bufferIndex];
+
+    result.count = GetUnsigned(accessor["count"], 0, "accessor count");
+    result.componentType = static_cast<int>(GetUnsigned(accessor["componentType"], 0, "accessor componentType"));
+    result.componentCount = GetComponentCount(accessor["type"].GetString());
+    result.normalized = accessor["normalized"].GetBool(false);
+
+    const std::size_t elementSize = GetComponentSize(result.componentType) * result.componentCount;
+    result.stride = GetUnsigned(bufferView["byteStride"], elementSize, "buffer view byteStride");
+    if (result.stride == 0)
+    {
+        throw std::runtime_error{"glTF buffer view has a byteStride of 0"};
+    }
+
+    // checked with divisions, so crafted offsets and counts can't wrap around
+    const std::size_t viewOffset = GetUnsigned(bufferView["byteOffset"], 0, "buffer view byteOffset");
+    const std::size_t viewLength = GetUnsigned(bufferView["byteLength"], 0, "buffer view byteLength");
+    const std::size_t accessorOffset = GetUnsigned(accessor["byteOffset"], 0, "accessor byteOffset");
+    if (IsRangeInside(viewOffset, viewLength, buffer.size) == false || accessorOffset > viewLength ||
+        (result.count > 0 && (elementSize > viewLength - accessorOffset || result.count - 1 > (viewLength - accessorOffset - elementSize) / result.stride)))
+    {
+        throw std::runtime_error{"glTF accessor reaches past its buffer"};
+    }
+
+    result.data = buffer.data + viewOffset + accessorOffset;
+    return result;
+}
+
+// reads up to count components as floats, missing components are 0
+void ReadFloats(const Accessor& accessor, std::size_t index, float* values, int count)
+{
+    const unsigned char* element = accessor.data + index * accessor.stride;
+    if (accessor.componentType == FloatComponent && accessor.componentCount >= count)
+    {
+        std::memcpy(values, element, count * sizeof(float));
+        return;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        float value = 0.0f;
+        if (i < accessor.componentCount)
+        {
+            switch (accessor.componentType)
+            {
+            case ByteComponent:
+            {
+                const float component = static_cast<float>(static_cast<std::int8_t>(element[i]));
+                value = accessor.normalized ? std::max(component / 127.0f, -1.0f) : component;
+                break;
+            }
+            case UnsignedByteComponent:
+                value = accessor.normalized ? element[i] / 255.0f : element[i];
+                break;
+            case ShortComponent:
+            {
+                std::int16_t component;
+                std::memcpy(&component, element + i * 2, sizeof(component));
+                value = accessor.normalized ? std::max(component / 32767.0f, -1.0f) : static_cast<float>(component);
+                break;
+            }
+            case UnsignedShortComponent:
+            {
+                std::uint16_t component;
+                std::memcpy(&component, element + i * 2, sizeof(component));
+                value = accessor.normalized ? component / 65535.0f : static_cast<float>(component);
+                break;
+            }
+            case UnsignedIntComponent:
+            {
+                std::uint32_t component;
+                std::memcpy(&component, element + i * 4, sizeof(component));
+                value = static_cast<float>(component);
+                break;
+            }
+            case FloatComponent:
+                std::memcpy(&value, element + i * 4, sizeof(value));
+                break;
+            }
+        }
+        values[i] = value;
+    }
+}
+
+std::size_t ReadIndex(const Accessor& accessor, std::size_t index)
+{
+    const unsigned char* element = accessor.data + index * accessor.stride;
+    switch (accessor.componentType)
+    {
+    case UnsignedByteComponent:
+        return element[0];
+    case UnsignedShortComponent:
+    {
+        std::uint16_t value;
+        std::memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    default:
+    {
+        std::uint32_t value;
+        std::memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    }
+}
+
+glm::mat4 GetLocalTransform(const JsonValue& node)
+{
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.GetSize() == 16)
+    {
+        glm::mat4 transform;
+        for (int i = 0; i < 16; ++i)
+        {
+            transform[i / 4][i % 4] = static_cast<float>(matrix[i].GetNumber(0.0));
+        }
+        return transform;
+    }
+
+    const JsonValue& translation = node["translation"];
+    const JsonValue& rotation = node["rotation"];
+    const JsonValue& scale = node["scale"];
+
+    // rotation is a unit quaternion x, y, z, w
+    const float x = static_cast<float>(rotation[0].GetNumber(0.0));
+    const float y = static_cast<float>(rotation[1].GetNumber(0.0));
+    const float z = static_cast<float>(rotation[2].GetNumber(0.0));
+    const float w = static_cast<float>(rotation[3].GetNumber(1.0));
+
+    glm::mat4 transform{1.0f};
+    transform[0] = glm::vec4{1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f};
+    transform[1] = glm::vec4{2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f};
+    transform[2] = glm::vec4{2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        transform[axis] *= static_cast<float>(scale[axis].GetNumber(1.0));
+    }
+    transform[3] = glm::vec4{static_cast<float>(translation[0].GetNumber(0.0)), static_cast<float>(translation[1].GetNumber(0.0)),
+                             static_cast<float>(translation[2].GetNumber(0.0)), 1.0f};
+
+    return transform;
+}
+
+void AddMeshInstances(const JsonValue& document, const std::vector<GltfBuffer>& buffers, const JsonValue& mesh, const glm::mat4& transform,
+                      std::vector<PrimitiveInstance>& instances)
+{
+    const glm::mat3 linearPart{transform};
+    const float determinant = glm::dot(linearPart[0], glm::cross(linearPart[1], linearPart[2]));
+
+    const JsonValue& primitives = mesh["primitives"];
+    for (std::size_t i = 0; i < primitives.GetSize(); ++i)
+    {
+        const JsonValue& primitive = primitives[i];
+        if (GetUnsigned(primitive["mode"], TrianglesMode, "primitive mode") != static_cast<std::size_t>(TrianglesMode))
+        {
+            continue;
+        }
+
+        const JsonValue& attributes = primitive["attributes"];
+
+        PrimitiveInstance instance;
+        instance.positions = ResolveAccessor(document, buffers, attributes["POSITION"]);
+        instance.normals = ResolveAccessor(document, buffers, attributes["NORMAL"]);
+        instance.texCoords = ResolveAccessor(document, buffers, attributes["TEXCOORD_0"]);
+        instance.indices = ResolveAccessor(document, buffers, primitive["indices"]);
+        if (instance.positions.data == nullptr || instance.positions.componentCount < 3)
+        {
+            continue;
+        }
+        if (instance.indices.data != nullptr && instance.indices.componentType != UnsignedByteComponent &&
+            instance.indices.componentType != UnsignedShortComponent && instance.indices.componentType != UnsignedIntComponent)
+        {
+            throw std::runtime_error{"glTF indices must be unsigned integers"};
+        }
+
+        const Accessor& positions = instance.positions;
+        instance.vertexLayout = instance.normals.data == positions.data + 12 && instance.texCoords.data == positions.data + 24 &&
+                                positions.stride == sizeof(Vertex) && instance.normals.stride == sizeof(Vertex) &&
+                                instance.texCoords.stride == sizeof(Vertex) && positions.componentType == FloatComponent &&
+                                instance.normals.componentType == FloatComponent && instance.texCoords.componentType == FloatComponent &&
+                                positions.componentCount == 3 && instance.normals.componentCount == 3 && instance.texCoords.componentCount == 2;
+
+        instance.transform = transform;
+        instance.normalTransform = glm::transpose(glm::inverse(linearPart));
+        instance.identityTransform = (transform == glm::mat4{1.0f});
+        instance.mirrored = determinant < 0.0f;
+
+        // material 0 is the default, glTF material i is i + 1
+        const JsonValue& material = primitive["material"];
+        instance.materialIndex = material.IsNull() ? 0 : static_cast<unsigned int>(GetIndex(material) + 1);
+
+        const std::size_t cornerCount = (instance.indices.data != nullptr) ? instance.indices.count : positions.count;
+        if (cornerCount > std::numeric_limits<unsigned int>::max())
+        {
+            throw std::runtime_error{"glTF primitive has more than 4 billion vertices"};
+        }
+        instance.vertexCount = static_cast<unsigned int>(cornerCount - cornerCount % 3);
+        instance.firstVertex = 0;
+        if (instance.vertexCount > 0)
+        {
+            instances.push_back(instance);
+        }
+    }
+}
+
+void AddNodeInstances(const JsonValue& document, const std::vector<GltfBuffer>& buffers, std::size_t nodeIndex, const glm::mat4& parentTransform,
+                      std::size_t depth, std::vector<PrimitiveInstance>& instances)
+{
+    const JsonValue& nodes = document["nodes"];
+    const JsonValue& node = nodes[nodeIndex];
+
+    // a node can't be deeper than the number of nodes unless the hierarchy has a cycle
+    if (node.IsNull() || depth > nodes.GetSize())
+    {
+        throw std::runtime_error{"glTF node hierarchy references a missing node or has a cycle"};
+    }
+
+    const glm::mat4 transform = parentTransform * GetLocalTransform(node);
+
+    const JsonValue& meshIndex = node["mesh"];
+    if (meshIndex.IsNull() == false)
+    {
+        AddMeshInstances(document, buffers, document["meshes"][GetIndex(meshIndex)], transform, instances);
+    }
+
+    const JsonValue& children = node["children"];
+    for (std::size_t i = 0; i < children.GetSize(); ++i)
+    {
+        AddNodeInstances(document, buffers, GetIndex(children[i]), transform, depth + 1, instances);
+    }
+}
+
+std::vector<PrimitiveInstance> CollectInstances(const JsonValue& document, const std::vector<GltfBuffer>& buffers)
+{
+    std::vector<PrimitiveInstance> instances;
+
+    const JsonValue& scenes = document["scenes"];
+    if (scenes.GetSize() == 0)
+    {
+        // without scenes every mesh is drawn once where it is defined
+        const JsonValue& meshes = document["meshes"];
+        for (std::size_t i = 0; i < meshes.GetSize(); ++i)
+        {
+            AddMeshInstances(document, buffers, meshes[i], glm::mat4{1.0f}, instances);
+        }
+        return instances;
+    }
+
+    const JsonValue& scene = scenes[GetUnsigned(document["scene"], 0, "scene")];
+    if (scene.IsNull())
+    {
+        throw std::runtime_error{"glTF document references a missing scene"};
+    }
+
+    const JsonValue& rootNodes = scene["nodes"];
+    for (std::size_t i = 0; i < rootNodes.GetSize(); ++i)
+    {
+        AddNodeInstances(document, buffers, GetIndex(rootNodes[i]), glm::mat4{1.0f}, 0, instances);
+    }
+
+    return instances;
+}
+
+std::vector<Material> LoadMaterials(const JsonValue& document, const std::vector<GltfBuffer>& buffers, const std::string& filepath)
+{
+    const std::string directory = GetDirectory(filepath);
+
+    std::vector<Material> materials;
+    materials.push_back(MakeDefaultMaterial("default"));
+
+    const JsonValue& materialList = document["materials"];
+    for (std::size_t i = 0; i < materialList.GetSize(); ++i)
+    {
+        const JsonValue& gltfMaterial = materialList[i];
+        const JsonValue& pbr = gltfMaterial["pbrMetallicRoughness"];
+
+        const std::string& name = gltfMaterial["name"].GetString();
+        Material material = MakeDefaultMaterial(name.empty() ? "material " + std::to_string(i) : name);
+
+        const JsonValue& baseColor = pbr["baseColorFactor"];
+        const glm::vec3 baseColorFactor{static_cast<float>(baseColor[0].GetNumber(1.0)), static_cast<float>(baseColor[1].GetNumber(1.0)),
+                                        static_cast<float>(baseColor[2].GetNumber(1.0))};
+
+        material.metallic = static_cast<float>(pbr["metallicFactor"].GetNumber(1.0));
+        material.roughness = static_cast<float>(pbr["roughnessFactor"].GetNumber(1.0));
+        material.diffuseColor = baseColorFactor;
+        material.ambientColor = baseColorFactor * 0.2f;
+
+        // the Phong shader gets the dielectric or metal reflectance and the exponent RoughnessFromShininess inverts
+        material.specularColor = glm::mix(glm::vec3{0.04f}, baseColorFactor, material.metallic);
+        material.shininessValue = std::max(2.0f / std::max(material.roughness * material.roughness, 1.0e-4f) - 2.0f, 1.0f);
+
+        const JsonValue& image = document["images"][GetIndex(document["textures"][GetIndex(pbr["baseColorTexture"]["index"])]["source"])];
+        const std::string& uri = image["uri"].GetString();
+        if (uri.empty() == false && uri.compare(0, 5, "data:") != 0)
+        {
+            material.diffuseTexturePath = directory + DecodeUri(uri);
+        }
+        else if (image["bufferView"].IsNull() == false)
+        {
+            const JsonValue& bufferView = document["bufferViews"][GetIndex(image["bufferView"])];
+            const std::size_t bufferIndex = GetIndex(bufferView["buffer"]);
+            const std::size_t viewOffset = GetUnsigned(bufferView["byteOffset"], 0, "buffer view byteOffset");
+            const std::size_t viewLength = GetUnsigned(bufferView["byteLength"], 0, "buffer view byteLength");
+            if (bufferIndex < buffers.size() && IsRangeInside(viewOffset, viewLength, buffers[bufferIndex].size))
+            {
+                material.diffuseTexturePath = buffers[bufferIndex].filepath;
+                material.diffuseTextureOffset = buffers[bufferIndex].fileOffset + viewOffset;
+                material.diffuseTextureSize = viewLength;
+            }
+        }
+
+        materials.push_back(material);
+    }
+
+    return materials;
+}
+
+// writes the task's triangles into their place in vertices, returns false when an index was out of range
+bool GatherTriangles(const PrimitiveInstance& instance, GatherTask& task, std::vector<Vertex>& vertices)
+{
+    bool indicesValid = true;
+    const bool hasNormals = instance.normals.data != nullptr;
+    const bool hasTexCoords = instance.texCoords.data != nullptr;
+    const bool floatPositions = instance.positions.componentType == FloatComponent;
+
+    const unsigned int cornerOrder[3] = {0, instance.mirrored ? 2u : 1u, instance.mirrored ? 1u : 2u};
+
+    Vertex* const output = &vertices[instance.firstVertex + task.firstTriangle * 3];
+    for (unsigned int triangle = 0; triangle < task.triangleCount; ++triangle)
+    {
+        for (unsigned int corner = 0; corner < 3; ++corner)
+        {
+            const std::size_t sourceCorner = static_cast<std::size_t>(task.firstTriangle + triangle) * 3 + cornerOrder[corner];
+            std::size_t index = (instance.indices.data != nullptr) ? ReadIndex(instance.indices, sourceCorner) : sourceCorner;
+            if (index >= instance.positions.count || (hasNormals && index >= instance.normals.count) || (hasTexCoords && index >= instance.texCoords.count))
+            {
+                indicesValid = false;
+                index = 0;
+            }
+
+            Vertex& vertex = output[triangle * 3 + corner];
+            if (instance.vertexLayout)
+            {
+                std::memcpy(&vertex, instance.positions.data + index * sizeof(Vertex), sizeof(Vertex));
+            }
+            else
+            {
+                if (floatPositions)
+                {
+                    std::memcpy(&vertex.position, instance.positions.data + index * instance.positions.stride, sizeof(glm::vec3));
+                }
+                else
+                {
+                    ReadFloats(instance.positions, index, &vertex.position.x, 3);
+                }
+
+                vertex.normal = glm::vec3{0.0f, 0.0f, 0.0f};
+                if (hasNormals)
+                {
+                    ReadFloats(instance.normals, index, &vertex.normal.x, 3);
+                }
+
+                vertex.texCoord = glm::vec2{0.0f, 0.0f};
+                if (hasTexCoords)
+                {
+                    ReadFloats(instance.texCoords, index, &vertex.texCoord.x, 2);
+                }
+            }
+
+            // glTF images start at the top row, the texture cache's at the bottom
+            vertex.texCoord.y = 1.0f - vertex.texCoord.y;
+
+            if (instance.identityTransform == false)
+            {
+                vertex.position = glm::vec3{instance.transform * glm::vec4{vertex.position, 1.0f}};
+                vertex.normal = instance.normalTransform * vertex.normal;
+            }
+        }
+
+        Vertex* const corners = &output[triangle * 3];
+        if (hasNormals == false)
+        {
+            const glm::vec3 faceNormal = glm::cross(corners[1].position - corners[0].position, corners[2].position - corners[0].position);
+            const float length = glm::length(faceNormal);
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                corners[corner].normal = (length > 0.0f) ? faceNormal / length : glm::vec3{0.0f, 1.0f, 0.0f};
+            }
+        }
+        else if (instance.identityTransform == false)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const float length = glm::length(corners[corner].normal);
+                corners[corner].normal = (length > 0.0f) ? corners[corner].normal / length : corners[corner].normal;
+            }
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            task.boundsMin = glm::min(task.boundsMin, corners[corner].position);
+            task.boundsMax = glm::max(task.boundsMax, corners[corner].position);
+        }
+    }
+
+    return indicesValid;
+}
+
+} // namespace
+
+Model LoadGltfFile(const std::string& filepath)
+{
+    const MappedFile file{filepath};
+    const unsigned char* const data = file.GetData();
+    const std::size_t size = file.GetSize();
+
+    const char* json = reinterpret_cast<const char*>(data);
+    std::size_t jsonLength = size;
+    const unsigned char* glbBinary = nullptr;
+    std::size_t glbBinarySize = 0;
+    std::size_t glbBinaryOffset = 0;
+
+    std::uint32_t magic = 0;
+    if (size >= 4)
+    {
+        std::memcpy(&magic, data, sizeof(magic));
+    }
+
+    if (magic == GlbMagic)
+    {
+        // 12 byte header, then chunks of a 32 bit length, a 32 bit type and the data: JSON first, binary optional
+        std::uint32_t header[3];
+        if (size < 20)
+        {
+            throw std::runtime_error{"GLB file is truncated"};
+        }
+        std::memcpy(header, data, sizeof(header));
+        if (header[1] != 2)
+        {
+            throw std::runtime_error{"Only glTF 2.0 GLB files are supported"};
+        }
+
+        std::size_t chunkOffset = 12;
+        while (chunkOffset + 8 <= std::min<std::size_t>(size, header[2]))
+        {
+            std::uint32_t chunkHeader[2];
+            std::memcpy(chunkHeader, data + chunkOffset, sizeof(chunkHeader));
+            const std::size_t chunkDataOffset = chunkOffset + 8;
+            if (chunkDataOffset + chunkHeader[0] > size)
+            {
+                throw std::runtime_error{"GLB file is truncated"};
+            }
+
+            if (chunkHeader[1] == GlbJsonChunk && chunkOffset == 12)
+            {
+                json = reinterpret_cast<const char*>(data + chunkDataOffset);
+                jsonLength = chunkHeader[0];
+            }
+            else if (chunkHeader[1] == GlbBinaryChunk && glbBinary == nullptr)
+            {
+                glbBinary = data + chunkDataOffset;
+                glbBinarySize = chunkHeader[0];
+                glbBinaryOffset = chunkDataOffset;
+            }
+
+            // chunks are padded to 4 bytes
+            chunkOffset = chunkDataOffset + ((chunkHeader[0] + 3) & ~std::size_t{3});
+        }
+
+        if (json == reinterpret_cast<const char*>(data))
+        {
+            throw std::runtime_error{"GLB file has no JSON chunk"};
+        }
+    }
+
+    const JsonValue document = ParseJson(json, jsonLength);
+
+    if (document["asset"]["version"].GetString().compare(0, 2, "2.") != 0)
+    {
+        throw std::runtime_error{"Only glTF 2.0 files are supported"};
+    }
+
+    const JsonValue& requiredExtensions = document["extensionsRequired"];
+    for (std::size_t i = 0; i < requiredExtensions.GetSize(); ++i)
+    {
+        if (requiredExtensions[i].GetString() != "KHR_mesh_quantization")
+        {
+            throw std::runtime_error{"glTF file requires the unsupported extension " + requiredExtensions[i].GetString()};
+        }
+    }
+
+    std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+    const std::vector<GltfBuffer> buffers = LoadBuffers(document, filepath, glbBinary, glbBinarySize, glbBinaryOffset, mappedFiles);
+
+    std::vector<PrimitiveInstance> instances = CollectInstances(document, buffers);
+
+    Model model;
+    model.materials = LoadMaterials(document, buffers, filepath);
+
+    std::size_t vertexCount = 0;
+    std::vector<GatherTask> tasks;
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        PrimitiveInstance& instance = instances[i];
+        if (instance.materialIndex >= model.materials.size())
+        {
+            instance.materialIndex = 0;
+        }
+
+        instance.firstVertex = static_cast<unsigned int>(vertexCount);
+        vertexCount += instance.vertexCount;
+        if (vertexCount > 0xffffffffu)
+        {
+            throw std::runtime_error{"glTF model has more than 4 billion vertices"};
+        }
+
+        const unsigned int triangleCount = instance.vertexCount / 3;
+        for (unsigned int firstTriangle = 0; firstTriangle < triangleCount; firstTriangle += TrianglesPerTask)
+        {
+            tasks.push_back(GatherTask{static_cast<unsigned int>(i), firstTriangle, std::min(TrianglesPerTask, triangleCount - firstTriangle),
+                                       glm::vec3{std::numeric_limits<float>::max()}, glm::vec3{-std::numeric_limits<float>::max()}});
+        }
+    }
+
+    if (vertexCount == 0)
+    {
+        throw std::runtime_error{"glTF file has no triangles"};
+    }
+
+    // the page faults of the mapped buffers are spread over every thread, so reading the file is what takes the time
+    model.vertices.resize(vertexCount);
+
+    std::atomic<bool> indicesValid{true};
+    GetSharedJobSystem().ParallelFor(tasks.size(), 1, [&](std::size_t firstTask, std::size_t endTask)
+    {
+        for (std::size_t task = firstTask; task < endTask; ++task)
+        {
+            if (GatherTriangles(instances[tasks[task].instance], tasks[task], model.vertices) == false)
+            {
+                indicesValid = false;
+            }
+        }
+    });
+
+    if (indicesValid == false)
+    {
+        throw std::runtime_error{"glTF primitive indexes a missing vertex"};
+    }
+
+    for (const auto& instance : instances)
+    {
+        Submesh submesh;
+        submesh.materialIndex = instance.materialIndex;
+        submesh.firstVertex = instance.firstVertex;
+        submesh.vertexCount = instance.vertexCount;
+        submesh.boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+        submesh.boundsMax = glm::vec3{-std::numeric_limits<float>::max()};
+        model.submeshes.push_back(submesh);
+    }
+    for (const auto& task : tasks)
+    {
+        Submesh& submesh = model.submeshes[task.instance];
+        submesh.boundsMin = glm::min(submesh.boundsMin, task.boundsMin);
+        submesh.boundsMax = glm::max(submesh.boundsMax, task.boundsMax);
+    }
+
+    return model;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "model.h"
+
+// Loads a glTF 2.0 model, either a .glb file or a .gltf description with
+// external .bin buffers. Every buffer is mapped into memory rather than read,
+// and the triangle lists of the default scene's meshes are placed with the
+// node hierarchy's transforms and gathered into the model's vertices in chunks,
+// as jobs of the shared job system. Float attributes are copied as they are (the
+// whole vertex at once when a buffer view interleaves position, normal and
+// texture coordinate exactly like Vertex), quantized ones (KHR_mesh_quantization)
+// are converted. Each primitive of each node becomes a submesh with its
+// metallic-roughness material; base colour textures are loaded by the texture
+// cache in the background, embedded ones straight from the model file.
+// Primitives without normals get flat normals, other primitive modes than
+// triangles are skipped, and sparse accessors, data URIs and required
+// extensions other than KHR_mesh_quantization throw.
+Model LoadGltfFile(const std::string& filepath);
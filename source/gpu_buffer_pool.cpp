@@ -0,0 +1,346 @@
+#include "gpu_buffer_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+const std::size_t minimumBlockSize = 256;
+
+std::size_t GetBlockSize(unsigned int order)
+{
+    return minimumBlockSize << order;
+}
+
+} // namespace
+
+GpuBufferPool::GpuBufferPool(std::size_t bufferSize, float defragmentThreshold)
+    : bufferSize{GetBlockSize(GetOrder(bufferSize))},
+      defragmentThreshold{defragmentThreshold},
+      allocationsChanged{false},
+      defragmentations{0},
+      movedBytes{0}
+{
+}
+
+GpuBufferPool::~GpuBufferPool()
+{
+    for (const Buffer& buffer : buffers)
+    {
+        glDeleteBuffers(1, &buffer.buffer);
+    }
+}
+
+unsigned int GpuBufferPool::Allocate(std::size_t size)
+{
+    Allocation allocation{true, 0, 0, GetOrder(size), size};
+    Place(buffers, allocation);
+    if (buffers.back().buffer == 0)
+    {
+        CreateBufferObject(buffers.back());
+    }
+    allocationsChanged = true;
+
+    if (freeHandles.empty())
+    {
+        allocations.push_back(allocation);
+        return static_cast<unsigned int>(allocations.size());
+    }
+
+    const unsigned int handle = freeHandles.back();
+    freeHandles.pop_back();
+    allocations[handle - 1] = allocation;
+
+    return handle;
+}
+
+void GpuBufferPool::Free(unsigned int allocation)
+{
+    if (allocation == 0)
+    {
+        return;
+    }
+
+    // a second free would put the block into the free lists twice
+    GetLiveAllocation(allocation);
+
+    Allocation& freed = allocations[allocation - 1];
+    FreeBlock(buffers[freed.bufferIndex], freed.offset, freed.order);
+
+    freed.live = false;
+    freeHandles.push_back(allocation);
+    allocationsChanged = true;
+}
+
+void GpuBufferPool::Upload(unsigned int allocation, const void* data, std::size_t size)
+{
+    // a stale handle would write into another allocation's range
+    const Allocation& target = GetLiveAllocation(allocation);
+    if (size > target.size)
+    {
+        throw std::runtime_error{"upload of " + std::to_string(size) + " bytes exceeds an allocation of " + std::to_string(target.size)};
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[target.bufferIndex].buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(target.offset), static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GpuBufferRange GpuBufferPool::GetRange(unsigned int allocation) const
+{
+    const Allocation& target = GetLiveAllocation(allocation);
+    return GpuBufferRange{buffers[target.bufferIndex].buffer, target.offset, target.size};
+}
+
+bool GpuBufferPool::DefragmentIfNeeded()
+{
+    // packing the same allocations again would give the same layout
+    if (allocationsChanged == false)
+    {
+        return false;
+    }
+    allocationsChanged = false;
+
+    const GpuBufferPoolStats stats = GetStats();
+    if (stats.fragmentedBytes == 0 || static_cast<float>(stats.fragmentedBytes) <= defragmentThreshold * static_cast<float>(stats.capacityBytes))
+    {
+        return false;
+    }
+
+    Defragment();
+    return true;
+}
+
+void GpuBufferPool::Defragment()
+{
+    std::vector<Buffer> packedBuffers;
+    std::vector<Allocation> packedAllocations;
+    Pack(packedBuffers, packedAllocations);
+
+    for (Buffer& buffer : packedBuffers)
+    {
+        CreateBufferObject(buffer);
+    }
+
+    for (std::size_t i = 0; i < allocations.size(); ++i)
+    {
+        const Allocation& source = allocations[i];
+        const Allocation& destination = packedAllocations[i];
+        if (source.live == false || source.size == 0)
+        {
+            continue;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers[source.bufferIndex].buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, packedBuffers[destination.bufferIndex].buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(source.offset), static_cast<GLintptr>(destination.offset),
+                            static_cast<GLsizeiptr>(source.size));
+        movedBytes += source.size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // draws already issued keep the storage of a deleted buffer alive until they are done
+    for (const Buffer& buffer : buffers)
+    {
+        glDeleteBuffers(1, &buffer.buffer);
+    }
+    buffers = std::move(packedBuffers);
+    allocations = std::move(packedAllocations);
+
+    ++defragmentations;
+}
+
+GpuBufferPoolStats GpuBufferPool::GetStats() const
+{
+    GpuBufferPoolStats stats;
+    stats.bufferCount = static_cast<unsigned int>(buffers.size());
+    stats.defragmentations = defragmentations;
+    stats.movedBytes = movedBytes;
+
+    for (const Buffer& buffer : buffers)
+    {
+        stats.capacityBytes += buffer.size;
+        for (unsigned int order = 0; order < buffer.freeBlocks.size(); ++order)
+        {
+            stats.freeBytes += buffer.freeBlocks[order].size() * GetBlockSize(order);
+        }
+    }
+    stats.largestFreeBlock = GetLargestFreeBlock(buffers);
+
+    // a lone small allocation leaves free halves of every size behind it, which packing can't merge either
+    std::vector<Buffer> packedBuffers;
+    std::vector<Allocation> packedAllocations;
+    Pack(packedBuffers, packedAllocations);
+
+    std::size_t packedCapacityBytes = 0;
+    for (const Buffer& buffer : packedBuffers)
+    {
+        packedCapacityBytes += buffer.size;
+    }
+    const std::size_t packedLargestFreeBlock = GetLargestFreeBlock(packedBuffers);
+    stats.fragmentedBytes = (stats.capacityBytes - std::min(packedCapacityBytes, stats.capacityBytes)) +
+                            (packedLargestFreeBlock - std::min(stats.largestFreeBlock, packedLargestFreeBlock));
+
+    for (const Allocation& allocation : allocations)
+    {
+        if (allocation.live)
+        {
+            stats.usedBytes += allocation.size;
+            stats.paddingBytes += GetBlockSize(allocation.order) - allocation.size;
+            ++stats.allocationCount;
+        }
+    }
+
+    return stats;
+}
+
+unsigned int GpuBufferPool::GetOrder(std::size_t size)
+{
+    unsigned int order = 0;
+    while (GetBlockSize(order) < size)
+    {
+        ++order;
+    }
+
+    return order;
+}
+
+void GpuBufferPool::CreateBufferObject(Buffer& buffer)
+{
+    glGenBuffers(1, &buffer.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(buffer.size), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool GpuBufferPool::AllocateBlock(Buffer& buffer, unsigned int order, std::size_t& offset)
+{
+    unsigned int splitOrder = order;
+    while (splitOrder < buffer.freeBlocks.size() && buffer.freeBlocks[splitOrder].empty())
+    {
+        ++splitOrder;
+    }
+
+    if (splitOrder >= buffer.freeBlocks.size())
+    {
+        return false;
+    }
+
+    // the lowest free block, which keeps allocations towards the start of the buffer
+    offset = *buffer.freeBlocks[splitOrder].begin();
+    buffer.freeBlocks[splitOrder].erase(buffer.freeBlocks[splitOrder].begin());
+
+    // the upper halves of the split blocks stay free
+    while (splitOrder > order)
+    {
+        --splitOrder;
+        buffer.freeBlocks[splitOrder].insert(offset + GetBlockSize(splitOrder));
+    }
+
+    return true;
+}
+
+void GpuBufferPool::FreeBlock(Buffer& buffer, std::size_t offset, unsigned int order)
+{
+    while (order + 1 < buffer.freeBlocks.size())
+    {
+        const std::size_t buddyOffset = offset ^ GetBlockSize(order);
+        const auto buddy = buffer.freeBlocks[order].find(buddyOffset);
+        if (buddy == buffer.freeBlocks[order].end())
+        {
+            break;
+        }
+
+        buffer.freeBlocks[order].erase(buddy);
+        offset = std::min(offset, buddyOffset);
+        ++order;
+    }
+
+    buffer.freeBlocks[order].insert(offset);
+}
+
+std::size_t GpuBufferPool::GetLargestFreeBlock(const std::vector<Buffer>& targetBuffers)
+{
+    std::size_t largestFreeBlock = 0;
+    for (const Buffer& buffer : targetBuffers)
+    {
+        for (unsigned int order = 0; order < buffer.freeBlocks.size(); ++order)
+        {
+            if (buffer.freeBlocks[order].empty() == false)
+            {
+                largestFreeBlock = std::max(largestFreeBlock, GetBlockSize(order));
+            }
+        }
+    }
+
+    return largestFreeBlock;
+}
+
+const GpuBufferPool::Allocation& GpuBufferPool::GetLiveAllocation(unsigned int allocation) const
+{
+    if (allocation == 0 || allocation > allocations.size() || allocations[allocation - 1].live == false)
+    {
+        throw std::runtime_error{"GPU buffer pool allocation " + std::to_string(allocation) + " is not allocated"};
+    }
+
+    return allocations[allocation - 1];
+}
+
+void GpuBufferPool::Place(std::vector<Buffer>& targetBuffers, Allocation& allocation) const
+{
+    for (std::size_t i = 0; i < targetBuffers.size(); ++i)
+    {
+        if (AllocateBlock(targetBuffers[i], allocation.order, allocation.offset))
+        {
+            allocation.bufferIndex = static_cast<unsigned int>(i);
+            return;
+        }
+    }
+
+    Buffer buffer;
+    buffer.buffer = 0;
+    buffer.size = std::max(bufferSize, GetBlockSize(allocation.order));
+    buffer.freeBlocks.resize(GetOrder(buffer.size) + 1);
+    buffer.freeBlocks.back().insert(0);
+    targetBuffers.push_back(std::move(buffer));
+
+    AllocateBlock(targetBuffers.back(), allocation.order, allocation.offset);
+    allocation.bufferIndex = static_cast<unsigned int>(targetBuffers.size() - 1);
+}
+
+void GpuBufferPool::Pack(std::vector<Buffer>& packedBuffers, std::vector<Allocation>& packedAllocations) const
+{
+    std::vector<unsigned int> liveIndices;
+    for (std::size_t i = 0; i < allocations.size(); ++i)
+    {
+        if (allocations[i].live)
+        {
+            liveIndices.push_back(static_cast<unsigned int>(i));
+        }
+    }
+
+    // blocks placed largest first leave no gaps, every block starts where the previous one ended
+    std::sort(liveIndices.begin(), liveIndices.end(), [this](unsigned int a, unsigned int b)
+    {
+        const Allocation& first = allocations[a];
+        const Allocation& second = allocations[b];
+        if (first.order != second.order)
+        {
+            return first.order > second.order;
+        }
+        return first.bufferIndex != second.bufferIndex ? first.bufferIndex < second.bufferIndex : first.offset < second.offset;
+    });
+
+    packedBuffers.clear();
+    packedAllocations = allocations;
+    for (unsigned int index : liveIndices)
+    {
+        Place(packedBuffers, packedAllocations[index]);
+    }
+}
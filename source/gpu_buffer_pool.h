@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+// where an allocation lives, valid until the pool moves it
+struct GpuBufferRange
+{
+    unsigned int buffer;
+    std::size_t offset;
+    std::size_t size;
+};
+
+struct GpuBufferPoolStats
+{
+    std::size_t capacityBytes = 0;     // of every pool buffer
+    std::size_t usedBytes = 0;         // requested by live allocations
+    std::size_t paddingBytes = 0;      // allocations rounded up to their block size
+    std::size_t freeBytes = 0;         // in free blocks
+    std::size_t largestFreeBlock = 0;
+    std::size_t fragmentedBytes = 0;   // what packing would gain: larger largest free block plus buffers it frees
+    unsigned int bufferCount = 0;
+    unsigned int allocationCount = 0;
+    unsigned int defragmentations = 0;
+    std::size_t movedBytes = 0;        // copied by defragmentations
+};
+
+// Suballocates vertex and index data from a few large GL buffers instead of a
+// buffer per mesh, which keeps buffer object switches and driver allocations
+// out of loading and unloading. Each buffer is managed by a buddy allocator:
+// blocks are powers of two from 256 bytes up to the buffer size, a request
+// takes the smallest block that fits and splits larger ones on the way, and a
+// freed block merges with its buddy while that is free too. A pool that runs
+// out of blocks adds another buffer. Freeing scatters small blocks over the
+// buffers until no large request fits. Packing the live allocations largest
+// first leaves no gaps, so a dry run of it tells what defragmenting would gain:
+// a larger largest free block, or buffers that are no longer needed. Once that
+// gain passes a share of the capacity, Defragment packs the allocations into
+// fresh buffers with glCopyBufferSubData and deletes the old ones. The copies
+// are ordered after draws still reading the old buffers, so nothing waits, but
+// the pool briefly needs its memory twice. Allocations are named by handles,
+// so owners look their range up again after a defragmentation moved them.
+class GpuBufferPool
+{
+public:
+    // bufferSize is rounded up to a power of two, a larger allocation gets a buffer of its own
+    GpuBufferPool(std::size_t bufferSize, float defragmentThreshold);
+    ~GpuBufferPool();
+
+    GpuBufferPool(const GpuBufferPool&) = delete;
+    GpuBufferPool& operator=(const GpuBufferPool&) = delete;
+
+    // handle of size bytes, never 0; the contents are undefined until uploaded
+    unsigned int Allocate(std::size_t size);
+
+    // 0 is ignored, freeing a freed handle throws
+    void Free(unsigned int allocation);
+
+    // throw for a handle that is not allocated
+    void Upload(unsigned int allocation, const void* data, std::size_t size);
+    GpuBufferRange GetRange(unsigned int allocation) const;
+
+    // packs the allocations when packing would gain more than the threshold share of the capacity,
+    // returns whether anything moved; only looks again after allocations changed
+    bool DefragmentIfNeeded();
+    void Defragment();
+
+    GpuBufferPoolStats GetStats() const;
+
+private:
+    struct Buffer
+    {
+        unsigned int buffer;
+        std::size_t size;
+        std::vector<std::set<std::size_t>> freeBlocks;  // offsets of the free blocks of each order
+    };
+
+    struct Allocation
+    {
+        bool live;
+        unsigned int bufferIndex;
+        std::size_t offset;
+        unsigned int order;  // the block is 256 << order bytes
+        std::size_t size;
+    };
+
+    static unsigned int GetOrder(std::size_t size);
+    static void CreateBufferObject(Buffer& buffer);
+    static bool AllocateBlock(Buffer& buffer, unsigned int order, std::size_t& offset);
+    static void FreeBlock(Buffer& buffer, std::size_t offset, unsigned int order);
+    static std::size_t GetLargestFreeBlock(const std::vector<Buffer>& targetBuffers);
+
+    // the allocation of a live handle, throws for any other handle
+    const Allocation& GetLiveAllocation(unsigned int allocation) const;
+
+    // places a block in the first of targetBuffers with room, adding a buffer without a GL object when none has
+    void Place(std::vector<Buffer>& targetBuffers, Allocation& allocation) const;
+
+    // the layout Defragment would produce, its buffers don't have GL objects yet
+    void Pack(std::vector<Buffer>& packedBuffers, std::vector<Allocation>& packedAllocations) const;
+
+    std::size_t bufferSize;
+    float defragmentThreshold;
+
+    std::vector<Buffer> buffers;
+    std::vector<Allocation> allocations;   // handle - 1
+    std::vector<unsigned int> freeHandles;
+
+    bool allocationsChanged;  // since DefragmentIfNeeded last looked
+    unsigned int defragmentations;
+    std::size_t movedBytes;
+};
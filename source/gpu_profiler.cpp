@@ -0,0 +1,208 @@
+#include "gpu_profiler.h"
+
+#include <glad/glad.h>
+
+namespace
+{
+
+// frames in flight before a frame's queries are read back
+const std::size_t frameLatency = 4;
+
+const std::size_t frameSectionIndex = 0;
+const std::size_t noSection = static_cast<std::size_t>(-1);
+
+} // namespace
+
+GpuProfiler::GpuProfiler()
+    : frames(frameLatency),
+      currentFrame{0},
+      openSection{noSection}
+{
+    for (auto& frame : frames)
+    {
+        frame.usedSections = 0;
+        frame.pending = false;
+    }
+
+    sectionNames.push_back("frame");
+    sectionTotals.push_back(SectionTotals{0.0, 0, 0.0});
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (auto& frame : frames)
+    {
+        for (auto& section : frame.sections)
+        {
+            glDeleteQueries(1, &section.beginQuery);
+            glDeleteQueries(1, &section.endQuery);
+            glDeleteQueries(1, &section.samplesQuery);
+        }
+    }
+}
+
+void GpuProfiler::BeginFrame()
+{
+    FrameQueries& frame = frames[currentFrame];
+
+    // the queries of this slot were issued frameLatency frames ago
+    if (frame.pending)
+    {
+        CollectFrame(frame);
+    }
+
+    frame.usedSections = 0;
+    frame.pending = true;
+
+    glQueryCounter(AcquireQuery(frameSectionIndex).beginQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndFrame()
+{
+    glQueryCounter(frames[currentFrame].sections[0].endQuery, GL_TIMESTAMP);
+
+    currentFrame = (currentFrame + 1) % frames.size();
+}
+
+void GpuProfiler::BeginSection(const std::string& name, bool countFragments)
+{
+    openSection = frames[currentFrame].usedSections;
+
+    SectionQuery& section = AcquireQuery(FindSection(name));
+    section.countsFragments = countFragments;
+
+    glQueryCounter(section.beginQuery, GL_TIMESTAMP);
+    if (countFragments)
+    {
+        glBeginQuery(GL_SAMPLES_PASSED, section.samplesQuery);
+    }
+}
+
+void GpuProfiler::EndSection()
+{
+    if (openSection == noSection)
+    {
+        return;
+    }
+
+    const SectionQuery& section = frames[currentFrame].sections[openSection];
+    if (section.countsFragments)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+
+    glQueryCounter(section.endQuery, GL_TIMESTAMP);
+    openSection = noSection;
+}
+
+void GpuProfiler::Report(std::ostream& stream, unsigned int pixelCount)
+{
+    stream << "gpu:";
+
+    for (std::size_t i = 0; i < sectionNames.size(); ++i)
+    {
+        if (sectionTotals[i].samples == 0)
+        {
+            continue;
+        }
+
+        stream << " " << sectionNames[i] << " " << sectionTotals[i].milliseconds / sectionTotals[i].samples << " ms";
+        if (sectionTotals[i].fragments > 0.0 && pixelCount > 0)
+        {
+            stream << " (" << sectionTotals[i].fragments / sectionTotals[i].samples / pixelCount << " fragments/pixel)";
+        }
+        sectionTotals[i] = SectionTotals{0.0, 0, 0.0};
+    }
+
+    stream << std::endl;
+}
+
+double GpuProfiler::GetAverageMilliseconds(const std::string& name) const
+{
+    for (std::size_t i = 0; i < sectionNames.size(); ++i)
+    {
+        if (sectionNames[i] == name && sectionTotals[i].samples > 0)
+        {
+            return sectionTotals[i].milliseconds / sectionTotals[i].samples;
+        }
+    }
+
+    return 0.0;
+}
+
+std::size_t GpuProfiler::FindSection(const std::string& name)
+{
+    for (std::size_t i = 0; i < sectionNames.size(); ++i)
+    {
+        if (sectionNames[i] == name)
+        {
+            return i;
+        }
+    }
+
+    sectionNames.push_back(name);
+    sectionTotals.push_back(SectionTotals{0.0, 0, 0.0});
+
+    return sectionNames.size() - 1;
+}
+
+GpuProfiler::SectionQuery& GpuProfiler::AcquireQuery(std::size_t sectionIndex)
+{
+    FrameQueries& frame = frames[currentFrame];
+
+    if (frame.usedSections == frame.sections.size())
+    {
+        SectionQuery section;
+        glGenQueries(1, &section.beginQuery);
+        glGenQueries(1, &section.endQuery);
+        glGenQueries(1, &section.samplesQuery);
+
+        frame.sections.push_back(section);
+    }
+
+    SectionQuery& section = frame.sections[frame.usedSections++];
+    section.sectionIndex = sectionIndex;
+    section.countsFragments = false;
+
+    return section;
+}
+
+void GpuProfiler::CollectFrame(FrameQueries& frame)
+{
+    frame.pending = false;
+
+    // the frame's last timestamp is issued last, if it is not available yet drop the frame rather than wait
+    int available = 0;
+    glGetQueryObjectiv(frame.sections[0].endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == 0)
+    {
+        return;
+    }
+
+    // a section drawn several times in a frame counts once, with the sum of its times
+    std::vector<bool> sampled(sectionNames.size(), false);
+
+    for (std::size_t i = 0; i < frame.usedSections; ++i)
+    {
+        GLuint64 beginTime = 0;
+        GLuint64 endTime = 0;
+        glGetQueryObjectui64v(frame.sections[i].beginQuery, GL_QUERY_RESULT, &beginTime);
+        glGetQueryObjectui64v(frame.sections[i].endQuery, GL_QUERY_RESULT, &endTime);
+
+        const std::size_t sectionIndex = frame.sections[i].sectionIndex;
+
+        SectionTotals& totals = sectionTotals[sectionIndex];
+        totals.milliseconds += static_cast<double>(endTime - beginTime) / 1.0e6;
+        if (frame.sections[i].countsFragments)
+        {
+            GLuint64 fragments = 0;
+            glGetQueryObjectui64v(frame.sections[i].samplesQuery, GL_QUERY_RESULT, &fragments);
+            totals.fragments += static_cast<double>(fragments);
+        }
+        if (sampled[sectionIndex] == false)
+        {
+            sampled[sectionIndex] = true;
+            ++totals.samples;
+        }
+    }
+}
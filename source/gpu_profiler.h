@@ -0,0 +1,68 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measures GPU time of named sections of a frame with GL_TIMESTAMP queries.
+// Results are read back a few frames later, once the GPU has finished them,
+// so profiling never stalls the pipeline. Sections may not nest. A section can
+// also count the fragments that pass the depth test with a GL_SAMPLES_PASSED
+// query, which measures how much shading work overdraw costs.
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void BeginFrame();
+    void EndFrame();
+
+    void BeginSection(const std::string& name, bool countFragments = false);
+    void EndSection();
+
+    // prints the average frame and section times since the previous report and resets them,
+    // counted fragments are reported per pixel of a pixelCount sized framebuffer
+    void Report(std::ostream& stream, unsigned int pixelCount);
+
+    // average time of a section since the previous report, 0 when it has no samples yet
+    double GetAverageMilliseconds(const std::string& name) const;
+
+private:
+    struct SectionQuery
+    {
+        std::size_t sectionIndex;  // index into sectionNames, frame totals use frameSectionIndex
+        unsigned int beginQuery;
+        unsigned int endQuery;
+        unsigned int samplesQuery;
+        bool countsFragments;
+    };
+
+    struct FrameQueries
+    {
+        std::vector<SectionQuery> sections;
+        std::size_t usedSections;
+        bool pending;
+    };
+
+    struct SectionTotals
+    {
+        double milliseconds;
+        unsigned int samples;
+        double fragments;
+    };
+
+    std::size_t FindSection(const std::string& name);
+    SectionQuery& AcquireQuery(std::size_t sectionIndex);
+    void CollectFrame(FrameQueries& frame);
+
+    std::vector<FrameQueries> frames;
+    std::size_t currentFrame;
+
+    std::vector<std::string> sectionNames;
+    std::vector<SectionTotals> sectionTotals;
+    std::size_t openSection;
+};
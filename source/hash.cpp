@@ -0,0 +1,12 @@
+#include "hash.h"
+
+unsigned long long HashString(const std::string& text, unsigned long long hash)
+{
+    for (const char character : text)
+    {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// 64-bit FNV-1a, continued from a previous hash value
+unsigned long long HashString(const std::string& text, unsigned long long hash = 14695981039346656037ull);
@@ -0,0 +1,647 @@
+#include "hiz_occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "screen_bounds.h"
+
+namespace
+{
+
+const int HiZPyramidTextureUnit = 7;
+
+// pixel pack buffers in flight, a readback is usually complete one or two frames later
+const std::size_t readbackCount = 3;
+
+// the CPU path reads back the first pyramid level with at most this many texels
+const int maxReadbackTexels = 128 * 128;
+
+const unsigned int cullWorkGroupSize = 64;
+
+// waits for the fence when asked to, deletes it once signalled
+bool IsFenceSignalled(void*& fence, bool wait)
+{
+    const GLsync sync = static_cast<GLsync>(fence);
+    const GLenum result = glClientWaitSync(sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+    {
+        return false;
+    }
+
+    glDeleteSync(sync);
+    fence = nullptr;
+
+    return true;
+}
+
+// same reduction as hiz_downsample.frag, the last texel of an odd-sized level folds in the extra row or column
+DepthPyramidLevel DownsampleDepthLevel(const DepthPyramidLevel& source)
+{
+    DepthPyramidLevel level;
+    level.width = std::max(source.width / 2, 1);
+    level.height = std::max(source.height / 2, 1);
+    level.depths.resize(static_cast<std::size_t>(level.width) * level.height);
+
+    for (int y = 0; y < level.height; ++y)
+    {
+        const int firstY = y * 2;
+        const int lastY = (y == level.height - 1) ? source.height - 1 : std::min(firstY + 1, source.height - 1);
+
+        for (int x = 0; x < level.width; ++x)
+        {
+            const int firstX = x * 2;
+            const int lastX = (x == level.width - 1) ? source.width - 1 : std::min(firstX + 1, source.width - 1);
+
+            float depth = 0.0f;
+            for (int sourceY = firstY; sourceY <= lastY; ++sourceY)
+            {
+                for (int sourceX = firstX; sourceX <= lastX; ++sourceX)
+                {
+                    depth = std::max(depth, source.depths[sourceY * source.width + sourceX]);
+                }
+            }
+
+            level.depths[y * level.width + x] = depth;
+        }
+    }
+
+    return level;
+}
+
+// same test as hiz_cull.comp; levels[0] is pyramid level firstLevel, whose texels span 2^(firstLevel + 1) depth pixels
+bool IsOccluded(const std::vector<DepthPyramidLevel>& levels, int firstLevel, int depthWidth, int depthHeight, const glm::vec3& ndcMin, const glm::vec3& ndcMax)
+{
+    const int pixelMinX = NdcToPixel(ndcMin.x, depthWidth);
+    const int pixelMinY = NdcToPixel(ndcMin.y, depthHeight);
+    const int pixelMaxX = NdcToPixel(ndcMax.x, depthWidth);
+    const int pixelMaxY = NdcToPixel(ndcMax.y, depthHeight);
+
+    const int extent = std::max(pixelMaxX - pixelMinX, pixelMaxY - pixelMinY) + 1;
+    const int pyramidLevel = static_cast<int>(std::ceil(std::log2(static_cast<float>(extent)))) - 1;
+    const int levelIndex = std::min(std::max(pyramidLevel - firstLevel, 0), static_cast<int>(levels.size()) - 1);
+
+    const DepthPyramidLevel& level = levels[levelIndex];
+    const int shift = firstLevel + levelIndex + 1;
+
+    const int texelMinX = std::min(pixelMinX >> shift, level.width - 1);
+    const int texelMinY = std::min(pixelMinY >> shift, level.height - 1);
+    const int texelMaxX = std::min(pixelMaxX >> shift, level.width - 1);
+    const int texelMaxY = std::min(pixelMaxY >> shift, level.height - 1);
+
+    float occluderDepth = 0.0f;
+    for (int y = texelMinY; y <= texelMaxY; ++y)
+    {
+        for (int x = texelMinX; x <= texelMaxX; ++x)
+        {
+            occluderDepth = std::max(occluderDepth, level.depths[y * level.width + x]);
+        }
+    }
+
+    return ndcMin.z * 0.5f + 0.5f > occluderDepth;
+}
+
+} // namespace
+
+HiZOcclusionCuller::HiZOcclusionCuller(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                       const std::string& cullShaderSource, int width, int height)
+    : cullProgram{0},
+      width{width},
+      height{height},
+      readbackLevel{0},
+      nextReadback{0},
+      boundsBuffer{0},
+      indirectBuffer{0},
+      statsBuffer{0},
+      nextStatsReadback{0}
+{
+    const std::vector<SamplerBinding> samplerBindings{{"sourceTexture", HiZPyramidTextureUnit}};
+
+    downsampleShaders.reset(new ShaderPermutationSet{shaderCache, vertexShaderSource, fragmentShaderSource, {}, samplerBindings});
+    downsamplePermutation = downsampleShaders->Add({});
+    downsampleShaders->CompileAll();
+
+    glGenVertexArrays(1, &emptyVertexArray);
+
+    if (cullShaderSource.empty() == false)
+    {
+        cullProgram = CreateComputeProgram(cullShaderSource);
+
+        glUseProgram(cullProgram);
+        glUniform1i(glGetUniformLocation(cullProgram, "hiZPyramid"), HiZPyramidTextureUnit);
+        glUseProgram(0);
+
+        glGenBuffers(1, &boundsBuffer);
+        glGenBuffers(1, &indirectBuffer);
+
+        glGenBuffers(1, &statsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        statsReadbacks.resize(readbackCount);
+        for (auto& readback : statsReadbacks)
+        {
+            glGenBuffers(1, &readback.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, 2 * sizeof(unsigned int), nullptr, GL_STREAM_READ);
+            readback.fence = nullptr;
+            readback.pending = false;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    CreateTargets();
+}
+
+HiZOcclusionCuller::~HiZOcclusionCuller()
+{
+    DestroyTargets();
+
+    for (auto& readback : statsReadbacks)
+    {
+        if (readback.fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(readback.fence));
+        }
+        glDeleteBuffers(1, &readback.buffer);
+    }
+
+    glDeleteBuffers(1, &statsBuffer);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteProgram(cullProgram);
+
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+bool HiZOcclusionCuller::IsComputeCullingSupported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void HiZOcclusionCuller::Resize(int width, int height)
+{
+    if ((width == this->width && height == this->height) || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DestroyTargets();
+    CreateTargets();
+}
+
+void HiZOcclusionCuller::SetDrawList(const std::vector<DrawCommand>& drawList)
+{
+    drawBounds.clear();
+    for (const auto& drawCommand : drawList)
+    {
+        drawBounds.push_back(drawCommand.boundsMin);
+        drawBounds.push_back(drawCommand.boundsMax);
+    }
+
+    occludedDraws.assign(drawList.size(), 0);
+    visibleDraws.assign(drawList.size(), 1);
+
+    if (cullProgram == 0)
+    {
+        return;
+    }
+
+    // std430 pads the vec3 bounds to vec4
+    std::vector<glm::vec4> paddedBounds;
+    std::vector<DrawArraysIndirectCommand> commands;
+    for (const auto& drawCommand : drawList)
+    {
+        paddedBounds.push_back(glm::vec4{drawCommand.boundsMin, 0.0f});
+        paddedBounds.push_back(glm::vec4{drawCommand.boundsMax, 0.0f});
+
+        commands.push_back(DrawArraysIndirectCommand{static_cast<unsigned int>(drawCommand.vertexCount), 1,
+                                                     static_cast<unsigned int>(drawCommand.firstVertex), 0});
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, paddedBounds.size() * sizeof(glm::vec4), paddedBounds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void HiZOcclusionCuller::RenderOccluders(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass)
+{
+    const float clearDepth = 1.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, occluderFramebuffer);
+    glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+    // the indirect commands still hold last frame's instance counts
+    DrawVisibility visibility;
+    if (cullProgram != 0)
+    {
+        visibility.indirectBuffer = indirectBuffer;
+    }
+    else
+    {
+        visibility.visibleDraws = &visibleDraws;
+    }
+
+    depthPrepass.SubmitDepth(drawList, visibility);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void HiZOcclusionCuller::BuildPyramid()
+{
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(downsampleShaders->GetProgram(downsamplePermutation));
+    glBindVertexArray(emptyVertexArray);
+    glActiveTexture(GL_TEXTURE0 + HiZPyramidTextureUnit);
+
+    for (std::size_t level = 0; level < pyramidFramebuffers.size(); ++level)
+    {
+        // limiting the pyramid to the previous level lets a level be rendered while the one above it is sampled
+        if (level == 0)
+        {
+            glBindTexture(GL_TEXTURE_2D, occluderDepthTexture);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<int>(level) - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<int>(level) - 1);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, pyramidFramebuffers[level]);
+        glViewport(0, 0, pyramidSizes[level].x, pyramidSizes[level].y);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<int>(pyramidFramebuffers.size()) - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+DrawVisibility HiZOcclusionCuller::Cull(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix)
+{
+    DrawVisibility visibility;
+    if (cullProgram != 0)
+    {
+        CullOnGpu(drawList, viewProjectionMatrix);
+        visibility.indirectBuffer = indirectBuffer;
+    }
+    else
+    {
+        CullOnCpu(drawList, viewProjectionMatrix);
+        visibility.visibleDraws = &visibleDraws;
+    }
+
+    return visibility;
+}
+
+const OcclusionStats& HiZOcclusionCuller::GetStats() const
+{
+    return stats;
+}
+
+void HiZOcclusionCuller::ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    downsampleShaders->Reload(vertexShaderSource, fragmentShaderSource);
+}
+
+bool HiZOcclusionCuller::UpdateShaders()
+{
+    return downsampleShaders->Update();
+}
+
+bool HiZOcclusionCuller::ReloadCullShader(const std::string& cullShaderSource)
+{
+    if (cullProgram == 0)
+    {
+        return false;
+    }
+
+    unsigned int program = 0;
+    try
+    {
+        program = CreateComputeProgram(cullShaderSource);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << "cull shader reload failed, keeping the previous program: " << error.what() << std::endl;
+        return false;
+    }
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "hiZPyramid"), HiZPyramidTextureUnit);
+    glUseProgram(0);
+
+    glDeleteProgram(cullProgram);
+    cullProgram = program;
+
+    return true;
+}
+
+void HiZOcclusionCuller::CreateTargets()
+{
+    glGenTextures(1, &occluderDepthTexture);
+    glBindTexture(GL_TEXTURE_2D, occluderDepthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &occluderFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, occluderFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, occluderDepthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{"occluder framebuffer is incomplete"};
+    }
+
+    // the first level halves the depth buffer, the chain ends at 1x1
+    pyramidSizes.clear();
+    glm::ivec2 levelSize{std::max(width / 2, 1), std::max(height / 2, 1)};
+    while (true)
+    {
+        pyramidSizes.push_back(levelSize);
+        if (levelSize.x == 1 && levelSize.y == 1)
+        {
+            break;
+        }
+        levelSize = glm::ivec2{std::max(levelSize.x / 2, 1), std::max(levelSize.y / 2, 1)};
+    }
+
+    glGenTextures(1, &pyramidTexture);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    for (std::size_t level = 0; level < pyramidSizes.size(); ++level)
+    {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<int>(level), GL_R32F, pyramidSizes[level].x, pyramidSizes[level].y, 0, GL_RED, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<int>(pyramidSizes.size()) - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    pyramidFramebuffers.resize(pyramidSizes.size());
+    glGenFramebuffers(static_cast<int>(pyramidFramebuffers.size()), pyramidFramebuffers.data());
+    for (std::size_t level = 0; level < pyramidFramebuffers.size(); ++level)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, pyramidFramebuffers[level]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, static_cast<int>(level));
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw std::runtime_error{"Hi-Z pyramid framebuffer is incomplete"};
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (cullProgram != 0)
+    {
+        return;
+    }
+
+    readbackLevel = 0;
+    while (readbackLevel + 1 < static_cast<int>(pyramidSizes.size()) &&
+           pyramidSizes[readbackLevel].x * pyramidSizes[readbackLevel].y > maxReadbackTexels)
+    {
+        ++readbackLevel;
+    }
+
+    const glm::ivec2 readbackSize = pyramidSizes[readbackLevel];
+
+    readbacks.resize(readbackCount);
+    for (auto& readback : readbacks)
+    {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, readbackSize.x * readbackSize.y * sizeof(float), nullptr, GL_STREAM_READ);
+        readback.fence = nullptr;
+        readback.pending = false;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    nextReadback = 0;
+
+    cpuLevels.clear();
+}
+
+void HiZOcclusionCuller::DestroyTargets()
+{
+    for (auto& readback : readbacks)
+    {
+        if (readback.fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(readback.fence));
+        }
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    readbacks.clear();
+
+    glDeleteFramebuffers(static_cast<int>(pyramidFramebuffers.size()), pyramidFramebuffers.data());
+    glDeleteTextures(1, &pyramidTexture);
+    glDeleteFramebuffers(1, &occluderFramebuffer);
+    glDeleteTextures(1, &occluderDepthTexture);
+}
+
+void HiZOcclusionCuller::CullOnCpu(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // the slot about to be reused holds the oldest readback, then take any newer one that has finished too
+    bool collected = false;
+    for (std::size_t i = 0; i < readbacks.size(); ++i)
+    {
+        Readback& readback = readbacks[(nextReadback + i) % readbacks.size()];
+        if (readback.pending)
+        {
+            collected = CollectReadback(readback, i == 0) || collected;
+        }
+    }
+
+    // occlusion results come from the readback's own matrices, they are re-evaluated whenever a newer one arrives
+    if (collected)
+    {
+        cpuLevels.resize(1);
+        while (cpuLevels.back().width > 1 || cpuLevels.back().height > 1)
+        {
+            cpuLevels.push_back(DownsampleDepthLevel(cpuLevels.back()));
+        }
+
+        for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+        {
+            glm::vec3 ndcMin;
+            glm::vec3 ndcMax;
+            const bool projected = ProjectBounds(drawBounds[drawIndex * 2], drawBounds[drawIndex * 2 + 1], cpuLevelsViewProjectionMatrix, ndcMin, ndcMax);
+
+            occludedDraws[drawIndex] = projected && IsOutsideFrustum(ndcMin, ndcMax) == false &&
+                                       IsOccluded(cpuLevels, readbackLevel, width, height, ndcMin, ndcMax);
+        }
+    }
+
+    Readback& readback = readbacks[nextReadback];
+    const glm::ivec2 readbackSize = pyramidSizes[readbackLevel];
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, pyramidFramebuffers[readbackLevel]);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glReadPixels(0, 0, readbackSize.x, readbackSize.y, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.viewProjectionMatrix = viewProjectionMatrix;
+    readback.pending = true;
+    nextReadback = (nextReadback + 1) % readbacks.size();
+
+    // frustum culling needs no readback and always uses this frame's matrices
+    stats.testedDraws = static_cast<unsigned int>(drawList.size());
+    stats.frustumCulledDraws = 0;
+    stats.occludedDraws = 0;
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        glm::vec3 ndcMin;
+        glm::vec3 ndcMax;
+        const bool projected = ProjectBounds(drawBounds[drawIndex * 2], drawBounds[drawIndex * 2 + 1], viewProjectionMatrix, ndcMin, ndcMax);
+
+        visibleDraws[drawIndex] = 1;
+        if (projected && IsOutsideFrustum(ndcMin, ndcMax))
+        {
+            visibleDraws[drawIndex] = 0;
+            ++stats.frustumCulledDraws;
+        }
+        else if (occludedDraws[drawIndex] != 0)
+        {
+            visibleDraws[drawIndex] = 0;
+            ++stats.occludedDraws;
+        }
+    }
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void HiZOcclusionCuller::CullOnGpu(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // cleared on the GPU, an upload would wait for the previous frame's readback copy
+    const unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, 2 * sizeof(unsigned int), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(cullProgram);
+    glUniformMatrix4fv(glGetUniformLocation(cullProgram, "viewProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(viewProjectionMatrix));
+    glUniform2i(glGetUniformLocation(cullProgram, "depthSize"), width, height);
+    glUniform1i(glGetUniformLocation(cullProgram, "levelCount"), static_cast<int>(pyramidSizes.size()));
+    glUniform1ui(glGetUniformLocation(cullProgram, "drawCount"), static_cast<unsigned int>(drawList.size()));
+
+    glActiveTexture(GL_TEXTURE0 + HiZPyramidTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, statsBuffer);
+
+    glDispatchCompute((static_cast<unsigned int>(drawList.size()) + cullWorkGroupSize - 1) / cullWorkGroupSize, 1, 1);
+
+    // the draws read the instance counts as indirect commands, the counters are copied into a readback buffer
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glUseProgram(0);
+
+    // the counters arrive a few frames late, the slot about to be reused holds the oldest ones
+    Readback& readback = statsReadbacks[nextStatsReadback];
+    if (readback.pending && IsFenceSignalled(readback.fence, true))
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+        const void* counts = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, 2 * sizeof(unsigned int), GL_MAP_READ_BIT);
+        if (counts != nullptr)
+        {
+            stats.frustumCulledDraws = static_cast<const unsigned int*>(counts)[0];
+            stats.occludedDraws = static_cast<const unsigned int*>(counts)[1];
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    else if (readback.pending)
+    {
+        glDeleteSync(static_cast<GLsync>(readback.fence));
+        readback.fence = nullptr;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, statsBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 2 * sizeof(unsigned int));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.pending = true;
+    nextStatsReadback = (nextStatsReadback + 1) % statsReadbacks.size();
+
+    stats.testedDraws = static_cast<unsigned int>(drawList.size());
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool HiZOcclusionCuller::CollectReadback(Readback& readback, bool wait)
+{
+    if (IsFenceSignalled(readback.fence, wait) == false)
+    {
+        // a readback that did not finish within the wait is dropped so its slot can be reused
+        if (wait)
+        {
+            glDeleteSync(static_cast<GLsync>(readback.fence));
+            readback.fence = nullptr;
+            readback.pending = false;
+        }
+        return false;
+    }
+
+    readback.pending = false;
+
+    const glm::ivec2 readbackSize = pyramidSizes[readbackLevel];
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const void* depths = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackSize.x * readbackSize.y * sizeof(float), GL_MAP_READ_BIT);
+    if (depths == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return false;
+    }
+
+    cpuLevels.resize(1);
+    cpuLevels[0].width = readbackSize.x;
+    cpuLevels[0].height = readbackSize.y;
+    cpuLevels[0].depths.assign(static_cast<const float*>(depths), static_cast<const float*>(depths) + readbackSize.x * readbackSize.y);
+    cpuLevelsViewProjectionMatrix = readback.viewProjectionMatrix;
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return true;
+}
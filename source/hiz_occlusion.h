@@ -0,0 +1,127 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "depth_prepass.h"
+
+struct OcclusionStats
+{
+    unsigned int testedDraws = 0;
+    unsigned int frustumCulledDraws = 0;
+    unsigned int occludedDraws = 0;
+    double milliseconds = 0.0;  // CPU time of the readback and the bounding box tests
+};
+
+// CPU copy of one level of a max-depth pyramid
+struct DepthPyramidLevel
+{
+    int width;
+    int height;
+    std::vector<float> depths;
+};
+
+// Hierarchical-Z occlusion culling. The draws found visible in the previous
+// frame are drawn depth-only with this frame's matrices as occluders, and a
+// max-depth mip pyramid is built from that depth buffer. Every draw's bounding
+// box is then projected to a screen rectangle, the pyramid level whose texels
+// cover the rectangle with at most 2x2 of them is looked up, and the draw is
+// skipped when the box's nearest depth lies behind all of them.
+//
+// On GL 3.3 a coarse pyramid level is read back through a ring of pixel pack
+// buffers and tested on the CPU once its fence has signalled, so occlusion
+// results lag a frame or two behind; frustum culling always uses the current
+// matrices. With GL 4.3 a compute shader tests the boxes against the full
+// pyramid in the same frame and writes the instance count of one indirect
+// draw command per draw, the statistics are read back with latency.
+class HiZOcclusionCuller
+{
+public:
+    // an empty cull shader source selects the CPU readback path
+    HiZOcclusionCuller(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                       const std::string& cullShaderSource, int width, int height);
+    ~HiZOcclusionCuller();
+
+    HiZOcclusionCuller(const HiZOcclusionCuller&) = delete;
+    HiZOcclusionCuller& operator=(const HiZOcclusionCuller&) = delete;
+
+    // compute shaders and shader storage buffers
+    static bool IsComputeCullingSupported();
+
+    // reallocates the occluder depth buffer and the pyramid when the framebuffer size changed
+    void Resize(int width, int height);
+
+    // takes the bounds of a new or re-sorted draw list, every draw starts out visible
+    void SetDrawList(const std::vector<DrawCommand>& drawList);
+
+    // draws last frame's visible draws into the occluder depth buffer, the frame uniforms must be current
+    void RenderOccluders(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass);
+
+    void BuildPyramid();
+
+    // the returned visibility refers to storage of the culler and stays valid until the next call
+    DrawVisibility Cull(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix);
+
+    const OcclusionStats& GetStats() const;
+
+    void ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool UpdateShaders();
+
+    // compiles the cull shader right away, keeps the previous program and returns false on errors
+    bool ReloadCullShader(const std::string& cullShaderSource);
+
+private:
+    // pixel pack buffer holding one read back pyramid level
+    struct Readback
+    {
+        unsigned int buffer;
+        void* fence;
+        glm::mat4 viewProjectionMatrix;
+        bool pending;
+    };
+
+    void CreateTargets();
+    void DestroyTargets();
+
+    void CullOnCpu(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix);
+    void CullOnGpu(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix);
+
+    // copies a finished readback into the first CPU level, returns false while its fence is unsignalled
+    bool CollectReadback(Readback& readback, bool wait);
+
+    std::unique_ptr<ShaderPermutationSet> downsampleShaders;
+    ShaderPermutation downsamplePermutation;
+    unsigned int cullProgram;
+
+    int width;
+    int height;
+
+    unsigned int occluderDepthTexture;
+    unsigned int occluderFramebuffer;
+    unsigned int pyramidTexture;
+    std::vector<unsigned int> pyramidFramebuffers;
+    std::vector<glm::ivec2> pyramidSizes;
+    unsigned int emptyVertexArray;
+
+    // CPU path: the first pyramid level small enough to read back every frame, and the levels built from it
+    int readbackLevel;
+    std::vector<Readback> readbacks;
+    std::size_t nextReadback;
+    std::vector<DepthPyramidLevel> cpuLevels;
+    glm::mat4 cpuLevelsViewProjectionMatrix;
+    std::vector<glm::vec3> drawBounds;  // min and max of every draw
+    std::vector<unsigned char> occludedDraws;
+    std::vector<unsigned char> visibleDraws;
+
+    // GPU path
+    unsigned int boundsBuffer;
+    unsigned int indirectBuffer;
+    unsigned int statsBuffer;
+    std::vector<Readback> statsReadbacks;
+    std::size_t nextStatsReadback;
+
+    OcclusionStats stats;
+};
@@ -0,0 +1,452 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+struct JobCounter::Job
+{
+    std::function<void()> function;
+    JobCounter* counter;
+};
+
+namespace
+{
+// deque slots per worker, jobs pushed beyond it go to the injection queue
+const std::int64_t dequeCapacity = 4096;
+
+// failed searches before an idle worker sleeps or a waiting thread backs off
+const int idleSpinCount = 64;
+
+// the job system and worker index of the current thread, a worker of no system has none
+thread_local JobSystem* currentSystem = nullptr;
+thread_local unsigned int currentWorker = 0;
+
+// nested jobs run while a job waits are already counted in the outer job's busy time
+thread_local int executeDepth = 0;
+
+unsigned int NextRandom(unsigned int& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+} // namespace
+
+// Counters hold twice the pending job count. The job finishing the last one sets
+// them to 1 while it queues the continuations, so a waiting thread, which only
+// returns at 0, cannot destroy the counter while it is still in use.
+JobCounter::JobCounter() : pendingJobs{0}
+{
+}
+
+bool JobCounter::IsDone() const
+{
+    return pendingJobs.load(std::memory_order_acquire) == 0;
+}
+
+void JobCounter::StoreException(std::exception_ptr jobException)
+{
+    std::lock_guard<std::mutex> lock{exceptionMutex};
+    if (exception == nullptr)
+    {
+        exception = jobException;
+    }
+}
+
+JobSystem::WorkDeque::WorkDeque() : top{0}, bottom{0}, slots{new std::atomic<Job*>[dequeCapacity]}
+{
+}
+
+bool JobSystem::WorkDeque::Push(Job* job)
+{
+    const std::int64_t currentBottom = bottom.load(std::memory_order_relaxed);
+    const std::int64_t currentTop = top.load(std::memory_order_acquire);
+    if (currentBottom - currentTop >= dequeCapacity)
+    {
+        return false;
+    }
+
+    slots[currentBottom & (dequeCapacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(currentBottom + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::Pop()
+{
+    const std::int64_t currentBottom = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(currentBottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t currentTop = top.load(std::memory_order_relaxed);
+
+    if (currentTop > currentBottom)
+    {
+        bottom.store(currentBottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = slots[currentBottom & (dequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (currentTop == currentBottom)
+    {
+        // the last job, a thief may be taking it as well
+        if (top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+        {
+            job = nullptr;
+        }
+        bottom.store(currentBottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::Steal()
+{
+    std::int64_t currentTop = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t currentBottom = bottom.load(std::memory_order_acquire);
+
+    if (currentTop >= currentBottom)
+    {
+        return nullptr;
+    }
+
+    Job* job = slots[currentTop & (dequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+    {
+        return nullptr;
+    }
+
+    return job;
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : injectedJobCount{0}, queuedJobs{0}, sleepingWorkers{0}, stopWorkers{false}, statsStartTime{std::chrono::steady_clock::now()}
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        std::unique_ptr<ThreadStats> stats{new ThreadStats};
+        stats->executedJobs = 0;
+        stats->stolenJobs = 0;
+        stats->busyNanoseconds = 0;
+        threadStats.push_back(std::move(stats));
+    }
+
+    for (unsigned int i = 0; i + 1 < threadCount; ++i)
+    {
+        deques.emplace_back(new WorkDeque);
+    }
+
+    for (unsigned int i = 0; i + 1 < threadCount; ++i)
+    {
+        workers.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock{sleepMutex};
+        stopWorkers = true;
+    }
+    jobQueued.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+unsigned int JobSystem::GetThreadCount() const
+{
+    return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter& counter, JobCounter* dependency)
+{
+    counter.pendingJobs.fetch_add(2, std::memory_order_relaxed);
+
+    Job* queuedJob = new Job{std::move(job), &counter};
+
+    if (dependency != nullptr)
+    {
+        std::lock_guard<std::mutex> lock{dependency->continuationMutex};
+        if (dependency->pendingJobs.load(std::memory_order_acquire) >= 2)
+        {
+            dependency->continuations.push_back(queuedJob);
+            return;
+        }
+    }
+
+    Enqueue(queuedJob);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    const unsigned int threadIndex = (currentSystem == this) ? currentWorker : static_cast<unsigned int>(workers.size());
+    unsigned int randomState = 0x9e3779b9u ^ static_cast<unsigned int>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    if (randomState == 0)
+    {
+        randomState = 1;
+    }
+
+    int idleSearches = 0;
+    while (counter.IsDone() == false)
+    {
+        bool stolen = false;
+        if (Job* job = FindJob(threadIndex, randomState, stolen))
+        {
+            Execute(job, threadIndex, stolen);
+            idleSearches = 0;
+        }
+        else if (++idleSearches < idleSpinCount)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            // the remaining jobs are running elsewhere
+            std::this_thread::sleep_for(std::chrono::microseconds{20});
+        }
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock{counter.exceptionMutex};
+        exception.swap(counter.exception);
+    }
+
+    if (exception != nullptr)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+void JobSystem::ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& function)
+{
+    grainSize = std::max<std::size_t>(grainSize, 1);
+    if (count <= grainSize || workers.empty())
+    {
+        if (count > 0)
+        {
+            function(0, count);
+        }
+        return;
+    }
+
+    // the calling thread runs the first range itself, its exception must not leave while the other ranges still run
+    JobCounter counter;
+    try
+    {
+        SplitRange(0, count, grainSize, function, counter);
+    }
+    catch (...)
+    {
+        counter.StoreException(std::current_exception());
+    }
+    Wait(counter);
+}
+
+std::vector<JobThreadStats> JobSystem::ConsumeStats()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsedMilliseconds = std::chrono::duration<double, std::milli>(now - statsStartTime).count();
+    statsStartTime = now;
+
+    std::vector<JobThreadStats> result(threadStats.size());
+    for (std::size_t i = 0; i < threadStats.size(); ++i)
+    {
+        result[i].executedJobs = threadStats[i]->executedJobs.exchange(0);
+        result[i].stolenJobs = threadStats[i]->stolenJobs.exchange(0);
+        result[i].busyMilliseconds = static_cast<double>(threadStats[i]->busyNanoseconds.exchange(0)) * 1.0e-6;
+        result[i].utilization = (elapsedMilliseconds > 0.0) ? std::min(result[i].busyMilliseconds / elapsedMilliseconds, 1.0) : 0.0;
+    }
+
+    return result;
+}
+
+void JobSystem::Enqueue(Job* job)
+{
+    queuedJobs.fetch_add(1);
+
+    if (currentSystem != this || deques[currentWorker]->Push(job) == false)
+    {
+        std::lock_guard<std::mutex> lock{injectionMutex};
+        injectedJobs.push_back(job);
+        injectedJobCount = injectedJobs.size();
+    }
+
+    if (sleepingWorkers.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleepMutex};
+        }
+        jobQueued.notify_one();
+    }
+}
+
+JobSystem::Job* JobSystem::FindJob(unsigned int threadIndex, unsigned int& randomState, bool& stolen)
+{
+    Job* job = nullptr;
+    stolen = false;
+
+    if (queuedJobs.load(std::memory_order_relaxed) <= 0)
+    {
+        return nullptr;
+    }
+
+    if (threadIndex < deques.size())
+    {
+        job = deques[threadIndex]->Pop();
+    }
+
+    if (job == nullptr && injectedJobCount.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock{injectionMutex};
+        if (injectedJobs.empty() == false)
+        {
+            job = injectedJobs.front();
+            injectedJobs.pop_front();
+            injectedJobCount = injectedJobs.size();
+        }
+    }
+
+    if (job == nullptr && deques.empty() == false)
+    {
+        // visit the other deques from a random one so thieves spread over the victims
+        const std::size_t firstVictim = NextRandom(randomState) % deques.size();
+        for (std::size_t i = 0; i < deques.size() && job == nullptr; ++i)
+        {
+            const std::size_t victim = (firstVictim + i) % deques.size();
+            if (victim != threadIndex)
+            {
+                job = deques[victim]->Steal();
+                stolen = (job != nullptr);
+            }
+        }
+    }
+
+    if (job != nullptr)
+    {
+        queuedJobs.fetch_sub(1);
+    }
+
+    return job;
+}
+
+void JobSystem::Execute(Job* job, unsigned int threadIndex, bool stolen)
+{
+    ThreadStats& stats = *threadStats[threadIndex];
+
+    const auto startTime = std::chrono::steady_clock::now();
+    ++executeDepth;
+    try
+    {
+        job->function();
+    }
+    catch (...)
+    {
+        // rethrown by Wait, the counter must still drop this job
+        job->counter->StoreException(std::current_exception());
+    }
+    --executeDepth;
+
+    if (executeDepth == 0)
+    {
+        stats.busyNanoseconds += static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+    }
+
+    ++stats.executedJobs;
+    if (stolen)
+    {
+        ++stats.stolenJobs;
+    }
+
+    JobCounter& counter = *job->counter;
+    delete job;
+
+    // drop this job's share, keeping the counter at 1 when it was the last one
+    unsigned int pending = counter.pendingJobs.load(std::memory_order_relaxed);
+    while (counter.pendingJobs.compare_exchange_weak(pending, (pending == 2) ? 1 : pending - 2, std::memory_order_acq_rel, std::memory_order_relaxed) == false)
+    {
+    }
+
+    if (pending == 2)
+    {
+        std::vector<Job*> continuations;
+        {
+            std::lock_guard<std::mutex> lock{counter.continuationMutex};
+            continuations.swap(counter.continuations);
+        }
+
+        for (Job* continuation : continuations)
+        {
+            Enqueue(continuation);
+        }
+
+        counter.pendingJobs.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::SplitRange(std::size_t begin, std::size_t end, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& function,
+                           JobCounter& counter)
+{
+    // hand out the upper half and keep splitting the lower one, the owner pops the smallest piece next
+    while (end - begin > grainSize)
+    {
+        const std::size_t grainCount = (end - begin + grainSize - 1) / grainSize;
+        const std::size_t middle = begin + (grainCount / 2) * grainSize;
+        Run([this, middle, end, grainSize, &function, &counter]() { SplitRange(middle, end, grainSize, function, counter); }, counter);
+        end = middle;
+    }
+
+    function(begin, end);
+}
+
+void JobSystem::WorkerMain(unsigned int workerIndex)
+{
+    currentSystem = this;
+    currentWorker = workerIndex;
+
+    unsigned int randomState = 0x9e3779b9u * (workerIndex + 1);
+    int idleSearches = 0;
+
+    while (true)
+    {
+        bool stolen = false;
+        if (Job* job = FindJob(workerIndex, randomState, stolen))
+        {
+            Execute(job, workerIndex, stolen);
+            idleSearches = 0;
+            continue;
+        }
+
+        if (++idleSearches < idleSpinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{sleepMutex};
+        ++sleepingWorkers;
+        jobQueued.wait(lock, [this]() { return stopWorkers || queuedJobs.load() > 0; });
+        --sleepingWorkers;
+        if (stopWorkers)
+        {
+            return;
+        }
+
+        idleSearches = 0;
+    }
+}
+
+JobSystem& GetSharedJobSystem()
+{
+    static JobSystem jobSystem{0};
+    return jobSystem;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts the unfinished jobs started with it. A job can depend on a counter:
+// it is queued only once every job counted there has finished. Wait on a
+// counter before destroying it, even when its jobs are known to be done. The
+// first exception thrown by one of its jobs is rethrown by Wait once every job
+// has finished.
+class JobCounter
+{
+public:
+    JobCounter();
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const;
+
+private:
+    friend class JobSystem;
+
+    struct Job;
+
+    void StoreException(std::exception_ptr jobException);
+
+    std::atomic<unsigned int> pendingJobs;
+    std::mutex continuationMutex;
+    std::vector<Job*> continuations;  // jobs depending on this counter, queued when it reaches zero
+    std::mutex exceptionMutex;
+    std::exception_ptr exception;  // the first one thrown by a job, taken by Wait
+};
+
+struct JobThreadStats
+{
+    unsigned long long executedJobs = 0;
+    unsigned long long stolenJobs = 0;  // taken from another worker's deque
+    double busyMilliseconds = 0.0;
+    double utilization = 0.0;  // busy share of the time since the stats were last consumed
+};
+
+// Work-stealing job scheduler shared by everything in the viewer that runs in
+// parallel. Each worker thread owns a Chase-Lev deque: it pushes and pops jobs
+// at the bottom without locks, while idle threads steal single jobs from the
+// top. Threads that are not workers queue jobs in a shared injection queue.
+// A thread waiting on a counter runs jobs until the counter is done instead of
+// blocking, so jobs can start and wait on jobs of their own. ParallelFor
+// splits its range in halves down to the grain size, pushing one half and
+// keeping the other, so stolen work spreads over the workers in large pieces.
+// Workers that find nothing to run spin briefly, then sleep until a job is queued.
+class JobSystem
+{
+public:
+    // threadCount includes a thread waiting on a counter, which runs jobs as well, so
+    // threadCount - 1 workers are started; 0 uses every hardware thread
+    explicit JobSystem(unsigned int threadCount);
+
+    // every job must have finished
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int GetThreadCount() const;
+
+    // queues the job, counted by counter until it has run; with a dependency the job
+    // is held back until the dependency's jobs are done
+    void Run(std::function<void()> job, JobCounter& counter, JobCounter* dependency = nullptr);
+
+    // runs jobs on the calling thread until the counter's jobs are done, then rethrows the
+    // first exception one of them threw
+    void Wait(JobCounter& counter);
+
+    // calls function(begin, end) for consecutive ranges of [0, count), each a multiple of grainSize
+    // long except the last, and returns once all have run; an exception of any range is rethrown
+    void ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& function);
+
+    // calls function(index) for every index below count, one job per index
+    template <typename Function>
+    void ParallelFor(std::size_t count, const Function& function);
+
+    // One entry per worker, then one shared by the threads that are not workers. Utilization
+    // is relative to the time since the previous call or the construction.
+    std::vector<JobThreadStats> ConsumeStats();
+
+private:
+    using Job = JobCounter::Job;
+
+    // Chase-Lev deque of fixed capacity, Push and Pop only on the owning worker
+    class WorkDeque
+    {
+    public:
+        WorkDeque();
+
+        bool Push(Job* job);
+        Job* Pop();
+        Job* Steal();
+
+    private:
+        std::atomic<std::int64_t> top;
+        std::atomic<std::int64_t> bottom;
+        std::unique_ptr<std::atomic<Job*>[]> slots;
+    };
+
+    struct ThreadStats
+    {
+        std::atomic<unsigned long long> executedJobs;
+        std::atomic<unsigned long long> stolenJobs;
+        std::atomic<unsigned long long> busyNanoseconds;
+    };
+
+    void Enqueue(Job* job);
+    Job* FindJob(unsigned int threadIndex, unsigned int& randomState, bool& stolen);
+    void Execute(Job* job, unsigned int threadIndex, bool stolen);
+    void SplitRange(std::size_t begin, std::size_t end, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& function,
+                    JobCounter& counter);
+    void WorkerMain(unsigned int workerIndex);
+
+    std::vector<std::unique_ptr<WorkDeque>> deques;  // one per worker
+    std::vector<std::unique_ptr<ThreadStats>> threadStats;  // one per worker, then the threads that are not workers
+
+    std::mutex injectionMutex;
+    std::deque<Job*> injectedJobs;
+    std::atomic<std::size_t> injectedJobCount;  // lets searches skip the lock while the queue is empty
+
+    // jobs sitting in a deque or the injection queue, workers only sleep while it is 0
+    std::atomic<int> queuedJobs;
+
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable jobQueued;
+    std::atomic<unsigned int> sleepingWorkers;
+    bool stopWorkers;
+
+    std::chrono::steady_clock::time_point statsStartTime;
+};
+
+template <typename Function>
+void JobSystem::ParallelFor(std::size_t count, const Function& function)
+{
+    ParallelFor(count, 1, [&function](std::size_t first, std::size_t end)
+    {
+        for (std::size_t index = first; index < end; ++index)
+        {
+            function(index);
+        }
+    });
+}
+
+// the job system of every hardware thread, started on first use and shared by the whole viewer
+JobSystem& GetSharedJobSystem();
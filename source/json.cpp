@@ -0,0 +1,421 @@
+#include "json.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+
+const JsonValue NullValue;
+
+// deeper nesting than any real document, but shallow enough not to overflow the stack on malicious input
+const int MaxDepth = 256;
+
+} // namespace
+
+class JsonParser
+{
+public:
+    JsonParser(const char* text, std::size_t length)
+        : text{text},
+          end{text + length},
+          current{text}
+    {
+    }
+
+    JsonValue ParseDocument()
+    {
+        JsonValue value = ParseValue(0);
+
+        SkipWhitespace();
+        if (current != end)
+        {
+            Fail("unexpected data after the document");
+        }
+
+        return value;
+    }
+
+private:
+    void Fail(const char* message) const
+    {
+        throw std::runtime_error{std::string{"JSON error at byte "} + std::to_string(current - text) + ": " + message};
+    }
+
+    void SkipWhitespace()
+    {
+        while (current != end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+        {
+            ++current;
+        }
+    }
+
+    bool Consume(const char* literal)
+    {
+        const char* position = current;
+        for (; *literal != '\0'; ++literal, ++position)
+        {
+            if (position == end || *position != *literal)
+            {
+                return false;
+            }
+        }
+
+        current = position;
+        return true;
+    }
+
+    JsonValue ParseValue(int depth)
+    {
+        if (depth > MaxDepth)
+        {
+            Fail("nesting too deep");
+        }
+
+        SkipWhitespace();
+        if (current == end)
+        {
+            Fail("unexpected end");
+        }
+
+        JsonValue value;
+        switch (*current)
+        {
+        case '{':
+            ParseObject(value, depth);
+            break;
+        case '[':
+            ParseArray(value, depth);
+            break;
+        case '"':
+            value.type = JsonValue::Type::String;
+            value.stringValue = ParseString();
+            break;
+        case 't':
+        case 'f':
+            value.type = JsonValue::Type::Bool;
+            value.boolValue = Consume("true");
+            if (value.boolValue == false && Consume("false") == false)
+            {
+                Fail("invalid literal");
+            }
+            break;
+        case 'n':
+            if (Consume("null") == false)
+            {
+                Fail("invalid literal");
+            }
+            break;
+        default:
+            value.type = JsonValue::Type::Number;
+            value.numberValue = ParseNumber();
+            break;
+        }
+
+        return value;
+    }
+
+    void ParseObject(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::Type::Object;
+        ++current;
+
+        SkipWhitespace();
+        if (current != end && *current == '}')
+        {
+            ++current;
+            return;
+        }
+
+        while (true)
+        {
+            SkipWhitespace();
+            if (current == end || *current != '"')
+            {
+                Fail("expected a member name");
+            }
+            std::string key = ParseString();
+
+            SkipWhitespace();
+            if (current == end || *current != ':')
+            {
+                Fail("expected ':'");
+            }
+            ++current;
+
+            value.members.emplace_back(std::move(key), ParseValue(depth + 1));
+
+            SkipWhitespace();
+            if (current != end && *current == ',')
+            {
+                ++current;
+                continue;
+            }
+            if (current != end && *current == '}')
+            {
+                ++current;
+                return;
+            }
+            Fail("expected ',' or '}'");
+        }
+    }
+
+    void ParseArray(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::Type::Array;
+        ++current;
+
+        SkipWhitespace();
+        if (current != end && *current == ']')
+        {
+            ++current;
+            return;
+        }
+
+        while (true)
+        {
+            value.elements.push_back(ParseValue(depth + 1));
+
+            SkipWhitespace();
+            if (current != end && *current == ',')
+            {
+                ++current;
+                continue;
+            }
+            if (current != end && *current == ']')
+            {
+                ++current;
+                return;
+            }
+            Fail("expected ',' or ']'");
+        }
+    }
+
+    unsigned int ParseHexDigits()
+    {
+        unsigned int codePoint = 0;
+        for (int i = 0; i < 4; ++i, ++current)
+        {
+            if (current == end)
+            {
+                Fail("unexpected end in an escape");
+            }
+
+            const char c = *current;
+            codePoint <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                codePoint |= c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                codePoint |= c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                codePoint |= c - 'A' + 10;
+            }
+            else
+            {
+                Fail("invalid \\u escape");
+            }
+        }
+
+        return codePoint;
+    }
+
+    static void AppendUtf8(std::string& result, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            result += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            result += static_cast<char>(0xc0 | (codePoint >> 6));
+            result += static_cast<char>(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            result += static_cast<char>(0xe0 | (codePoint >> 12));
+            result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+            result += static_cast<char>(0xf0 | (codePoint >> 18));
+            result += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+            result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    std::string ParseString()
+    {
+        ++current;
+
+        std::string result;
+        while (true)
+        {
+            // copy the run up to the next quote or escape in one go
+            const char* runBegin = current;
+            while (current != end && *current != '"' && *current != '\\')
+            {
+                ++current;
+            }
+            result.append(runBegin, current);
+
+            if (current == end)
+            {
+                Fail("unterminated string");
+            }
+            if (*current == '"')
+            {
+                ++current;
+                return result;
+            }
+
+            ++current;
+            if (current == end)
+            {
+                Fail("unterminated string");
+            }
+
+            const char escape = *current++;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                result += escape;
+                break;
+            case 'b':
+                result += '\b';
+                break;
+            case 'f':
+                result += '\f';
+                break;
+            case 'n':
+                result += '\n';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'u':
+            {
+                unsigned int codePoint = ParseHexDigits();
+
+                // a surrogate pair encodes a code point above the basic multilingual plane
+                if (codePoint >= 0xd800 && codePoint < 0xdc00 && Consume("\\u"))
+                {
+                    const unsigned int lowSurrogate = ParseHexDigits();
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+                }
+                AppendUtf8(result, codePoint);
+                break;
+            }
+            default:
+                Fail("invalid escape");
+            }
+        }
+    }
+
+    double ParseNumber()
+    {
+        // strtod needs a terminated string, numbers are short
+        const char* numberEnd = current;
+        while (numberEnd != end && (*numberEnd == '-' || *numberEnd == '+' || *numberEnd == '.' || *numberEnd == 'e' || *numberEnd == 'E' ||
+                                    (*numberEnd >= '0' && *numberEnd <= '9')))
+        {
+            ++numberEnd;
+        }
+        if (numberEnd == current)
+        {
+            Fail("unexpected character");
+        }
+
+        const std::string number{current, numberEnd};
+        char* parsedEnd = nullptr;
+        const double value = std::strtod(number.c_str(), &parsedEnd);
+        if (parsedEnd != number.c_str() + number.size())
+        {
+            Fail("invalid number");
+        }
+
+        current = numberEnd;
+        return value;
+    }
+
+    const char* text;
+    const char* end;
+    const char* current;
+};
+
+JsonValue::JsonValue()
+    : type{Type::Null},
+      boolValue{false},
+      numberValue{0.0}
+{
+}
+
+JsonValue::Type JsonValue::GetType() const
+{
+    return type;
+}
+
+bool JsonValue::IsNull() const
+{
+    return type == Type::Null;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+    for (const auto& member : members)
+    {
+        if (member.first == key)
+        {
+            return member.second;
+        }
+    }
+
+    return NullValue;
+}
+
+const JsonValue& JsonValue::operator[](std::size_t index) const
+{
+    return (index < elements.size()) ? elements[index] : NullValue;
+}
+
+std::size_t JsonValue::GetSize() const
+{
+    return (type == Type::Object) ? members.size() : elements.size();
+}
+
+bool JsonValue::GetBool(bool fallback) const
+{
+    return (type == Type::Bool) ? boolValue : fallback;
+}
+
+double JsonValue::GetNumber(double fallback) const
+{
+    return (type == Type::Number) ? numberValue : fallback;
+}
+
+const std::string& JsonValue::GetString() const
+{
+    return stringValue;
+}
+
+const std::vector<std::pair<std::string, JsonValue>>& JsonValue::GetMembers() const
+{
+    return members;
+}
+
+JsonValue ParseJson(const char* text, std::size_t length)
+{
+    JsonParser parser{text, length};
+    return parser.ParseDocument();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsed JSON document, enough for the small descriptions that binary model
+// formats such as glTF carry next to their data. Lookups of missing members
+// or out-of-range elements return a null value instead of throwing, so
+// optional properties read as their defaults:
+//   const double stride = accessor["byteStride"].GetNumber(0.0);
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    JsonValue();
+
+    Type GetType() const;
+    bool IsNull() const;
+
+    // member of an object, null when the value isn't an object or has no such member
+    const JsonValue& operator[](const std::string& key) const;
+
+    // element of an array, null when the value isn't an array or the index is out of range
+    const JsonValue& operator[](std::size_t index) const;
+
+    // elements of an array or members of an object, 0 otherwise
+    std::size_t GetSize() const;
+
+    // the value, or fallback when it has a different type
+    bool GetBool(bool fallback) const;
+    double GetNumber(double fallback) const;
+    const std::string& GetString() const;  // empty for non-strings
+
+    const std::vector<std::pair<std::string, JsonValue>>& GetMembers() const;
+
+private:
+    friend class JsonParser;
+
+    Type type;
+    bool boolValue;
+    double numberValue;
+    std::string stringValue;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+// parses a UTF-8 JSON document, throws std::runtime_error with the byte offset of the first error
+JsonValue ParseJson(const char* text, std::size_t length);
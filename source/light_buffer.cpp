@@ -0,0 +1,67 @@
+#include "light_buffer.h"
+
+#include <glad/glad.h>
+
+namespace
+{
+
+// two RGBA32F texels read with texelFetch(lightData, 2 * index) and 2 * index + 1
+struct GpuLight
+{
+    glm::vec4 positionRadius;
+    glm::vec4 color;
+};
+
+static_assert(sizeof(GpuLight) == 32, "GpuLight must be two RGBA32F texels");
+
+} // namespace
+
+LightBuffer CreateLightBuffer()
+{
+    LightBuffer lightBuffer;
+    lightBuffer.bufferSize = sizeof(GpuLight);
+    lightBuffer.lightCount = 0;
+
+    glGenBuffers(1, &lightBuffer.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, lightBuffer.bufferSize, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &lightBuffer.texture);
+    glBindTexture(GL_TEXTURE_BUFFER, lightBuffer.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    return lightBuffer;
+}
+
+void DestroyLightBuffer(LightBuffer& lightBuffer)
+{
+    glDeleteTextures(1, &lightBuffer.texture);
+    glDeleteBuffers(1, &lightBuffer.buffer);
+
+    lightBuffer.texture = 0;
+    lightBuffer.buffer = 0;
+    lightBuffer.bufferSize = 0;
+    lightBuffer.lightCount = 0;
+}
+
+void UpdateLightBuffer(LightBuffer& lightBuffer, StreamingBuffer& streamingBuffer, const std::vector<PointLight>& lights)
+{
+    std::vector<GpuLight> gpuLights(lights.size());
+    for (std::size_t i = 0; i < lights.size(); ++i)
+    {
+        gpuLights[i].positionRadius = glm::vec4{lights[i].position, lights[i].radius};
+        gpuLights[i].color = glm::vec4{lights[i].color, 1.0f};
+    }
+
+    lightBuffer.lightCount = static_cast<unsigned int>(lights.size());
+
+    // the GPU copy is ordered after the draws still reading the previous lights, the CPU doesn't wait for them
+    const StreamingRange range = streamingBuffer.Write(gpuLights.data(), gpuLights.size() * sizeof(GpuLight), sizeof(GpuLight));
+    CopyStreamedRange(range, lightBuffer.buffer, lightBuffer.bufferSize);
+
+    glActiveTexture(GL_TEXTURE0 + LightBufferTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightBuffer.texture);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include "light_rig.h"
+#include "streaming_buffer.h"
+
+// texture unit the light buffer texture is bound to, programs name the sampler lightData
+const int LightBufferTextureUnit = 1;
+
+// Lights of a frame in a buffer texture (GL_RGBA32F, two texels per light:
+// position and radius, then color), so shaders can loop over any number of
+// lights without the size limits of a uniform block.
+struct LightBuffer
+{
+    unsigned int buffer;
+    std::size_t bufferSize;
+    unsigned int texture;
+    unsigned int lightCount;
+};
+
+LightBuffer CreateLightBuffer();
+void DestroyLightBuffer(LightBuffer& lightBuffer);
+
+// streams the lights, copies them into the buffer texture's buffer and binds the texture to LightBufferTextureUnit
+void UpdateLightBuffer(LightBuffer& lightBuffer, StreamingBuffer& streamingBuffer, const std::vector<PointLight>& lights);
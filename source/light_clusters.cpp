@@ -0,0 +1,270 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+const unsigned int clustersPerSlice = ClusterCountX * ClusterCountY;
+
+bool SphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    const glm::vec3 closestPoint = glm::clamp(center, boxMin, boxMax);
+    const glm::vec3 offset = closestPoint - center;
+
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+unsigned int ToTile(float ndc, unsigned int tileCount)
+{
+    const float tile = (ndc * 0.5f + 0.5f) * static_cast<float>(tileCount);
+    return static_cast<unsigned int>(glm::clamp(tile, 0.0f, static_cast<float>(tileCount - 1)));
+}
+
+unsigned int CreateBufferTexture(GLenum internalFormat, unsigned int& buffer, std::size_t& bufferSize)
+{
+    bufferSize = 2 * sizeof(unsigned int);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, bufferSize, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    return texture;
+}
+
+} // namespace
+
+LightClusters::LightClusters(JobSystem& jobSystem)
+    : jobSystem(jobSystem),
+      projectionParams{0.0f},
+      depthSliceParams{0.0f},
+      sliceClusterLights(ClusterCountZ)
+{
+    dataTexture = CreateBufferTexture(GL_RG32UI, dataBuffer, dataBufferSize);
+    indexTexture = CreateBufferTexture(GL_R32UI, indexBuffer, indexBufferSize);
+}
+
+LightClusters::~LightClusters()
+{
+    glDeleteTextures(1, &dataTexture);
+    glDeleteTextures(1, &indexTexture);
+    glDeleteBuffers(1, &dataBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+void LightClusters::Build(const std::vector<PointLight>& lights, unsigned int firstLight, const glm::mat4& viewMatrix,
+                          float fov, float aspectRatio, float nearPlane, float farPlane, ClusterLightLists& lists)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    const glm::vec4 params{fov, aspectRatio, nearPlane, farPlane};
+    if (params != projectionParams)
+    {
+        projectionParams = params;
+        UpdateClusterBounds(fov, aspectRatio, nearPlane, farPlane);
+    }
+
+    const float tanHalfFovY = std::tan(fov * 0.5f);
+    const float tanHalfFovX = tanHalfFovY * aspectRatio;
+
+    // narrow every light down to a box of clusters, the slices then only test those
+    lightBounds.clear();
+    for (unsigned int i = firstLight; i < lights.size(); ++i)
+    {
+        LightBounds bounds;
+        bounds.center = glm::vec3{viewMatrix * glm::vec4{lights[i].position, 1.0f}};
+        bounds.radius = lights[i].radius;
+        bounds.lightIndex = i;
+
+        const float minDepth = -bounds.center.z - bounds.radius;
+        const float maxDepth = -bounds.center.z + bounds.radius;
+        if (maxDepth < nearPlane || minDepth > farPlane)
+        {
+            continue;
+        }
+
+        const auto toSlice = [this](float depth)
+        {
+            const float slice = std::log(depth) * depthSliceParams.x - depthSliceParams.y;
+            return static_cast<unsigned int>(glm::clamp(slice, 0.0f, static_cast<float>(ClusterCountZ - 1)));
+        };
+        bounds.minZ = toSlice(std::max(minDepth, nearPlane));
+        bounds.maxZ = toSlice(std::min(maxDepth, farPlane));
+
+        bounds.minX = 0;
+        bounds.maxX = ClusterCountX - 1;
+        bounds.minY = 0;
+        bounds.maxY = ClusterCountY - 1;
+
+        // the projected corners of the sphere's bounding box enclose its projection
+        // as long as the box is entirely in front of the camera
+        if (minDepth > nearPlane)
+        {
+            glm::vec2 ndcMin{1.0f};
+            glm::vec2 ndcMax{-1.0f};
+            for (unsigned int corner = 0; corner < 8; ++corner)
+            {
+                const glm::vec3 point = bounds.center + glm::vec3{(corner & 1) ? bounds.radius : -bounds.radius,
+                                                                  (corner & 2) ? bounds.radius : -bounds.radius,
+                                                                  (corner & 4) ? bounds.radius : -bounds.radius};
+                const glm::vec2 ndc{point.x / (-point.z * tanHalfFovX), point.y / (-point.z * tanHalfFovY)};
+
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+
+            if (ndcMin.x > 1.0f || ndcMin.y > 1.0f || ndcMax.x < -1.0f || ndcMax.y < -1.0f)
+            {
+                continue;
+            }
+
+            bounds.minX = ToTile(ndcMin.x, ClusterCountX);
+            bounds.maxX = ToTile(ndcMax.x, ClusterCountX);
+            bounds.minY = ToTile(ndcMin.y, ClusterCountY);
+            bounds.maxY = ToTile(ndcMax.y, ClusterCountY);
+        }
+
+        lightBounds.push_back(bounds);
+    }
+
+    jobSystem.ParallelFor(ClusterCountZ, 1, [this](std::size_t firstSlice, std::size_t endSlice)
+    {
+        for (std::size_t slice = firstSlice; slice < endSlice; ++slice)
+        {
+            BinSlice(static_cast<unsigned int>(slice));
+        }
+    });
+
+    // slices were binned independently, concatenate their lists in cluster order
+    lists.clusterData.resize(clustersPerSlice * ClusterCountZ * 2);
+    lists.lightIndices.clear();
+    stats.maxLightsPerCluster = 0;
+    for (unsigned int slice = 0; slice < ClusterCountZ; ++slice)
+    {
+        for (unsigned int cluster = 0; cluster < clustersPerSlice; ++cluster)
+        {
+            const std::vector<unsigned int>& lights = sliceClusterLights[slice][cluster];
+            const unsigned int clusterIndex = slice * clustersPerSlice + cluster;
+
+            lists.clusterData[clusterIndex * 2] = static_cast<unsigned int>(lists.lightIndices.size());
+            lists.clusterData[clusterIndex * 2 + 1] = static_cast<unsigned int>(lights.size());
+            lists.lightIndices.insert(lists.lightIndices.end(), lights.begin(), lights.end());
+
+            stats.maxLightsPerCluster = std::max(stats.maxLightsPerCluster, static_cast<unsigned int>(lights.size()));
+        }
+    }
+    stats.lightIndexCount = static_cast<unsigned int>(lists.lightIndices.size());
+
+    // buffer textures may not be empty, an unused index keeps the last one valid
+    if (lists.lightIndices.empty())
+    {
+        lists.lightIndices.push_back(0);
+    }
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+glm::vec4 LightClusters::GetDepthSliceParams() const
+{
+    return depthSliceParams;
+}
+
+const LightClusterStats& LightClusters::GetStats() const
+{
+    return stats;
+}
+
+void LightClusters::UpdateClusterBounds(float fov, float aspectRatio, float nearPlane, float farPlane)
+{
+    // slice = log(depth / near) / log(far / near) * sliceCount, split into a scale and bias of log(depth)
+    const float logDepthRange = std::log(farPlane / nearPlane);
+    depthSliceParams = glm::vec4{ClusterCountZ / logDepthRange, ClusterCountZ * std::log(nearPlane) / logDepthRange, 0.0f, 0.0f};
+
+    const float tanHalfFovY = std::tan(fov * 0.5f);
+    const float tanHalfFovX = tanHalfFovY * aspectRatio;
+
+    clusterBounds.resize(clustersPerSlice * ClusterCountZ);
+    for (unsigned int z = 0; z < ClusterCountZ; ++z)
+    {
+        const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / ClusterCountZ);
+        const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z + 1) / ClusterCountZ);
+
+        for (unsigned int y = 0; y < ClusterCountY; ++y)
+        {
+            const float ndcMinY = -1.0f + 2.0f * y / ClusterCountY;
+            const float ndcMaxY = -1.0f + 2.0f * (y + 1) / ClusterCountY;
+
+            for (unsigned int x = 0; x < ClusterCountX; ++x)
+            {
+                const float ndcMinX = -1.0f + 2.0f * x / ClusterCountX;
+                const float ndcMaxX = -1.0f + 2.0f * (x + 1) / ClusterCountX;
+
+                // the tile's edges widen with depth, the extremes lie on the near or far slice plane
+                ClusterBounds& bounds = clusterBounds[(z * ClusterCountY + y) * ClusterCountX + x];
+                bounds.min = glm::vec3{std::min(ndcMinX * sliceNear, ndcMinX * sliceFar) * tanHalfFovX,
+                                       std::min(ndcMinY * sliceNear, ndcMinY * sliceFar) * tanHalfFovY,
+                                       -sliceFar};
+                bounds.max = glm::vec3{std::max(ndcMaxX * sliceNear, ndcMaxX * sliceFar) * tanHalfFovX,
+                                       std::max(ndcMaxY * sliceNear, ndcMaxY * sliceFar) * tanHalfFovY,
+                                       -sliceNear};
+            }
+        }
+    }
+}
+
+void LightClusters::BinSlice(unsigned int slice)
+{
+    // lists keep their capacity between frames, so binning does not allocate once warmed up
+    std::vector<std::vector<unsigned int>>& clusterLights = sliceClusterLights[slice];
+    clusterLights.resize(clustersPerSlice);
+    for (auto& lights : clusterLights)
+    {
+        lights.clear();
+    }
+
+    for (const auto& light : lightBounds)
+    {
+        if (slice < light.minZ || slice > light.maxZ)
+        {
+            continue;
+        }
+
+        for (unsigned int y = light.minY; y <= light.maxY; ++y)
+        {
+            for (unsigned int x = light.minX; x <= light.maxX; ++x)
+            {
+                const ClusterBounds& cluster = clusterBounds[(slice * ClusterCountY + y) * ClusterCountX + x];
+                if (SphereIntersectsBox(light.center, light.radius, cluster.min, cluster.max))
+                {
+                    clusterLights[y * ClusterCountX + x].push_back(light.lightIndex);
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::Upload(const ClusterLightLists& lists, StreamingBuffer& streamingBuffer)
+{
+    const StreamingRange dataRange = streamingBuffer.Write(lists.clusterData.data(), lists.clusterData.size() * sizeof(unsigned int), sizeof(unsigned int));
+    CopyStreamedRange(dataRange, dataBuffer, dataBufferSize);
+
+    const StreamingRange indexRange = streamingBuffer.Write(lists.lightIndices.data(), lists.lightIndices.size() * sizeof(unsigned int), sizeof(unsigned int));
+    CopyStreamedRange(indexRange, indexBuffer, indexBufferSize);
+
+    glActiveTexture(GL_TEXTURE0 + ClusterDataTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, dataTexture);
+    glActiveTexture(GL_TEXTURE0 + ClusterLightIndexTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
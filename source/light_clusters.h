@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "light_rig.h"
+#include "streaming_buffer.h"
+
+// froxel grid the view frustum is divided into, depth slices are spaced exponentially
+const unsigned int ClusterCountX = 16;
+const unsigned int ClusterCountY = 9;
+const unsigned int ClusterCountZ = 24;
+
+// texture units of the cluster buffer textures, programs name the samplers clusterData and clusterLightIndices
+const int ClusterDataTextureUnit = 5;
+const int ClusterLightIndexTextureUnit = 6;
+
+struct LightClusterStats
+{
+    unsigned int lightIndexCount = 0;
+    unsigned int maxLightsPerCluster = 0;
+    double milliseconds = 0.0;  // binning time of the last build
+};
+
+// the binned lights of one frame, as uploaded into the two buffer textures
+struct ClusterLightLists
+{
+    std::vector<unsigned int> clusterData;   // offset and count per cluster
+    std::vector<unsigned int> lightIndices;  // never empty, buffer textures can't be
+};
+
+// Clustered forward shading: every frame the bounded lights are binned on the
+// CPU into the clusters of the view frustum they can reach, and each fragment
+// only loops over the lights of its own cluster. Every depth slice is binned
+// by a job of its own. The result is
+// uploaded as two buffer textures:
+//   clusterData          GL_RG32UI, offset and count into the index list per cluster
+//   clusterLightIndices  GL_R32UI, indices into the light buffer
+// Clusters are numbered x fastest, then y, then the depth slice. Binning
+// makes no GL calls, so a frame can be binned on one thread while the
+// previous frame's lists are uploaded on the thread owning the context.
+class LightClusters
+{
+public:
+    // bins with the jobs of jobSystem
+    explicit LightClusters(JobSystem& jobSystem);
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // bins lights[firstLight...] (the unbounded lights before them reach every cluster)
+    // into the clusters of a glm::perspective frustum
+    void Build(const std::vector<PointLight>& lights, unsigned int firstLight, const glm::mat4& viewMatrix,
+               float fov, float aspectRatio, float nearPlane, float farPlane, ClusterLightLists& lists);
+
+    // streams lists built by Build into the buffer textures and binds them
+    void Upload(const ClusterLightLists& lists, StreamingBuffer& streamingBuffer);
+
+    // scale and bias turning log(view depth) into a depth slice, for the Frame block
+    glm::vec4 GetDepthSliceParams() const;
+
+    const LightClusterStats& GetStats() const;
+
+private:
+    struct ClusterBounds
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // view-space sphere of a light with the clusters it can touch
+    struct LightBounds
+    {
+        glm::vec3 center;
+        float radius;
+        unsigned int lightIndex;
+        unsigned int minX, maxX, minY, maxY, minZ, maxZ;
+    };
+
+    void UpdateClusterBounds(float fov, float aspectRatio, float nearPlane, float farPlane);
+    void BinSlice(unsigned int slice);
+
+    JobSystem& jobSystem;
+
+    std::vector<ClusterBounds> clusterBounds;
+    glm::vec4 projectionParams;  // fov, aspect ratio, near and far plane of clusterBounds
+    glm::vec4 depthSliceParams;
+
+    // per-frame binning state, written by the calling thread before the jobs start
+    std::vector<LightBounds> lightBounds;
+    std::vector<std::vector<std::vector<unsigned int>>> sliceClusterLights;  // light indices per cluster of each slice
+
+    unsigned int dataBuffer;
+    std::size_t dataBufferSize;
+    unsigned int dataTexture;
+    unsigned int indexBuffer;
+    std::size_t indexBufferSize;
+    unsigned int indexTexture;
+
+    LightClusterStats stats;
+};
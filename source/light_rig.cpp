@@ -0,0 +1,56 @@
+#include "light_rig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+LightRig CreateLightRig(const glm::vec3& keyLightPos, const glm::vec3& keyLightColor, unsigned int pointLightCount,
+                        const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    LightRig lightRig;
+    lightRig.lights.push_back(PointLight{keyLightPos, 0.0f, keyLightColor});
+    lightRig.unboundedLightCount = 1;
+
+    // lights cover a box slightly larger than the model, each reaching a fraction of it
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    const glm::vec3 extent = glm::max((boundsMax - boundsMin) * 0.75f, glm::vec3{0.5f});
+    const float lightRadius = std::max(extent.x, std::max(extent.y, extent.z)) * 0.5f;
+
+    std::mt19937 generator{1234};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+
+    for (unsigned int i = 0; i < pointLightCount; ++i)
+    {
+        const float height = center.y + (unit(generator) * 2.0f - 1.0f) * extent.y;
+        const float orbitRadius = std::max(extent.x, extent.z) * std::sqrt(unit(generator));
+
+        LightOrbit orbit;
+        orbit.center = glm::vec3{center.x, height, center.z};
+        orbit.orbitRadius = orbitRadius;
+        orbit.angularSpeed = (unit(generator) < 0.5f ? -1.0f : 1.0f) * (0.2f + unit(generator) * 0.8f);
+        orbit.phase = unit(generator) * 6.2831853f;
+
+        // saturated colours so overlapping lights stay distinguishable
+        const float hue = unit(generator) * 6.0f;
+        const glm::vec3 color = glm::clamp(glm::vec3{std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f)},
+                                           glm::vec3{0.0f}, glm::vec3{1.0f});
+
+        lightRig.lights.push_back(PointLight{orbit.center, lightRadius, color});
+        lightRig.orbits.push_back(orbit);
+    }
+
+    AnimateLightRig(lightRig, 0.0f);
+
+    return lightRig;
+}
+
+void AnimateLightRig(LightRig& lightRig, float time)
+{
+    for (std::size_t i = 0; i < lightRig.orbits.size(); ++i)
+    {
+        const LightOrbit& orbit = lightRig.orbits[i];
+        const float angle = orbit.phase + orbit.angularSpeed * time;
+
+        lightRig.lights[lightRig.unboundedLightCount + i].position = orbit.center + glm::vec3{std::cos(angle), 0.0f, std::sin(angle)} * orbit.orbitRadius;
+    }
+}
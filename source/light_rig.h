@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;       // distance at which the light fades out, 0 for an unbounded light
+    glm::vec3 color;
+};
+
+// circle a light travels around the model
+struct LightOrbit
+{
+    glm::vec3 center;
+    float orbitRadius;
+    float angularSpeed;  // radians per second, negative orbits run clockwise
+    float phase;
+};
+
+// The lights of a scene. Unbounded lights always come first, the deferred
+// renderer shades them with a fullscreen pass and the rest with light volumes.
+struct LightRig
+{
+    std::vector<PointLight> lights;
+    std::vector<LightOrbit> orbits;  // one per bounded light
+    unsigned int unboundedLightCount;
+};
+
+// One white key light at keyLightPos plus pointLightCount coloured point lights
+// scattered through the given bounds. The layout is deterministic so runs with
+// the same light count are comparable.
+LightRig CreateLightRig(const glm::vec3& keyLightPos, const glm::vec3& keyLightColor, unsigned int pointLightCount,
+                        const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+// moves the bounded lights along their orbits
+void AnimateLightRig(LightRig& lightRig, float time);
@@ -1,12 +1,14 @@
 #include <cmath>
 
-#include <array>
 #include <vector>
 #include <algorithm>
-#include <fstream>
+#include <chrono>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 
 #include <glad/glad.h>
 
@@ -16,20 +18,102 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-struct Vertex
-{
-    glm::vec3 position;
-    glm::vec3 normal;
-};
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "ambient_occlusion.h"
+#include "antialiasing.h"
+#include "cpu_features.h"
+#include "deferred_renderer.h"
+#include "depth_prepass.h"
+#include "draw_list.h"
+#include "environment_lighting.h"
+#include "file_watcher.h"
+#include "frame_capture.h"
+#include "frame_uniforms.h"
+#include "gpu_buffer_pool.h"
+#include "gpu_profiler.h"
+#include "hiz_occlusion.h"
+#include "job_system.h"
+#include "light_buffer.h"
+#include "light_clusters.h"
+#include "light_rig.h"
+#include "material_buffer.h"
+#include "meshlets.h"
+#include "model.h"
+#include "progressive_model.h"
+#include "model_loader.h"
+#include "options.h"
+#include "overdraw_view.h"
+#include "render_thread.h"
+#include "shader.h"
+#include "shader_permutations.h"
+#include "shadow_maps.h"
+#include "software_occlusion.h"
+#include "software_renderer.h"
+#include "streaming_buffer.h"
+#include "texture_cache.h"
 
-void FramebufferSizeCallback(GLFWwindow* windowHandle, int width, int height);
 void ProcessInput(GLFWwindow* windowHandle, float& distanceFromTarget, float& azimuth, float& elevation, float deltaTime);
 
 glm::vec3 CalculateCameraPosition(float distanceFromTarget, float azimuth, float elevation, const glm::vec3& target);
-std::vector<Vertex> LoadObjFile(const std::string& filepath);
 
-int main()
+std::vector<DrawCommand> BuildDrawList(const Model& model, unsigned int vao, ShaderPermutationSet& shaders,
+                                       const std::vector<ShaderPermutation>& materialPermutations, const std::vector<TextureHandle>& materialTextures);
+
+std::vector<DrawCommand> BuildHeadlessDrawList(const Model& model);
+
+void CalculateModelBounds(const Model& model, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+void PrintJobStats(const std::vector<JobThreadStats>& threadStats);
+
+void RunOcclusionBenchmark(const Model& model);
+void RunMeshletBenchmark(Model model);
+void RunJobBenchmark(Model model);
+void RunSoftwareRender(const Model& model, unsigned int lightCount, const std::string& imagePath);
+
+// largest triangles of the model rasterized by the software occlusion buffer
+const unsigned int occluderTriangleBudget = 4096;
+
+// channel difference up to which a software rendered pixel still matches the GL frame
+const int softwareImageTolerance = 8;
+
+int main(int argc, char* argv[])
 {
+    const auto startupBeginTime = std::chrono::steady_clock::now();
+
+    const Options options = ParseCommandLine(argc, argv);
+
+    if (options.occlusionBenchmark)
+    {
+        RunOcclusionBenchmark(LoadModelFile(options.modelPath));
+        return 0;
+    }
+
+    if (options.meshletBenchmark)
+    {
+        RunMeshletBenchmark(LoadModelFile(options.modelPath));
+        return 0;
+    }
+
+    if (options.jobBenchmark)
+    {
+        RunJobBenchmark(LoadModelFile(options.modelPath));
+        return 0;
+    }
+
+    if (options.softwareRenderPath.empty() == false)
+    {
+        RunSoftwareRender(LoadModelFile(options.modelPath), options.lightCount, options.softwareRenderPath);
+        return 0;
+    }
+
+    // loading, mesh processing and culling all run as jobs on every hardware thread
+    JobSystem& jobSystem = GetSharedJobSystem();
+
+    // the model loads while the window and context are created, the render loop swaps in finer versions as they arrive
+    std::unique_ptr<ProgressiveModelLoader> modelLoader{new ProgressiveModelLoader{options.modelPath, options.modelCacheDirectory}};
+
     if (glfwInit() == false)
     {
         throw std::runtime_error{"Failed to intialize GLFW"};
@@ -43,6 +127,24 @@ int main()
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    // the G-buffer is single-sampled and can't be blitted into a multisampled window, the overdraw
+    // view shows fragment counts that must not be filtered
+    Antialiasing antialiasing = options.overdrawView ? Antialiasing::Off : options.antialiasing;
+    if (options.overdrawView && options.antialiasing != Antialiasing::Off)
+    {
+        std::cerr << "the overdraw view is not antialiased" << std::endl;
+    }
+    if (options.renderer == Renderer::Deferred && (antialiasing == Antialiasing::Msaa || antialiasing == Antialiasing::MsaaWindow))
+    {
+        std::cerr << "deferred shading can't use MSAA, using FXAA" << std::endl;
+        antialiasing = Antialiasing::Fxaa;
+    }
+
+    if (antialiasing == Antialiasing::MsaaWindow)
+    {
+        glfwWindowHint(GLFW_SAMPLES, static_cast<int>(options.msaaSamples));
+    }
+
     const int windowWidth = 800;
     const int windowHeight = 600;
 
@@ -55,8 +157,6 @@ int main()
     }
 
     glfwMakeContextCurrent(windowHandle);
-    
-    glfwSetFramebufferSizeCallback(windowHandle, FramebufferSizeCallback);
 
     if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) == false)
     {
@@ -69,128 +169,355 @@ int main()
 
     glViewport(0, 0, windowWidth, windowHeight);
 
-    std::vector<Vertex> vertices = LoadObjFile("../assets/tetrahedron.obj");
- 
+    // the window may get fewer samples than asked for, or none at all
+    int windowSamples = 0;
+    if (antialiasing == Antialiasing::MsaaWindow)
+    {
+        glEnable(GL_MULTISAMPLE);
+        glGetIntegerv(GL_SAMPLES, &windowSamples);
+    }
+
+    Model firstModel = modelLoader->WaitForFirstModel();
+
+    // meshlets reorder the triangles within each submesh, so they are built before the vertices are uploaded
+    std::unique_ptr<MeshletCuller> meshletCuller;
+    if (options.meshlets)
+    {
+        meshletCuller.reset(new MeshletCuller{BuildMeshlets(firstModel), jobSystem, true});
+    }
+
+    // the version the main thread culls, the render thread takes each new version with the frame that introduces it
+    std::shared_ptr<const Model> model = std::make_shared<const Model>(std::move(firstModel));
+
+    const auto reportModel = [&model, &modelLoader]()
+    {
+        const ProgressiveModelStats& modelStats = modelLoader->GetStats();
+        if (modelLoader->IsComplete() == false)
+        {
+            std::cout << "model: coarser version of " << model->vertices.size() / 3 << " triangles after " << modelStats.milliseconds << " ms" << std::endl;
+            return;
+        }
+
+        const ModelCacheStats& cacheStats = modelStats.cacheStats;
+        std::cout << "model: " << model->vertices.size() / 3 << " triangles " << (cacheStats.loadedFromCache ? "decoded from the cache" : "loaded")
+                  << " after " << modelStats.milliseconds << " ms";
+        if (cacheStats.compressedSize > 0)
+        {
+            std::cout << ", " << cacheStats.uncompressedSize / 1024 << " KB of vertices in a " << cacheStats.compressedSize / 1024 << " KB entry";
+        }
+        std::cout << std::endl;
+    };
+    reportModel();
+
+    // the render thread's version, ahead of or behind the main thread's for a frame after a new one arrives
+    std::shared_ptr<const Model> renderModel = model;
+
+    std::unique_ptr<TextureCache> textureCache{new TextureCache{TextureCacheSettings{}}};
+
+    // requests are shared by source, asking again for the textures of a finer version of the model is cheap
+    const auto requestMaterialTextures = [&textureCache](const std::vector<Material>& materials)
+    {
+        std::vector<TextureHandle> textures;
+        for (const auto& material : materials)
+        {
+            textures.push_back(material.diffuseTexturePath.empty()
+                                   ? InvalidTextureHandle
+                                   : textureCache->Request(material.diffuseTexturePath, material.diffuseTextureOffset, material.diffuseTextureSize));
+        }
+        return textures;
+    };
+    std::vector<TextureHandle> materialTextures = requestMaterialTextures(model->materials);
+
+    MaterialBuffer materialBuffer = CreateMaterialBuffer(model->materials);
+
+    // vertex streams are suballocated from shared buffers, packed again once replaced models leave too many holes
+    std::unique_ptr<GpuBufferPool> geometryPool{new GpuBufferPool{64 * 1024 * 1024, 0.25f}};
+
     unsigned int vao;
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
 
-    unsigned int vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    // the attribute pointers start at the model's allocation, so draw commands index its vertices from 0
+    unsigned int vertexAllocation = 0;
+    const auto bindModelVertices = [&]()
+    {
+        const GpuBufferRange range = geometryPool->GetRange(vertexAllocation);
+        const std::size_t offset = range.offset;
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+
+        // enable position attribute
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offset));
+        glEnableVertexAttribArray(0);
 
-    // enable position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    glEnableVertexAttribArray(0);
+        // enable normal attribute
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offset + offsetof(Vertex, normal)));
+        glEnableVertexAttribArray(1);
 
-    // enable normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
+        // enable texture coordinate attribute
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offset + offsetof(Vertex, texCoord)));
+        glEnableVertexAttribArray(2);
 
-    glBindVertexArray(0);
+        glBindVertexArray(0);
+    };
+    const auto setModelVertices = [&](const std::vector<Vertex>& vertices)
+    {
+        geometryPool->Free(vertexAllocation);
+        vertexAllocation = geometryPool->Allocate(vertices.size() * sizeof(Vertex));
+        geometryPool->Upload(vertexAllocation, vertices.data(), vertices.size() * sizeof(Vertex));
+        bindModelVertices();
+    };
+    setModelVertices(model->vertices);
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    CalculateModelBounds(*model, boundsMin, boundsMax);
+
+    // the deferred renderer draws the scene into its G-buffer with the same vertex shader
+    const bool deferred = options.renderer == Renderer::Deferred;
+    const bool clustered = options.renderer == Renderer::Clustered;
+
+    // the G-buffer has no room for metallic and roughness, and the overdraw view shades nothing
+    const bool physicallyBased = options.shading == Shading::Pbr && deferred == false && options.overdrawView == false;
+    if (options.shading == Shading::Pbr && deferred)
+    {
+        std::cerr << "physically based shading needs the forward or clustered renderer, using phong shading" << std::endl;
+    }
 
-    // transforms vertices to clip space and passes data to fragment shader
-    const char* vertexShaderSource = R"(
-        #version 330 core
+    const std::string vertexShaderPath = options.shaderDirectory + "/phong.vert";
+    const std::string fragmentShaderPath = options.shaderDirectory + (deferred ? "/gbuffer.frag" : (physicallyBased ? "/pbr.frag" : "/phong.frag"));
+    const std::string lightVertexShaderPath = options.shaderDirectory + "/deferred_light.vert";
+    const std::string lightFragmentShaderPath = options.shaderDirectory + "/deferred_light.frag";
+    const std::string depthVertexShaderPath = options.shaderDirectory + "/depth.vert";
+    const std::string depthFragmentShaderPath = options.shaderDirectory + "/depth.frag";
+    const std::string fullscreenVertexShaderPath = options.shaderDirectory + "/fullscreen.vert";
+    const std::string overdrawFragmentShaderPath = options.shaderDirectory + "/overdraw.frag";
+    const std::string hiZFragmentShaderPath = options.shaderDirectory + "/hiz_downsample.frag";
+    const std::string hiZCullShaderPath = options.shaderDirectory + "/hiz_cull.comp";
+    const std::string fxaaFragmentShaderPath = options.shaderDirectory + "/fxaa.frag";
+    const std::string ambientOcclusionFragmentShaderPath = options.shaderDirectory + "/ssao.frag";
+
+    // the compute path needs GL 4.3, older contexts fall back to reading the pyramid back
+    OcclusionCulling occlusionCulling = options.occlusionCulling;
+    if (occlusionCulling == OcclusionCulling::Gpu && HiZOcclusionCuller::IsComputeCullingSupported() == false)
+    {
+        std::cerr << "compute shaders need OpenGL 4.3, using CPU occlusion culling" << std::endl;
+        occlusionCulling = OcclusionCulling::Cpu;
+    }
+    const bool hiZOcclusion = occlusionCulling == OcclusionCulling::Cpu || occlusionCulling == OcclusionCulling::Gpu;
 
-        layout (location = 0) in vec3 aPos;
-        layout (location = 1) in vec3 aNormal;
+    // the GPU culler's indirect commands draw whole submeshes, which would drop the meshlet ranges culled on the main thread
+    if (occlusionCulling == OcclusionCulling::Gpu && meshletCuller)
+    {
+        std::cerr << "meshlet culling doesn't combine with GPU occlusion culling, drawing whole submeshes" << std::endl;
+        meshletCuller.reset();
+    }
 
-        out vec3 worldVertexPos;
-        out vec3 worldVertexNormal;
+    // the main thread replaces its culler with every model version, this tells the render thread whether there is one
+    const bool meshletCulling = meshletCuller != nullptr;
 
-        uniform mat4 modelMatrix;
-        uniform mat4 viewMatrix;
-        uniform mat4 projectionMatrix;
+    // the overdraw view shades nothing that could be shadowed
+    const bool shadows = options.shadows && options.overdrawView == false;
+    const bool ambientOcclusion = options.ambientOcclusion && options.overdrawView == false;
 
-        void main()
-        {
-            vec4 worldPos = modelMatrix * vec4(aPos, 1.0);
-            vec3 worldNormal = transpose(inverse(mat3(modelMatrix))) * aNormal;
+    ShaderCache shaderCache{options.shaderCacheDirectory};
 
-            gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+    const std::vector<UniformBlockBinding> uniformBlockBindings{{"Materials", MaterialBlockBinding}, {"Frame", FrameBlockBinding},
+                                                                {"Shadows", ShadowBlockBinding}};
+    const std::vector<SamplerBinding> samplerBindings{{"diffuseTexture", DiffuseTextureUnit}, {"lightData", LightBufferTextureUnit},
+                                                      {"clusterData", ClusterDataTextureUnit}, {"clusterLightIndices", ClusterLightIndexTextureUnit},
+                                                      {"shadowMap", ShadowMapTextureUnit}, {"ambientOcclusion", AmbientOcclusionTextureUnit},
+                                                      {"irradianceMap", IrradianceTextureUnit}, {"prefilteredMap", PrefilteredEnvironmentTextureUnit},
+                                                      {"brdfLut", BrdfLutTextureUnit}};
+    std::unique_ptr<ShaderPermutationSet> sceneShaders{new ShaderPermutationSet{shaderCache, LoadTextFile(vertexShaderPath), LoadTextFile(fragmentShaderPath),
+                                                                                uniformBlockBindings, samplerBindings}};
 
-            worldVertexPos = worldPos.xyz;
-            worldVertexNormal = worldNormal;
+    // textured and untextured materials use different permutations, the renderer may add its own defines
+    const auto addMaterialPermutations = [&]()
+    {
+        std::vector<ShaderPermutation> permutations;
+        for (const auto& materialTexture : materialTextures)
+        {
+            std::vector<std::string> defines;
+            if (materialTexture != InvalidTextureHandle)
+            {
+                defines.push_back("HAS_DIFFUSE_TEXTURE");
+            }
+            if (clustered)
+            {
+                defines.push_back("CLUSTERED_LIGHTS");
+            }
+            if (shadows && deferred == false)
+            {
+                defines.push_back("SHADOWS");
+            }
+            if (ambientOcclusion && deferred == false)
+            {
+                defines.push_back("AMBIENT_OCCLUSION");
+            }
+
+            permutations.push_back(sceneShaders->Add(defines));
         }
-    )";
+        return permutations;
+    };
+    std::vector<ShaderPermutation> materialPermutations = addMaterialPermutations();
+
+    sceneShaders->CompileAll();
 
-    // implements phong lighting model
-    const char* fragmentShaderSource = R"(
-        #version 330 core
+    std::unique_ptr<DeferredRenderer> deferredRenderer;
+    if (deferred)
+    {
+        deferredRenderer.reset(new DeferredRenderer{shaderCache, LoadTextFile(lightVertexShaderPath), LoadTextFile(lightFragmentShaderPath), windowWidth, windowHeight,
+                                                    shadows});
+    }
 
-        in vec3 worldVertexPos;
-        in vec3 worldVertexNormal;
+    // the overdraw view, the occluder pass, the shadow casters and the forward occlusion depth draw the pre-pass's position stream,
+    // with or without the pre-pass itself
+    std::unique_ptr<DepthPrepass> depthPrepass;
+    if (options.depthPrepass || options.overdrawView || hiZOcclusion || shadows || (ambientOcclusion && deferred == false))
+    {
+        depthPrepass.reset(new DepthPrepass{shaderCache, *geometryPool, LoadTextFile(depthVertexShaderPath), LoadTextFile(depthFragmentShaderPath), model->vertices});
+    }
+
+    std::unique_ptr<OverdrawView> overdrawView;
+    if (options.overdrawView)
+    {
+        overdrawView.reset(new OverdrawView{shaderCache, LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(overdrawFragmentShaderPath), windowWidth, windowHeight});
+    }
 
-        out vec4 FragColor;
+    // every upload of per-frame data goes through the ring, grown when a frame outgrows its region
+    std::unique_ptr<StreamingBuffer> streamingBuffer{new StreamingBuffer{256 * 1024}};
 
-        uniform vec3 lightPos;
-        uniform vec3 lightColor;
-        uniform vec3 cameraPos;
-        uniform vec3 ambientColor;
-        uniform vec3 diffuseColor;
-        uniform vec3 specularColor;
-        uniform float shininessValue;
+    std::unique_ptr<CascadedShadowMaps> shadowMaps;
+    if (shadows)
+    {
+        shadowMaps.reset(new CascadedShadowMaps{*streamingBuffer, static_cast<int>(options.shadowMapSize), static_cast<int>(options.shadowCascades)});
+    }
 
-        void main()
+    // precomputed once and cached on disk, so the PBR shader only adds three texture lookups to the ambient term
+    std::unique_ptr<EnvironmentLighting> environmentLighting;
+    if (physicallyBased)
+    {
+        EnvironmentLightingSettings environmentSettings;
+        environmentSettings.environmentPath = options.environmentPath;
+        environmentSettings.cacheDirectory = options.environmentCacheDirectory;
+        environmentLighting.reset(new EnvironmentLighting{environmentSettings});
+
+        const EnvironmentLightingStats& environmentStats = environmentLighting->GetStats();
+        std::cout << "environment lighting: " << (environmentStats.loadedFromCache ? "loaded from cache" : "precomputed") << " in "
+                  << environmentStats.milliseconds << " ms";
+        if (environmentStats.loadedFromCache == false)
         {
-            vec3 normal = normalize(worldVertexNormal);
+            std::cout << " on " << environmentStats.threadCount << (environmentStats.threadCount == 1 ? " thread" : " threads");
+        }
+        std::cout << std::endl;
+    }
 
-            vec3 ambient = lightColor * 0.1 * ambientColor;
-            
-            vec3 lightDir = normalize(lightPos - worldVertexPos);
-            float diff = max(dot(normal, lightDir), 0.0);
-            vec3 diffuse = lightColor * diff * diffuseColor;
+    // samples reach a tenth of the model's size, the model is expected to fill most of the view
+    std::unique_ptr<AmbientOcclusionPass> ambientOcclusionPass;
+    if (ambientOcclusion)
+    {
+        ambientOcclusionPass.reset(new AmbientOcclusionPass{shaderCache, LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(ambientOcclusionFragmentShaderPath),
+                                                            windowWidth, windowHeight, static_cast<int>(options.ambientOcclusionDivisor),
+                                                            0.1f * glm::length(boundsMax - boundsMin)});
+    }
 
-            vec3 viewDir = normalize(cameraPos - worldVertexPos);
-            vec3 reflectDir = reflect(-lightDir, normal);
-            float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininessValue);
-            vec3 specular = lightColor * spec * specularColor;
+    // created even with antialiasing off so M can switch between the offscreen modes
+    std::unique_ptr<AntialiasingPass> antialiasingPass;
+    if (antialiasing != Antialiasing::MsaaWindow && options.overdrawView == false)
+    {
+        antialiasingPass.reset(new AntialiasingPass{shaderCache, LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(fxaaFragmentShaderPath), windowWidth,
+                                                    windowHeight});
+        antialiasingPass->SetMode(antialiasing, static_cast<int>(options.msaaSamples));
+    }
 
-            FragColor = vec4(ambient + diffuse + specular, 1);
+    // the modes M cycles through, MSAA with every power of two sample count the driver supports
+    std::vector<std::pair<Antialiasing, int>> antialiasingModes{{Antialiasing::Off, 1}, {Antialiasing::Fxaa, 1}};
+    if (antialiasingPass && deferred == false)
+    {
+        for (int sampleCount = 2; sampleCount <= AntialiasingPass::GetMaxSamples(); sampleCount *= 2)
+        {
+            antialiasingModes.push_back({Antialiasing::Msaa, sampleCount});
         }
-    )";
+    }
 
-    int success;
-    char log[512];
+    std::unique_ptr<HiZOcclusionCuller> occlusionCuller;
+    if (hiZOcclusion)
+    {
+        const std::string cullShaderSource = (occlusionCulling == OcclusionCulling::Gpu) ? LoadTextFile(hiZCullShaderPath) : std::string{};
+        occlusionCuller.reset(new HiZOcclusionCuller{shaderCache, LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(hiZFragmentShaderPath),
+                                                     cullShaderSource, windowWidth, windowHeight});
+    }
 
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    std::unique_ptr<SoftwareOcclusionBuffer> softwareOcclusion;
+    if (occlusionCulling == OcclusionCulling::Software)
     {
-        glGetShaderInfoLog(vertexShader, 512, nullptr, log);
-        std::cerr << log << std::endl;
-        throw std::runtime_error{"vertex shader compilation failed"};
+        softwareOcclusion.reset(new SoftwareOcclusionBuffer{CreateOccluderTriangles(model->vertices, occluderTriangleBudget), jobSystem, true});
     }
 
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // rebuilt by the render thread for every model version and shader reload, the main thread culls against the latest
+    std::shared_ptr<const SceneDrawList> drawList;
+    const auto rebuildDrawList = [&]()
     {
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, log);
-        std::cerr << log << std::endl;
-        throw std::runtime_error{"fragment shader compilation failed"};
+        drawList = std::make_shared<const SceneDrawList>(
+            SceneDrawList{renderModel, BuildDrawList(*renderModel, vao, *sceneShaders, materialPermutations, materialTextures)});
+        if (occlusionCuller)
+        {
+            occlusionCuller->SetDrawList(drawList->draws);
+        }
+    };
+    rebuildDrawList();
+
+    // the overdraw view shows no lit scene to compare with
+    std::unique_ptr<SoftwareRenderer> softwareRenderer;
+    if (options.compareSoftwareRenderer && options.overdrawView == false)
+    {
+        softwareRenderer.reset(new SoftwareRenderer{*model, jobSystem, true});
     }
 
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    std::cout << "shader programs: " << sceneShaders->GetStats().unique << " unique of " << sceneShaders->GetStats().requested << " permutations, "
+              << shaderCache.GetStats().hits << " loaded from cache, " << shaderCache.GetStats().misses << " compiled, "
+              << shaderCache.GetStats().milliseconds << " ms" << (shaderCache.IsEnabled() ? "" : " (cache disabled)") << std::endl;
+
+    // edited shaders are recompiled in the background while the old programs keep drawing
+    std::vector<std::string> shaderPaths{vertexShaderPath, fragmentShaderPath};
+    if (deferred)
+    {
+        shaderPaths.push_back(lightVertexShaderPath);
+        shaderPaths.push_back(lightFragmentShaderPath);
+    }
+    if (depthPrepass)
+    {
+        shaderPaths.push_back(depthVertexShaderPath);
+        shaderPaths.push_back(depthFragmentShaderPath);
+    }
+    if (overdrawView)
+    {
+        shaderPaths.push_back(fullscreenVertexShaderPath);
+        shaderPaths.push_back(overdrawFragmentShaderPath);
+    }
+    if (antialiasingPass)
+    {
+        shaderPaths.push_back(fullscreenVertexShaderPath);
+        shaderPaths.push_back(fxaaFragmentShaderPath);
+    }
+    if (ambientOcclusionPass)
+    {
+        shaderPaths.push_back(fullscreenVertexShaderPath);
+        shaderPaths.push_back(ambientOcclusionFragmentShaderPath);
+    }
+    if (occlusionCuller)
     {
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, log);
-        std::cerr << log << std::endl;
-        throw std::runtime_error{"shader program linking failed"};
+        shaderPaths.push_back(fullscreenVertexShaderPath);
+        shaderPaths.push_back(hiZFragmentShaderPath);
+        if (occlusionCulling == OcclusionCulling::Gpu)
+        {
+            shaderPaths.push_back(hiZCullShaderPath);
+        }
     }
+    FileWatcher shaderWatcher{shaderPaths};
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    std::unique_ptr<GpuProfiler> gpuProfiler{new GpuProfiler{}};
 
     float cameraDistanceFromTarget = 5.0f;
     float cameraAzimuth = 0.0f;
@@ -203,72 +530,850 @@ int main()
     const float distanceToNearPlane = 0.1f;
     const float distanceToFarPlane = 100.0f;
 
-    const int modelMatrixLocation = glGetUniformLocation(shaderProgram, "modelMatrix");
-    const int viewMatrixLocation = glGetUniformLocation(shaderProgram, "viewMatrix");
-    const int projectionMatrixLocation = glGetUniformLocation(shaderProgram, "projectionMatrix");
-
     const glm::vec3 lightPos{2.0f, 3.0f, 2.0f};
     const glm::vec3 lightColor{1.0f, 1.0f, 1.0f};
-    const glm::vec3 ambientColor{0.2f, 0.2f, 0.2f};
-    const glm::vec3 diffuseColor{0.8f, 0.5f, 0.3f};
-    const glm::vec3 specularColor{1.0f, 1.0f, 1.0f};
-    const float shininessValue = 32.0f;
-
-    const int lightPosLocation = glGetUniformLocation(shaderProgram, "lightPos");
-    const int lightColorLocation = glGetUniformLocation(shaderProgram, "lightColor");
-    const int cameraPosLocation = glGetUniformLocation(shaderProgram, "cameraPos");
-    const int ambientColorLocation = glGetUniformLocation(shaderProgram, "ambientColor");
-    const int diffuseColorLocation = glGetUniformLocation(shaderProgram, "diffuseColor");
-    const int specularColorLocation = glGetUniformLocation(shaderProgram, "specularColor");
-    const int shininessValueLocation = glGetUniformLocation(shaderProgram, "shininessValue");
+
+    LightRig lightRig = CreateLightRig(lightPos, lightColor, options.lightCount, boundsMin, boundsMax);
+    LightBuffer lightBuffer = CreateLightBuffer();
+
+    std::unique_ptr<LightClusters> lightClusters;
+    if (clustered)
+    {
+        lightClusters.reset(new LightClusters{jobSystem});
+    }
+
+    std::cout << "renderer: " << (deferred ? "deferred" : (clustered ? "clustered" : "forward")) << (physicallyBased ? ", pbr" : "")
+              << ", lights: " << lightRig.lights.size()
+              << (options.depthPrepass ? ", depth pre-pass" : "") << (options.overdrawView ? ", overdraw view" : "")
+              << (occlusionCulling == OcclusionCulling::Cpu ? ", cpu occlusion culling" : "")
+              << (occlusionCulling == OcclusionCulling::Gpu ? ", gpu occlusion culling" : "")
+              << (occlusionCulling == OcclusionCulling::Software ? ", software occlusion culling" : "");
+    if (meshletCuller)
+    {
+        std::cout << ", culling " << meshletCuller->GetMeshletCount() << " meshlets";
+    }
+    if (shadowMaps)
+    {
+        std::cout << ", shadows: " << shadowMaps->GetCascadeCount() << " cascades of " << shadowMaps->GetMapSize() << "x" << shadowMaps->GetMapSize();
+    }
+    if (ambientOcclusionPass)
+    {
+        std::cout << ", ssao at " << (ambientOcclusionPass->GetResolutionDivisor() == 2 ? "half" : "quarter") << " resolution";
+    }
+    if (antialiasingPass && antialiasingPass->GetMode() != Antialiasing::Off)
+    {
+        std::cout << ", antialiasing: " << antialiasingPass->GetDescription();
+    }
+    else if (antialiasing == Antialiasing::MsaaWindow)
+    {
+        std::cout << ", antialiasing: msaa " << windowSamples << "x window";
+    }
+    std::cout << std::endl;
+
+    // reads the finished frames back a few frames late so neither the GPU nor the encoder stalls the loop
+    std::unique_ptr<FrameCapture> frameCapture;
+    if (options.capturePath.empty() == false)
+    {
+        FrameCaptureSettings captureSettings;
+        captureSettings.outputPath = options.capturePath;
+        captureSettings.videoFrameRate = options.captureFrameRate;
+        frameCapture.reset(new FrameCapture{captureSettings});
+
+        std::cout << "capturing to " << options.capturePath
+                  << (frameCapture->IsVideo() ? " through ffmpeg at " + std::to_string(options.captureFrameRate) + " fps" : " as PNG files") << std::endl;
+    }
+
+    const glm::vec4 clearColor{0.2f, 0.3f, 0.3f, 1.0f};
 
     glEnable(GL_DEPTH_TEST);
 
+    // state of the render thread
+    float lastStatsReportTime = 0.0f;
+    double prepareMilliseconds = 0.0;
+    double submitMilliseconds = 0.0;
+    unsigned int reportFrameCount = 0;
+    bool firstFramePresented = false;
+    unsigned int redrawnShadowCascades = 0;
+    unsigned int shadowCasterDraws = 0;
+
+    // the last report without occlusion or meshlet culling is the baseline of its net gain
+    double unculledGpuFrameMilliseconds = 0.0;
+    double unculledMeshletGpuFrameMilliseconds = 0.0;
+
+    // each antialiasing mode keeps the GPU frame time of its last full report interval
+    bool antialiasingModeChanged = false;
+    std::vector<std::pair<std::string, double>> antialiasingFrameMilliseconds;
+
+    // the main thread prepares frames and the render thread, which owns the context from then on, submits them
+    std::unique_ptr<RenderThread> renderThread;
+
+    // submits a frame prepared by the main thread, everything touching GL happens here
+    const auto renderFrame = [&](const FrameSnapshot& frame)
+    {
+        const auto submitBeginTime = std::chrono::steady_clock::now();
+
+        textureCache->Update();
+
+        // a finer version of the model replaces everything built from the previous one
+        if (frame.newModel)
+        {
+            renderModel = frame.newModel;
+
+            materialTextures = requestMaterialTextures(renderModel->materials);
+            DestroyMaterialBuffer(materialBuffer);
+            materialBuffer = CreateMaterialBuffer(renderModel->materials);
+            materialPermutations = addMaterialPermutations();
+
+            setModelVertices(renderModel->vertices);
+
+            if (depthPrepass)
+            {
+                depthPrepass->SetVertices(renderModel->vertices);
+            }
+            if (shadowMaps)
+            {
+                shadowMaps->Invalidate();
+            }
+            if (softwareRenderer)
+            {
+                softwareRenderer.reset(new SoftwareRenderer{*renderModel, jobSystem, true});
+            }
+
+            rebuildDrawList();
+            renderThread->PublishDrawList(drawList);
+        }
+
+        // the streams of replaced models leave holes behind, packing moves every stream still in use
+        if (geometryPool->DefragmentIfNeeded())
+        {
+            bindModelVertices();
+            if (depthPrepass)
+            {
+                depthPrepass->RebindPositions();
+            }
+        }
+
+        if (frame.toggleAmbientOcclusion)
+        {
+            ambientOcclusionPass->SetEnabled(!ambientOcclusionPass->IsEnabled());
+            std::cout << "ambient occlusion " << (ambientOcclusionPass->IsEnabled() ? "on" : "off") << std::endl;
+        }
+
+        if (frame.switchAntialiasing)
+        {
+            const auto current = std::find(antialiasingModes.begin(), antialiasingModes.end(),
+                                           std::make_pair(antialiasingPass->GetMode(), antialiasingPass->GetSampleCount()));
+            const std::size_t next = (current == antialiasingModes.end()) ? 0 : (current - antialiasingModes.begin() + 1) % antialiasingModes.size();
+            antialiasingPass->SetMode(antialiasingModes[next].first, antialiasingModes[next].second);
+            antialiasingModeChanged = true;
+
+            std::cout << "antialiasing " << antialiasingPass->GetDescription() << std::endl;
+        }
+
+        const std::vector<std::string> changedShaders = shaderWatcher.ConsumeChangedFiles();
+        if (changedShaders.empty() == false)
+        {
+            const auto changed = [&changedShaders](const std::string& path)
+            {
+                return std::find(changedShaders.begin(), changedShaders.end(), path) != changedShaders.end();
+            };
+
+            try
+            {
+                if (changed(vertexShaderPath) || changed(fragmentShaderPath))
+                {
+                    sceneShaders->Reload(LoadTextFile(vertexShaderPath), LoadTextFile(fragmentShaderPath));
+                }
+                if (deferred && (changed(lightVertexShaderPath) || changed(lightFragmentShaderPath)))
+                {
+                    deferredRenderer->ReloadShaders(LoadTextFile(lightVertexShaderPath), LoadTextFile(lightFragmentShaderPath));
+                }
+                if (depthPrepass && (changed(depthVertexShaderPath) || changed(depthFragmentShaderPath)))
+                {
+                    depthPrepass->ReloadShaders(LoadTextFile(depthVertexShaderPath), LoadTextFile(depthFragmentShaderPath));
+                }
+                if (overdrawView && (changed(fullscreenVertexShaderPath) || changed(overdrawFragmentShaderPath)))
+                {
+                    overdrawView->ReloadShaders(LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(overdrawFragmentShaderPath));
+                }
+                if (antialiasingPass && (changed(fullscreenVertexShaderPath) || changed(fxaaFragmentShaderPath)))
+                {
+                    antialiasingPass->ReloadShaders(LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(fxaaFragmentShaderPath));
+                }
+                if (ambientOcclusionPass && (changed(fullscreenVertexShaderPath) || changed(ambientOcclusionFragmentShaderPath)))
+                {
+                    ambientOcclusionPass->ReloadShaders(LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(ambientOcclusionFragmentShaderPath));
+                }
+                if (occlusionCuller && (changed(fullscreenVertexShaderPath) || changed(hiZFragmentShaderPath)))
+                {
+                    occlusionCuller->ReloadShaders(LoadTextFile(fullscreenVertexShaderPath), LoadTextFile(hiZFragmentShaderPath));
+                }
+                if (occlusionCulling == OcclusionCulling::Gpu && changed(hiZCullShaderPath) && occlusionCuller->ReloadCullShader(LoadTextFile(hiZCullShaderPath)))
+                {
+                    std::cout << "cull shader reloaded" << std::endl;
+                }
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cerr << "failed to read shader sources, keeping the previous programs: " << error.what() << std::endl;
+            }
+        }
+
+        if (deferred && deferredRenderer->UpdateShaders())
+        {
+            std::cout << "light shaders reloaded" << std::endl;
+        }
+        if (depthPrepass && depthPrepass->UpdateShaders())
+        {
+            std::cout << "depth shaders reloaded" << std::endl;
+        }
+        if (overdrawView && overdrawView->UpdateShaders())
+        {
+            std::cout << "overdraw shaders reloaded" << std::endl;
+        }
+        if (antialiasingPass && antialiasingPass->UpdateShaders())
+        {
+            std::cout << "FXAA shaders reloaded" << std::endl;
+        }
+        if (ambientOcclusionPass && ambientOcclusionPass->UpdateShaders())
+        {
+            std::cout << "SSAO shaders reloaded" << std::endl;
+        }
+        if (occlusionCuller && occlusionCuller->UpdateShaders())
+        {
+            std::cout << "Hi-Z shaders reloaded" << std::endl;
+        }
+
+        // reloaded programs have new names, the draw list refers to programs directly
+        if (sceneShaders->Update())
+        {
+            rebuildDrawList();
+            renderThread->PublishDrawList(drawList);
+
+            std::cout << "shaders reloaded" << std::endl;
+        }
+
+        // set here rather than in a framebuffer size callback, which runs on the main thread without the context
+        const int framebufferWidth = frame.framebufferWidth;
+        const int framebufferHeight = frame.framebufferHeight;
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+        {
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+        }
+
+        streamingBuffer->BeginFrame();
+
+        UpdateLightBuffer(lightBuffer, *streamingBuffer, frame.lights);
+        if (clustered)
+        {
+            lightClusters->Upload(frame.clusterLights, *streamingBuffer);
+        }
+
+        gpuProfiler->BeginFrame();
+
+        UploadFrameUniforms(*streamingBuffer, frame.frameUniforms);
+
+        const glm::mat4 viewProjectionMatrix = frame.projectionMatrix * frame.viewMatrix;
+
+        // the key light and the model don't move, so cascades are only redrawn when the camera leaves them
+        if (shadowMaps)
+        {
+            gpuProfiler->BeginSection("shadows");
+            shadowMaps->Update(*depthPrepass, drawList->draws, lightPos, frame.boundsMin, frame.boundsMax, frame.viewMatrix, fov, frame.aspectRatio,
+                               distanceToNearPlane, distanceToFarPlane);
+            gpuProfiler->EndSection();
+
+            redrawnShadowCascades += shadowMaps->GetStats().renderedCascades;
+            shadowCasterDraws += shadowMaps->GetStats().casterDraws;
+        }
+
+        // the main thread's culling indexes the draw list it culled, a replaced list is drawn unculled for a frame
+        DrawVisibility visibility;
+        if (frame.culledDrawList == drawList)
+        {
+            visibility.visibleDraws = frame.hasVisibleDraws ? &frame.visibleDraws : nullptr;
+            visibility.drawRanges = frame.hasDrawRanges ? &frame.drawRanges : nullptr;
+        }
+
+        // the Hi-Z culler reads the GPU's depth, so it culls here; the GPU path never runs with meshlet ranges
+        if (occlusionCuller && frame.occlusionCullingEnabled)
+        {
+            occlusionCuller->Resize(framebufferWidth, framebufferHeight);
+
+            gpuProfiler->BeginSection("occluders");
+            occlusionCuller->RenderOccluders(drawList->draws, *depthPrepass);
+            gpuProfiler->EndSection();
+
+            gpuProfiler->BeginSection("hi-z");
+            occlusionCuller->BuildPyramid();
+            gpuProfiler->EndSection();
+
+            gpuProfiler->BeginSection("cull");
+            const DrawVisibility occlusionVisibility = occlusionCuller->Cull(drawList->draws, viewProjectionMatrix);
+            gpuProfiler->EndSection();
+
+            visibility.visibleDraws = occlusionVisibility.visibleDraws;
+            visibility.indirectBuffer = occlusionVisibility.indirectBuffer;
+        }
+
+        if (antialiasingPass)
+        {
+            antialiasingPass->Resize(framebufferWidth, framebufferHeight);
+        }
+        if (ambientOcclusionPass)
+        {
+            ambientOcclusionPass->Resize(framebufferWidth, framebufferHeight);
+        }
+
+        DrawStats drawStats;
+        if (overdrawView)
+        {
+            overdrawView->Resize(framebufferWidth, framebufferHeight);
+
+            gpuProfiler->BeginSection("overdraw");
+            overdrawView->Render(drawList->draws, *depthPrepass, options.depthPrepass, visibility);
+            gpuProfiler->EndSection();
+        }
+        else if (deferred)
+        {
+            deferredRenderer->Resize(framebufferWidth, framebufferHeight);
+            deferredRenderer->BeginGeometryPass(clearColor);
+
+            if (options.depthPrepass)
+            {
+                gpuProfiler->BeginSection("depth pre-pass");
+                depthPrepass->Submit(drawList->draws, visibility);
+                gpuProfiler->EndSection();
+            }
+
+            gpuProfiler->BeginSection("geometry", true);
+            drawStats = SubmitDrawList(drawList->draws, materialBuffer, *textureCache, visibility);
+            gpuProfiler->EndSection();
+
+            if (options.depthPrepass)
+            {
+                depthPrepass->EndShadingPass();
+            }
+
+            // the light accumulation target holds only the ambient term until the lights are added
+            if (ambientOcclusionPass && ambientOcclusionPass->IsEnabled())
+            {
+                gpuProfiler->BeginSection("ssao");
+                ambientOcclusionPass->RenderFromGBuffer(viewProjectionMatrix, deferredRenderer->GetDepthTexture(),
+                                                        deferredRenderer->GetNormalShininessTexture(), deferredRenderer->GetLightAccumulationFramebuffer());
+                gpuProfiler->EndSection();
+            }
+
+            gpuProfiler->BeginSection("lighting");
+            deferredRenderer->ShadeLights(lightBuffer, frame.unboundedLightCount);
+            gpuProfiler->EndSection();
+
+            gpuProfiler->BeginSection("present");
+            deferredRenderer->Present(antialiasingPass->GetFramebuffer());
+            gpuProfiler->EndSection();
+        }
+        else
+        {
+            // the scene shaders read the occlusion, so it needs a depth pass of its own before them
+            if (ambientOcclusionPass)
+            {
+                gpuProfiler->BeginSection("ssao depth");
+                ambientOcclusionPass->RenderDepth(drawList->draws, *depthPrepass, visibility);
+                gpuProfiler->EndSection();
+
+                gpuProfiler->BeginSection("ssao");
+                ambientOcclusionPass->Render(viewProjectionMatrix);
+                gpuProfiler->EndSection();
+            }
+
+            if (antialiasingPass)
+            {
+                antialiasingPass->Begin(clearColor);
+            }
+            else
+            {
+                glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+
+            if (options.depthPrepass)
+            {
+                gpuProfiler->BeginSection("depth pre-pass");
+                depthPrepass->Submit(drawList->draws, visibility);
+                gpuProfiler->EndSection();
+            }
+
+            if (environmentLighting)
+            {
+                environmentLighting->Bind();
+            }
+
+            // fragments passing the depth test are the ones paying for the full shading
+            gpuProfiler->BeginSection("scene", true);
+            drawStats = SubmitDrawList(drawList->draws, materialBuffer, *textureCache, visibility);
+            gpuProfiler->EndSection();
+
+            if (options.depthPrepass)
+            {
+                depthPrepass->EndShadingPass();
+            }
+        }
+
+        if (antialiasingPass && antialiasingPass->GetMode() != Antialiasing::Off)
+        {
+            gpuProfiler->BeginSection((antialiasingPass->GetMode() == Antialiasing::Msaa) ? "resolve" : "fxaa");
+            antialiasingPass->Resolve();
+            gpuProfiler->EndSection();
+        }
+
+        if (frameCapture)
+        {
+            gpuProfiler->BeginSection("capture");
+            frameCapture->CaptureFrame(framebufferWidth, framebufferHeight);
+            gpuProfiler->EndSection();
+        }
+
+        gpuProfiler->EndFrame();
+        streamingBuffer->EndFrame();
+
+        prepareMilliseconds += frame.prepareMilliseconds;
+        submitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitBeginTime).count();
+        ++reportFrameCount;
+
+        // report the state changes of one frame and the average frame times once per second
+        if (frame.time - lastStatsReportTime >= 1.0f)
+        {
+            const double frameIntervalMilliseconds = 1000.0 * (frame.time - lastStatsReportTime) / reportFrameCount;
+            lastStatsReportTime = frame.time;
+
+            std::cout << "draws: " << drawStats.drawCalls
+                      << ", program changes: " << drawStats.programChanges
+                      << ", vertex array changes: " << drawStats.vertexArrayChanges
+                      << ", material changes: " << drawStats.materialChanges
+                      << ", material window changes: " << drawStats.materialWindowChanges
+                      << ", texture changes: " << drawStats.textureChanges << std::endl;
+
+            if (clustered)
+            {
+                std::cout << "clusters: " << frame.clusterStats.lightIndexCount << " light indices, " << frame.clusterStats.maxLightsPerCluster
+                          << " max per cluster, binned in " << frame.clusterStats.milliseconds << " ms" << std::endl;
+            }
+
+            if (shadowMaps)
+            {
+                std::cout << "shadows: " << redrawnShadowCascades << " cascades redrawn with " << shadowCasterDraws << " caster draws in "
+                          << reportFrameCount << " frames" << std::endl;
+                redrawnShadowCascades = 0;
+                shadowCasterDraws = 0;
+            }
+
+            if (occlusionCulling != OcclusionCulling::Off)
+            {
+                const double gpuFrameMilliseconds = gpuProfiler->GetAverageMilliseconds("frame");
+
+                if (frame.occlusionCullingEnabled == false)
+                {
+                    unculledGpuFrameMilliseconds = gpuFrameMilliseconds;
+                }
+                else
+                {
+                    if (occlusionCuller)
+                    {
+                        const OcclusionStats& occlusionStats = occlusionCuller->GetStats();
+                        std::cout << "occlusion: " << occlusionStats.occludedDraws << " occluded, " << occlusionStats.frustumCulledDraws
+                                  << " outside the frustum of " << occlusionStats.testedDraws << " draws, cpu " << occlusionStats.milliseconds << " ms";
+                    }
+                    else
+                    {
+                        const SoftwareOcclusionStats& occlusionStats = frame.occlusionStats;
+                        std::cout << "occlusion: " << occlusionStats.occludedDraws << " occluded, " << occlusionStats.frustumCulledDraws
+                                  << " outside the frustum of " << occlusionStats.testedDraws << " draws, " << occlusionStats.rasterizedTriangles
+                                  << " occluder triangles rasterized in " << occlusionStats.rasterMilliseconds << " ms ("
+                                  << occlusionStats.occluderTriangles / std::max(occlusionStats.rasterMilliseconds, 1.0e-3) << " triangles/ms"
+                                  << (frame.occlusionUsingAvx2 ? ", avx2" : "") << "), tests " << occlusionStats.testMilliseconds << " ms";
+                    }
+
+                    if (unculledGpuFrameMilliseconds > 0.0)
+                    {
+                        std::cout << ", net gpu frame gain " << unculledGpuFrameMilliseconds - gpuFrameMilliseconds << " ms";
+                    }
+                    std::cout << std::endl;
+                }
+            }
+
+            if (meshletCulling)
+            {
+                const double gpuFrameMilliseconds = gpuProfiler->GetAverageMilliseconds("frame");
+
+                if (frame.meshletCullingEnabled == false)
+                {
+                    unculledMeshletGpuFrameMilliseconds = gpuFrameMilliseconds;
+                }
+                else
+                {
+                    const MeshletCullStats& meshletStats = frame.meshletStats;
+                    const unsigned int culledClusters = meshletStats.frustumCulledClusters + meshletStats.backFacingClusters;
+                    std::cout << "meshlets: " << culledClusters << " of " << meshletStats.testedClusters << " culled ("
+                              << 100.0 * culledClusters / std::max(meshletStats.testedClusters, 1u) << "%), " << meshletStats.frustumCulledClusters
+                              << " outside the frustum, " << meshletStats.backFacingClusters << " back-facing, "
+                              << 100.0 * meshletStats.culledTriangles / std::max(meshletStats.testedTriangles, 1ull) << "% of triangles culled, "
+                              << meshletStats.drawRanges << " multi-draw ranges, cpu " << meshletStats.milliseconds << " ms on "
+                              << jobSystem.GetThreadCount() << " threads" << (frame.meshletsUsingAvx2 ? " with avx2" : "");
+                    if (unculledMeshletGpuFrameMilliseconds > 0.0)
+                    {
+                        std::cout << ", net gpu frame gain " << unculledMeshletGpuFrameMilliseconds - gpuFrameMilliseconds << " ms";
+                    }
+                    std::cout << std::endl;
+                }
+            }
+
+            if (softwareRenderer)
+            {
+                // the frame is still in the back buffer until the swap below
+                std::vector<unsigned char> frameImage(static_cast<std::size_t>(framebufferWidth) * framebufferHeight * 4);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                glReadBuffer(GL_BACK);
+                glReadPixels(0, 0, framebufferWidth, framebufferHeight, GL_RGBA, GL_UNSIGNED_BYTE, frameImage.data());
+
+                softwareRenderer->Render(drawList->draws, frame.frameUniforms, frame.lights, clearColor);
+
+                const SoftwareRenderStats& softwareStats = softwareRenderer->GetStats();
+                const ImageDifference difference = CompareImages(softwareRenderer->GetImage(), frameImage, softwareImageTolerance);
+                std::cout << "software renderer: " << softwareStats.milliseconds << " ms on " << softwareRenderer->GetThreadCount() << " threads"
+                          << (softwareRenderer->IsUsingAvx2() ? " with avx2" : "") << ", "
+                          << softwareStats.triangles / std::max(softwareStats.milliseconds, 1.0e-3) / 1000.0 << " Mtris/s, max difference "
+                          << difference.maxDifference << ", mean " << difference.meanDifference << ", "
+                          << difference.differingPixelFraction * 100.0 << "% of pixels off by more than " << softwareImageTolerance << std::endl;
+            }
+
+            if (antialiasingPass)
+            {
+                const std::string description = antialiasingPass->GetDescription();
+
+                // an interval that switched modes mixes their costs
+                if (antialiasingModeChanged == false)
+                {
+                    const double gpuFrameMilliseconds = gpuProfiler->GetAverageMilliseconds("frame");
+                    const auto sameMode = [&description](const std::pair<std::string, double>& cost)
+                    {
+                        return cost.first == description;
+                    };
+
+                    auto entry = std::find_if(antialiasingFrameMilliseconds.begin(), antialiasingFrameMilliseconds.end(), sameMode);
+                    if (entry == antialiasingFrameMilliseconds.end())
+                    {
+                        antialiasingFrameMilliseconds.push_back({description, gpuFrameMilliseconds});
+                    }
+                    else
+                    {
+                        entry->second = gpuFrameMilliseconds;
+                    }
+                }
+                antialiasingModeChanged = false;
+
+                if (antialiasingPass->GetMode() != Antialiasing::Off || antialiasingFrameMilliseconds.size() > 1)
+                {
+                    std::cout << "antialiasing: " << description;
+                    if (antialiasingPass->GetMode() != Antialiasing::Off)
+                    {
+                        const char* section = (antialiasingPass->GetMode() == Antialiasing::Msaa) ? "resolve" : "fxaa";
+                        std::cout << ", " << section << " " << gpuProfiler->GetAverageMilliseconds(section) << " ms";
+                    }
+
+                    const char* separator = ", gpu frame per mode: ";
+                    for (const auto& cost : antialiasingFrameMilliseconds)
+                    {
+                        std::cout << separator << cost.first << " " << cost.second << " ms";
+                        separator = ", ";
+                    }
+                    std::cout << std::endl;
+                }
+            }
+
+            if (frameCapture)
+            {
+                const FrameCaptureStats captureStats = frameCapture->ConsumeStats();
+                std::cout << "capture: " << captureStats.capturedFrames << " frames, " << captureStats.droppedFrames << " dropped, "
+                          << captureStats.encodedFrames << " encoded, readback latency " << captureStats.averageLatencyMilliseconds << " ms ("
+                          << captureStats.averageLatencyFrames << " frames)" << std::endl;
+            }
+
+            std::cout << "jobs: ";
+            PrintJobStats(jobSystem.ConsumeStats());
+
+            const StreamingBufferStats streamingStats = streamingBuffer->ConsumeStats();
+            std::cout << "streaming: " << streamingStats.bytes / 1024.0 / std::max(streamingStats.frames, 1u) << " KB per frame, "
+                      << streamingStats.stalls << " stalls (" << streamingStats.stallMilliseconds << " ms), "
+                      << (streamingBuffer->IsPersistent() ? "persistent" : "unsynchronized") << " mapping, "
+                      << streamingBuffer->GetRegionSize() / 1024 << " KB per region";
+            if (streamingStats.growths > 0)
+            {
+                std::cout << " after growing " << streamingStats.growths << " times";
+            }
+            std::cout << std::endl;
+
+            const GpuBufferPoolStats poolStats = geometryPool->GetStats();
+            const double megabyte = 1024.0 * 1024.0;
+            std::cout << "geometry: " << poolStats.usedBytes / megabyte << " MB used by " << poolStats.allocationCount << " allocations in "
+                      << poolStats.bufferCount << " buffers of " << poolStats.capacityBytes / megabyte << " MB, " << poolStats.paddingBytes / megabyte
+                      << " MB padding, " << poolStats.freeBytes / megabyte << " MB free of which " << poolStats.fragmentedBytes / megabyte
+                      << " MB fragmented, " << poolStats.defragmentations << " defragmentations moved " << poolStats.movedBytes / megabyte << " MB"
+                      << std::endl;
+
+            // GL_SAMPLES_PASSED counts samples, so multisampled targets report fragments per sample
+            const int samplesPerPixel = antialiasingPass ? antialiasingPass->GetSampleCount() : std::max(windowSamples, 1);
+
+            // with the render thread a frame takes about the longer of preparing and submitting it instead of their sum
+            const RenderThreadStats threadStats = renderThread->ConsumeStats();
+            std::cout << "cpu: frame every " << frameIntervalMilliseconds << " ms, prepared in " << prepareMilliseconds / reportFrameCount
+                      << " ms, submitted in " << submitMilliseconds / reportFrameCount << " ms";
+            if (renderThread->IsThreaded())
+            {
+                std::cout << " on the render thread, waits per frame: main " << threadStats.mainWaitMilliseconds / reportFrameCount << " ms, render "
+                          << threadStats.renderWaitMilliseconds / reportFrameCount << " ms";
+            }
+            std::cout << ", ";
+            gpuProfiler->Report(std::cout, static_cast<unsigned int>(framebufferWidth * framebufferHeight * samplesPerPixel));
+
+            prepareMilliseconds = 0.0;
+            submitMilliseconds = 0.0;
+            reportFrameCount = 0;
+        }
+
+        glfwSwapBuffers(windowHandle);
+
+        if (firstFramePresented == false)
+        {
+            firstFramePresented = true;
+
+            const double startupMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBeginTime).count();
+            std::cout << "startup: first frame presented after " << startupMilliseconds << " ms" << std::endl;
+        }
+    };
+
+    renderThread.reset(new RenderThread{windowHandle, renderFrame, options.renderThread});
+    renderThread->PublishDrawList(drawList);
+
+    // state of the main thread
     float lastFrameTime = 0.0f;
 
+    // O toggles occlusion culling
+    bool occlusionCullingEnabled = true;
+    bool occlusionToggleKeyDown = false;
+
+    // C toggles meshlet culling
+    bool meshletCullingEnabled = true;
+    bool meshletToggleKeyDown = false;
+
+    // K toggles ambient occlusion
+    bool ambientOcclusionKeyDown = false;
+
+    // M switches the antialiasing mode
+    bool antialiasingKeyDown = false;
+
     while (glfwWindowShouldClose(windowHandle) == false)
     {
+        // waits while the render thread still submits the frame before the last one
+        FrameSnapshot& frame = renderThread->BeginFrame();
+
+        const auto prepareBeginTime = std::chrono::steady_clock::now();
+
         float currentFrameTime = static_cast<float>(glfwGetTime());
         float deltaTime = currentFrameTime - lastFrameTime;
         lastFrameTime = currentFrameTime;
 
         ProcessInput(windowHandle, cameraDistanceFromTarget, cameraAzimuth, cameraElevation, deltaTime);
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const bool occlusionToggleKeyPressed = glfwGetKey(windowHandle, GLFW_KEY_O) == GLFW_PRESS;
+        if (occlusionCulling != OcclusionCulling::Off && occlusionToggleKeyPressed && occlusionToggleKeyDown == false)
+        {
+            occlusionCullingEnabled = !occlusionCullingEnabled;
+            std::cout << "occlusion culling " << (occlusionCullingEnabled ? "on" : "off") << std::endl;
+        }
+        occlusionToggleKeyDown = occlusionToggleKeyPressed;
+
+        const bool meshletToggleKeyPressed = glfwGetKey(windowHandle, GLFW_KEY_C) == GLFW_PRESS;
+        if (meshletCuller && meshletToggleKeyPressed && meshletToggleKeyDown == false)
+        {
+            meshletCullingEnabled = !meshletCullingEnabled;
+            std::cout << "meshlet culling " << (meshletCullingEnabled ? "on" : "off") << std::endl;
+        }
+        meshletToggleKeyDown = meshletToggleKeyPressed;
+
+        const bool ambientOcclusionKeyPressed = glfwGetKey(windowHandle, GLFW_KEY_K) == GLFW_PRESS;
+        frame.toggleAmbientOcclusion = ambientOcclusionPass && ambientOcclusionKeyPressed && ambientOcclusionKeyDown == false;
+        ambientOcclusionKeyDown = ambientOcclusionKeyPressed;
 
-        glUseProgram(shaderProgram);
+        const bool antialiasingKeyPressed = glfwGetKey(windowHandle, GLFW_KEY_M) == GLFW_PRESS;
+        frame.switchAntialiasing = antialiasingPass && antialiasingKeyPressed && antialiasingKeyDown == false;
+        antialiasingKeyDown = antialiasingKeyPressed;
+
+        // the meshlets and occluders of a finer version are built here, the render thread uploads it with this frame
+        Model finerModel;
+        bool modelChanged = false;
+        try
+        {
+            modelChanged = modelLoader && modelLoader->TakeNewerModel(finerModel);
+        }
+        catch (const std::exception& error)
+        {
+            // the loader thread forwards every exception, std::stoi's and failed allocations included
+            std::cerr << "failed to load the complete model, keeping the coarser version: " << error.what() << std::endl;
+            modelLoader.reset();
+        }
+
+        frame.newModel.reset();
+        if (modelChanged)
+        {
+            if (meshletCuller)
+            {
+                meshletCuller.reset(new MeshletCuller{BuildMeshlets(finerModel), jobSystem, true});
+            }
+            if (softwareOcclusion)
+            {
+                softwareOcclusion.reset(new SoftwareOcclusionBuffer{CreateOccluderTriangles(finerModel.vertices, occluderTriangleBudget), jobSystem, true});
+            }
 
-        glm::mat4 modelMatrix = glm::mat4{1.0f};
+            CalculateModelBounds(finerModel, boundsMin, boundsMax);
+            lightRig = CreateLightRig(lightPos, lightColor, options.lightCount, boundsMin, boundsMax);
+
+            model = std::make_shared<const Model>(std::move(finerModel));
+            frame.newModel = model;
+
+            reportModel();
+            if (modelLoader->IsComplete())
+            {
+                modelLoader.reset();
+            }
+        }
+
+        int framebufferWidth = 0;
+        int framebufferHeight = 0;
+        glfwGetFramebufferSize(windowHandle, &framebufferWidth, &framebufferHeight);
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+        {
+            aspectRatio = static_cast<float>(framebufferWidth) / static_cast<float>(framebufferHeight);
+        }
+
+        AnimateLightRig(lightRig, currentFrameTime);
 
         glm::vec3 cameraPos = CalculateCameraPosition(cameraDistanceFromTarget, cameraAzimuth, cameraElevation, cameraTarget);
         glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraTarget, cameraUp);
-        
+
         glm::mat4 projectionMatrix = glm::perspective(fov, aspectRatio, distanceToNearPlane, distanceToFarPlane);
 
-        glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-        glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+        frame.time = currentFrameTime;
+        frame.framebufferWidth = framebufferWidth;
+        frame.framebufferHeight = framebufferHeight;
+        frame.cameraPos = cameraPos;
+        frame.viewMatrix = viewMatrix;
+        frame.projectionMatrix = projectionMatrix;
+        frame.aspectRatio = aspectRatio;
+        frame.boundsMin = boundsMin;
+        frame.boundsMax = boundsMax;
+        frame.lights = lightRig.lights;
+        frame.unboundedLightCount = lightRig.unboundedLightCount;
+
+        FrameUniforms& frameUniforms = frame.frameUniforms;
+        frameUniforms.viewMatrix = viewMatrix;
+        frameUniforms.projectionMatrix = projectionMatrix;
+        frameUniforms.inverseViewProjectionMatrix = glm::inverse(projectionMatrix * viewMatrix);
+        frameUniforms.cameraPos = glm::vec4{cameraPos, 1.0f};
+        frameUniforms.viewportSize = glm::vec4{static_cast<float>(framebufferWidth), static_cast<float>(framebufferHeight),
+                                               1.0f / std::max(framebufferWidth, 1), 1.0f / std::max(framebufferHeight, 1)};
+        frameUniforms.lightCounts = glm::uvec4{static_cast<unsigned int>(lightRig.lights.size()), lightRig.unboundedLightCount, 0, 0};
+        if (clustered)
+        {
+            lightClusters->Build(lightRig.lights, lightRig.unboundedLightCount, viewMatrix, fov, aspectRatio, distanceToNearPlane, distanceToFarPlane,
+                                 frame.clusterLights);
+            frame.clusterStats = lightClusters->GetStats();
+
+            frameUniforms.clusterDepthParams = lightClusters->GetDepthSliceParams();
+            frameUniforms.clusterCounts = glm::uvec4{ClusterCountX, ClusterCountY, ClusterCountZ, 0};
+        }
+        else
+        {
+            frameUniforms.clusterDepthParams = glm::vec4{0.0f};
+            frameUniforms.clusterCounts = glm::uvec4{0, 0, 0, 0};
+        }
+
+        // culls against the render thread's latest draw list, unless that was built from an older version of the model
+        const std::shared_ptr<const SceneDrawList> culledDrawList = renderThread->GetDrawList();
+        frame.culledDrawList.reset();
+        frame.hasVisibleDraws = false;
+        frame.hasDrawRanges = false;
+        frame.occlusionCullingEnabled = occlusionCullingEnabled;
+        frame.meshletCullingEnabled = meshletCullingEnabled;
+        frame.occlusionStats = SoftwareOcclusionStats{};
+        frame.meshletStats = MeshletCullStats{};
+        if (culledDrawList->model == model)
+        {
+            DrawVisibility visibility;
+            if (softwareOcclusion && occlusionCullingEnabled)
+            {
+                softwareOcclusion->RenderOccluders(projectionMatrix * viewMatrix);
+                visibility = softwareOcclusion->Cull(culledDrawList->draws, projectionMatrix * viewMatrix);
 
-        glUniform3fv(lightPosLocation, 1, glm::value_ptr(lightPos));
-        glUniform3fv(lightColorLocation, 1, glm::value_ptr(lightColor));
-        glUniform3fv(cameraPosLocation, 1, glm::value_ptr(cameraPos));
-        glUniform3fv(ambientColorLocation, 1, glm::value_ptr(ambientColor));
-        glUniform3fv(diffuseColorLocation, 1, glm::value_ptr(diffuseColor));
-        glUniform3fv(specularColorLocation, 1, glm::value_ptr(specularColor));
-        glUniform1f(shininessValueLocation, shininessValue);
+                frame.occlusionStats = softwareOcclusion->GetStats();
+                frame.occlusionUsingAvx2 = softwareOcclusion->IsUsingAvx2();
+            }
 
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
-        glBindVertexArray(0);
+            // whole draws culled above have no meshlets left to test
+            if (meshletCuller && meshletCullingEnabled)
+            {
+                visibility = meshletCuller->Cull(culledDrawList->draws, visibility, projectionMatrix * viewMatrix, cameraPos);
+
+                frame.meshletStats = meshletCuller->GetStats();
+                frame.meshletsUsingAvx2 = meshletCuller->IsUsingAvx2();
+            }
+
+            // the cullers reuse their storage next frame, the snapshot keeps copies
+            frame.culledDrawList = culledDrawList;
+            frame.hasVisibleDraws = visibility.visibleDraws != nullptr;
+            if (frame.hasVisibleDraws)
+            {
+                frame.visibleDraws = *visibility.visibleDraws;
+            }
+            frame.hasDrawRanges = visibility.drawRanges != nullptr;
+            if (frame.hasDrawRanges)
+            {
+                frame.drawRanges = *visibility.drawRanges;
+            }
+        }
+
+        frame.prepareMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - prepareBeginTime).count();
+        renderThread->Publish();
 
-        glfwSwapBuffers(windowHandle);
         glfwPollEvents();
     }
 
+    // the last frames are submitted and the context returns to this thread for the cleanup
+    renderThread.reset();
+
     glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteProgram(shaderProgram);
+    geometryPool->Free(vertexAllocation);
+
+    modelLoader.reset();
+    frameCapture.reset();
+    gpuProfiler.reset();
+    softwareRenderer.reset();
+    antialiasingPass.reset();
+    ambientOcclusionPass.reset();
+    environmentLighting.reset();
+    shadowMaps.reset();
+    occlusionCuller.reset();
+    softwareOcclusion.reset();
+    meshletCuller.reset();
+    deferredRenderer.reset();
+    overdrawView.reset();
+    depthPrepass.reset();
+    geometryPool.reset();
+    lightClusters.reset();
+    DestroyLightBuffer(lightBuffer);
+    streamingBuffer.reset();
+    DestroyMaterialBuffer(materialBuffer);
+    sceneShaders.reset();
+    textureCache.reset();
 
     glfwDestroyWindow(windowHandle);
     glfwTerminate();
@@ -276,11 +1381,6 @@ int main()
     return 0;
 }
 
-void FramebufferSizeCallback(GLFWwindow*, int width, int height)
-{
-    glViewport(0, 0, width, height);
-}
-
 void ProcessInput(GLFWwindow* windowHandle, float& distanceFromTarget, float& azimuth, float& elevation, float deltaTime)
 {
     if (glfwGetKey(windowHandle, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -349,77 +1449,352 @@ glm::vec3 CalculateCameraPosition(float distanceFromTarget, float azimuth, float
     return target + glm::vec3{x, y, z};
 }
 
+// one draw per submesh, sorted so draws sharing a program and material are adjacent
+std::vector<DrawCommand> BuildDrawList(const Model& model, unsigned int vao, ShaderPermutationSet& shaders,
+                                       const std::vector<ShaderPermutation>& materialPermutations, const std::vector<TextureHandle>& materialTextures)
+{
+    std::vector<DrawCommand> drawList;
+    for (const auto& submesh : model.submeshes)
+    {
+        const unsigned int shaderProgram = shaders.GetProgram(materialPermutations[submesh.materialIndex]);
+
+        drawList.push_back(MakeDrawCommand(shaderProgram, 0, vao, submesh.materialIndex, materialTextures[submesh.materialIndex],
+                                           static_cast<int>(submesh.firstVertex), static_cast<int>(submesh.vertexCount),
+                                           submesh.boundsMin, submesh.boundsMax));
+    }
+    SortDrawList(drawList);
+
+    return drawList;
+}
+
+// axis-aligned box around every vertex of the model
+void CalculateModelBounds(const Model& model, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    boundsMin = model.vertices.empty() ? glm::vec3{0.0f} : model.vertices[0].position;
+    boundsMax = boundsMin;
+    for (const auto& vertex : model.vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+}
 
- // Loads a 3D model from an OBJ file
- // Handles OBJ files with vertex positions (v) and normals (vn).
-std::vector<Vertex> LoadObjFile(const std::string& filepath)
+// one draw per submesh without any GL objects, for the modes that run without a window
+std::vector<DrawCommand> BuildHeadlessDrawList(const Model& model)
 {
-    std::ifstream file{filepath};
-    if (file.is_open() == false)
+    std::vector<DrawCommand> drawList;
+    for (const auto& submesh : model.submeshes)
     {
-        throw std::runtime_error{"Failed to open OBJ file"};
+        drawList.push_back(MakeDrawCommand(0, 0, 0, submesh.materialIndex, InvalidTextureHandle, static_cast<int>(submesh.firstVertex),
+                                           static_cast<int>(submesh.vertexCount), submesh.boundsMin, submesh.boundsMax));
+    }
+
+    return drawList;
+}
+
+// prints the jobs run and stolen and the utilization of every worker, then of the threads that are not workers
+void PrintJobStats(const std::vector<JobThreadStats>& threadStats)
+{
+    unsigned long long executedJobs = 0;
+    unsigned long long stolenJobs = 0;
+    for (const JobThreadStats& stats : threadStats)
+    {
+        executedJobs += stats.executedJobs;
+        stolenJobs += stats.stolenJobs;
+    }
+
+    std::cout << executedJobs << " run, " << stolenJobs << " stolen, utilization";
+    for (std::size_t i = 0; i < threadStats.size(); ++i)
+    {
+        std::cout << (i + 1 == threadStats.size() ? " | " : " ") << static_cast<int>(threadStats[i].utilization * 100.0 + 0.5) << "%";
+    }
+    std::cout << std::endl;
+}
+
+// renders the occluders of the model from a circle of viewpoints, with and without AVX2 and on one
+// and on every hardware thread, needs no window or GL context
+void RunOcclusionBenchmark(const Model& model)
+{
+    const std::vector<DrawCommand> drawList = BuildHeadlessDrawList(model);
+
+    const std::vector<glm::vec3> occluderTriangles = CreateOccluderTriangles(model.vertices, occluderTriangleBudget);
+
+    const unsigned int viewCount = 360;
+    const glm::mat4 projectionMatrix = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+    std::cout << "occlusion benchmark: " << occluderTriangles.size() / 3 << " occluder triangles, " << drawList.size() << " draws, "
+              << SoftwareOcclusionWidth << "x" << SoftwareOcclusionHeight << " buffer, " << viewCount << " views" << std::endl;
+
+    std::vector<unsigned int> threadCounts{1};
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+
+    for (const bool useAvx2 : {true, false})
+    {
+        if (useAvx2 && IsAvx2Supported() == false)
+        {
+            continue;
+        }
+
+        for (const unsigned int threadCount : threadCounts)
+        {
+            JobSystem jobSystem{threadCount};
+            SoftwareOcclusionBuffer occlusionBuffer{occluderTriangles, jobSystem, useAvx2};
+
+            double rasterMilliseconds = 0.0;
+            double testMilliseconds = 0.0;
+            unsigned long long rasterizedTriangles = 0;
+            unsigned long long occludedDraws = 0;
+            for (unsigned int view = 0; view < viewCount; ++view)
+            {
+                const float azimuth = glm::radians(static_cast<float>(view));
+                const glm::vec3 cameraPos = CalculateCameraPosition(5.0f, azimuth, 0.3f, glm::vec3{0.0f});
+                const glm::mat4 viewProjectionMatrix = projectionMatrix * glm::lookAt(cameraPos, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+
+                occlusionBuffer.RenderOccluders(viewProjectionMatrix);
+                occlusionBuffer.Cull(drawList, viewProjectionMatrix);
+
+                rasterMilliseconds += occlusionBuffer.GetStats().rasterMilliseconds;
+                testMilliseconds += occlusionBuffer.GetStats().testMilliseconds;
+                rasterizedTriangles += occlusionBuffer.GetStats().rasterizedTriangles;
+                occludedDraws += occlusionBuffer.GetStats().occludedDraws;
+            }
+
+            std::cout << (useAvx2 ? "avx2" : "scalar") << ", " << threadCount << (threadCount == 1 ? " thread: " : " threads: ")
+                      << occluderTriangles.size() / 3 * viewCount / std::max(rasterMilliseconds, 1.0e-3) << " triangles/ms, "
+                      << rasterMilliseconds / viewCount << " ms per view (" << rasterizedTriangles / viewCount << " triangles rasterized), tests "
+                      << testMilliseconds / viewCount << " ms, " << static_cast<double>(occludedDraws) / viewCount << " draws occluded" << std::endl;
+        }
     }
+}
 
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
+// builds the model's meshlets and culls them from a circle of viewpoints, with and without AVX2 and on
+// one and on every hardware thread, needs no window or GL context
+void RunMeshletBenchmark(Model model)
+{
+    const auto buildBeginTime = std::chrono::steady_clock::now();
+    const std::vector<Meshlet> meshlets = BuildMeshlets(model);
+    const double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildBeginTime).count();
+
+    const std::vector<DrawCommand> drawList = BuildHeadlessDrawList(model);
 
-    std::vector<Vertex> vertices;
+    const unsigned int viewCount = 360;
+    const glm::mat4 projectionMatrix = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
 
-    std::string line;
-    while (std::getline(file, line))
+    std::cout << "meshlet benchmark: " << model.vertices.size() / 3 << " triangles in " << meshlets.size() << " meshlets ("
+              << static_cast<double>(model.vertices.size()) / 3.0 / std::max<std::size_t>(meshlets.size(), 1) << " triangles each), built in "
+              << buildMilliseconds << " ms, " << viewCount << " views" << std::endl;
+
+    std::vector<unsigned int> threadCounts{1};
+    if (std::thread::hardware_concurrency() > 1)
     {
-        if (line.empty() || line[0] == '#')
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+
+    for (const bool useAvx2 : {true, false})
+    {
+        if (useAvx2 && IsAvx2Supported() == false)
         {
             continue;
         }
 
-        std::istringstream lineStream{line};
-        
-        std::string prefix;
-        lineStream >> prefix;
-        if (prefix == "v")
+        for (const unsigned int threadCount : threadCounts)
         {
-            glm::vec3 position;
+            JobSystem jobSystem{threadCount};
+            MeshletCuller culler{meshlets, jobSystem, useAvx2};
+
+            double milliseconds = 0.0;
+            unsigned long long culledClusters = 0;
+            unsigned long long culledTriangles = 0;
+            unsigned long long drawRanges = 0;
+            for (unsigned int view = 0; view < viewCount; ++view)
+            {
+                const float azimuth = glm::radians(static_cast<float>(view));
+                const glm::vec3 cameraPos = CalculateCameraPosition(5.0f, azimuth, 0.3f, glm::vec3{0.0f});
+                const glm::mat4 viewProjectionMatrix = projectionMatrix * glm::lookAt(cameraPos, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
 
-            lineStream >> position.x;
-            lineStream >> position.y;
-            lineStream >> position.z;
+                culler.Cull(drawList, DrawVisibility{}, viewProjectionMatrix, cameraPos);
 
-            positions.push_back(position);
+                const MeshletCullStats& stats = culler.GetStats();
+                milliseconds += stats.milliseconds;
+                culledClusters += stats.frustumCulledClusters + stats.backFacingClusters;
+                culledTriangles += stats.culledTriangles;
+                drawRanges += stats.drawRanges;
+            }
+
+            std::cout << (useAvx2 ? "avx2" : "scalar") << ", " << threadCount << (threadCount == 1 ? " thread: " : " threads: ") << milliseconds / viewCount
+                      << " ms per view, " << 100.0 * culledClusters / std::max<std::size_t>(meshlets.size() * viewCount, 1) << "% of meshlets and "
+                      << 100.0 * culledTriangles / std::max<std::size_t>(model.vertices.size() / 3 * viewCount, 1) << "% of triangles culled, "
+                      << static_cast<double>(drawRanges) / viewCount << " multi-draw ranges" << std::endl;
+        }
+    }
+}
+
+// runs the job-based culling of the viewer and batches of empty jobs on 1, 2, 4... threads up to every
+// hardware thread, reporting the speedup over one thread and the utilization of every worker; needs no
+// window or GL context
+void RunJobBenchmark(Model model)
+{
+    const std::vector<Meshlet> meshlets = BuildMeshlets(model);
+    const std::vector<DrawCommand> drawList = BuildHeadlessDrawList(model);
+    const std::vector<glm::vec3> occluderTriangles = CreateOccluderTriangles(model.vertices, occluderTriangleBudget);
+
+    const unsigned int viewCount = 360;
+    const std::size_t emptyJobCount = 4096;
+    const glm::mat4 projectionMatrix = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+    std::vector<unsigned int> threadCounts;
+    const unsigned int hardwareThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threadCount = 1; threadCount < hardwareThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(hardwareThreadCount);
+
+    std::cout << "job benchmark: " << model.vertices.size() / 3 << " triangles in " << meshlets.size() << " meshlets, "
+              << occluderTriangles.size() / 3 << " occluder triangles, " << emptyJobCount << " empty jobs, " << viewCount << " views" << std::endl;
+
+    double baselineCullMilliseconds = 0.0;
+    double baselineOcclusionMilliseconds = 0.0;
+    for (const unsigned int threadCount : threadCounts)
+    {
+        JobSystem jobSystem{threadCount};
+        MeshletCuller culler{meshlets, jobSystem, true};
+        SoftwareOcclusionBuffer occlusionBuffer{occluderTriangles, jobSystem, true};
+        jobSystem.ConsumeStats();
+
+        double cullMilliseconds = 0.0;
+        double occlusionMilliseconds = 0.0;
+        double emptyJobMilliseconds = 0.0;
+        for (unsigned int view = 0; view < viewCount; ++view)
+        {
+            const float azimuth = glm::radians(static_cast<float>(view));
+            const glm::vec3 cameraPos = CalculateCameraPosition(5.0f, azimuth, 0.3f, glm::vec3{0.0f});
+            const glm::mat4 viewProjectionMatrix = projectionMatrix * glm::lookAt(cameraPos, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+
+            const auto cullBeginTime = std::chrono::steady_clock::now();
+            culler.Cull(drawList, DrawVisibility{}, viewProjectionMatrix, cameraPos);
+            const auto occlusionBeginTime = std::chrono::steady_clock::now();
+            occlusionBuffer.RenderOccluders(viewProjectionMatrix);
+            const auto emptyJobBeginTime = std::chrono::steady_clock::now();
+            jobSystem.ParallelFor(emptyJobCount, 1, [](std::size_t, std::size_t) {});
+            const auto endTime = std::chrono::steady_clock::now();
+
+            cullMilliseconds += std::chrono::duration<double, std::milli>(occlusionBeginTime - cullBeginTime).count();
+            occlusionMilliseconds += std::chrono::duration<double, std::milli>(emptyJobBeginTime - occlusionBeginTime).count();
+            emptyJobMilliseconds += std::chrono::duration<double, std::milli>(endTime - emptyJobBeginTime).count();
         }
-        else if (prefix == "vn")
+
+        if (threadCount == 1)
         {
-            glm::vec3 normal;
+            baselineCullMilliseconds = cullMilliseconds;
+            baselineOcclusionMilliseconds = occlusionMilliseconds;
+        }
+
+        std::cout << threadCount << (threadCount == 1 ? " thread: " : " threads: ") << "meshlet culling " << cullMilliseconds / viewCount
+                  << " ms per view (" << baselineCullMilliseconds / std::max(cullMilliseconds, 1.0e-6) << "x), occluders "
+                  << occlusionMilliseconds / viewCount << " ms (" << baselineOcclusionMilliseconds / std::max(occlusionMilliseconds, 1.0e-6)
+                  << "x), " << emptyJobMilliseconds * 1.0e6 / (static_cast<double>(emptyJobCount) * viewCount) << " ns per empty job" << std::endl;
+        std::cout << "  jobs: ";
+        PrintJobStats(jobSystem.ConsumeStats());
+    }
+}
+
+// renders the viewer's first frame on the CPU on 1, 2, 4... threads up to every hardware thread, with and
+// without AVX2, and writes the image as PNG; needs no window or GL context
+void RunSoftwareRender(const Model& model, unsigned int lightCount, const std::string& imagePath)
+{
+    const std::vector<DrawCommand> drawList = BuildHeadlessDrawList(model);
 
-            lineStream >> normal.x;
-            lineStream >> normal.y;
-            lineStream >> normal.z;
+    const int imageWidth = 800;
+    const int imageHeight = 600;
+    const unsigned int frameCount = 20;
+
+    // the same camera, key light and light rig as the viewer starts with
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    CalculateModelBounds(model, boundsMin, boundsMax);
+    const LightRig lightRig = CreateLightRig(glm::vec3{2.0f, 3.0f, 2.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, lightCount, boundsMin, boundsMax);
+
+    const glm::vec3 cameraPos = CalculateCameraPosition(5.0f, 0.0f, 0.0f, glm::vec3{0.0f});
+
+    FrameUniforms frameUniforms = FrameUniforms();
+    frameUniforms.viewMatrix = glm::lookAt(cameraPos, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    frameUniforms.projectionMatrix = glm::perspective(glm::radians(45.0f), static_cast<float>(imageWidth) / static_cast<float>(imageHeight), 0.1f, 100.0f);
+    frameUniforms.inverseViewProjectionMatrix = glm::inverse(frameUniforms.projectionMatrix * frameUniforms.viewMatrix);
+    frameUniforms.cameraPos = glm::vec4{cameraPos, 1.0f};
+    frameUniforms.viewportSize = glm::vec4{static_cast<float>(imageWidth), static_cast<float>(imageHeight), 1.0f / imageWidth, 1.0f / imageHeight};
+
+    const glm::vec4 clearColor{0.2f, 0.3f, 0.3f, 1.0f};
+
+    std::vector<unsigned int> threadCounts;
+    const unsigned int hardwareThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threadCount = 1; threadCount < hardwareThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(hardwareThreadCount);
 
-            normals.push_back(normal);
+    std::cout << "software renderer: " << model.vertices.size() / 3 << " triangles, " << drawList.size() << " draws, " << lightRig.lights.size()
+              << " lights, " << imageWidth << "x" << imageHeight << ", " << frameCount << " frames per run" << std::endl;
+
+    bool imageWritten = false;
+    for (const bool useAvx2 : {true, false})
+    {
+        if (useAvx2 && IsAvx2Supported() == false)
+        {
+            continue;
         }
-        else if (prefix == "f")
+
+        for (const unsigned int threadCount : threadCounts)
         {
-            std::string vertex0;
-            std::string vertex1;
-            std::string vertex2;
+            JobSystem jobSystem{threadCount};
+            SoftwareRenderer renderer{model, jobSystem, useAvx2};
+
+            // the first frame sizes the bins and the image
+            renderer.Render(drawList, frameUniforms, lightRig.lights, clearColor);
+            jobSystem.ConsumeStats();
+
+            SoftwareRenderStats total;
+            for (unsigned int frame = 0; frame < frameCount; ++frame)
+            {
+                renderer.Render(drawList, frameUniforms, lightRig.lights, clearColor);
 
-            lineStream >> vertex0;
-            lineStream >> vertex1;
-            lineStream >> vertex2;
+                const SoftwareRenderStats& stats = renderer.GetStats();
+                total.vertexMilliseconds += stats.vertexMilliseconds;
+                total.setupMilliseconds += stats.setupMilliseconds;
+                total.rasterMilliseconds += stats.rasterMilliseconds;
+                total.milliseconds += stats.milliseconds;
+            }
 
-            for (const auto& vertex : std::array<std::string, 3>{vertex0, vertex1, vertex2})
+            unsigned long long stolenJobs = 0;
+            for (const JobThreadStats& threadStats : jobSystem.ConsumeStats())
             {
-                const std::size_t separatorIndex = vertex.find("//");
+                stolenJobs += threadStats.stolenJobs;
+            }
 
-                const int positionIndex = std::stoi(vertex.substr(0, separatorIndex)) - 1;
-                const int normalIndex = std::stoi(vertex.substr(separatorIndex + 2)) - 1;
+            const SoftwareRenderStats& stats = renderer.GetStats();
+            std::cout << (useAvx2 ? "avx2" : "scalar") << ", " << threadCount << (threadCount == 1 ? " thread: " : " threads: ")
+                      << total.milliseconds / frameCount << " ms per frame, "
+                      << static_cast<double>(stats.triangles) * frameCount / std::max(total.milliseconds, 1.0e-3) / 1000.0 << " Mtris/s (vertex "
+                      << total.vertexMilliseconds / frameCount << " ms, setup " << total.setupMilliseconds / frameCount << " ms, raster "
+                      << total.rasterMilliseconds / frameCount << " ms), " << stats.rasterizedTriangles << " triangles rasterized, "
+                      << static_cast<double>(stolenJobs) / frameCount << " jobs stolen" << std::endl;
 
-                vertices.push_back(Vertex{positions[positionIndex], normals[normalIndex]});
+            if (imageWritten == false)
+            {
+                // rows are stored bottom first like glReadPixels
+                stbi_flip_vertically_on_write(1);
+                if (stbi_write_png(imagePath.c_str(), imageWidth, imageHeight, 4, renderer.GetImage().data(), imageWidth * 4) == 0)
+                {
+                    throw std::runtime_error{"failed to write " + imagePath};
+                }
+
+                std::cout << "image written to " << imagePath << std::endl;
+                imageWritten = true;
             }
         }
     }
-
-    file.close();
-
-    return vertices;
-}
\ No newline at end of file
+}
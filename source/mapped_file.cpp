@@ -0,0 +1,121 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filepath)
+    : data{nullptr},
+      size{0},
+      fileHandle{INVALID_HANDLE_VALUE},
+      mappingHandle{nullptr}
+{
+    fileHandle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error{"Failed to open " + filepath};
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+    if (size == 0)
+    {
+        return;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+    {
+        data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+
+    if (data == nullptr)
+    {
+        if (mappingHandle != nullptr)
+        {
+            CloseHandle(mappingHandle);
+        }
+        CloseHandle(fileHandle);
+        throw std::runtime_error{"Failed to map " + filepath};
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+        CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filepath)
+    : data{nullptr},
+      size{0}
+{
+    const int file = open(filepath.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error{"Failed to open " + filepath};
+    }
+
+    struct stat fileStatus;
+    if (fstat(file, &fileStatus) != 0)
+    {
+        close(file);
+        throw std::runtime_error{"Failed to read the size of " + filepath};
+    }
+
+    size = static_cast<std::size_t>(fileStatus.st_size);
+    if (size > 0)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(file);
+            throw std::runtime_error{"Failed to map " + filepath};
+        }
+
+        // loaders walk the file front to back once, start reading all of it ahead
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        madvise(mapping, size, MADV_WILLNEED);
+        data = static_cast<const unsigned char*>(mapping);
+    }
+
+    // the mapping keeps the file's pages alive without the descriptor
+    close(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+}
+
+#endif
+
+const unsigned char* MappedFile::GetData() const
+{
+    return data;
+}
+
+std::size_t MappedFile::GetSize() const
+{
+    return size;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file mapped into memory, so loaders parse binary
+// formats in place and the OS pages the file in at disk speed instead of the
+// loader copying it through a stream. Throws when the file can't be opened.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // null for an empty file
+    const unsigned char* GetData() const;
+    std::size_t GetSize() const;
+
+private:
+    const unsigned char* data;
+    std::size_t size;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
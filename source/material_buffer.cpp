@@ -0,0 +1,62 @@
+#include "material_buffer.h"
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+// std140 layout of MaterialData in the shaders
+struct GpuMaterial
+{
+    glm::vec4 ambientColor;   // w holds the metallic factor
+    glm::vec4 diffuseColor;   // w holds the roughness
+    glm::vec4 specularColor;  // w holds the shininess
+};
+
+static_assert(sizeof(GpuMaterial) == 48, "GpuMaterial must match the std140 MaterialData layout");
+
+} // namespace
+
+MaterialBuffer CreateMaterialBuffer(const std::vector<Material>& materials)
+{
+    // pad to whole windows so the last window can be bound with the full block size
+    const std::size_t windowCount = (materials.size() + MaterialsPerWindow - 1) / MaterialsPerWindow;
+
+    std::vector<GpuMaterial> gpuMaterials(std::max<std::size_t>(windowCount, 1) * MaterialsPerWindow);
+    for (std::size_t i = 0; i < materials.size(); ++i)
+    {
+        gpuMaterials[i].ambientColor = glm::vec4{materials[i].ambientColor, materials[i].metallic};
+        gpuMaterials[i].diffuseColor = glm::vec4{materials[i].diffuseColor, materials[i].roughness};
+        gpuMaterials[i].specularColor = glm::vec4{materials[i].specularColor, materials[i].shininessValue};
+    }
+
+    MaterialBuffer materialBuffer;
+    materialBuffer.materialCount = static_cast<unsigned int>(materials.size());
+
+    glGenBuffers(1, &materialBuffer.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer.buffer);
+    glBufferData(GL_UNIFORM_BUFFER, gpuMaterials.size() * sizeof(GpuMaterial), gpuMaterials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    BindMaterialWindow(materialBuffer, 0);
+
+    return materialBuffer;
+}
+
+void DestroyMaterialBuffer(MaterialBuffer& materialBuffer)
+{
+    glDeleteBuffers(1, &materialBuffer.buffer);
+
+    materialBuffer.buffer = 0;
+    materialBuffer.materialCount = 0;
+}
+
+void BindMaterialWindow(const MaterialBuffer& materialBuffer, unsigned int materialIndex)
+{
+    const unsigned int window = materialIndex / MaterialsPerWindow;
+    const GLsizeiptr windowBytes = MaterialsPerWindow * sizeof(GpuMaterial);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, MaterialBlockBinding, materialBuffer.buffer, window * windowBytes, windowBytes);
+}
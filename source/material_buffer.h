@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "model.h"
+
+// uniform block binding point of the Materials block in every shader program
+const unsigned int MaterialBlockBinding = 0;
+
+// materials visible to a draw at once, std140 arrays of MaterialData are 48 bytes
+// per element so a window is 12 KiB, under the 16 KiB minimum uniform block size
+// and a multiple of every common GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+const unsigned int MaterialsPerWindow = 256;
+
+// All materials of a scene packed into a single uniform buffer. Draws select
+// their material with an index into the currently bound window of the buffer.
+struct MaterialBuffer
+{
+    unsigned int buffer;
+    unsigned int materialCount;
+};
+
+MaterialBuffer CreateMaterialBuffer(const std::vector<Material>& materials);
+void DestroyMaterialBuffer(MaterialBuffer& materialBuffer);
+
+// binds the window of MaterialsPerWindow materials containing the given material
+void BindMaterialWindow(const MaterialBuffer& materialBuffer, unsigned int materialIndex);
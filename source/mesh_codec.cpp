@@ -0,0 +1,542 @@
+#include "mesh_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "job_system.h"
+#include "mapped_file.h"
+
+namespace
+{
+
+const std::uint32_t CompressedModelMagic = 0x5a48534d;  // "MSHZ"
+
+// 256 KB of raw vertices and 192K indices per chunk: enough chunks for every thread, small enough to stay in cache
+const std::uint32_t VerticesPerChunk = 8192;
+const std::uint32_t IndicesPerChunk = 3 * 65536;
+
+const std::size_t VertexSize = sizeof(Vertex);
+const std::uint32_t GroupSize = 16;
+
+struct CompressedModelHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t key;
+    std::uint32_t uniqueVertexCount;
+    std::uint32_t indexCount;  // vertices of the triangle list
+    std::uint32_t materialCount;
+    std::uint32_t submeshCount;
+};
+
+// where a chunk's bytes are, relative to the end of the header, tables, materials and submeshes
+struct ChunkEntry
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+
+    // index chunks: unique vertices used by earlier chunks, the first value a 0 code decodes to
+    std::uint32_t nextVertex;
+    std::uint32_t padding;
+};
+
+void Append(std::vector<unsigned char>& output, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    output.insert(output.end(), bytes, bytes + size);
+}
+
+void AppendString(std::vector<unsigned char>& output, const std::string& text)
+{
+    const std::uint32_t length = static_cast<std::uint32_t>(text.size());
+    Append(output, &length, sizeof(length));
+    Append(output, text.data(), text.size());
+}
+
+class ByteReader
+{
+public:
+    ByteReader(const unsigned char* data, std::size_t size)
+        : data{data},
+          size{size},
+          offset{0}
+    {
+    }
+
+    void Read(void* destination, std::size_t length)
+    {
+        std::memcpy(destination, Take(length), length);
+    }
+
+    std::string ReadString()
+    {
+        std::uint32_t length;
+        Read(&length, sizeof(length));
+
+        const unsigned char* text = Take(length);
+        return std::string{reinterpret_cast<const char*>(text), length};
+    }
+
+    std::size_t GetRemaining() const
+    {
+        return size - offset;
+    }
+
+    const unsigned char* Take(std::size_t length)
+    {
+        if (length > size - offset)
+        {
+            throw std::runtime_error{"compressed model is truncated"};
+        }
+
+        const unsigned char* position = data + offset;
+        offset += length;
+        return position;
+    }
+
+private:
+    const unsigned char* data;
+    std::size_t size;
+    std::size_t offset;
+};
+
+// the triangle list as unique vertices in order of first use and an index per corner
+void BuildIndexedVertices(const std::vector<Vertex>& vertices, std::vector<Vertex>& uniqueVertices, std::vector<std::uint32_t>& indices)
+{
+    const std::uint32_t emptySlot = 0xffffffffu;
+
+    std::size_t tableSize = 1024;
+    while (tableSize < 2 * vertices.size())
+    {
+        tableSize *= 2;
+    }
+    std::vector<std::uint32_t> table(tableSize, emptySlot);
+    const std::size_t mask = tableSize - 1;
+
+    indices.resize(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        // vertices are equal when all their bytes are, FNV-1a over the 32 bit words
+        std::uint32_t words[VertexSize / 4];
+        std::memcpy(words, &vertices[i], VertexSize);
+
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const std::uint32_t word : words)
+        {
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+
+        std::size_t slot = static_cast<std::size_t>(hash ^ (hash >> 32)) & mask;
+        while (table[slot] != emptySlot && std::memcmp(&uniqueVertices[table[slot]], &vertices[i], VertexSize) != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        if (table[slot] == emptySlot)
+        {
+            table[slot] = static_cast<std::uint32_t>(uniqueVertices.size());
+            uniqueVertices.push_back(vertices[i]);
+        }
+        indices[i] = table[slot];
+    }
+}
+
+void EncodeVertexChunk(const Vertex* vertices, std::uint32_t count, std::vector<unsigned char>& output)
+{
+    const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(vertices);
+    const std::uint32_t groupCount = (count + GroupSize - 1) / GroupSize;
+
+    std::vector<unsigned char> deltas(static_cast<std::size_t>(groupCount) * GroupSize);
+    std::vector<unsigned char> modes;
+    std::vector<unsigned char> payload;
+
+    for (std::size_t byte = 0; byte < VertexSize; ++byte)
+    {
+        unsigned char previous = 0;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const unsigned char value = bytes[i * VertexSize + byte];
+            const unsigned char delta = static_cast<unsigned char>(value - previous);
+            deltas[i] = static_cast<unsigned char>((delta << 1) ^ ((delta & 0x80) ? 0xff : 0x00));
+            previous = value;
+        }
+        std::fill(deltas.begin() + count, deltas.end(), 0);
+
+        // 2 bit mode per group, four groups per byte, ahead of the groups' payload
+        modes.assign((groupCount + 3) / 4, 0);
+        payload.clear();
+        for (std::uint32_t group = 0; group < groupCount; ++group)
+        {
+            const unsigned char* const groupDeltas = &deltas[group * GroupSize];
+            const unsigned char largest = *std::max_element(groupDeltas, groupDeltas + GroupSize);
+
+            const unsigned int mode = (largest == 0) ? 0 : (largest < 4) ? 1 : (largest < 16) ? 2 : 3;
+            modes[group / 4] |= static_cast<unsigned char>(mode << ((group % 4) * 2));
+
+            if (mode == 1)
+            {
+                for (std::uint32_t i = 0; i < GroupSize; i += 4)
+                {
+                    payload.push_back(static_cast<unsigned char>(groupDeltas[i] | groupDeltas[i + 1] << 2 | groupDeltas[i + 2] << 4 | groupDeltas[i + 3] << 6));
+                }
+            }
+            else if (mode == 2)
+            {
+                for (std::uint32_t i = 0; i < GroupSize; i += 2)
+                {
+                    payload.push_back(static_cast<unsigned char>(groupDeltas[i] | groupDeltas[i + 1] << 4));
+                }
+            }
+            else if (mode == 3)
+            {
+                payload.insert(payload.end(), groupDeltas, groupDeltas + GroupSize);
+            }
+        }
+
+        Append(output, modes.data(), modes.size());
+        Append(output, payload.data(), payload.size());
+    }
+}
+
+void DecodeVertexChunk(const unsigned char* data, std::size_t size, Vertex* vertices, std::uint32_t count)
+{
+    unsigned char* const bytes = reinterpret_cast<unsigned char*>(vertices);
+    const std::uint32_t groupCount = (count + GroupSize - 1) / GroupSize;
+
+    ByteReader reader{data, size};
+    unsigned char deltas[GroupSize];
+
+    for (std::size_t byte = 0; byte < VertexSize; ++byte)
+    {
+        const unsigned char* const modes = reader.Take((groupCount + 3) / 4);
+
+        unsigned char previous = 0;
+        for (std::uint32_t group = 0; group < groupCount; ++group)
+        {
+            const unsigned int mode = (modes[group / 4] >> ((group % 4) * 2)) & 3;
+            if (mode == 0)
+            {
+                std::memset(deltas, 0, GroupSize);
+            }
+            else if (mode == 1)
+            {
+                const unsigned char* const packed = reader.Take(GroupSize / 4);
+                for (std::uint32_t i = 0; i < GroupSize; ++i)
+                {
+                    deltas[i] = (packed[i / 4] >> ((i % 4) * 2)) & 3;
+                }
+            }
+            else if (mode == 2)
+            {
+                const unsigned char* const packed = reader.Take(GroupSize / 2);
+                for (std::uint32_t i = 0; i < GroupSize; ++i)
+                {
+                    deltas[i] = (packed[i / 2] >> ((i % 2) * 4)) & 15;
+                }
+            }
+            else
+            {
+                std::memcpy(deltas, reader.Take(GroupSize), GroupSize);
+            }
+
+            const std::uint32_t groupEnd = std::min(GroupSize, count - group * GroupSize);
+            unsigned char* output = bytes + static_cast<std::size_t>(group) * GroupSize * VertexSize + byte;
+            for (std::uint32_t i = 0; i < groupEnd; ++i, output += VertexSize)
+            {
+                previous = static_cast<unsigned char>(previous + ((deltas[i] >> 1) ^ -(deltas[i] & 1)));
+                *output = previous;
+            }
+        }
+    }
+}
+
+void EncodeIndexChunk(const std::uint32_t* indices, std::uint32_t count, std::uint32_t nextVertex, std::vector<unsigned char>& output)
+{
+    std::int64_t previous = 0;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        std::uint64_t code = 0;
+        if (indices[i] == nextVertex)
+        {
+            ++nextVertex;
+        }
+        else
+        {
+            const std::int64_t delta = static_cast<std::int64_t>(indices[i]) - previous;
+            code = ((static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63)) + 1;
+        }
+        previous = indices[i];
+
+        // 7 bits per byte, the high bit marks that more follow
+        while (code >= 0x80)
+        {
+            output.push_back(static_cast<unsigned char>(code | 0x80));
+            code >>= 7;
+        }
+        output.push_back(static_cast<unsigned char>(code));
+    }
+}
+
+// expands the chunk's indices into the triangle list, returns false when the data is corrupt
+bool DecodeIndexChunk(const unsigned char* data, std::size_t size, std::uint32_t nextVertex, const std::vector<Vertex>& uniqueVertices, Vertex* output,
+                      std::uint32_t count)
+{
+    const unsigned char* position = data;
+    const unsigned char* const end = data + size;
+    const std::uint64_t uniqueCount = uniqueVertices.size();
+
+    std::uint64_t previous = 0;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        std::uint64_t code = 0;
+        for (unsigned int shift = 0;; shift += 7)
+        {
+            if (position == end || shift > 63)
+            {
+                return false;
+            }
+
+            const unsigned char byte = *position++;
+            code |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+
+        std::uint64_t index;
+        if (code == 0)
+        {
+            index = nextVertex++;
+        }
+        else
+        {
+            const std::uint64_t zigzag = code - 1;
+            index = previous + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+        }
+
+        if (index >= uniqueCount)
+        {
+            return false;
+        }
+
+        output[i] = uniqueVertices[static_cast<std::size_t>(index)];
+        previous = index;
+    }
+
+    return position == end;
+}
+
+} // namespace
+
+std::vector<unsigned char> EncodeCompressedModel(const Model& model, std::uint64_t key)
+{
+    std::vector<Vertex> uniqueVertices;
+    std::vector<std::uint32_t> indices;
+    BuildIndexedVertices(model.vertices, uniqueVertices, indices);
+
+    const std::uint32_t uniqueVertexCount = static_cast<std::uint32_t>(uniqueVertices.size());
+    const std::uint32_t indexCount = static_cast<std::uint32_t>(indices.size());
+
+    std::vector<ChunkEntry> vertexChunks;
+    std::vector<ChunkEntry> indexChunks;
+    std::vector<unsigned char> chunkData;
+
+    for (std::uint32_t first = 0; first < uniqueVertexCount; first += VerticesPerChunk)
+    {
+        ChunkEntry chunk{chunkData.size(), 0, 0, 0};
+        EncodeVertexChunk(&uniqueVertices[first], std::min(VerticesPerChunk, uniqueVertexCount - first), chunkData);
+        chunk.size = chunkData.size() - chunk.offset;
+        vertexChunks.push_back(chunk);
+    }
+
+    std::uint32_t nextVertex = 0;
+    for (std::uint32_t first = 0; first < indexCount; first += IndicesPerChunk)
+    {
+        const std::uint32_t count = std::min(IndicesPerChunk, indexCount - first);
+
+        ChunkEntry chunk{chunkData.size(), 0, nextVertex, 0};
+        EncodeIndexChunk(&indices[first], count, nextVertex, chunkData);
+        chunk.size = chunkData.size() - chunk.offset;
+        indexChunks.push_back(chunk);
+
+        // vertices are numbered by first use, so the next unused one follows the largest index so far
+        for (std::uint32_t i = first; i < first + count; ++i)
+        {
+            nextVertex = std::max(nextVertex, indices[i] + 1);
+        }
+    }
+
+    CompressedModelHeader header;
+    header.magic = CompressedModelMagic;
+    header.version = CompressedModelVersion;
+    header.key = key;
+    header.uniqueVertexCount = uniqueVertexCount;
+    header.indexCount = indexCount;
+    header.materialCount = static_cast<std::uint32_t>(model.materials.size());
+    header.submeshCount = static_cast<std::uint32_t>(model.submeshes.size());
+
+    std::vector<unsigned char> output;
+    output.reserve(sizeof(header) + chunkData.size() + 4096);
+    Append(output, &header, sizeof(header));
+    Append(output, vertexChunks.data(), vertexChunks.size() * sizeof(ChunkEntry));
+    Append(output, indexChunks.data(), indexChunks.size() * sizeof(ChunkEntry));
+
+    for (const auto& material : model.materials)
+    {
+        AppendString(output, material.name);
+        Append(output, &material.ambientColor, sizeof(material.ambientColor));
+        Append(output, &material.diffuseColor, sizeof(material.diffuseColor));
+        Append(output, &material.specularColor, sizeof(material.specularColor));
+        Append(output, &material.shininessValue, sizeof(material.shininessValue));
+        Append(output, &material.metallic, sizeof(material.metallic));
+        Append(output, &material.roughness, sizeof(material.roughness));
+        AppendString(output, material.diffuseTexturePath);
+
+        const std::uint64_t textureRange[2] = {material.diffuseTextureOffset, material.diffuseTextureSize};
+        Append(output, textureRange, sizeof(textureRange));
+    }
+    Append(output, model.submeshes.data(), model.submeshes.size() * sizeof(Submesh));
+
+    Append(output, chunkData.data(), chunkData.size());
+
+    return output;
+}
+
+std::uint64_t GetCompressedModelKey(const unsigned char* data, std::size_t size)
+{
+    CompressedModelHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error{"compressed model is truncated"};
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CompressedModelMagic || header.version != CompressedModelVersion)
+    {
+        throw std::runtime_error{"not a compressed model of version " + std::to_string(CompressedModelVersion)};
+    }
+
+    return header.key;
+}
+
+Model DecodeCompressedModel(const unsigned char* data, std::size_t size)
+{
+    GetCompressedModelKey(data, size);
+
+    ByteReader reader{data, size};
+
+    CompressedModelHeader header;
+    reader.Read(&header, sizeof(header));
+
+    const std::uint32_t vertexChunkCount = (header.uniqueVertexCount + VerticesPerChunk - 1) / VerticesPerChunk;
+    const std::uint32_t indexChunkCount = (header.indexCount + IndicesPerChunk - 1) / IndicesPerChunk;
+
+    // the counts of a corrupt header must not size allocations beyond what the data could hold
+    if ((static_cast<std::size_t>(vertexChunkCount) + indexChunkCount) > reader.GetRemaining() / sizeof(ChunkEntry))
+    {
+        throw std::runtime_error{"compressed model is truncated"};
+    }
+
+    std::vector<ChunkEntry> vertexChunks(vertexChunkCount);
+    std::vector<ChunkEntry> indexChunks(indexChunkCount);
+    reader.Read(vertexChunks.data(), vertexChunks.size() * sizeof(ChunkEntry));
+    reader.Read(indexChunks.data(), indexChunks.size() * sizeof(ChunkEntry));
+
+    Model model;
+    for (std::uint32_t i = 0; i < header.materialCount; ++i)
+    {
+        Material material;
+        material.name = reader.ReadString();
+        reader.Read(&material.ambientColor, sizeof(material.ambientColor));
+        reader.Read(&material.diffuseColor, sizeof(material.diffuseColor));
+        reader.Read(&material.specularColor, sizeof(material.specularColor));
+        reader.Read(&material.shininessValue, sizeof(material.shininessValue));
+        reader.Read(&material.metallic, sizeof(material.metallic));
+        reader.Read(&material.roughness, sizeof(material.roughness));
+        material.diffuseTexturePath = reader.ReadString();
+
+        std::uint64_t textureRange[2];
+        reader.Read(textureRange, sizeof(textureRange));
+        material.diffuseTextureOffset = static_cast<std::size_t>(textureRange[0]);
+        material.diffuseTextureSize = static_cast<std::size_t>(textureRange[1]);
+
+        model.materials.push_back(material);
+    }
+
+    if (header.submeshCount > reader.GetRemaining() / sizeof(Submesh))
+    {
+        throw std::runtime_error{"compressed model is truncated"};
+    }
+
+    model.submeshes.resize(header.submeshCount);
+    reader.Read(model.submeshes.data(), model.submeshes.size() * sizeof(Submesh));
+    for (const auto& submesh : model.submeshes)
+    {
+        if (submesh.materialIndex >= model.materials.size() || submesh.firstVertex > header.indexCount ||
+            submesh.vertexCount > header.indexCount - submesh.firstVertex)
+        {
+            throw std::runtime_error{"compressed model has an invalid submesh"};
+        }
+    }
+
+    // chunk offsets are relative to what follows the submeshes
+    const std::size_t chunkDataSize = size - (reader.Take(0) - data);
+    const unsigned char* const chunkData = reader.Take(chunkDataSize);
+    const auto checkChunk = [chunkDataSize](const ChunkEntry& chunk)
+    {
+        if (chunk.offset > chunkDataSize || chunk.size > chunkDataSize - chunk.offset)
+        {
+            throw std::runtime_error{"compressed model is truncated"};
+        }
+    };
+    std::for_each(vertexChunks.begin(), vertexChunks.end(), checkChunk);
+    std::for_each(indexChunks.begin(), indexChunks.end(), checkChunk);
+
+    std::atomic<bool> corrupt{false};
+
+    std::vector<Vertex> uniqueVertices(header.uniqueVertexCount);
+    GetSharedJobSystem().ParallelFor(vertexChunkCount, [&](unsigned int chunk)
+    {
+        try
+        {
+            const std::uint32_t first = chunk * VerticesPerChunk;
+            DecodeVertexChunk(chunkData + vertexChunks[chunk].offset, static_cast<std::size_t>(vertexChunks[chunk].size), &uniqueVertices[first],
+                              std::min(VerticesPerChunk, header.uniqueVertexCount - first));
+        }
+        catch (const std::runtime_error&)
+        {
+            corrupt = true;
+        }
+    });
+
+    model.vertices.resize(header.indexCount);
+    if (corrupt == false)
+    {
+        GetSharedJobSystem().ParallelFor(indexChunkCount, [&](unsigned int chunk)
+        {
+            const std::uint32_t first = chunk * IndicesPerChunk;
+            if (DecodeIndexChunk(chunkData + indexChunks[chunk].offset, static_cast<std::size_t>(indexChunks[chunk].size),
+                                 indexChunks[chunk].nextVertex, uniqueVertices, &model.vertices[first],
+                                 std::min(IndicesPerChunk, header.indexCount - first)) == false)
+            {
+                corrupt = true;
+            }
+        });
+    }
+
+    if (corrupt)
+    {
+        throw std::runtime_error{"compressed model is corrupt"};
+    }
+
+    return model;
+}
+
+Model LoadCompressedModelFile(const std::string& filepath)
+{
+    const MappedFile file{filepath};
+    return DecodeCompressedModel(file.GetData(), file.GetSize());
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+// Compressed model format (.meshz), written by the model cache and loadable
+// like any other model file. The triangle list is split into unique vertices
+// in order of first use and 32 bit indices into them, both compressed in
+// independent chunks, each decoded by a job of its own:
+//   vertices  each of the 32 bytes of a Vertex forms its own stream through the
+//             chunk; the streams hold byte deltas to the previous vertex, zigzag
+//             encoded and packed in groups of 16 at 0, 2, 4 or 8 bits each
+//   indices   0 for the next unused vertex, otherwise the zigzag encoded delta
+//             to the previous index plus 1, as variable-length integers
+// Materials and submeshes follow the header uncompressed. Decoding writes the
+// triangle list straight from the index chunks, so loading a model from slow
+// storage reads about a third of its raw vertex data.
+const std::uint32_t CompressedModelVersion = 1;
+
+// key is stored in the header for the cache to check, standalone files use 0
+std::vector<unsigned char> EncodeCompressedModel(const Model& model, std::uint64_t key);
+
+// key in the header of data, throws when data is not a compressed model of this version
+std::uint64_t GetCompressedModelKey(const unsigned char* data, std::size_t size);
+
+// decodes the chunks as jobs of the shared job system, throws on corrupt data
+Model DecodeCompressedModel(const unsigned char* data, std::size_t size);
+
+Model LoadCompressedModelFile(const std::string& filepath);
@@ -0,0 +1,476 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace
+{
+
+// meshlets tested per job, a multiple of the 8 the AVX2 test takes at once
+const std::size_t testChunkSize = 1024;
+
+// cells of the Morton curve along each axis of a submesh's bounds
+const unsigned int mortonBits = 9;
+
+// slots of the open-addressed table of a meshlet's distinct positions, a power of two above MeshletMaxVertices
+const unsigned int positionSlotCount = 128;
+
+std::uint32_t SpreadBits(std::uint32_t value)
+{
+    // inserts two zero bits above each of the low 10 bits
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+// 0 to 5 for +x, -x, +y, -y, +z, -z
+std::uint32_t GetNormalDirection(const glm::vec3& normal)
+{
+    const glm::vec3 magnitude = glm::abs(normal);
+    if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+    {
+        return normal.x >= 0.0f ? 0 : 1;
+    }
+    if (magnitude.y >= magnitude.z)
+    {
+        return normal.y >= 0.0f ? 2 : 3;
+    }
+    return normal.z >= 0.0f ? 4 : 5;
+}
+
+// sorts by the upper 32 bits, which hold a key below 2^30, in three passes of 10 bits
+void RadixSortKeys(std::vector<std::uint64_t>& keys)
+{
+    std::vector<std::uint64_t> scratch(keys.size());
+    for (unsigned int shift = 32; shift < 62; shift += 10)
+    {
+        std::size_t offsets[1024] = {};
+        for (const std::uint64_t key : keys)
+        {
+            ++offsets[(key >> shift) & 0x3FF];
+        }
+
+        std::size_t offset = 0;
+        for (std::size_t& bucket : offsets)
+        {
+            const std::size_t count = bucket;
+            bucket = offset;
+            offset += count;
+        }
+
+        for (const std::uint64_t key : keys)
+        {
+            scratch[offsets[(key >> shift) & 0x3FF]++] = key;
+        }
+        keys.swap(scratch);
+    }
+}
+
+// Counts the distinct corner positions of one meshlet. Positions are compared
+// bit for bit, so corners shared through a welded vertex count once.
+class PositionSet
+{
+public:
+    PositionSet()
+        : count{0}
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        std::fill(slots, slots + positionSlotCount, 0u);
+        count = 0;
+    }
+
+    unsigned int GetCount() const
+    {
+        return count;
+    }
+
+    bool Contains(const glm::vec3& position) const
+    {
+        for (unsigned int slot = Hash(position);; slot = (slot + 1) & (positionSlotCount - 1))
+        {
+            if (slots[slot] == 0)
+            {
+                return false;
+            }
+            if (std::memcmp(&positions[slots[slot] - 1], &position, sizeof(glm::vec3)) == 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    void Insert(const glm::vec3& position)
+    {
+        unsigned int slot = Hash(position);
+        while (slots[slot] != 0)
+        {
+            if (std::memcmp(&positions[slots[slot] - 1], &position, sizeof(glm::vec3)) == 0)
+            {
+                return;
+            }
+            slot = (slot + 1) & (positionSlotCount - 1);
+        }
+
+        positions[count] = position;
+        slots[slot] = ++count;
+    }
+
+private:
+    static unsigned int Hash(const glm::vec3& position)
+    {
+        std::uint32_t bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+        return (((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u)) >> 7) & (positionSlotCount - 1);
+    }
+
+    glm::vec3 positions[MeshletMaxVertices];
+    unsigned int slots[positionSlotCount];  // index + 1 into positions, 0 for empty slots
+    unsigned int count;
+};
+
+Meshlet MakeMeshlet(const std::vector<Vertex>& vertices, unsigned int firstVertex, unsigned int vertexCount)
+{
+    Meshlet meshlet;
+    meshlet.firstVertex = firstVertex;
+    meshlet.vertexCount = vertexCount;
+
+    glm::vec3 boundsMin = vertices[firstVertex].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (unsigned int i = firstVertex; i < firstVertex + vertexCount; ++i)
+    {
+        boundsMin = glm::min(boundsMin, vertices[i].position);
+        boundsMax = glm::max(boundsMax, vertices[i].position);
+    }
+
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (unsigned int i = firstVertex; i < firstVertex + vertexCount; ++i)
+    {
+        const glm::vec3 offset = vertices[i].position - meshlet.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // the cone is around the average face normal, degenerate triangles face nowhere
+    glm::vec3 normals[MeshletMaxTriangles];
+    unsigned int normalCount = 0;
+    glm::vec3 normalSum{0.0f};
+    for (unsigned int i = firstVertex; i + 2 < firstVertex + vertexCount; i += 3)
+    {
+        const glm::vec3 normal = glm::cross(vertices[i + 1].position - vertices[i].position, vertices[i + 2].position - vertices[i].position);
+        const float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals[normalCount] = normal / length;
+            normalSum += normals[normalCount++];
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3{0.0f, 0.0f, 1.0f};
+    meshlet.coneCutoff = 1.0f;
+    if (glm::length(normalSum) > 0.0f)
+    {
+        meshlet.coneAxis = glm::normalize(normalSum);
+
+        float minDot = 1.0f;
+        for (unsigned int i = 0; i < normalCount; ++i)
+        {
+            minDot = std::min(minDot, glm::dot(normals[i], meshlet.coneAxis));
+        }
+
+        // cones of 90 degrees or more always have a face toward the camera
+        meshlet.coneCutoff = (minDot > 0.0f) ? std::sqrt(std::max(1.0f - minDot * minDot, 0.0f)) : 1.0f;
+    }
+
+    return meshlet;
+}
+
+} // namespace
+
+void CullClustersScalar(const ClusterBounds& bounds, const ClusterCullView& view, std::size_t first, std::size_t count, unsigned char* results)
+{
+    for (std::size_t i = first; i < first + count; ++i)
+    {
+        bool outside = false;
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            const float* p = view.frustumPlanes[plane];
+            outside = outside || p[0] * bounds.centerX[i] + p[1] * bounds.centerY[i] + p[2] * bounds.centerZ[i] + p[3] < -bounds.radius[i];
+        }
+        if (outside)
+        {
+            results[i] = ClusterOutsideFrustum;
+            continue;
+        }
+
+        const float toCenterX = bounds.centerX[i] - view.cameraPosition[0];
+        const float toCenterY = bounds.centerY[i] - view.cameraPosition[1];
+        const float toCenterZ = bounds.centerZ[i] - view.cameraPosition[2];
+        const float distance = std::sqrt(toCenterX * toCenterX + toCenterY * toCenterY + toCenterZ * toCenterZ);
+        const float alongAxis = toCenterX * bounds.coneAxisX[i] + toCenterY * bounds.coneAxisY[i] + toCenterZ * bounds.coneAxisZ[i];
+
+        results[i] = (alongAxis >= bounds.coneCutoff[i] * distance + bounds.radius[i]) ? ClusterBackFacing : ClusterVisible;
+    }
+}
+
+std::vector<Meshlet> BuildMeshlets(Model& model)
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<Vertex> sortedVertices;
+    std::vector<std::uint64_t> keys;
+    PositionSet positions;
+
+    for (const auto& submesh : model.submeshes)
+    {
+        const unsigned int triangleCount = submesh.vertexCount / 3;
+        if (triangleCount == 0)
+        {
+            continue;
+        }
+
+        Vertex* triangles = model.vertices.data() + submesh.firstVertex;
+        const glm::vec3 cellScale = glm::vec3{static_cast<float>((1u << mortonBits) - 1)} / glm::max(submesh.boundsMax - submesh.boundsMin, glm::vec3{1.0e-20f});
+
+        // (direction, Morton code) above the triangle index
+        keys.resize(triangleCount);
+        for (unsigned int i = 0; i < triangleCount; ++i)
+        {
+            const glm::vec3& p0 = triangles[i * 3].position;
+            const glm::vec3& p1 = triangles[i * 3 + 1].position;
+            const glm::vec3& p2 = triangles[i * 3 + 2].position;
+
+            const glm::vec3 cell = glm::clamp(((p0 + p1 + p2) / 3.0f - submesh.boundsMin) * cellScale, glm::vec3{0.0f},
+                                              glm::vec3{static_cast<float>((1u << mortonBits) - 1)});
+            const std::uint32_t morton = SpreadBits(static_cast<std::uint32_t>(cell.x)) | (SpreadBits(static_cast<std::uint32_t>(cell.y)) << 1) |
+                                         (SpreadBits(static_cast<std::uint32_t>(cell.z)) << 2);
+            const std::uint32_t direction = GetNormalDirection(glm::cross(p1 - p0, p2 - p0));
+
+            keys[i] = (static_cast<std::uint64_t>((direction << (3 * mortonBits)) | morton) << 32) | i;
+        }
+        RadixSortKeys(keys);
+
+        sortedVertices.resize(static_cast<std::size_t>(triangleCount) * 3);
+        for (unsigned int i = 0; i < triangleCount; ++i)
+        {
+            const std::uint32_t triangle = static_cast<std::uint32_t>(keys[i]);
+            std::copy(triangles + triangle * 3, triangles + triangle * 3 + 3, sortedVertices.begin() + i * 3);
+        }
+        std::copy(sortedVertices.begin(), sortedVertices.end(), triangles);
+
+        unsigned int meshletStart = 0;
+        std::uint64_t meshletDirection = keys[0] >> (32 + 3 * mortonBits);
+        positions.Clear();
+        for (unsigned int i = 0; i < triangleCount; ++i)
+        {
+            const std::uint64_t direction = keys[i] >> (32 + 3 * mortonBits);
+
+            unsigned int newPositions = 0;
+            for (unsigned int corner = 0; corner < 3; ++corner)
+            {
+                newPositions += positions.Contains(triangles[i * 3 + corner].position) ? 0 : 1;
+            }
+
+            if (i - meshletStart == MeshletMaxTriangles || positions.GetCount() + newPositions > MeshletMaxVertices || direction != meshletDirection)
+            {
+                meshlets.push_back(MakeMeshlet(model.vertices, submesh.firstVertex + meshletStart * 3, (i - meshletStart) * 3));
+                meshletStart = i;
+                meshletDirection = direction;
+                positions.Clear();
+            }
+
+            for (unsigned int corner = 0; corner < 3; ++corner)
+            {
+                positions.Insert(triangles[i * 3 + corner].position);
+            }
+        }
+        meshlets.push_back(MakeMeshlet(model.vertices, submesh.firstVertex + meshletStart * 3, (triangleCount - meshletStart) * 3));
+    }
+
+    std::sort(meshlets.begin(), meshlets.end(), [](const Meshlet& a, const Meshlet& b) { return a.firstVertex < b.firstVertex; });
+
+    return meshlets;
+}
+
+MeshletCuller::MeshletCuller(const std::vector<Meshlet>& meshlets, JobSystem& jobSystem, bool useAvx2)
+    : jobSystem(jobSystem),
+      useAvx2{useAvx2 && IsAvx2Supported()},
+      view()
+{
+    // padding meshlets have no extent and are never drawn
+    const std::size_t paddedCount = (meshlets.size() + 7) & ~static_cast<std::size_t>(7);
+    for (std::vector<float>* component : {&centerX, &centerY, &centerZ, &radius, &coneAxisX, &coneAxisY, &coneAxisZ, &coneCutoff})
+    {
+        component->assign(paddedCount, 0.0f);
+    }
+    results.assign(paddedCount, ClusterVisible);
+
+    for (std::size_t i = 0; i < meshlets.size(); ++i)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        firstVertices.push_back(meshlet.firstVertex);
+        vertexCounts.push_back(meshlet.vertexCount);
+
+        centerX[i] = meshlet.center.x;
+        centerY[i] = meshlet.center.y;
+        centerZ[i] = meshlet.center.z;
+        radius[i] = meshlet.radius;
+        coneAxisX[i] = meshlet.coneAxis.x;
+        coneAxisY[i] = meshlet.coneAxis.y;
+        coneAxisZ[i] = meshlet.coneAxis.z;
+        coneCutoff[i] = meshlet.coneCutoff;
+    }
+
+    bounds.centerX = centerX.data();
+    bounds.centerY = centerY.data();
+    bounds.centerZ = centerZ.data();
+    bounds.radius = radius.data();
+    bounds.coneAxisX = coneAxisX.data();
+    bounds.coneAxisY = coneAxisY.data();
+    bounds.coneAxisZ = coneAxisZ.data();
+    bounds.coneCutoff = coneCutoff.data();
+}
+
+bool MeshletCuller::IsUsingAvx2() const
+{
+    return useAvx2;
+}
+
+unsigned int MeshletCuller::GetThreadCount() const
+{
+    return jobSystem.GetThreadCount();
+}
+
+std::size_t MeshletCuller::GetMeshletCount() const
+{
+    return firstVertices.size();
+}
+
+DrawVisibility MeshletCuller::Cull(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility, const glm::mat4& viewProjectionMatrix,
+                                   const glm::vec3& cameraPosition)
+{
+    if (visibility.indirectBuffer != 0)
+    {
+        return visibility;
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // the rows of the view-projection matrix give the clip planes
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        const int axis = plane / 2;
+        const float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+
+        glm::vec4 coefficients;
+        for (int column = 0; column < 4; ++column)
+        {
+            coefficients[column] = viewProjectionMatrix[column][3] + sign * viewProjectionMatrix[column][axis];
+        }
+        coefficients /= std::max(glm::length(glm::vec3{coefficients}), 1.0e-20f);
+
+        for (int component = 0; component < 4; ++component)
+        {
+            view.frustumPlanes[plane][component] = coefficients[component];
+        }
+    }
+    view.cameraPosition[0] = cameraPosition.x;
+    view.cameraPosition[1] = cameraPosition.y;
+    view.cameraPosition[2] = cameraPosition.z;
+
+    jobSystem.ParallelFor(results.size(), testChunkSize, [this](std::size_t first, std::size_t end) { TestMeshlets(first, end - first); });
+
+    stats = MeshletCullStats{};
+    drawRanges.firstVertices.clear();
+    drawRanges.vertexCounts.clear();
+    drawRanges.drawOffsets.assign(1, 0);
+
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        const DrawCommand& drawCommand = drawList[drawIndex];
+        const unsigned int drawFirstVertex = static_cast<unsigned int>(drawCommand.firstVertex);
+        const unsigned int drawEndVertex = drawFirstVertex + static_cast<unsigned int>(drawCommand.vertexCount);
+
+        if (visibility.visibleDraws != nullptr && (*visibility.visibleDraws)[drawIndex] == 0)
+        {
+            drawRanges.drawOffsets.push_back(static_cast<unsigned int>(drawRanges.firstVertices.size()));
+            continue;
+        }
+
+        std::size_t meshletIndex = std::lower_bound(firstVertices.begin(), firstVertices.end(), drawFirstVertex) - firstVertices.begin();
+        if (meshletIndex == firstVertices.size() || firstVertices[meshletIndex] >= drawEndVertex)
+        {
+            drawRanges.firstVertices.push_back(drawCommand.firstVertex);
+            drawRanges.vertexCounts.push_back(drawCommand.vertexCount);
+        }
+
+        const std::size_t drawFirstRange = drawRanges.firstVertices.size();
+        for (; meshletIndex < firstVertices.size() && firstVertices[meshletIndex] < drawEndVertex; ++meshletIndex)
+        {
+            const unsigned int triangleCount = vertexCounts[meshletIndex] / 3;
+            ++stats.testedClusters;
+            stats.testedTriangles += triangleCount;
+
+            if (results[meshletIndex] != ClusterVisible)
+            {
+                stats.frustumCulledClusters += (results[meshletIndex] == ClusterOutsideFrustum) ? 1 : 0;
+                stats.backFacingClusters += (results[meshletIndex] == ClusterBackFacing) ? 1 : 0;
+                stats.culledTriangles += triangleCount;
+                continue;
+            }
+
+            // meshlets follow each other in the vertex buffer, so surviving runs become one range
+            const int firstVertex = static_cast<int>(firstVertices[meshletIndex]);
+            if (drawRanges.firstVertices.size() > drawFirstRange && drawRanges.firstVertices.back() + drawRanges.vertexCounts.back() == firstVertex)
+            {
+                drawRanges.vertexCounts.back() += static_cast<int>(vertexCounts[meshletIndex]);
+            }
+            else
+            {
+                drawRanges.firstVertices.push_back(firstVertex);
+                drawRanges.vertexCounts.push_back(static_cast<int>(vertexCounts[meshletIndex]));
+            }
+        }
+
+        drawRanges.drawOffsets.push_back(static_cast<unsigned int>(drawRanges.firstVertices.size()));
+    }
+
+    stats.drawRanges = static_cast<unsigned int>(drawRanges.firstVertices.size());
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    DrawVisibility culledVisibility;
+    culledVisibility.visibleDraws = visibility.visibleDraws;
+    culledVisibility.drawRanges = &drawRanges;
+
+    return culledVisibility;
+}
+
+const MeshletCullStats& MeshletCuller::GetStats() const
+{
+    return stats;
+}
+
+void MeshletCuller::TestMeshlets(std::size_t first, std::size_t count)
+{
+#ifdef RASTER_AVX2
+    if (useAvx2)
+    {
+        CullClustersAvx2(bounds, view, first, count, results.data());
+    }
+    else
+#endif
+    {
+        CullClustersScalar(bounds, view, first, count, results.data());
+    }
+}
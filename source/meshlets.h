@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cluster_cull.h"
+#include "draw_list.h"
+#include "job_system.h"
+#include "model.h"
+
+// the cluster size of mesh shader pipelines: at most 124 triangles with 64 distinct corner positions
+const unsigned int MeshletMaxTriangles = 124;
+const unsigned int MeshletMaxVertices = 64;
+
+// neighbouring triangles of one submesh, a contiguous range of the triangle list
+struct Meshlet
+{
+    unsigned int firstVertex;
+    unsigned int vertexCount;
+
+    glm::vec3 center;
+    float radius;
+
+    // every face normal is within the cone around coneAxis, coneCutoff is the sine of
+    // its half angle, 1 when the cone is too wide to ever face away from the camera
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Reorders the triangles of every submesh so that neighbours are adjacent, then
+// cuts each submesh into meshlets. Triangles are grouped by the axis direction
+// their face normal points along most, which keeps the normal cones below 90
+// degrees, and sorted along a Morton curve through their centroids within the
+// submesh bounds. Meshlets are cut from that order at MeshletMaxTriangles, at
+// MeshletMaxVertices distinct positions, or where the normal direction changes.
+// The submeshes keep their vertex ranges. Returns the meshlets in vertex order.
+std::vector<Meshlet> BuildMeshlets(Model& model);
+
+struct MeshletCullStats
+{
+    unsigned int testedClusters = 0;  // clusters of the draws the incoming visibility kept
+    unsigned int frustumCulledClusters = 0;
+    unsigned int backFacingClusters = 0;
+    unsigned long long testedTriangles = 0;
+    unsigned long long culledTriangles = 0;
+    unsigned int drawRanges = 0;  // multi-draw ranges left after merging adjacent visible clusters
+    double milliseconds = 0.0;
+};
+
+// Culls meshlets on the CPU every frame: bounding spheres outside the view
+// frustum, and normal cones facing away from the camera. The bounds are kept
+// as one array per component, so the AVX2 test handles 8 meshlets at a time;
+// chunks of meshlets are tested as jobs of the job system. The surviving meshlets of each draw, merged where they are
+// adjacent, become the ranges of one glMultiDrawArrays call. Back-facing
+// meshlets hide nothing on closed surfaces only: on open ones their back
+// faces, which the viewer draws, disappear.
+class MeshletCuller
+{
+public:
+    // tests with the jobs of jobSystem, useAvx2 false forces the scalar test
+    MeshletCuller(const std::vector<Meshlet>& meshlets, JobSystem& jobSystem, bool useAvx2);
+
+    MeshletCuller(const MeshletCuller&) = delete;
+    MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+    bool IsUsingAvx2() const;
+    unsigned int GetThreadCount() const;
+    std::size_t GetMeshletCount() const;
+
+    // Culls the meshlets of the draws the visibility keeps, with identity model matrices. Draws
+    // must cover whole meshlets; a draw without any is submitted whole. The returned visibility
+    // refers to storage of the culler and stays valid until the next call. GPU-decided
+    // (indirect) visibility is passed through unchanged.
+    DrawVisibility Cull(const std::vector<DrawCommand>& drawList, const DrawVisibility& visibility, const glm::mat4& viewProjectionMatrix,
+                        const glm::vec3& cameraPosition);
+
+    const MeshletCullStats& GetStats() const;
+
+private:
+    void TestMeshlets(std::size_t first, std::size_t count);
+
+    std::vector<unsigned int> firstVertices;
+    std::vector<unsigned int> vertexCounts;
+
+    // one array per component, padded to a multiple of 8
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    std::vector<float> coneAxisX;
+    std::vector<float> coneAxisY;
+    std::vector<float> coneAxisZ;
+    std::vector<float> coneCutoff;
+    ClusterBounds bounds;
+
+    JobSystem& jobSystem;
+    bool useAvx2;
+
+    // per-frame state, written by the calling thread before the jobs start
+    ClusterCullView view;
+    std::vector<unsigned char> results;
+
+    DrawRanges drawRanges;
+
+    MeshletCullStats stats;
+};
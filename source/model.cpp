@@ -0,0 +1,148 @@
+#include "model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+
+float RoughnessFromShininess(float shininessValue)
+{
+    return std::sqrt(2.0f / (std::max(shininessValue, 0.0f) + 2.0f));
+}
+
+Material MakeDefaultMaterial(const std::string& name)
+{
+    Material material;
+    material.name = name;
+    material.ambientColor = glm::vec3{0.2f, 0.2f, 0.2f};
+    material.diffuseColor = glm::vec3{0.8f, 0.5f, 0.3f};
+    material.specularColor = glm::vec3{1.0f, 1.0f, 1.0f};
+    material.shininessValue = 32.0f;
+    material.metallic = 0.0f;
+    material.roughness = RoughnessFromShininess(material.shininessValue);
+    material.diffuseTextureOffset = 0;
+    material.diffuseTextureSize = 0;
+
+    return material;
+}
+
+Submesh MakeSubmesh(const std::vector<Vertex>& vertices, unsigned int materialIndex, unsigned int firstVertex, unsigned int vertexCount)
+{
+    Submesh submesh;
+    submesh.materialIndex = materialIndex;
+    submesh.firstVertex = firstVertex;
+    submesh.vertexCount = vertexCount;
+    submesh.boundsMin = vertices[firstVertex].position;
+    submesh.boundsMax = vertices[firstVertex].position;
+    for (unsigned int i = firstVertex; i < firstVertex + vertexCount; ++i)
+    {
+        submesh.boundsMin = glm::min(submesh.boundsMin, vertices[i].position);
+        submesh.boundsMax = glm::max(submesh.boundsMax, vertices[i].position);
+    }
+
+    return submesh;
+}
+
+Model CreateClusteredProxy(const Model& model, unsigned int gridResolution)
+{
+    Model proxy;
+    proxy.materials = model.materials;
+    if (model.vertices.empty())
+    {
+        return proxy;
+    }
+
+    glm::vec3 boundsMin = model.vertices[0].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (const auto& vertex : model.vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    // cubic cells, so the proxy keeps its proportions
+    const glm::vec3 extent = boundsMax - boundsMin;
+    const float cellSize = std::max(std::max(extent.x, std::max(extent.y, extent.z)) / gridResolution, 1.0e-20f);
+    const glm::ivec3 cellCounts = glm::min(glm::ivec3{extent / cellSize} + glm::ivec3{1}, glm::ivec3{static_cast<int>(gridResolution)});
+
+    const auto getCell = [&](const glm::vec3& position)
+    {
+        const glm::ivec3 cell = glm::clamp(glm::ivec3{(position - boundsMin) / cellSize}, glm::ivec3{0}, cellCounts - glm::ivec3{1});
+        return static_cast<std::uint32_t>((cell.z * cellCounts.y + cell.y) * cellCounts.x + cell.x);
+    };
+
+    // every vertex in a cell moves to the average position and normal of the cell, the texture coordinate is the first one's
+    struct Cluster
+    {
+        glm::vec3 positionSum;
+        glm::vec3 normalSum;
+        glm::vec2 texCoord;
+        unsigned int count;
+    };
+    std::vector<Cluster> clusters(static_cast<std::size_t>(cellCounts.x) * cellCounts.y * cellCounts.z,
+                                  Cluster{glm::vec3{0.0f}, glm::vec3{0.0f}, glm::vec2{0.0f}, 0});
+
+    std::vector<std::uint32_t> vertexCells(model.vertices.size());
+    for (std::size_t i = 0; i < model.vertices.size(); ++i)
+    {
+        const Vertex& vertex = model.vertices[i];
+        vertexCells[i] = getCell(vertex.position);
+
+        Cluster& cluster = clusters[vertexCells[i]];
+        if (cluster.count == 0)
+        {
+            cluster.texCoord = vertex.texCoord;
+        }
+        cluster.positionSum += vertex.position;
+        cluster.normalSum += vertex.normal;
+        ++cluster.count;
+    }
+
+    const auto makeVertex = [&clusters](std::uint32_t cell)
+    {
+        const Cluster& cluster = clusters[cell];
+
+        Vertex vertex;
+        vertex.position = cluster.positionSum / static_cast<float>(cluster.count);
+        vertex.normal = (glm::length(cluster.normalSum) > 0.0f) ? glm::normalize(cluster.normalSum) : glm::vec3{0.0f, 1.0f, 0.0f};
+        vertex.texCoord = cluster.texCoord;
+        return vertex;
+    };
+
+    for (const auto& submesh : model.submeshes)
+    {
+        const unsigned int firstVertex = static_cast<unsigned int>(proxy.vertices.size());
+
+        std::unordered_set<std::uint64_t> emittedTriangles;
+        for (unsigned int i = submesh.firstVertex; i + 2 < submesh.firstVertex + submesh.vertexCount; i += 3)
+        {
+            std::uint32_t cells[3] = {vertexCells[i], vertexCells[i + 1], vertexCells[i + 2]};
+            if (cells[0] == cells[1] || cells[1] == cells[2] || cells[0] == cells[2])
+            {
+                continue;
+            }
+
+            // fewer than 2^21 cells, the sorted corners of a triangle fit one key
+            std::uint32_t sortedCells[3] = {cells[0], cells[1], cells[2]};
+            std::sort(sortedCells, sortedCells + 3);
+            const std::uint64_t key = (static_cast<std::uint64_t>(sortedCells[0]) << 42) | (static_cast<std::uint64_t>(sortedCells[1]) << 21) | sortedCells[2];
+            if (emittedTriangles.insert(key).second == false)
+            {
+                continue;
+            }
+
+            for (const std::uint32_t cell : cells)
+            {
+                proxy.vertices.push_back(makeVertex(cell));
+            }
+        }
+
+        const unsigned int vertexCount = static_cast<unsigned int>(proxy.vertices.size()) - firstVertex;
+        if (vertexCount > 0)
+        {
+            proxy.submeshes.push_back(MakeSubmesh(proxy.vertices, submesh.materialIndex, firstVertex, vertexCount));
+        }
+    }
+
+    return proxy;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+struct Material
+{
+    std::string name;
+
+    glm::vec3 ambientColor;
+    glm::vec3 diffuseColor;
+    glm::vec3 specularColor;
+    float shininessValue;
+
+    // metallic-roughness parameters of the physically based shader, from the MTL PBR extension (Pm, Pr);
+    // without Pr the roughness follows from the Phong exponent
+    float metallic;
+    float roughness;
+
+    // path of the diffuse (map_Kd) texture, empty when the material is untextured
+    std::string diffuseTexturePath;
+
+    // byte range of the image inside diffuseTexturePath when it is embedded in a binary model file (GLB),
+    // a size of 0 reads the whole file
+    std::size_t diffuseTextureOffset;
+    std::size_t diffuseTextureSize;
+};
+
+// contiguous range of a model's vertices drawn with a single material, one per
+// material of every object or group of the file
+struct Submesh
+{
+    unsigned int materialIndex;
+    unsigned int firstVertex;
+    unsigned int vertexCount;
+
+    // axis-aligned bounds of the submesh's vertices
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+struct Model
+{
+    std::vector<Vertex> vertices;
+    std::vector<Material> materials;
+    std::vector<Submesh> submeshes;
+};
+
+// receives a model of the triangles parsed so far while a model file loads
+using PartialModelCallback = std::function<void(Model&& partialModel)>;
+
+// Blinn-Phong exponent to GGX roughness, where both lobes have about the same width
+float RoughnessFromShininess(float shininessValue);
+
+// the look of faces without a material, shared by every loader
+Material MakeDefaultMaterial(const std::string& name);
+
+// submesh over vertices [firstVertex, firstVertex + vertexCount) with the bounds of those vertices
+Submesh MakeSubmesh(const std::vector<Vertex>& vertices, unsigned int materialIndex, unsigned int firstVertex, unsigned int vertexCount);
+
+// Coarse stand-in for the model by vertex clustering: positions are snapped to
+// the average of a grid of gridResolution cells along the longest axis of the
+// bounds, and triangles whose corners fall into fewer than three cells are
+// dropped, as are repeats of the same three cells. Materials and submeshes are
+// kept, submeshes that collapse entirely are left out. gridResolution is at
+// most 128.
+Model CreateClusteredProxy(const Model& model, unsigned int gridResolution);
@@ -0,0 +1,120 @@
+#include "model_cache.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "file_utility.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "mesh_codec.h"
+#include "model_loader.h"
+
+namespace
+{
+
+// a .meshz file is a cache entry already, decoding it directly is as fast as decoding a copy
+bool IsCompressedModelFile(const std::string& filepath)
+{
+    return GetLowerCaseExtension(filepath) == "meshz";
+}
+
+// the model file's path, size and modification time, and the format version
+bool CalculateKey(const std::string& filepath, unsigned long long& key)
+{
+    struct stat fileStatus;
+    if (stat(filepath.c_str(), &fileStatus) != 0)
+    {
+        return false;
+    }
+
+    char parameters[96];
+    std::snprintf(parameters, sizeof(parameters), "meshz %u %lld %lld", CompressedModelVersion, static_cast<long long>(fileStatus.st_size),
+                  static_cast<long long>(fileStatus.st_mtime));
+    key = HashString(filepath, HashString(parameters));
+
+    return true;
+}
+
+std::string GetCachePath(const std::string& directory, unsigned long long key, const char* suffix)
+{
+    char fileName[48];
+    std::snprintf(fileName, sizeof(fileName), "%016llx%s.meshz", key, suffix);
+
+    return directory + "/" + fileName;
+}
+
+bool LoadCachedModel(const std::string& filepath, unsigned long long key, Model& model, std::size_t& compressedSize)
+{
+    // a missing, stale or corrupt entry is a miss
+    try
+    {
+        const MappedFile file{filepath};
+        if (GetCompressedModelKey(file.GetData(), file.GetSize()) != key)
+        {
+            return false;
+        }
+
+        model = DecodeCompressedModel(file.GetData(), file.GetSize());
+        compressedSize = file.GetSize();
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        // besides decoding errors, a corrupt header can ask for more memory than there is
+        return false;
+    }
+}
+
+} // namespace
+
+Model LoadModelFileCached(const std::string& filepath, const std::string& cacheDirectory, ModelCacheStats& stats,
+                          const PartialModelCallback& onPartialModel)
+{
+    stats = ModelCacheStats{};
+
+    unsigned long long key = 0;
+    if (cacheDirectory.empty() || IsCompressedModelFile(filepath) || CalculateKey(filepath, key) == false)
+    {
+        Model model = LoadModelFile(filepath, onPartialModel);
+        stats.uncompressedSize = model.vertices.size() * sizeof(Vertex);
+        return model;
+    }
+
+    const std::string cachePath = GetCachePath(cacheDirectory, key, "");
+
+    Model model;
+    stats.loadedFromCache = LoadCachedModel(cachePath, key, model, stats.compressedSize);
+    if (stats.loadedFromCache == false)
+    {
+        model = LoadModelFile(filepath, onPartialModel);
+
+        const std::vector<unsigned char> entry = EncodeCompressedModel(model, key);
+        CreateDirectoryIfMissing(cacheDirectory);
+        if (WriteFileAtomically(cachePath, entry))
+        {
+            stats.compressedSize = entry.size();
+
+            // the proxy goes last, so whenever there is one the entry exists too
+            WriteFileAtomically(GetCachePath(cacheDirectory, key, ".proxy"),
+                                EncodeCompressedModel(CreateClusteredProxy(model, ModelProxyGridResolution), key));
+        }
+    }
+
+    stats.uncompressedSize = model.vertices.size() * sizeof(Vertex);
+    return model;
+}
+
+bool LoadCachedModelProxy(const std::string& filepath, const std::string& cacheDirectory, Model& proxy)
+{
+    unsigned long long key = 0;
+    if (cacheDirectory.empty() || IsCompressedModelFile(filepath) || CalculateKey(filepath, key) == false)
+    {
+        return false;
+    }
+
+    std::size_t compressedSize = 0;
+    return LoadCachedModel(GetCachePath(cacheDirectory, key, ".proxy"), key, proxy, compressedSize);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "model.h"
+
+// cells of the proxy along the longest axis of the model, a closed surface becomes some 50K triangles
+const unsigned int ModelProxyGridResolution = 64;
+
+struct ModelCacheStats
+{
+    bool loadedFromCache = false;
+    std::size_t uncompressedSize = 0;  // bytes of the triangle list
+    std::size_t compressedSize = 0;    // bytes of the cache entry, 0 when it couldn't be written
+};
+
+// Loads a model through an on-disk cache of compressed models (mesh_codec.h).
+// Entries are keyed by a hash of the path, size and modification time of the
+// model file, so a changed model is parsed again; material libraries and
+// textures referenced by the model are not part of the key. A miss parses the
+// file with LoadModelFile and writes the entry, which later runs decode on
+// every hardware thread instead of parsing. An empty directory disables the cache,
+// and .meshz files, which are compressed models already, bypass it.
+// Next to every entry goes a coarse proxy of the model (CreateClusteredProxy),
+// small enough to decode in a few milliseconds while the entry is still loading.
+Model LoadModelFileCached(const std::string& filepath, const std::string& cacheDirectory, ModelCacheStats& stats,
+                          const PartialModelCallback& onPartialModel = PartialModelCallback{});
+
+// the proxy cached with the current version of the model file, false when there is none
+bool LoadCachedModelProxy(const std::string& filepath, const std::string& cacheDirectory, Model& proxy);
@@ -0,0 +1,31 @@
+#include "model_loader.h"
+
+#include "file_utility.h"
+#include "gltf_loader.h"
+#include "mesh_codec.h"
+#include "obj_loader.h"
+#include "ply_loader.h"
+#include "stl_loader.h"
+
+Model LoadModelFile(const std::string& filepath, const PartialModelCallback& onPartialModel)
+{
+    const std::string extension = GetLowerCaseExtension(filepath);
+    if (extension == "gltf" || extension == "glb")
+    {
+        return LoadGltfFile(filepath);
+    }
+    if (extension == "meshz")
+    {
+        return LoadCompressedModelFile(filepath);
+    }
+    if (extension == "ply")
+    {
+        return LoadPlyFile(filepath);
+    }
+    if (extension == "stl")
+    {
+        return LoadStlFile(filepath);
+    }
+
+    return LoadObjFile(filepath, onPartialModel);
+}
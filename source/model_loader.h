@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+#include "model.h"
+
+// Loads a model with the loader matching the file extension (case-insensitive):
+// .gltf and .glb by the glTF loader, .ply and .stl by the binary loaders,
+// .meshz is decoded as a compressed model, and anything else loads as OBJ.
+// onPartialModel receives the triangles parsed so far from the OBJ parser, the
+// other loaders are fast enough to deliver only the finished model.
+Model LoadModelFile(const std::string& filepath, const PartialModelCallback& onPartialModel = PartialModelCallback{});
@@ -0,0 +1,538 @@
+#include "obj_loader.h"
+
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "job_system.h"
+
+namespace
+{
+
+// faces parsed between looks at the clock for a partial model
+const unsigned int PartialModelCheckInterval = 4096;
+const std::chrono::milliseconds PartialModelMinimumInterval{100};
+
+// bytes of whole lines parsed per job, and jobs per job system thread read at a time
+const std::size_t ParseChunkSize = 1 << 20;
+const unsigned int ParseChunksPerThread = 2;
+
+struct FaceVertexIndices
+{
+    int positionIndex;
+    int texCoordIndex;   // -1 when the face vertex has no texture coordinate
+    int normalIndex;     // -1 when the face vertex has no normal
+};
+
+// the indices of a face vertex as written in the file, 1-based or negative, 0 for a missing part
+struct RawFaceVertex
+{
+    int position;
+    int texCoord;
+    int normal;
+};
+
+// a line that depends on what came before it in the file, replayed in order after the parse
+struct ObjStatement
+{
+    enum class Type
+    {
+        Face,
+        MaterialLibrary,
+        UseMaterial,
+        Object
+    };
+
+    Type type;
+    std::string name;  // of the library or material
+
+    // face vertices in the chunk's list, and the elements the chunk had parsed before the face
+    std::size_t firstFaceVertex;
+    std::size_t faceVertexCount;
+    std::size_t positionCount;
+    std::size_t texCoordCount;
+    std::size_t normalCount;
+};
+
+// everything one job parsed from a range of lines
+struct ObjChunk
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<RawFaceVertex> faceVertices;
+    std::vector<ObjStatement> statements;
+    std::exception_ptr error;  // rethrown by the loading thread
+};
+
+std::string GetDirectory(const std::string& filepath)
+{
+    const std::size_t separatorIndex = filepath.find_last_of("/\\");
+    if (separatorIndex == std::string::npos)
+    {
+        return "";
+    }
+
+    return filepath.substr(0, separatorIndex + 1);
+}
+
+// converts a 1-based (or negative, relative) OBJ index into a 0-based index, -1 for a missing one
+int ResolveIndex(int index, std::size_t elementCount)
+{
+    if (index == 0)
+    {
+        return -1;
+    }
+
+    if (index < 0)
+    {
+        return static_cast<int>(elementCount) + index;
+    }
+
+    return index - 1;
+}
+
+// parses a face vertex in any of the forms v, v/vt, v//vn and v/vt/vn
+RawFaceVertex ParseFaceVertex(const std::string& vertex)
+{
+    RawFaceVertex indices{0, 0, 0};
+
+    const std::size_t firstSeparatorIndex = vertex.find('/');
+    indices.position = std::stoi(vertex.substr(0, firstSeparatorIndex));
+
+    if (firstSeparatorIndex == std::string::npos)
+    {
+        return indices;
+    }
+
+    const std::size_t secondSeparatorIndex = vertex.find('/', firstSeparatorIndex + 1);
+
+    const std::string texCoordToken = vertex.substr(firstSeparatorIndex + 1, secondSeparatorIndex - firstSeparatorIndex - 1);
+    if (texCoordToken.empty() == false)
+    {
+        indices.texCoord = std::stoi(texCoordToken);
+    }
+
+    if (secondSeparatorIndex != std::string::npos)
+    {
+        indices.normal = std::stoi(vertex.substr(secondSeparatorIndex + 1));
+    }
+
+    return indices;
+}
+
+// resolves a face vertex against the elements parsed before its face
+FaceVertexIndices ResolveFaceVertex(const RawFaceVertex& vertex, std::size_t positionCount, std::size_t texCoordCount, std::size_t normalCount)
+{
+    const FaceVertexIndices indices{ResolveIndex(vertex.position, positionCount), ResolveIndex(vertex.texCoord, texCoordCount),
+                                    ResolveIndex(vertex.normal, normalCount)};
+
+    // missing parts resolve to -1, anything else must lie within the elements parsed so far
+    const auto isDefined = [](int index, std::size_t elementCount) { return index >= -1 && index < static_cast<int>(elementCount); };
+    if (indices.positionIndex < 0 || isDefined(indices.positionIndex, positionCount) == false || isDefined(indices.texCoordIndex, texCoordCount) == false
+        || isDefined(indices.normalIndex, normalCount) == false)
+    {
+        throw std::runtime_error{"OBJ face refers to an undefined vertex"};
+    }
+
+    return indices;
+}
+
+// parses the lines of text[begin, end), which starts and ends at line boundaries
+void ParseObjChunk(const std::string& text, std::size_t begin, std::size_t end, ObjChunk& chunk)
+{
+    std::string line;
+    for (std::size_t lineBegin = begin; lineBegin < end;)
+    {
+        std::size_t lineEnd = text.find('\n', lineBegin);
+        if (lineEnd == std::string::npos || lineEnd > end)
+        {
+            lineEnd = end;
+        }
+        line.assign(text, lineBegin, lineEnd - lineBegin);
+        lineBegin = lineEnd + 1;
+
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream lineStream{line};
+
+        std::string prefix;
+        lineStream >> prefix;
+        if (prefix == "v")
+        {
+            glm::vec3 position;
+
+            lineStream >> position.x;
+            lineStream >> position.y;
+            lineStream >> position.z;
+
+            chunk.positions.push_back(position);
+        }
+        else if (prefix == "vt")
+        {
+            glm::vec2 texCoord;
+
+            lineStream >> texCoord.x;
+            lineStream >> texCoord.y;
+
+            chunk.texCoords.push_back(texCoord);
+        }
+        else if (prefix == "vn")
+        {
+            glm::vec3 normal;
+
+            lineStream >> normal.x;
+            lineStream >> normal.y;
+            lineStream >> normal.z;
+
+            chunk.normals.push_back(normal);
+        }
+        else if (prefix == "mtllib" || prefix == "usemtl" || prefix == "o" || prefix == "g")
+        {
+            ObjStatement statement = ObjStatement();
+            statement.type = (prefix == "mtllib") ? ObjStatement::Type::MaterialLibrary
+                                                  : (prefix == "usemtl") ? ObjStatement::Type::UseMaterial : ObjStatement::Type::Object;
+            lineStream >> statement.name;
+
+            chunk.statements.push_back(std::move(statement));
+        }
+        else if (prefix == "f")
+        {
+            ObjStatement statement = ObjStatement();
+            statement.type = ObjStatement::Type::Face;
+            statement.firstFaceVertex = chunk.faceVertices.size();
+            statement.positionCount = chunk.positions.size();
+            statement.texCoordCount = chunk.texCoords.size();
+            statement.normalCount = chunk.normals.size();
+
+            std::string vertex;
+            while (lineStream >> vertex)
+            {
+                chunk.faceVertices.push_back(ParseFaceVertex(vertex));
+            }
+
+            statement.faceVertexCount = chunk.faceVertices.size() - statement.firstFaceVertex;
+            chunk.statements.push_back(std::move(statement));
+        }
+    }
+}
+
+// loads every material of an MTL file, unspecified properties keep the default material's values
+std::vector<Material> LoadMtlFile(const std::string& filepath)
+{
+    std::vector<Material> materials;
+    std::vector<bool> explicitRoughness;
+
+    std::ifstream file{filepath};
+    if (file.is_open() == false)
+    {
+        throw std::runtime_error{"Failed to open MTL file"};
+    }
+
+    const std::string directory = GetDirectory(filepath);
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream lineStream{line};
+
+        std::string prefix;
+        lineStream >> prefix;
+        if (prefix == "newmtl")
+        {
+            std::string name;
+            lineStream >> name;
+
+            materials.push_back(MakeDefaultMaterial(name));
+            explicitRoughness.push_back(false);
+        }
+        else if (materials.empty())
+        {
+            continue;
+        }
+        else if (prefix == "Ka")
+        {
+            lineStream >> materials.back().ambientColor.x;
+            lineStream >> materials.back().ambientColor.y;
+            lineStream >> materials.back().ambientColor.z;
+        }
+        else if (prefix == "Kd")
+        {
+            lineStream >> materials.back().diffuseColor.x;
+            lineStream >> materials.back().diffuseColor.y;
+            lineStream >> materials.back().diffuseColor.z;
+        }
+        else if (prefix == "Ks")
+        {
+            lineStream >> materials.back().specularColor.x;
+            lineStream >> materials.back().specularColor.y;
+            lineStream >> materials.back().specularColor.z;
+        }
+        else if (prefix == "Ns")
+        {
+            lineStream >> materials.back().shininessValue;
+            if (explicitRoughness.back() == false)
+            {
+                materials.back().roughness = RoughnessFromShininess(materials.back().shininessValue);
+            }
+        }
+        else if (prefix == "Pm")
+        {
+            lineStream >> materials.back().metallic;
+        }
+        else if (prefix == "Pr")
+        {
+            lineStream >> materials.back().roughness;
+            explicitRoughness.back() = true;
+        }
+        else if (prefix == "map_Kd")
+        {
+            // the file name is the last token, anything before it is a texture option
+            std::string textureFile;
+            std::string token;
+            while (lineStream >> token)
+            {
+                textureFile = token;
+            }
+
+            if (textureFile.empty() == false)
+            {
+                materials.back().diffuseTexturePath = directory + textureFile;
+            }
+        }
+    }
+
+    return materials;
+}
+
+// appends the collected vertices to the model, one submesh per object and material
+void AppendSubmeshes(Model& model, const std::map<std::pair<unsigned int, unsigned int>, std::vector<Vertex>>& submeshVertices)
+{
+    for (const auto& submeshEntry : submeshVertices)
+    {
+        const std::vector<Vertex>& vertices = submeshEntry.second;
+        if (vertices.empty())
+        {
+            continue;
+        }
+
+        const unsigned int firstVertex = static_cast<unsigned int>(model.vertices.size());
+        model.vertices.insert(model.vertices.end(), vertices.begin(), vertices.end());
+        model.submeshes.push_back(MakeSubmesh(model.vertices, submeshEntry.first.second, firstVertex, static_cast<unsigned int>(vertices.size())));
+    }
+}
+
+} // namespace
+
+Model LoadObjFile(const std::string& filepath, const PartialModelCallback& onPartialModel)
+{
+    std::ifstream file{filepath, std::ios::binary};
+    if (file.is_open() == false)
+    {
+        throw std::runtime_error{"Failed to open OBJ file"};
+    }
+
+    const std::string directory = GetDirectory(filepath);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+
+    // materials declared by mtllib, only those referenced by usemtl end up in the model
+    std::vector<Material> libraryMaterials;
+
+    // vertices are collected per object and material and concatenated into submeshes at
+    // the end, so every object can be culled on its own and draws still sort by material
+    std::map<std::string, unsigned int> materialIndices;
+    std::map<std::pair<unsigned int, unsigned int>, std::vector<Vertex>> submeshVertices;
+    unsigned int currentMaterial = 0;
+    unsigned int currentObject = 0;
+
+    std::size_t triangleCount = 0;
+    std::size_t partialTriangleCount = 0;
+    unsigned int facesSinceCheck = 0;
+    std::chrono::steady_clock::time_point partialModelTime;
+
+    Model model;
+    model.materials.push_back(MakeDefaultMaterial("default"));
+
+    // The file is read a few chunks per thread at a time. Jobs parse the numbers of
+    // each chunk, then the statements are replayed in file order, since faces refer
+    // to the elements before them and use the current material and object.
+    JobSystem& jobSystem = GetSharedJobSystem();
+    const std::size_t readSize = ParseChunkSize * ParseChunksPerThread * jobSystem.GetThreadCount();
+
+    std::string text;
+    std::vector<ObjChunk> chunks;
+    while (file)
+    {
+        // the lines started at the end of the last read are completed by this one
+        const std::size_t carriedSize = text.size();
+        text.resize(carriedSize + readSize);
+        file.read(&text[carriedSize], static_cast<std::streamsize>(readSize));
+        text.resize(carriedSize + static_cast<std::size_t>(file.gcount()));
+
+        std::size_t parseEnd = text.size();
+        if (file)
+        {
+            const std::size_t lastNewline = text.rfind('\n');
+            parseEnd = (lastNewline == std::string::npos) ? 0 : lastNewline + 1;
+        }
+
+        std::vector<std::size_t> chunkBegins;
+        for (std::size_t chunkBegin = 0; chunkBegin < parseEnd;)
+        {
+            chunkBegins.push_back(chunkBegin);
+
+            const std::size_t newline = (chunkBegin + ParseChunkSize < parseEnd) ? text.find('\n', chunkBegin + ParseChunkSize) : std::string::npos;
+            chunkBegin = (newline == std::string::npos || newline >= parseEnd) ? parseEnd : newline + 1;
+        }
+        chunkBegins.push_back(parseEnd);
+
+        chunks.assign(chunkBegins.size() - 1, ObjChunk{});
+        jobSystem.ParallelFor(chunks.size(), 1, [&text, &chunkBegins, &chunks](std::size_t first, std::size_t end)
+        {
+            for (std::size_t chunk = first; chunk < end; ++chunk)
+            {
+                try
+                {
+                    ParseObjChunk(text, chunkBegins[chunk], chunkBegins[chunk + 1], chunks[chunk]);
+                }
+                catch (...)
+                {
+                    chunks[chunk].error = std::current_exception();
+                }
+            }
+        });
+        text.erase(0, parseEnd);
+
+        for (ObjChunk& chunk : chunks)
+        {
+            if (chunk.error)
+            {
+                std::rethrow_exception(chunk.error);
+            }
+
+            const std::size_t positionBase = positions.size();
+            const std::size_t texCoordBase = texCoords.size();
+            const std::size_t normalBase = normals.size();
+            positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+            texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+            for (const ObjStatement& statement : chunk.statements)
+            {
+                if (statement.type == ObjStatement::Type::MaterialLibrary)
+                {
+                    const std::vector<Material> materials = LoadMtlFile(directory + statement.name);
+                    libraryMaterials.insert(libraryMaterials.end(), materials.begin(), materials.end());
+                }
+                else if (statement.type == ObjStatement::Type::UseMaterial)
+                {
+                    const auto indexIt = materialIndices.find(statement.name);
+                    if (indexIt != materialIndices.end())
+                    {
+                        currentMaterial = indexIt->second;
+                        continue;
+                    }
+
+                    // unknown materials fall back to the default look but still get their own submesh
+                    Material material = MakeDefaultMaterial(statement.name);
+                    for (const auto& libraryMaterial : libraryMaterials)
+                    {
+                        if (libraryMaterial.name == statement.name)
+                        {
+                            material = libraryMaterial;
+                        }
+                    }
+
+                    currentMaterial = static_cast<unsigned int>(model.materials.size());
+                    materialIndices[statement.name] = currentMaterial;
+
+                    model.materials.push_back(material);
+                }
+                else if (statement.type == ObjStatement::Type::Object)
+                {
+                    ++currentObject;
+                }
+                else
+                {
+                    std::vector<Vertex> polygon;
+                    for (std::size_t i = statement.firstFaceVertex; i < statement.firstFaceVertex + statement.faceVertexCount; ++i)
+                    {
+                        const FaceVertexIndices indices = ResolveFaceVertex(chunk.faceVertices[i], positionBase + statement.positionCount,
+                                                                            texCoordBase + statement.texCoordCount, normalBase + statement.normalCount);
+
+                        Vertex faceVertex;
+                        faceVertex.position = positions[indices.positionIndex];
+                        faceVertex.texCoord = (indices.texCoordIndex >= 0) ? texCoords[indices.texCoordIndex] : glm::vec2{0.0f, 0.0f};
+                        faceVertex.normal = (indices.normalIndex >= 0) ? normals[indices.normalIndex] : glm::vec3{0.0f, 0.0f, 0.0f};
+
+                        polygon.push_back(faceVertex);
+                    }
+
+                    if (polygon.size() < 3)
+                    {
+                        continue;
+                    }
+
+                    // faces without normals get the flat face normal
+                    const glm::vec3 faceNormal = glm::normalize(glm::cross(polygon[1].position - polygon[0].position, polygon[2].position - polygon[0].position));
+                    for (auto& polygonVertex : polygon)
+                    {
+                        if (polygonVertex.normal == glm::vec3{0.0f, 0.0f, 0.0f})
+                        {
+                            polygonVertex.normal = faceNormal;
+                        }
+                    }
+
+                    // triangulate quads and larger polygons as a fan around the first vertex
+                    std::vector<Vertex>& vertices = submeshVertices[std::make_pair(currentObject, currentMaterial)];
+                    for (std::size_t i = 1; i + 1 < polygon.size(); ++i)
+                    {
+                        vertices.push_back(polygon[0]);
+                        vertices.push_back(polygon[i]);
+                        vertices.push_back(polygon[i + 1]);
+                    }
+                    triangleCount += polygon.size() - 2;
+
+                    // copying the partial model each time the triangle count doubles costs at most one more copy of the whole
+                    if (onPartialModel && ++facesSinceCheck == PartialModelCheckInterval)
+                    {
+                        facesSinceCheck = 0;
+
+                        const auto now = std::chrono::steady_clock::now();
+                        if (partialTriangleCount == 0 || (triangleCount >= 2 * partialTriangleCount && now - partialModelTime >= PartialModelMinimumInterval))
+                        {
+                            Model partialModel;
+                            partialModel.materials = model.materials;
+                            AppendSubmeshes(partialModel, submeshVertices);
+                            onPartialModel(std::move(partialModel));
+
+                            partialTriangleCount = triangleCount;
+                            partialModelTime = now;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    file.close();
+
+    AppendSubmeshes(model, submeshVertices);
+
+    return model;
+}
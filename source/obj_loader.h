@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+#include "model.h"
+
+// Loads a 3D model from an OBJ file.
+// Handles vertex positions (v), texture coordinates (vt), normals (vn) and the
+// materials (Ka, Kd, Ks, Ns, map_Kd) of the libraries referenced by mtllib.
+// Vertices are grouped into one submesh per material in use, faces that come
+// before any usemtl get a default material.
+// onPartialModel, when given, is called on the loading thread with everything
+// parsed so far, first after a few thousand faces and then whenever the
+// triangle count has doubled and a tenth of a second has passed.
+Model LoadObjFile(const std::string& filepath, const PartialModelCallback& onPartialModel = PartialModelCallback{});
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Screen-space occluder triangle set up for rasterization into a float depth
+// buffer whose rows start at the bottom of the screen. Pixel (x, y) is covered
+// when all three edge functions a*x + b*y + c are non-negative at its center;
+// the constants are pulled in by half a pixel so that only pixels the triangle
+// covers completely pass. The depth plane is pushed back by the same amount,
+// so its value at a pixel center is the farthest depth the triangle has over
+// that pixel. Both keep the occlusion buffer conservative.
+struct OccluderTriangle
+{
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+
+    float depthA;
+    float depthB;
+    float depthC;
+
+    // inclusive pixel bounds, minX is rounded down to a multiple of 8
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+// Rasterizes the triangles into rows [firstRow, firstRow + rowCount) of the depth buffer,
+// keeping the nearest depth per pixel. The width must be a multiple of 8.
+void RasterizeOccludersScalar(const OccluderTriangle* triangles, std::size_t triangleCount, float* depths, int width, int firstRow, int rowCount);
+
+// Same result 8 pixels at a time. Built with AVX2 and FMA enabled in a translation unit of its
+// own (x86-64 only, RASTER_AVX2), call it only when the CPU supports both.
+void RasterizeOccludersAvx2(const OccluderTriangle* triangles, std::size_t triangleCount, float* depths, int width, int firstRow, int rowCount);
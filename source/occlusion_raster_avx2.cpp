@@ -0,0 +1,63 @@
+#include "occlusion_raster.h"
+
+#include <immintrin.h>
+
+// This file is compiled with AVX2 enabled. It must not call inline functions from
+// other headers: the linker may keep this file's AVX2 copy for the whole program.
+
+void RasterizeOccludersAvx2(const OccluderTriangle* triangles, std::size_t triangleCount, float* depths, int width, int firstRow, int rowCount)
+{
+    const int lastRow = firstRow + rowCount - 1;
+    const __m256 laneCenters = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const OccluderTriangle& triangle = triangles[i];
+        if (triangle.maxY < firstRow || triangle.minY > lastRow)
+        {
+            continue;
+        }
+
+        const int minY = (triangle.minY > firstRow) ? triangle.minY : firstRow;
+        const int maxY = (triangle.maxY < lastRow) ? triangle.maxY : lastRow;
+
+        const __m256 edgeA0 = _mm256_set1_ps(triangle.edgeA[0]);
+        const __m256 edgeA1 = _mm256_set1_ps(triangle.edgeA[1]);
+        const __m256 edgeA2 = _mm256_set1_ps(triangle.edgeA[2]);
+        const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float centerY = static_cast<float>(y) + 0.5f;
+
+            // the y part of every plane is constant along the row
+            const __m256 rowEdge0 = _mm256_set1_ps(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+            const __m256 rowEdge1 = _mm256_set1_ps(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+            const __m256 rowEdge2 = _mm256_set1_ps(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+            const __m256 rowDepth = _mm256_set1_ps(triangle.depthB * centerY + triangle.depthC);
+
+            float* row = depths + y * width;
+
+            for (int x = triangle.minX; x <= triangle.maxX; x += 8)
+            {
+                const __m256 centerX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneCenters);
+
+                const __m256 edge0 = _mm256_fmadd_ps(edgeA0, centerX, rowEdge0);
+                const __m256 edge1 = _mm256_fmadd_ps(edgeA1, centerX, rowEdge1);
+                const __m256 edge2 = _mm256_fmadd_ps(edgeA2, centerX, rowEdge2);
+
+                const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(edge0, zero, _CMP_GE_OQ), _mm256_cmp_ps(edge1, zero, _CMP_GE_OQ)),
+                                                    _mm256_cmp_ps(edge2, zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0)
+                {
+                    continue;
+                }
+
+                const __m256 depth = _mm256_fmadd_ps(depthA, centerX, rowDepth);
+                const __m256 previous = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(previous, _mm256_min_ps(previous, depth), inside));
+            }
+        }
+    }
+}
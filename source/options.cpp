@@ -0,0 +1,294 @@
+#include "options.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+const char* usage =
+    "usage: opengl-model-viewer [options] [model.obj|.ply|.stl|.gltf|.glb|.meshz]\n"
+    "  --shader-dir <dir>     directory of the GLSL shader sources (default: ../shaders)\n"
+    "  --shader-cache <dir>   directory of cached shader program binaries (default: shader_cache)\n"
+    "  --no-shader-cache      always compile shaders from source\n"
+    "  --model-cache <dir>    directory of compressed models decoded instead of parsing (default: model_cache)\n"
+    "  --no-model-cache       always parse the model file\n"
+    "  --renderer <name>      forward, clustered or deferred (default: forward)\n"
+    "  --shading <model>      phong or pbr, pbr needs the forward or clustered renderer (default: phong)\n"
+    "  --environment <image>  equirectangular environment lighting the pbr shading (default: built-in sky)\n"
+    "  --ibl-cache <dir>      directory of precomputed environment lighting (default: ibl_cache)\n"
+    "  --no-ibl-cache         always precompute the environment lighting\n"
+    "  --lights <count>       animated point lights added to the key light (default: 0)\n"
+    "  --depth-prepass        lay down depth first and shade only visible fragments\n"
+    "  --overdraw             show the number of shaded fragments per pixel\n"
+    "  --shadows              cascaded shadow maps of the key light\n"
+    "  --shadow-map-size <n>  texels along each side of a shadow cascade (default: 2048)\n"
+    "  --shadow-cascades <n>  shadow cascades from 1 to 4 (default: 4)\n"
+    "  --ssao                 screen-space ambient occlusion of the ambient term\n"
+    "  --ssao-resolution <r>  resolution of the occlusion estimate: half or quarter (default: half)\n"
+    "  --aa <mode>            antialiasing: off, msaa, msaa-window or fxaa (default: off)\n"
+    "  --msaa-samples <n>     samples per pixel of both MSAA modes (default: 4)\n"
+    "  --occlusion <mode>     occlusion culling: off, cpu or gpu (Hi-Z), software (default: off)\n"
+    "  --occlusion-benchmark  measure the software occlusion rasterizer and exit\n"
+    "  --meshlets             cull meshlets outside the frustum or facing away on the CPU\n"
+    "  --meshlet-benchmark    measure meshlet culling and exit\n"
+    "  --job-benchmark        measure how the job system scales with the thread count and exit\n"
+    "  --no-render-thread     prepare and submit every frame on the main thread\n"
+    "  --software <png>       render on the CPU without a window, report the speed per thread count and exit\n"
+    "  --compare-software     compare the GL frame with the software renderer's once per second\n"
+    "  --capture <path>       record every frame, into a directory of PNG files or a video file through ffmpeg\n"
+    "  --capture-fps <n>      frame rate of the captured video (default: 60)";
+
+std::string GetOptionValue(int argc, char* argv[], int& index)
+{
+    if (index + 1 >= argc)
+    {
+        throw std::runtime_error{std::string{"missing value for "} + argv[index] + "\n" + usage};
+    }
+
+    return argv[++index];
+}
+
+unsigned int ParseCount(const std::string& option, const std::string& value)
+{
+    std::size_t parsedLength = 0;
+    unsigned long count = 0;
+    try
+    {
+        count = std::stoul(value, &parsedLength);
+    }
+    catch (const std::logic_error&)
+    {
+        parsedLength = 0;
+    }
+
+    if (parsedLength != value.size() || value.empty() || value[0] == '-')
+    {
+        throw std::runtime_error{"invalid value " + value + " for " + option + "\n" + usage};
+    }
+
+    return static_cast<unsigned int>(count);
+}
+
+} // namespace
+
+Options ParseCommandLine(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+
+        if (argument == "--shader-dir")
+        {
+            options.shaderDirectory = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--shader-cache")
+        {
+            options.shaderCacheDirectory = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--no-shader-cache")
+        {
+            options.shaderCacheDirectory.clear();
+        }
+        else if (argument == "--model-cache")
+        {
+            options.modelCacheDirectory = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--no-model-cache")
+        {
+            options.modelCacheDirectory.clear();
+        }
+        else if (argument == "--renderer")
+        {
+            const std::string renderer = GetOptionValue(argc, argv, i);
+            if (renderer == "forward")
+            {
+                options.renderer = Renderer::Forward;
+            }
+            else if (renderer == "clustered")
+            {
+                options.renderer = Renderer::Clustered;
+            }
+            else if (renderer == "deferred")
+            {
+                options.renderer = Renderer::Deferred;
+            }
+            else
+            {
+                throw std::runtime_error{"unknown renderer " + renderer + "\n" + usage};
+            }
+        }
+        else if (argument == "--shading")
+        {
+            const std::string shading = GetOptionValue(argc, argv, i);
+            if (shading == "phong")
+            {
+                options.shading = Shading::Phong;
+            }
+            else if (shading == "pbr")
+            {
+                options.shading = Shading::Pbr;
+            }
+            else
+            {
+                throw std::runtime_error{"unknown shading model " + shading + "\n" + usage};
+            }
+        }
+        else if (argument == "--environment")
+        {
+            options.environmentPath = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--ibl-cache")
+        {
+            options.environmentCacheDirectory = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--no-ibl-cache")
+        {
+            options.environmentCacheDirectory.clear();
+        }
+        else if (argument == "--lights")
+        {
+            options.lightCount = ParseCount(argument, GetOptionValue(argc, argv, i));
+        }
+        else if (argument == "--depth-prepass")
+        {
+            options.depthPrepass = true;
+        }
+        else if (argument == "--overdraw")
+        {
+            options.overdrawView = true;
+        }
+        else if (argument == "--shadows")
+        {
+            options.shadows = true;
+        }
+        else if (argument == "--shadow-map-size")
+        {
+            options.shadowMapSize = std::max(16u, ParseCount(argument, GetOptionValue(argc, argv, i)));
+        }
+        else if (argument == "--shadow-cascades")
+        {
+            options.shadowCascades = std::max(1u, std::min(4u, ParseCount(argument, GetOptionValue(argc, argv, i))));
+        }
+        else if (argument == "--ssao")
+        {
+            options.ambientOcclusion = true;
+        }
+        else if (argument == "--ssao-resolution")
+        {
+            const std::string resolution = GetOptionValue(argc, argv, i);
+            if (resolution == "half")
+            {
+                options.ambientOcclusionDivisor = 2;
+            }
+            else if (resolution == "quarter")
+            {
+                options.ambientOcclusionDivisor = 4;
+            }
+            else
+            {
+                throw std::runtime_error{"unknown ssao resolution " + resolution + "\n" + usage};
+            }
+        }
+        else if (argument == "--aa")
+        {
+            const std::string mode = GetOptionValue(argc, argv, i);
+            if (mode == "off")
+            {
+                options.antialiasing = Antialiasing::Off;
+            }
+            else if (mode == "msaa")
+            {
+                options.antialiasing = Antialiasing::Msaa;
+            }
+            else if (mode == "msaa-window")
+            {
+                options.antialiasing = Antialiasing::MsaaWindow;
+            }
+            else if (mode == "fxaa")
+            {
+                options.antialiasing = Antialiasing::Fxaa;
+            }
+            else
+            {
+                throw std::runtime_error{"unknown antialiasing mode " + mode + "\n" + usage};
+            }
+        }
+        else if (argument == "--msaa-samples")
+        {
+            options.msaaSamples = std::max(1u, ParseCount(argument, GetOptionValue(argc, argv, i)));
+        }
+        else if (argument == "--occlusion")
+        {
+            const std::string mode = GetOptionValue(argc, argv, i);
+            if (mode == "off")
+            {
+                options.occlusionCulling = OcclusionCulling::Off;
+            }
+            else if (mode == "cpu")
+            {
+                options.occlusionCulling = OcclusionCulling::Cpu;
+            }
+            else if (mode == "gpu")
+            {
+                options.occlusionCulling = OcclusionCulling::Gpu;
+            }
+            else if (mode == "software")
+            {
+                options.occlusionCulling = OcclusionCulling::Software;
+            }
+            else
+            {
+                throw std::runtime_error{"unknown occlusion culling mode " + mode + "\n" + usage};
+            }
+        }
+        else if (argument == "--occlusion-benchmark")
+        {
+            options.occlusionBenchmark = true;
+        }
+        else if (argument == "--meshlets")
+        {
+            options.meshlets = true;
+        }
+        else if (argument == "--meshlet-benchmark")
+        {
+            options.meshletBenchmark = true;
+        }
+        else if (argument == "--job-benchmark")
+        {
+            options.jobBenchmark = true;
+        }
+        else if (argument == "--no-render-thread")
+        {
+            options.renderThread = false;
+        }
+        else if (argument == "--software")
+        {
+            options.softwareRenderPath = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--compare-software")
+        {
+            options.compareSoftwareRenderer = true;
+        }
+        else if (argument == "--capture")
+        {
+            options.capturePath = GetOptionValue(argc, argv, i);
+        }
+        else if (argument == "--capture-fps")
+        {
+            options.captureFrameRate = std::max(1u, ParseCount(argument, GetOptionValue(argc, argv, i)));
+        }
+        else if (argument.empty() == false && argument[0] == '-')
+        {
+            throw std::runtime_error{"unknown option " + argument + "\n" + usage};
+        }
+        else
+        {
+            options.modelPath = argument;
+        }
+    }
+
+    return options;
+}
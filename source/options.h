@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+
+enum class Renderer
+{
+    Forward,
+    Clustered,
+    Deferred
+};
+
+enum class Shading
+{
+    Phong,
+    Pbr  // metallic-roughness GGX with precomputed image-based lighting
+};
+
+enum class OcclusionCulling
+{
+    Off,
+    Cpu,      // Hi-Z pyramid read back and tested on the CPU
+    Gpu,      // Hi-Z pyramid tested by a compute shader, needs GL 4.3
+    Software  // occluders rasterized on the CPU, no readback latency
+};
+
+enum class Antialiasing
+{
+    Off,
+    Msaa,        // multisampled offscreen framebuffer resolved with glBlitFramebuffer
+    MsaaWindow,  // multisampled default framebuffer, resolved by the driver on swap
+    Fxaa         // post-process filter of the single-sampled image
+};
+
+struct Options
+{
+    std::string modelPath = "../assets/tetrahedron.obj";
+
+    // directory of the GLSL sources, watched for changes while the viewer runs
+    std::string shaderDirectory = "../shaders";
+
+    // directory of cached program binaries, empty disables the cache
+    std::string shaderCacheDirectory = "shader_cache";
+
+    // directory of compressed models, empty disables the cache
+    std::string modelCacheDirectory = "model_cache";
+
+    Renderer renderer = Renderer::Forward;
+
+    Shading shading = Shading::Phong;
+
+    // equirectangular environment image lighting the PBR shader, empty for the built-in sky
+    std::string environmentPath;
+
+    // directory of precomputed environment lighting, empty disables the cache
+    std::string environmentCacheDirectory = "ibl_cache";
+
+    // animated point lights added to the key light
+    unsigned int lightCount = 0;
+
+    // depth-only pass before shading, which then runs with GL_EQUAL
+    bool depthPrepass = false;
+
+    // show fragments shaded per pixel as a heat map instead of the lit scene
+    bool overdrawView = false;
+
+    // cascaded shadow maps of the key light
+    bool shadows = false;
+    unsigned int shadowMapSize = 2048;
+    unsigned int shadowCascades = 4;
+
+    // screen-space ambient occlusion, estimated at 1/ambientOcclusionDivisor of the resolution along each axis
+    bool ambientOcclusion = false;
+    unsigned int ambientOcclusionDivisor = 2;
+
+    Antialiasing antialiasing = Antialiasing::Off;
+
+    // samples per pixel of both MSAA modes
+    unsigned int msaaSamples = 4;
+
+    OcclusionCulling occlusionCulling = OcclusionCulling::Off;
+
+    // measure the software occlusion rasterizer on the model and exit, needs no window or GPU
+    bool occlusionBenchmark = false;
+
+    // split the model into meshlets and cull those outside the frustum or facing away on the CPU every frame
+    bool meshlets = false;
+
+    // measure meshlet culling on the model and exit, needs no window or GPU
+    bool meshletBenchmark = false;
+
+    // measure how the job system scales with the thread count and exit, needs no window or GPU
+    bool jobBenchmark = false;
+
+    // submit frames on a thread owning the GL context while the main thread prepares the next one
+    bool renderThread = true;
+
+    // render the model on the CPU without a window or GPU, write the image here and exit
+    std::string softwareRenderPath;
+
+    // render every reported frame again with the software renderer and print how far it is off
+    bool compareSoftwareRenderer = false;
+
+    // record the frames as PNG files in this directory, or as a video when it ends in .mp4, .mkv, .mov, .webm or .avi
+    std::string capturePath;
+    unsigned int captureFrameRate = 60;
+};
+
+// Parses "opengl-model-viewer [options] [model.obj|.ply|.stl|.gltf|.glb|.meshz]", throws on unknown options.
+Options ParseCommandLine(int argc, char* argv[]);
@@ -0,0 +1,134 @@
+#include "overdraw_view.h"
+
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+const int FragmentCountTextureUnit = 2;
+
+} // namespace
+
+OverdrawView::OverdrawView(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, int width, int height)
+    : width{width},
+      height{height}
+{
+    const std::vector<SamplerBinding> samplerBindings{{"fragmentCountTexture", FragmentCountTextureUnit}};
+
+    heatmapShaders.reset(new ShaderPermutationSet{shaderCache, vertexShaderSource, fragmentShaderSource, {}, samplerBindings});
+    heatmapPermutation = heatmapShaders->Add({});
+    heatmapShaders->CompileAll();
+
+    glGenVertexArrays(1, &emptyVertexArray);
+
+    CreateTargets();
+}
+
+OverdrawView::~OverdrawView()
+{
+    DestroyTargets();
+
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+void OverdrawView::Resize(int width, int height)
+{
+    if ((width == this->width && height == this->height) || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DestroyTargets();
+    CreateTargets();
+}
+
+void OverdrawView::Render(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass, bool useDepthPrepass, const DrawVisibility& visibility)
+{
+    const float clearZero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const float clearDepth = 1.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glClearBufferfv(GL_COLOR, 0, clearZero);
+    glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+    if (useDepthPrepass)
+    {
+        depthPrepass.Submit(drawList, visibility);
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    depthPrepass.SubmitFragmentCount(drawList, visibility);
+
+    glDisable(GL_BLEND);
+
+    if (useDepthPrepass)
+    {
+        depthPrepass.EndShadingPass();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0 + FragmentCountTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, countTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(heatmapShaders->GetProgram(heatmapPermutation));
+    glBindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void OverdrawView::ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    heatmapShaders->Reload(vertexShaderSource, fragmentShaderSource);
+}
+
+bool OverdrawView::UpdateShaders()
+{
+    return heatmapShaders->Update();
+}
+
+void OverdrawView::CreateTargets()
+{
+    glGenTextures(1, &countTexture);
+    glBindTexture(GL_TEXTURE_2D, countTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, countTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{"overdraw framebuffer is incomplete"};
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OverdrawView::DestroyTargets()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    glDeleteTextures(1, &countTexture);
+}
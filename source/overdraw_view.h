@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "depth_prepass.h"
+
+// Debug view of how many fragments are shaded per pixel. The scene is drawn
+// into a GL_R16F target with additive blending, each fragment that passes the
+// depth test adding one, under the same depth setup as normal rendering
+// (plain GL_LESS, or the pre-pass followed by GL_EQUAL), and the counts are
+// shown as a heat map.
+class OverdrawView
+{
+public:
+    OverdrawView(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, int width, int height);
+    ~OverdrawView();
+
+    OverdrawView(const OverdrawView&) = delete;
+    OverdrawView& operator=(const OverdrawView&) = delete;
+
+    // reallocates the count target when the framebuffer size changed
+    void Resize(int width, int height);
+
+    // counts the fragments of the draw list and draws the heat map to the default framebuffer
+    void Render(const std::vector<DrawCommand>& drawList, DepthPrepass& depthPrepass, bool useDepthPrepass,
+                const DrawVisibility& visibility = DrawVisibility{});
+
+    void ReloadShaders(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool UpdateShaders();
+
+private:
+    void CreateTargets();
+    void DestroyTargets();
+
+    std::unique_ptr<ShaderPermutationSet> heatmapShaders;
+    ShaderPermutation heatmapPermutation;
+
+    int width;
+    int height;
+
+    unsigned int countTexture;
+    unsigned int depthRenderbuffer;
+    unsigned int framebuffer;
+    unsigned int emptyVertexArray;
+};
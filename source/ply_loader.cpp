@@ -0,0 +1,643 @@
+#include "ply_loader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "job_system.h"
+#include "mapped_file.h"
+
+namespace
+{
+
+// faces or vertices whose normals are computed per job
+const std::size_t NormalGrainSize = 4096;
+
+enum class PlyType
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+};
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type;
+
+    // list properties store a count of countType followed by that many values of type
+    bool isList;
+    PlyType countType;
+};
+
+struct PlyElement
+{
+    std::string name;
+    std::size_t count;
+    std::vector<PlyProperty> properties;
+};
+
+// byte offset and type of a Vertex float inside a PLY vertex, offset -1 when the file doesn't have it
+struct VertexFieldSource
+{
+    int offset;
+    PlyType type;
+};
+
+// the eight floats of Vertex in memory order with the property names exporters use for them
+const int VertexFieldCount = 8;
+const char* const VertexFieldNames[VertexFieldCount][3] = {
+    {"x", "", ""},
+    {"y", "", ""},
+    {"z", "", ""},
+    {"nx", "", ""},
+    {"ny", "", ""},
+    {"nz", "", ""},
+    {"u", "s", "texture_u"},
+    {"v", "t", "texture_v"}};
+
+PlyType ParsePlyType(const std::string& name)
+{
+    if (name == "char" || name == "int8")
+    {
+        return PlyType::Int8;
+    }
+    if (name == "uchar" || name == "uint8")
+    {
+        return PlyType::UInt8;
+    }
+    if (name == "short" || name == "int16")
+    {
+        return PlyType::Int16;
+    }
+    if (name == "ushort" || name == "uint16")
+    {
+        return PlyType::UInt16;
+    }
+    if (name == "int" || name == "int32")
+    {
+        return PlyType::Int32;
+    }
+    if (name == "uint" || name == "uint32")
+    {
+        return PlyType::UInt32;
+    }
+    if (name == "float" || name == "float32")
+    {
+        return PlyType::Float32;
+    }
+    if (name == "double" || name == "float64")
+    {
+        return PlyType::Float64;
+    }
+
+    throw std::runtime_error{"unknown PLY property type " + name};
+}
+
+std::size_t GetTypeSize(PlyType type)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    case PlyType::Float64:
+        return 8;
+    }
+
+    return 0;
+}
+
+bool IsLittleEndianHost()
+{
+    const std::uint16_t value = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &value, 1);
+
+    return firstByte == 1;
+}
+
+double ReadValue(const unsigned char* data, PlyType type, bool swapBytes)
+{
+    unsigned char bytes[8];
+    const std::size_t size = GetTypeSize(type);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        bytes[i] = swapBytes ? data[size - 1 - i] : data[i];
+    }
+
+    switch (type)
+    {
+    case PlyType::Int8:
+        return static_cast<signed char>(bytes[0]);
+    case PlyType::UInt8:
+        return bytes[0];
+    case PlyType::Int16:
+    {
+        std::int16_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::UInt16:
+    {
+        std::uint16_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Int32:
+    {
+        std::int32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::UInt32:
+    {
+        std::uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Float32:
+    {
+        float value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Float64:
+    {
+        double value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    }
+
+    return 0.0;
+}
+
+// bytes of one element starting at data, which only varies with list properties; throws when the element reaches past end
+std::size_t GetElementSize(const PlyElement& element, const unsigned char* data, const unsigned char* end, bool swapBytes)
+{
+    // sizes are compared with the remaining bytes, so counts from the file can't overflow them
+    const std::size_t remaining = static_cast<std::size_t>(end - data);
+
+    std::size_t size = 0;
+    for (const auto& property : element.properties)
+    {
+        if (property.isList)
+        {
+            if (GetTypeSize(property.countType) > remaining - size)
+            {
+                throw std::runtime_error{"PLY file is truncated"};
+            }
+
+            const std::size_t count = static_cast<std::size_t>(ReadValue(data + size, property.countType, swapBytes));
+            size += GetTypeSize(property.countType);
+            if (count > (remaining - size) / GetTypeSize(property.type))
+            {
+                throw std::runtime_error{"PLY file is truncated"};
+            }
+            size += count * GetTypeSize(property.type);
+        }
+        else
+        {
+            if (GetTypeSize(property.type) > remaining - size)
+            {
+                throw std::runtime_error{"PLY file is truncated"};
+            }
+            size += GetTypeSize(property.type);
+        }
+    }
+
+    return size;
+}
+
+// parses the header up to end_header and returns the offset of the first data byte
+std::size_t ParseHeader(const unsigned char* data, std::size_t size, std::vector<PlyElement>& elements, bool& littleEndian)
+{
+    const char* const text = reinterpret_cast<const char*>(data);
+    if (size < 4 || std::memcmp(text, "ply", 3) != 0 || (text[3] != '\n' && text[3] != '\r'))
+    {
+        throw std::runtime_error{"Not a PLY file"};
+    }
+
+    bool formatFound = false;
+    std::size_t lineBegin = 0;
+    while (lineBegin < size)
+    {
+        std::size_t lineEnd = lineBegin;
+        while (lineEnd < size && text[lineEnd] != '\n')
+        {
+            ++lineEnd;
+        }
+        if (lineEnd == size)
+        {
+            break;
+        }
+
+        std::istringstream lineStream{std::string{text + lineBegin, lineEnd - lineBegin}};
+        lineBegin = lineEnd + 1;
+
+        std::string keyword;
+        lineStream >> keyword;
+        if (keyword == "format")
+        {
+            std::string format;
+            lineStream >> format;
+            if (format == "binary_little_endian")
+            {
+                littleEndian = true;
+            }
+            else if (format == "binary_big_endian")
+            {
+                littleEndian = false;
+            }
+            else
+            {
+                throw std::runtime_error{"Only binary PLY files are supported, not " + format};
+            }
+            formatFound = true;
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element;
+            lineStream >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+            {
+                throw std::runtime_error{"PLY property before any element"};
+            }
+
+            PlyProperty property;
+            std::string typeName;
+            lineStream >> typeName;
+            property.isList = (typeName == "list");
+            if (property.isList)
+            {
+                std::string countTypeName;
+                lineStream >> countTypeName >> typeName;
+                property.countType = ParsePlyType(countTypeName);
+            }
+            else
+            {
+                property.countType = PlyType::UInt8;
+            }
+            property.type = ParsePlyType(typeName);
+            lineStream >> property.name;
+
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header")
+        {
+            if (formatFound == false)
+            {
+                throw std::runtime_error{"PLY header has no format"};
+            }
+
+            return lineBegin;
+        }
+    }
+
+    throw std::runtime_error{"PLY header has no end_header"};
+}
+
+std::vector<Vertex> ReadVertices(const PlyElement& element, const unsigned char* data, const unsigned char* end, bool swapBytes)
+{
+    VertexFieldSource sources[VertexFieldCount];
+    for (auto& source : sources)
+    {
+        source.offset = -1;
+        source.type = PlyType::Float32;
+    }
+
+    std::size_t stride = 0;
+    for (const auto& property : element.properties)
+    {
+        if (property.isList)
+        {
+            throw std::runtime_error{"list properties on PLY vertices are not supported"};
+        }
+
+        for (int field = 0; field < VertexFieldCount; ++field)
+        {
+            for (const char* name : VertexFieldNames[field])
+            {
+                if (property.name == name && sources[field].offset < 0)
+                {
+                    sources[field].offset = static_cast<int>(stride);
+                    sources[field].type = property.type;
+                }
+            }
+        }
+        stride += GetTypeSize(property.type);
+    }
+
+    if (sources[0].offset < 0 || sources[1].offset < 0 || sources[2].offset < 0)
+    {
+        throw std::runtime_error{"PLY vertices have no position"};
+    }
+    if (element.count > static_cast<std::size_t>(end - data) / stride)
+    {
+        throw std::runtime_error{"PLY file is truncated"};
+    }
+
+    std::vector<Vertex> vertices(element.count);
+
+    bool floatsInHostOrder = (swapBytes == false);
+    bool matchesVertexLayout = (stride == sizeof(Vertex));
+    for (int field = 0; field < VertexFieldCount; ++field)
+    {
+        const bool isFloat = (sources[field].offset < 0 || sources[field].type == PlyType::Float32);
+        floatsInHostOrder = floatsInHostOrder && isFloat;
+        matchesVertexLayout = matchesVertexLayout && sources[field].offset == field * static_cast<int>(sizeof(float));
+    }
+
+    if (floatsInHostOrder && matchesVertexLayout)
+    {
+        // x y z nx ny nz u v as floats is exactly Vertex
+        std::memcpy(vertices.data(), data, element.count * sizeof(Vertex));
+    }
+    else if (floatsInHostOrder)
+    {
+        // the common scanner layouts (x y z, x y z nx ny nz, with colours or confidence in between) are a strided gather
+        for (std::size_t i = 0; i < element.count; ++i)
+        {
+            const unsigned char* source = data + i * stride;
+            float* destination = &vertices[i].position.x;
+            for (int field = 0; field < VertexFieldCount; ++field)
+            {
+                if (sources[field].offset >= 0)
+                {
+                    std::memcpy(destination + field, source + sources[field].offset, sizeof(float));
+                }
+                else
+                {
+                    destination[field] = 0.0f;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (std::size_t i = 0; i < element.count; ++i)
+        {
+            const unsigned char* source = data + i * stride;
+            float* destination = &vertices[i].position.x;
+            for (int field = 0; field < VertexFieldCount; ++field)
+            {
+                destination[field] = (sources[field].offset >= 0)
+                                         ? static_cast<float>(ReadValue(source + sources[field].offset, sources[field].type, swapBytes))
+                                         : 0.0f;
+            }
+        }
+    }
+
+    return vertices;
+}
+
+// appends the triangles of every face as vertex indices, returns the bytes the faces took
+std::size_t ReadFaces(const PlyElement& element, const unsigned char* data, const unsigned char* end, bool swapBytes, std::size_t vertexCount,
+                      std::vector<unsigned int>& indices)
+{
+    int indexProperty = -1;
+    for (std::size_t i = 0; i < element.properties.size(); ++i)
+    {
+        const PlyProperty& property = element.properties[i];
+        if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index"))
+        {
+            indexProperty = static_cast<int>(i);
+        }
+    }
+    if (indexProperty < 0)
+    {
+        throw std::runtime_error{"PLY faces have no vertex_indices"};
+    }
+
+    const PlyProperty& listProperty = element.properties[indexProperty];
+    const bool fastPath = element.properties.size() == 1 && swapBytes == false && listProperty.countType == PlyType::UInt8 &&
+                          (listProperty.type == PlyType::Int32 || listProperty.type == PlyType::UInt32);
+
+    // every face takes at least one byte, a larger count can only come from a corrupt header
+    if (element.count > static_cast<std::size_t>(end - data))
+    {
+        throw std::runtime_error{"PLY file is truncated"};
+    }
+    indices.reserve(indices.size() + element.count * 3);
+
+    unsigned int polygon[256];
+    const unsigned char* face = data;
+    for (std::size_t f = 0; f < element.count; ++f)
+    {
+        std::size_t polygonSize = 0;
+        if (fastPath)
+        {
+            // "property list uchar int vertex_indices" alone, which nearly every exporter writes
+            if (face == end || static_cast<std::size_t>(face[0]) * 4 >= static_cast<std::size_t>(end - face))
+            {
+                throw std::runtime_error{"PLY file is truncated"};
+            }
+
+            polygonSize = face[0];
+            std::memcpy(polygon, face + 1, polygonSize * 4);
+            face += 1 + polygonSize * 4;
+        }
+        else
+        {
+            const unsigned char* property = face;
+            for (int p = 0; p < static_cast<int>(element.properties.size()); ++p)
+            {
+                const PlyProperty& faceProperty = element.properties[p];
+                if (GetTypeSize(faceProperty.isList ? faceProperty.countType : faceProperty.type) > static_cast<std::size_t>(end - property))
+                {
+                    throw std::runtime_error{"PLY file is truncated"};
+                }
+
+                if (faceProperty.isList == false)
+                {
+                    property += GetTypeSize(faceProperty.type);
+                    continue;
+                }
+
+                const std::size_t count = static_cast<std::size_t>(ReadValue(property, faceProperty.countType, swapBytes));
+                property += GetTypeSize(faceProperty.countType);
+                if (count > static_cast<std::size_t>(end - property) / GetTypeSize(faceProperty.type))
+                {
+                    throw std::runtime_error{"PLY file is truncated"};
+                }
+
+                if (p == indexProperty)
+                {
+                    if (count > 256)
+                    {
+                        throw std::runtime_error{"PLY face has more than 256 vertices"};
+                    }
+
+                    polygonSize = count;
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        polygon[i] = static_cast<unsigned int>(ReadValue(property + i * GetTypeSize(faceProperty.type), faceProperty.type, swapBytes));
+                    }
+                }
+                property += count * GetTypeSize(faceProperty.type);
+            }
+            face = property;
+        }
+
+        for (std::size_t i = 0; i < polygonSize; ++i)
+        {
+            if (polygon[i] >= vertexCount)
+            {
+                throw std::runtime_error{"PLY face references a missing vertex"};
+            }
+        }
+
+        // triangulate quads and larger polygons as a fan around the first vertex
+        for (std::size_t i = 1; i + 1 < polygonSize; ++i)
+        {
+            indices.push_back(polygon[0]);
+            indices.push_back(polygon[i]);
+            indices.push_back(polygon[i + 1]);
+        }
+    }
+
+    return static_cast<std::size_t>(face - data);
+}
+
+// sums the unnormalized face normals, whose length is twice the triangle area, around every vertex;
+// the faces of each vertex are listed first, so every job gathers the sums of its own vertices
+void ComputeSmoothNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    JobSystem& jobSystem = GetSharedJobSystem();
+    const std::size_t faceCount = indices.size() / 3;
+
+    std::vector<glm::vec3> faceNormals(faceCount);
+    jobSystem.ParallelFor(faceCount, NormalGrainSize, [&vertices, &indices, &faceNormals](std::size_t firstFace, std::size_t endFace)
+    {
+        for (std::size_t face = firstFace; face < endFace; ++face)
+        {
+            const glm::vec3& a = vertices[indices[face * 3]].position;
+            faceNormals[face] = glm::cross(vertices[indices[face * 3 + 1]].position - a, vertices[indices[face * 3 + 2]].position - a);
+        }
+    });
+
+    std::vector<unsigned int> vertexFaceOffsets(vertices.size() + 1, 0);
+    for (std::size_t corner = 0; corner < faceCount * 3; ++corner)
+    {
+        ++vertexFaceOffsets[indices[corner] + 1];
+    }
+    for (std::size_t i = 1; i < vertexFaceOffsets.size(); ++i)
+    {
+        vertexFaceOffsets[i] += vertexFaceOffsets[i - 1];
+    }
+
+    std::vector<unsigned int> vertexFaces(faceCount * 3);
+    {
+        std::vector<unsigned int> fillOffsets(vertexFaceOffsets.begin(), vertexFaceOffsets.end() - 1);
+        for (std::size_t corner = 0; corner < faceCount * 3; ++corner)
+        {
+            vertexFaces[fillOffsets[indices[corner]]++] = static_cast<unsigned int>(corner / 3);
+        }
+    }
+
+    jobSystem.ParallelFor(vertices.size(), NormalGrainSize, [&vertices, &faceNormals, &vertexFaceOffsets, &vertexFaces](std::size_t firstVertex, std::size_t endVertex)
+    {
+        for (std::size_t vertex = firstVertex; vertex < endVertex; ++vertex)
+        {
+            glm::vec3 normal{0.0f, 0.0f, 0.0f};
+            for (unsigned int i = vertexFaceOffsets[vertex]; i < vertexFaceOffsets[vertex + 1]; ++i)
+            {
+                normal += faceNormals[vertexFaces[i]];
+            }
+
+            const float length = glm::length(normal);
+            vertices[vertex].normal = (length > 0.0f) ? normal / length : glm::vec3{0.0f, 1.0f, 0.0f};
+        }
+    });
+}
+
+} // namespace
+
+Model LoadPlyFile(const std::string& filepath)
+{
+    const MappedFile file{filepath};
+    const unsigned char* const data = file.GetData();
+    const unsigned char* const end = data + file.GetSize();
+
+    std::vector<PlyElement> elements;
+    bool littleEndian = true;
+    const unsigned char* element = data + ParseHeader(data, file.GetSize(), elements, littleEndian);
+    const bool swapBytes = (littleEndian != IsLittleEndianHost());
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    bool hasNormals = false;
+    bool hasFaces = false;
+
+    for (const auto& plyElement : elements)
+    {
+        if (plyElement.name == "vertex")
+        {
+            vertices = ReadVertices(plyElement, element, end, swapBytes);
+            for (const auto& property : plyElement.properties)
+            {
+                hasNormals = hasNormals || property.name == "nx";
+            }
+            element += vertices.size() * GetElementSize(plyElement, element, end, swapBytes);
+        }
+        else if (plyElement.name == "face")
+        {
+            element += ReadFaces(plyElement, element, end, swapBytes, vertices.size(), indices);
+            hasFaces = true;
+        }
+        else
+        {
+            // anything else (edges, materials, camera) is skipped; every property takes at least one byte, so
+            // GetElementSize throws at the end of the file long before a huge count is reached
+            for (std::size_t i = 0; i < plyElement.count && plyElement.properties.empty() == false; ++i)
+            {
+                element += GetElementSize(plyElement, element, end, swapBytes);
+            }
+        }
+
+        if (element > end)
+        {
+            throw std::runtime_error{"PLY file is truncated"};
+        }
+    }
+
+    if (hasFaces == false || indices.empty())
+    {
+        throw std::runtime_error{"PLY file has no faces"};
+    }
+
+    if (hasNormals == false)
+    {
+        ComputeSmoothNormals(vertices, indices);
+    }
+
+    Model model;
+    model.materials.push_back(MakeDefaultMaterial("default"));
+
+    model.vertices.resize(indices.size());
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        model.vertices[i] = vertices[indices[i]];
+    }
+    model.submeshes.push_back(MakeSubmesh(model.vertices, 0, 0, static_cast<unsigned int>(model.vertices.size())));
+
+    return model;
+}
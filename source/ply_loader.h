@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+#include "model.h"
+
+// Loads a binary PLY file (little or big endian), the format 3D scanners write.
+// The file is mapped into memory and parsed in place: vertex positions
+// (x, y, z), normals (nx, ny, nz) and texture coordinates (u, v or s, t) are
+// copied straight into Vertex when the file stores them as floats in the
+// viewer's byte order, and converted per property otherwise. Faces come from
+// the vertex_indices list and are triangulated as fans. Files without normals
+// get area-weighted smooth normals. The model has one submesh with the default
+// material. ASCII PLY files and files without faces throw.
+Model LoadPlyFile(const std::string& filepath);
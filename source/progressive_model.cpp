@@ -0,0 +1,136 @@
+#include "progressive_model.h"
+
+namespace
+{
+
+// thrown through the parser from the partial model callback to stop loading early
+struct LoadStopped
+{
+};
+
+} // namespace
+
+ProgressiveModelLoader::ProgressiveModelLoader(const std::string& filepath, const std::string& cacheDirectory)
+    : stopRequested{false},
+      startTime{std::chrono::steady_clock::now()},
+      modelPending{false},
+      pendingComplete{false},
+      pendingMilliseconds{0.0},
+      complete{false}
+{
+    loadThread = std::thread{&ProgressiveModelLoader::Load, this, filepath, cacheDirectory};
+}
+
+ProgressiveModelLoader::~ProgressiveModelLoader()
+{
+    stopRequested = true;
+    loadThread.join();
+}
+
+Model ProgressiveModelLoader::WaitForFirstModel()
+{
+    {
+        std::unique_lock<std::mutex> lock{modelMutex};
+        modelChanged.wait(lock, [this]() { return modelPending || loadError; });
+    }
+
+    Model model;
+    TakeNewerModel(model);
+    return model;
+}
+
+bool ProgressiveModelLoader::TakeNewerModel(Model& model)
+{
+    std::lock_guard<std::mutex> lock{modelMutex};
+    if (modelPending == false)
+    {
+        if (loadError)
+        {
+            std::exception_ptr error = loadError;
+            loadError = nullptr;
+            std::rethrow_exception(error);
+        }
+
+        return false;
+    }
+
+    model = std::move(pendingModel);
+    pendingModel = Model{};
+    modelPending = false;
+
+    ++stats.versionsTaken;
+    stats.milliseconds = pendingMilliseconds;
+    if (pendingComplete)
+    {
+        complete = true;
+        stats.cacheStats = pendingCacheStats;
+    }
+
+    return true;
+}
+
+bool ProgressiveModelLoader::IsComplete() const
+{
+    return complete;
+}
+
+const ProgressiveModelStats& ProgressiveModelLoader::GetStats() const
+{
+    return stats;
+}
+
+void ProgressiveModelLoader::Load(const std::string& filepath, const std::string& cacheDirectory)
+{
+    try
+    {
+        Model proxy;
+        if (LoadCachedModelProxy(filepath, cacheDirectory, proxy))
+        {
+            Publish(std::move(proxy), false, ModelCacheStats{});
+        }
+
+        ModelCacheStats cacheStats;
+        Model model = LoadModelFileCached(filepath, cacheDirectory, cacheStats,
+                                          [this](Model&& partialModel)
+                                          {
+                                              if (stopRequested)
+                                              {
+                                                  throw LoadStopped{};
+                                              }
+                                              Publish(std::move(partialModel), false, ModelCacheStats{});
+                                          });
+
+        Publish(std::move(model), true, cacheStats);
+    }
+    catch (const LoadStopped&)
+    {
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock{modelMutex};
+        loadError = std::current_exception();
+        modelChanged.notify_all();
+    }
+}
+
+void ProgressiveModelLoader::Publish(Model&& model, bool isComplete, const ModelCacheStats& cacheStats)
+{
+    // an empty partial model would only replace the proxy with nothing
+    if (model.vertices.empty() && isComplete == false)
+    {
+        return;
+    }
+
+    // the version the render loop hasn't taken yet is freed outside the lock
+    Model replacedModel;
+    {
+        std::lock_guard<std::mutex> lock{modelMutex};
+        replacedModel = std::move(pendingModel);
+        pendingModel = std::move(model);
+        modelPending = true;
+        pendingComplete = isComplete;
+        pendingMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        pendingCacheStats = cacheStats;
+    }
+    modelChanged.notify_all();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "model.h"
+#include "model_cache.h"
+
+struct ProgressiveModelStats
+{
+    unsigned int versionsTaken = 0;
+    double milliseconds = 0.0;   // from construction until the last version taken was ready
+    ModelCacheStats cacheStats;  // valid once the complete model has been taken
+};
+
+// Loads a model on a background thread and hands out ever finer versions of
+// it while it loads, so the viewer draws something long before a huge model
+// has been parsed:
+//   1. the clustered proxy stored with the model's cache entry, decoded in a few milliseconds
+//   2. on a cache miss, the triangles the OBJ parser has produced so far, each
+//      time their number has doubled
+//   3. the complete model, decoded from the cache or parsed
+// Only the newest version is kept; one the render loop hasn't taken yet is
+// replaced by the next. Destruction stops a parse that is still running.
+class ProgressiveModelLoader
+{
+public:
+    ProgressiveModelLoader(const std::string& filepath, const std::string& cacheDirectory);
+    ~ProgressiveModelLoader();
+
+    ProgressiveModelLoader(const ProgressiveModelLoader&) = delete;
+    ProgressiveModelLoader& operator=(const ProgressiveModelLoader&) = delete;
+
+    // blocks until the first version is ready, throws when loading failed before that
+    Model WaitForFirstModel();
+
+    // moves the newest version into model when one arrived since the last call, throws when loading failed
+    bool TakeNewerModel(Model& model);
+
+    // the complete model has been taken, nothing more will arrive
+    bool IsComplete() const;
+
+    const ProgressiveModelStats& GetStats() const;
+
+private:
+    void Load(const std::string& filepath, const std::string& cacheDirectory);
+    void Publish(Model&& model, bool isComplete, const ModelCacheStats& cacheStats);
+
+    std::thread loadThread;
+    std::atomic<bool> stopRequested;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::mutex modelMutex;
+    std::condition_variable modelChanged;
+    Model pendingModel;
+    bool modelPending;
+    bool pendingComplete;
+    double pendingMilliseconds;
+    ModelCacheStats pendingCacheStats;
+    std::exception_ptr loadError;
+
+    bool complete;
+    ProgressiveModelStats stats;
+};
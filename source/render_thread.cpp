@@ -0,0 +1,170 @@
+#include "render_thread.h"
+
+#include <chrono>
+#include <utility>
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+namespace
+{
+
+double MillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+} // namespace
+
+RenderThread::RenderThread(GLFWwindow* window, std::function<void(const FrameSnapshot&)> renderFrame, bool threaded)
+    : window{window},
+      renderFrame{std::move(renderFrame)},
+      threaded{threaded},
+      slotStates{SlotState::Free, SlotState::Free},
+      writeSlot{0},
+      stopRendering{false}
+{
+    if (threaded)
+    {
+        // a context is current on one thread at a time, the render thread makes it current again
+        glfwMakeContextCurrent(nullptr);
+        renderThread = std::thread{&RenderThread::RenderMain, this};
+    }
+}
+
+RenderThread::~RenderThread()
+{
+    if (threaded == false)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{slotMutex};
+        stopRendering = true;
+    }
+    slotChanged.notify_all();
+    renderThread.join();
+
+    glfwMakeContextCurrent(window);
+}
+
+bool RenderThread::IsThreaded() const
+{
+    return threaded;
+}
+
+FrameSnapshot& RenderThread::BeginFrame()
+{
+    if (threaded)
+    {
+        const auto waitBeginTime = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock{slotMutex};
+        slotChanged.wait(lock, [this]() { return slotStates[writeSlot] == SlotState::Free || renderError; });
+        RethrowRenderError();
+
+        stats.mainWaitMilliseconds += MillisecondsSince(waitBeginTime);
+    }
+
+    return snapshots[writeSlot];
+}
+
+void RenderThread::Publish()
+{
+    if (threaded == false)
+    {
+        renderFrame(snapshots[writeSlot]);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{slotMutex};
+        RethrowRenderError();
+
+        slotStates[writeSlot] = SlotState::Published;
+    }
+    slotChanged.notify_all();
+
+    writeSlot = 1 - writeSlot;
+}
+
+void RenderThread::PublishDrawList(std::shared_ptr<const SceneDrawList> drawList)
+{
+    std::lock_guard<std::mutex> lock{drawListMutex};
+    this->drawList = std::move(drawList);
+}
+
+std::shared_ptr<const SceneDrawList> RenderThread::GetDrawList()
+{
+    std::lock_guard<std::mutex> lock{drawListMutex};
+    return drawList;
+}
+
+RenderThreadStats RenderThread::ConsumeStats()
+{
+    std::lock_guard<std::mutex> lock{slotMutex};
+
+    const RenderThreadStats consumedStats = stats;
+    stats = RenderThreadStats{};
+
+    return consumedStats;
+}
+
+void RenderThread::RenderMain()
+{
+    glfwMakeContextCurrent(window);
+
+    // snapshots are published into alternating slots, so they are taken in the same order
+    unsigned int readSlot = 0;
+    for (;;)
+    {
+        {
+            const auto waitBeginTime = std::chrono::steady_clock::now();
+
+            std::unique_lock<std::mutex> lock{slotMutex};
+            slotChanged.wait(lock, [this, readSlot]() { return slotStates[readSlot] == SlotState::Published || stopRendering; });
+
+            // frames published before the stop are still submitted
+            if (slotStates[readSlot] != SlotState::Published)
+            {
+                break;
+            }
+
+            slotStates[readSlot] = SlotState::Rendering;
+            stats.renderWaitMilliseconds += MillisecondsSince(waitBeginTime);
+        }
+
+        try
+        {
+            renderFrame(snapshots[readSlot]);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock{slotMutex};
+            renderError = std::current_exception();
+            slotStates[readSlot] = SlotState::Free;
+            slotChanged.notify_all();
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{slotMutex};
+            slotStates[readSlot] = SlotState::Free;
+        }
+        slotChanged.notify_all();
+
+        readSlot = 1 - readSlot;
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::RethrowRenderError()
+{
+    if (renderError)
+    {
+        std::rethrow_exception(renderError);
+    }
+}
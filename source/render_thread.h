@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "draw_list.h"
+#include "frame_uniforms.h"
+#include "light_clusters.h"
+#include "light_rig.h"
+#include "meshlets.h"
+#include "model.h"
+#include "software_occlusion.h"
+
+struct GLFWwindow;
+
+// the draw list the render thread submits, with the model it was built from
+struct SceneDrawList
+{
+    std::shared_ptr<const Model> model;
+    std::vector<DrawCommand> draws;
+};
+
+// Everything the render thread needs of one frame, prepared by the main thread.
+// A snapshot is not changed once it is published, so the main thread can prepare
+// the next frame while the render thread still submits this one.
+struct FrameSnapshot
+{
+    float time = 0.0f;
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+
+    glm::vec3 cameraPos;
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    float aspectRatio = 1.0f;
+    FrameUniforms frameUniforms;
+
+    glm::vec3 boundsMin;  // of the model, fitting the shadow cascades
+    glm::vec3 boundsMax;
+
+    std::vector<PointLight> lights;
+    unsigned int unboundedLightCount = 0;
+    ClusterLightLists clusterLights;  // only filled by the clustered renderer
+    LightClusterStats clusterStats;
+
+    // set in the frame the main thread took a finer version of the model
+    std::shared_ptr<const Model> newModel;
+
+    // Visibility culled on the main thread against culledDrawList, which is null when
+    // nothing was culled. The render thread ignores it once that list was replaced.
+    std::shared_ptr<const SceneDrawList> culledDrawList;
+    bool hasVisibleDraws = false;
+    std::vector<unsigned char> visibleDraws;
+    bool hasDrawRanges = false;
+    DrawRanges drawRanges;
+
+    bool occlusionCullingEnabled = true;
+    bool meshletCullingEnabled = true;
+    SoftwareOcclusionStats occlusionStats;
+    bool occlusionUsingAvx2 = false;
+    MeshletCullStats meshletStats;
+    bool meshletsUsingAvx2 = false;
+
+    // key presses that change state owned by the render thread
+    bool toggleAmbientOcclusion = false;
+    bool switchAntialiasing = false;
+
+    double prepareMilliseconds = 0.0;  // main thread time spent on the snapshot
+};
+
+struct RenderThreadStats
+{
+    double mainWaitMilliseconds = 0.0;    // the main thread waiting for a free snapshot, submission is the bottleneck
+    double renderWaitMilliseconds = 0.0;  // the render thread waiting for a snapshot, preparation is the bottleneck
+};
+
+// Submits the frames the main thread prepares on a thread of its own, which
+// owns the window's GL context from construction to destruction. Two snapshots
+// alternate: while the render thread submits frame N from one, the main thread
+// prepares frame N+1 in the other, and it only waits when it gets a whole frame
+// ahead. The render thread publishes the draw list it submits, so the main thread
+// can cull against it. Without a thread, Publish submits the frame right away on
+// the calling thread, which keeps the context.
+class RenderThread
+{
+public:
+    // The context of the window must be current on the calling thread. renderFrame is
+    // called with every published snapshot in order.
+    RenderThread(GLFWwindow* window, std::function<void(const FrameSnapshot&)> renderFrame, bool threaded);
+
+    // submits the published frames that are left, then makes the context current on the calling thread again
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    bool IsThreaded() const;
+
+    // the snapshot to prepare the next frame in, waits until the render thread is done with it
+    FrameSnapshot& BeginFrame();
+
+    // hands the snapshot of BeginFrame to the render thread; both rethrow an exception renderFrame threw
+    void Publish();
+
+    // called by renderFrame whenever it replaces its draw list
+    void PublishDrawList(std::shared_ptr<const SceneDrawList> drawList);
+    std::shared_ptr<const SceneDrawList> GetDrawList();
+
+    // totals since the last call
+    RenderThreadStats ConsumeStats();
+
+private:
+    enum class SlotState
+    {
+        Free,
+        Published,
+        Rendering
+    };
+
+    void RenderMain();
+    void RethrowRenderError();
+
+    GLFWwindow* window;
+    std::function<void(const FrameSnapshot&)> renderFrame;
+    bool threaded;
+
+    FrameSnapshot snapshots[2];
+    SlotState slotStates[2];
+    unsigned int writeSlot;  // main thread only
+
+    std::thread renderThread;
+    std::mutex slotMutex;
+    std::condition_variable slotChanged;
+    std::exception_ptr renderError;
+    bool stopRendering;
+
+    RenderThreadStats stats;
+
+    std::mutex drawListMutex;
+    std::shared_ptr<const SceneDrawList> drawList;
+};
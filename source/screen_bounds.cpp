@@ -0,0 +1,39 @@
+#include "screen_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool ProjectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& viewProjectionMatrix, glm::vec3& ndcMin, glm::vec3& ndcMax)
+{
+    ndcMin = glm::vec3{1.0e30f};
+    ndcMax = glm::vec3{-1.0e30f};
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 position{(corner & 1) != 0 ? boundsMax.x : boundsMin.x,
+                                 (corner & 2) != 0 ? boundsMax.y : boundsMin.y,
+                                 (corner & 4) != 0 ? boundsMax.z : boundsMin.z};
+        const glm::vec4 clipPosition = viewProjectionMatrix * glm::vec4{position, 1.0f};
+        if (clipPosition.w <= 0.0f)
+        {
+            return false;
+        }
+
+        const glm::vec3 ndcPosition = glm::vec3{clipPosition} / clipPosition.w;
+        ndcMin = glm::min(ndcMin, ndcPosition);
+        ndcMax = glm::max(ndcMax, ndcPosition);
+    }
+
+    return true;
+}
+
+bool IsOutsideFrustum(const glm::vec3& ndcMin, const glm::vec3& ndcMax)
+{
+    return ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f;
+}
+
+int NdcToPixel(float ndc, int size)
+{
+    const float pixel = (ndc * 0.5f + 0.5f) * static_cast<float>(size);
+    return static_cast<int>(std::floor(std::min(std::max(pixel, 0.0f), static_cast<float>(size - 1))));
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// normalized device coordinate bounds of a box, false when a corner lies behind the camera
+bool ProjectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& viewProjectionMatrix, glm::vec3& ndcMin, glm::vec3& ndcMax);
+
+// true when projected bounds lie entirely outside the view, the far plane is not tested
+bool IsOutsideFrustum(const glm::vec3& ndcMin, const glm::vec3& ndcMax);
+
+// pixel of a size pixels wide axis covering a normalized device coordinate, clamped to the axis
+int NdcToPixel(float ndc, int size);
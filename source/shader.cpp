@@ -0,0 +1,378 @@
+#include "shader.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "file_utility.h"
+#include "hash.h"
+
+namespace
+{
+
+const std::uint32_t cacheFileMagic = 0x48535643;  // "CVSH"
+const std::uint32_t cacheFileVersion = 1;
+
+// header written in front of every cached program binary
+struct CacheFileHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t key;
+    std::uint32_t binaryFormat;
+    std::uint32_t binaryLength;
+};
+
+bool parallelShaderCompile = false;
+
+unsigned int SubmitShader(GLenum type, const std::string& source)
+{
+    const char* sourceText = source.c_str();
+
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &sourceText, nullptr);
+    glCompileShader(shader);
+
+    return shader;
+}
+
+// prints the info log of a shader that failed to compile, returns false in that case
+bool CheckShaderCompiled(unsigned int shader)
+{
+    int success;
+    char log[512];
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, nullptr, log);
+        std::cerr << log << std::endl;
+    }
+
+    return success != 0;
+}
+
+std::string GetGlString(GLenum name)
+{
+    const GLubyte* value = glGetString(name);
+    return (value != nullptr) ? reinterpret_cast<const char*>(value) : "";
+}
+
+bool IsProgramBinarySupported()
+{
+    if (GLAD_GL_VERSION_4_1 == false && GLAD_GL_ARB_get_program_binary == false)
+    {
+        return false;
+    }
+
+    int binaryFormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+
+    return binaryFormatCount > 0;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+} // namespace
+
+std::string LoadTextFile(const std::string& filepath)
+{
+    std::ifstream file{filepath};
+    if (file.is_open() == false)
+    {
+        throw std::runtime_error{"Failed to open " + filepath};
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    return contents.str();
+}
+
+bool EnableParallelShaderCompile()
+{
+    if (GLAD_GL_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);  // let the driver pick the thread count
+        parallelShaderCompile = true;
+    }
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        parallelShaderCompile = true;
+    }
+
+    return parallelShaderCompile;
+}
+
+unsigned int CreateComputeProgram(const std::string& source)
+{
+    const unsigned int shader = SubmitShader(GL_COMPUTE_SHADER, source);
+    if (CheckShaderCompiled(shader) == false)
+    {
+        glDeleteShader(shader);
+        throw std::runtime_error{"compute shader compilation failed"};
+    }
+
+    const unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        char log[512];
+        glGetProgramInfoLog(program, 512, nullptr, log);
+        std::cerr << log << std::endl;
+
+        glDeleteProgram(program);
+        throw std::runtime_error{"compute program linking failed"};
+    }
+
+    return program;
+}
+
+ShaderCache::ShaderCache(const std::string& directory)
+    : directory{directory},
+      enabled{false}
+{
+    if (directory.empty())
+    {
+        return;
+    }
+
+    if (IsProgramBinarySupported() == false)
+    {
+        std::cerr << "program binaries are not supported by this driver, shader cache disabled" << std::endl;
+        return;
+    }
+
+    driverIdentity = GetGlString(GL_VENDOR) + "|" + GetGlString(GL_RENDERER) + "|" + GetGlString(GL_VERSION);
+
+    CreateDirectoryIfMissing(directory);
+
+    enabled = true;
+}
+
+unsigned int ShaderCache::CreateProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    return FinishProgram(BeginProgram(vertexShaderSource, fragmentShaderSource));
+}
+
+PendingProgram ShaderCache::BeginProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    PendingProgram pendingProgram{0, 0, 0, 0};
+
+    if (enabled)
+    {
+        pendingProgram.cacheKey = CalculateKey(vertexShaderSource, fragmentShaderSource);
+        pendingProgram.program = LoadProgram(pendingProgram.cacheKey);
+    }
+
+    if (pendingProgram.program == 0)
+    {
+        pendingProgram.vertexShader = SubmitShader(GL_VERTEX_SHADER, vertexShaderSource);
+        pendingProgram.fragmentShader = SubmitShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+
+        // with parallel compilation the link is queued behind the compiles, no status is queried here
+        pendingProgram.program = glCreateProgram();
+        if (enabled)
+        {
+            glProgramParameteri(pendingProgram.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(pendingProgram.program, pendingProgram.vertexShader);
+        glAttachShader(pendingProgram.program, pendingProgram.fragmentShader);
+        glLinkProgram(pendingProgram.program);
+    }
+
+    stats.milliseconds += MillisecondsSince(startTime);
+
+    return pendingProgram;
+}
+
+bool ShaderCache::IsProgramReady(const PendingProgram& pendingProgram) const
+{
+    if (parallelShaderCompile == false || pendingProgram.vertexShader == 0)
+    {
+        return true;
+    }
+
+    int completed = GL_FALSE;
+    glGetProgramiv(pendingProgram.program, GL_COMPLETION_STATUS_KHR, &completed);
+
+    return completed == GL_TRUE;
+}
+
+unsigned int ShaderCache::FinishProgram(const PendingProgram& pendingProgram)
+{
+    if (pendingProgram.vertexShader == 0)
+    {
+        ++stats.hits;
+        return pendingProgram.program;
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    int success;
+    char log[512];
+
+    glGetProgramiv(pendingProgram.program, GL_LINK_STATUS, &success);
+
+    // report the stage that actually failed before the link error
+    const char* error = nullptr;
+    if (!success)
+    {
+        if (CheckShaderCompiled(pendingProgram.vertexShader) == false)
+        {
+            error = "vertex shader compilation failed";
+        }
+        else if (CheckShaderCompiled(pendingProgram.fragmentShader) == false)
+        {
+            error = "fragment shader compilation failed";
+        }
+        else
+        {
+            glGetProgramInfoLog(pendingProgram.program, 512, nullptr, log);
+            std::cerr << log << std::endl;
+            error = "shader program linking failed";
+        }
+    }
+
+    glDetachShader(pendingProgram.program, pendingProgram.vertexShader);
+    glDetachShader(pendingProgram.program, pendingProgram.fragmentShader);
+    glDeleteShader(pendingProgram.vertexShader);
+    glDeleteShader(pendingProgram.fragmentShader);
+
+    if (error != nullptr)
+    {
+        glDeleteProgram(pendingProgram.program);
+        throw std::runtime_error{error};
+    }
+
+    if (enabled)
+    {
+        SaveProgram(pendingProgram.cacheKey, pendingProgram.program);
+    }
+
+    ++stats.misses;
+    stats.milliseconds += MillisecondsSince(startTime);
+
+    return pendingProgram.program;
+}
+
+bool ShaderCache::IsEnabled() const
+{
+    return enabled;
+}
+
+const ShaderCacheStats& ShaderCache::GetStats() const
+{
+    return stats;
+}
+
+unsigned long long ShaderCache::CalculateKey(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) const
+{
+    unsigned long long hash = HashString(driverIdentity);
+    hash = HashString(vertexShaderSource, hash);
+    hash = HashString("|", hash);
+    hash = HashString(fragmentShaderSource, hash);
+
+    return hash;
+}
+
+std::string ShaderCache::GetEntryPath(unsigned long long key) const
+{
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin", key);
+
+    return directory + "/" + fileName;
+}
+
+unsigned int ShaderCache::LoadProgram(unsigned long long key) const
+{
+    std::ifstream file{GetEntryPath(key), std::ios::binary | std::ios::ate};
+    if (file.is_open() == false)
+    {
+        return 0;
+    }
+
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    CacheFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.good() == false || header.magic != cacheFileMagic || header.version != cacheFileVersion || header.key != key)
+    {
+        return 0;
+    }
+
+    // a corrupt or truncated entry is a miss, its length must not size the allocation or claim bytes the driver never gets
+    if (fileSize < static_cast<std::streamoff>(sizeof(header)) ||
+        static_cast<std::streamoff>(header.binaryLength) != fileSize - static_cast<std::streamoff>(sizeof(header)))
+    {
+        return 0;
+    }
+
+    std::vector<char> binary(header.binaryLength);
+    file.read(binary.data(), binary.size());
+    if (file.good() == false)
+    {
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // drivers reject binaries they no longer understand, fall back to compiling in that case
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void ShaderCache::SaveProgram(unsigned long long key, unsigned int program) const
+{
+    int binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0)
+    {
+        return;
+    }
+
+    // the binary is read straight behind the header of the entry
+    std::vector<unsigned char> entry(sizeof(CacheFileHeader) + binaryLength);
+    GLenum binaryFormat;
+    glGetProgramBinary(program, binaryLength, nullptr, &binaryFormat, entry.data() + sizeof(CacheFileHeader));
+
+    CacheFileHeader header;
+    header.magic = cacheFileMagic;
+    header.version = cacheFileVersion;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = static_cast<std::uint32_t>(binaryLength);
+
+    std::memcpy(entry.data(), &header, sizeof(header));
+
+    WriteFileAtomically(GetEntryPath(key), entry);
+}
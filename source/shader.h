@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+// Reads a whole text file such as a shader source, throws if it cannot be opened.
+std::string LoadTextFile(const std::string& filepath);
+
+// Asks the driver to compile and link on its own threads (GL_KHR_parallel_shader_compile
+// or GL_ARB_parallel_shader_compile). Returns false when neither extension is available.
+bool EnableParallelShaderCompile();
+
+// Compiles and links a compute shader (GL 4.3), throws with the info log on errors.
+// Compute programs are few and small, they bypass the program binary cache.
+unsigned int CreateComputeProgram(const std::string& source);
+
+struct ShaderCacheStats
+{
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    double milliseconds = 0.0;  // total time spent creating programs through the cache
+};
+
+// program whose compile/link may still be running in the driver
+struct PendingProgram
+{
+    unsigned int program;
+    unsigned int vertexShader;    // 0 when the program was restored from a binary
+    unsigned int fragmentShader;
+    unsigned long long cacheKey;
+};
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by a hash of the shader sources and the driver's vendor,
+// renderer and version strings, so a driver update or a shader edit simply
+// misses the cache. Any binary the driver rejects falls back to compiling.
+class ShaderCache
+{
+public:
+    // an empty directory disables the cache
+    explicit ShaderCache(const std::string& directory);
+
+    unsigned int CreateProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+
+    // split form of CreateProgram: BeginProgram submits the compile and link without
+    // waiting, FinishProgram checks the result and stores the binary; on errors it
+    // deletes the program and throws
+    PendingProgram BeginProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    bool IsProgramReady(const PendingProgram& pendingProgram) const;
+    unsigned int FinishProgram(const PendingProgram& pendingProgram);
+
+    bool IsEnabled() const;
+    const ShaderCacheStats& GetStats() const;
+
+private:
+    unsigned long long CalculateKey(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) const;
+    std::string GetEntryPath(unsigned long long key) const;
+
+    unsigned int LoadProgram(unsigned long long key) const;
+    void SaveProgram(unsigned long long key, unsigned int program) const;
+
+    std::string directory;
+    std::string driverIdentity;
+    bool enabled;
+
+    ShaderCacheStats stats;
+};
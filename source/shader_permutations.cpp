@@ -0,0 +1,281 @@
+#include "shader_permutations.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include "hash.h"
+
+namespace
+{
+
+std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+    const std::size_t versionIndex = source.find("#version");
+    if (versionIndex == std::string::npos)
+    {
+        throw std::runtime_error{"shader source has no #version directive"};
+    }
+
+    const std::size_t lineEndIndex = source.find('\n', versionIndex);
+
+    std::string defineBlock;
+    for (const auto& define : defines)
+    {
+        defineBlock += "#define " + define + "\n";
+    }
+
+    if (lineEndIndex == std::string::npos)
+    {
+        return source + "\n" + defineBlock;
+    }
+
+    return source.substr(0, lineEndIndex + 1) + defineBlock + source.substr(lineEndIndex + 1);
+}
+
+} // namespace
+
+ShaderPermutationSet::ShaderPermutationSet(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                                           const std::vector<UniformBlockBinding>& uniformBlockBindings, const std::vector<SamplerBinding>& samplerBindings)
+    : shaderCache{shaderCache},
+      vertexShaderSource{vertexShaderSource},
+      fragmentShaderSource{fragmentShaderSource},
+      uniformBlockBindings{uniformBlockBindings},
+      samplerBindings{samplerBindings},
+      parallelCompile{EnableParallelShaderCompile()}
+{
+}
+
+ShaderPermutationSet::~ShaderPermutationSet()
+{
+    const auto deletePending = [](const PendingProgram& pendingProgram)
+    {
+        glDeleteShader(pendingProgram.vertexShader);
+        glDeleteShader(pendingProgram.fragmentShader);
+        glDeleteProgram(pendingProgram.program);
+    };
+
+    for (auto& permutation : permutations)
+    {
+        if (permutation.state == PermutationState::Compiling)
+        {
+            deletePending(permutation.pendingProgram);
+        }
+        else if (permutation.state == PermutationState::Linked)
+        {
+            glDeleteProgram(permutation.program);
+        }
+
+        if (permutation.reloadState == ReloadState::Compiling)
+        {
+            deletePending(permutation.reloadProgram);
+        }
+    }
+}
+
+ShaderPermutation ShaderPermutationSet::Add(std::vector<std::string> defines)
+{
+    ++stats.requested;
+
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+    Permutation permutation;
+    permutation.defines = defines;
+    permutation.vertexShaderSource = InjectDefines(vertexShaderSource, defines);
+    permutation.fragmentShaderSource = InjectDefines(fragmentShaderSource, defines);
+    permutation.state = PermutationState::Registered;
+    permutation.pendingProgram = PendingProgram{0, 0, 0, 0};
+    permutation.program = 0;
+    permutation.reloadState = ReloadState::None;
+    permutation.reloadProgram = PendingProgram{0, 0, 0, 0};
+
+    // defines that neither stage looks at still produce distinct text, so hash the
+    // final sources rather than the define list
+    const unsigned long long sourceHash = HashString(permutation.fragmentShaderSource, HashString(permutation.vertexShaderSource));
+
+    const auto permutationIt = permutationsBySourceHash.find(sourceHash);
+    if (permutationIt != permutationsBySourceHash.end())
+    {
+        return permutationIt->second;
+    }
+
+    const ShaderPermutation handle = static_cast<ShaderPermutation>(permutations.size());
+    permutations.push_back(permutation);
+    permutationsBySourceHash[sourceHash] = handle;
+
+    ++stats.unique;
+
+    return handle;
+}
+
+void ShaderPermutationSet::CompileAll()
+{
+    if (parallelCompile == false)
+    {
+        return;
+    }
+
+    for (auto& permutation : permutations)
+    {
+        if (permutation.state == PermutationState::Registered)
+        {
+            permutation.pendingProgram = shaderCache.BeginProgram(permutation.vertexShaderSource, permutation.fragmentShaderSource);
+            permutation.state = PermutationState::Compiling;
+        }
+    }
+}
+
+void ShaderPermutationSet::Reload(const std::string& vertexShaderSource, const std::string& fragmentShaderSource)
+{
+    this->vertexShaderSource = vertexShaderSource;
+    this->fragmentShaderSource = fragmentShaderSource;
+
+    // existing handles stay valid even if two permutations now produce the same source
+    permutationsBySourceHash.clear();
+
+    for (ShaderPermutation handle = 0; handle < permutations.size(); ++handle)
+    {
+        Permutation& permutation = permutations[handle];
+
+        permutation.vertexShaderSource = InjectDefines(vertexShaderSource, permutation.defines);
+        permutation.fragmentShaderSource = InjectDefines(fragmentShaderSource, permutation.defines);
+
+        const unsigned long long sourceHash = HashString(permutation.fragmentShaderSource, HashString(permutation.vertexShaderSource));
+        permutationsBySourceHash.insert(std::make_pair(sourceHash, handle));
+
+        // permutations never compiled simply pick up the new sources when first used
+        if (permutation.state == PermutationState::Registered)
+        {
+            continue;
+        }
+
+        // a reload already in flight is superseded by the newer sources
+        if (permutation.reloadState == ReloadState::Compiling)
+        {
+            glDeleteShader(permutation.reloadProgram.vertexShader);
+            glDeleteShader(permutation.reloadProgram.fragmentShader);
+            glDeleteProgram(permutation.reloadProgram.program);
+        }
+
+        permutation.reloadState = ReloadState::Requested;
+        if (parallelCompile)
+        {
+            permutation.reloadProgram = shaderCache.BeginProgram(permutation.vertexShaderSource, permutation.fragmentShaderSource);
+            permutation.reloadState = ReloadState::Compiling;
+        }
+    }
+}
+
+bool ShaderPermutationSet::Update()
+{
+    bool programsReplaced = false;
+    bool compiledThisUpdate = false;
+
+    for (auto& permutation : permutations)
+    {
+        if (permutation.state == PermutationState::Compiling && shaderCache.IsProgramReady(permutation.pendingProgram))
+        {
+            Finish(permutation);
+        }
+
+        if (permutation.reloadState == ReloadState::Requested && compiledThisUpdate == false)
+        {
+            permutation.reloadProgram = shaderCache.BeginProgram(permutation.vertexShaderSource, permutation.fragmentShaderSource);
+            permutation.reloadState = ReloadState::Compiling;
+
+            compiledThisUpdate = true;
+        }
+
+        if (permutation.reloadState == ReloadState::Compiling && shaderCache.IsProgramReady(permutation.reloadProgram))
+        {
+            programsReplaced = FinishReload(permutation) || programsReplaced;
+        }
+    }
+
+    return programsReplaced;
+}
+
+unsigned int ShaderPermutationSet::GetProgram(ShaderPermutation permutation)
+{
+    Permutation& entry = permutations.at(permutation);
+
+    if (entry.state == PermutationState::Registered)
+    {
+        entry.pendingProgram = shaderCache.BeginProgram(entry.vertexShaderSource, entry.fragmentShaderSource);
+        entry.state = PermutationState::Compiling;
+    }
+
+    if (entry.state == PermutationState::Compiling)
+    {
+        Finish(entry);
+    }
+
+    return entry.program;
+}
+
+const ShaderPermutationStats& ShaderPermutationSet::GetStats() const
+{
+    return stats;
+}
+
+void ShaderPermutationSet::Finish(Permutation& permutation)
+{
+    permutation.program = shaderCache.FinishProgram(permutation.pendingProgram);
+    permutation.state = PermutationState::Linked;
+
+    AttachBindings(permutation.program);
+
+    ++stats.compiled;
+}
+
+bool ShaderPermutationSet::FinishReload(Permutation& permutation)
+{
+    permutation.reloadState = ReloadState::None;
+
+    unsigned int program = 0;
+    try
+    {
+        program = shaderCache.FinishProgram(permutation.reloadProgram);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << "shader reload failed, keeping the previous program: " << error.what() << std::endl;
+
+        ++stats.reloadFailures;
+        return false;
+    }
+
+    AttachBindings(program);
+
+    glDeleteProgram(permutation.program);
+    permutation.program = program;
+
+    ++stats.reloaded;
+    return true;
+}
+
+void ShaderPermutationSet::AttachBindings(unsigned int program) const
+{
+    for (const auto& uniformBlockBinding : uniformBlockBindings)
+    {
+        const unsigned int blockIndex = glGetUniformBlockIndex(program, uniformBlockBinding.blockName.c_str());
+        if (blockIndex != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, blockIndex, uniformBlockBinding.binding);
+        }
+    }
+
+    // sampler units are program state that can only be set while the program is in use
+    if (samplerBindings.empty() == false)
+    {
+        glUseProgram(program);
+        for (const auto& samplerBinding : samplerBindings)
+        {
+            glUniform1i(glGetUniformLocation(program, samplerBinding.samplerName.c_str()), samplerBinding.textureUnit);
+        }
+        glUseProgram(0);
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "shader.h"
+
+using ShaderPermutation = unsigned int;
+
+// uniform block every program of a set is connected to after linking
+struct UniformBlockBinding
+{
+    std::string blockName;
+    unsigned int binding;
+};
+
+// texture unit a sampler uniform of every program of a set is pointed at after linking
+struct SamplerBinding
+{
+    std::string samplerName;
+    int textureUnit;
+};
+
+struct ShaderPermutationStats
+{
+    unsigned int requested = 0;  // Add calls, including duplicates
+    unsigned int unique = 0;
+    unsigned int compiled = 0;
+    unsigned int reloaded = 0;
+    unsigned int reloadFailures = 0;
+};
+
+// Variants of one vertex/fragment shader pair selected by preprocessor defines.
+// Defines are injected after the #version line; permutations whose final source
+// is identical share one program. CompileAll submits every permutation at once
+// when the driver compiles in parallel and otherwise leaves them to be compiled
+// lazily the first time GetProgram asks for them, so startup cost does not grow
+// with the number of registered permutations.
+// Reload swaps in new sources without stalling: every permutation keeps drawing
+// with its current program until the replacement has linked successfully.
+class ShaderPermutationSet
+{
+public:
+    ShaderPermutationSet(ShaderCache& shaderCache, const std::string& vertexShaderSource, const std::string& fragmentShaderSource,
+                         const std::vector<UniformBlockBinding>& uniformBlockBindings, const std::vector<SamplerBinding>& samplerBindings);
+    ~ShaderPermutationSet();
+
+    ShaderPermutationSet(const ShaderPermutationSet&) = delete;
+    ShaderPermutationSet& operator=(const ShaderPermutationSet&) = delete;
+
+    // defines are "NAME" or "NAME VALUE", their order does not matter
+    ShaderPermutation Add(std::vector<std::string> defines);
+
+    void CompileAll();
+
+    // recompiles every permutation from new sources in the background
+    void Reload(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+
+    // finishes permutations whose background compile has completed and returns true
+    // when any program was replaced; without parallel compilation one reload is
+    // compiled per call to spread the cost over frames
+    bool Update();
+
+    // returns the linked program, compiling or waiting for it if necessary
+    unsigned int GetProgram(ShaderPermutation permutation);
+
+    const ShaderPermutationStats& GetStats() const;
+
+private:
+    enum class PermutationState
+    {
+        Registered,
+        Compiling,
+        Linked
+    };
+
+    enum class ReloadState
+    {
+        None,
+        Requested,
+        Compiling
+    };
+
+    struct Permutation
+    {
+        std::vector<std::string> defines;
+        std::string vertexShaderSource;
+        std::string fragmentShaderSource;
+        PermutationState state;
+        PendingProgram pendingProgram;
+        unsigned int program;
+
+        ReloadState reloadState;
+        PendingProgram reloadProgram;
+    };
+
+    void Finish(Permutation& permutation);
+    bool FinishReload(Permutation& permutation);
+    void AttachBindings(unsigned int program) const;
+
+    ShaderCache& shaderCache;
+    std::string vertexShaderSource;
+    std::string fragmentShaderSource;
+    std::vector<UniformBlockBinding> uniformBlockBindings;
+    std::vector<SamplerBinding> samplerBindings;
+    bool parallelCompile;
+
+    std::vector<Permutation> permutations;
+    std::map<unsigned long long, ShaderPermutation> permutationsBySourceHash;
+
+    ShaderPermutationStats stats;
+};
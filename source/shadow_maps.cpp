@@ -0,0 +1,234 @@
+#include "shadow_maps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+static_assert(sizeof(ShadowUniforms) == 304, "ShadowUniforms must match the std140 Shadows block layout");
+
+namespace
+{
+
+// weight of logarithmic against uniform split distances, logarithmic splits keep the texel density even over depth
+const float splitLogarithmicWeight = 0.85f;
+
+// a redrawn cascade covers this much more than its sphere, so it stays valid while the camera moves a little
+const float cascadeGuardBand = 1.25f;
+
+// slope-scaled and constant depth bias of the shadow casters, the shaders add a normal offset on top
+const float polygonOffsetFactor = 2.0f;
+const float polygonOffsetUnits = 4.0f;
+
+} // namespace
+
+CascadedShadowMaps::CascadedShadowMaps(StreamingBuffer& streamingBuffer, int mapSize, int cascadeCount)
+    : streamingBuffer(streamingBuffer),
+      mapSize{mapSize},
+      cascadeCount{std::max(1, std::min(cascadeCount, MaxShadowCascades))},
+      lightDirection{0.0f},
+      sceneBoundsMin{0.0f},
+      sceneBoundsMax{0.0f},
+      cascades(static_cast<std::size_t>(this->cascadeCount), Cascade{false, glm::vec2{0.0f}, 0.0f}),
+      uniforms()
+{
+    uniforms.cascadeCount = glm::uvec4{static_cast<unsigned int>(this->cascadeCount), 0, 0, 0};
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, this->cascadeCount, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error{"shadow map framebuffer is incomplete"};
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+CascadedShadowMaps::~CascadedShadowMaps()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &depthTexture);
+}
+
+void CascadedShadowMaps::Update(DepthPrepass& depthPrepass, const std::vector<DrawCommand>& drawList, const glm::vec3& lightPos,
+                                const glm::vec3& sceneBoundsMin, const glm::vec3& sceneBoundsMax, const glm::mat4& viewMatrix, float fov,
+                                float aspectRatio, float nearPlane, float farPlane)
+{
+    stats = ShadowStats{};
+
+    const glm::vec3 sceneCenter = (sceneBoundsMin + sceneBoundsMax) * 0.5f;
+    const float sceneRadius = std::max(glm::length(sceneBoundsMax - sceneBoundsMin) * 0.5f, 1.0e-3f);
+
+    const glm::vec3 toLight = lightPos - sceneCenter;
+    const glm::vec3 direction = (glm::length(toLight) > 1.0e-6f) ? glm::normalize(toLight) : glm::vec3{0.0f, 1.0f, 0.0f};
+    if (direction != lightDirection || sceneBoundsMin != this->sceneBoundsMin || sceneBoundsMax != this->sceneBoundsMax)
+    {
+        Invalidate();
+
+        lightDirection = direction;
+        this->sceneBoundsMin = sceneBoundsMin;
+        this->sceneBoundsMax = sceneBoundsMax;
+    }
+
+    // light space only depends on the light direction, so snapped cascades keep their texel grid while the camera moves
+    const glm::vec3 up = (std::abs(direction.y) > 0.99f) ? glm::vec3{1.0f, 0.0f, 0.0f} : glm::vec3{0.0f, 1.0f, 0.0f};
+    const glm::mat4 lightViewMatrix = glm::lookAt(glm::vec3{0.0f}, -direction, up);
+
+    // every cascade spans the depth of the whole scene, so casters outside the view frustum still cast
+    const glm::vec3 lightSceneCenter{lightViewMatrix * glm::vec4{sceneCenter, 1.0f}};
+    const float depthMargin = sceneRadius * 0.01f;
+    const float lightNear = -(lightSceneCenter.z + sceneRadius) - depthMargin;
+    const float lightFar = -(lightSceneCenter.z - sceneRadius) + depthMargin;
+    const glm::vec2 sceneRectMin = glm::vec2{lightSceneCenter} - sceneRadius;
+    const glm::vec2 sceneRectMax = glm::vec2{lightSceneCenter} + sceneRadius;
+
+    const glm::mat4 inverseViewMatrix = glm::inverse(viewMatrix);
+    const glm::vec3 cameraPosition{inverseViewMatrix[3]};
+    const glm::vec3 cameraForward = -glm::normalize(glm::vec3{inverseViewMatrix[2]});
+
+    // squared distance from the view axis to a frustum corner per unit of view depth
+    const float tanHalfFov = std::tan(fov * 0.5f);
+    const float cornerScale = tanHalfFov * tanHalfFov * (1.0f + aspectRatio * aspectRatio);
+
+    const glm::mat4 textureSpaceMatrix = glm::scale(glm::translate(glm::mat4{1.0f}, glm::vec3{0.5f}), glm::vec3{0.5f});
+
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    bool framebufferBound = false;
+
+    float sliceNear = nearPlane;
+    for (int cascadeIndex = 0; cascadeIndex < cascadeCount; ++cascadeIndex)
+    {
+        const float splitFraction = static_cast<float>(cascadeIndex + 1) / static_cast<float>(cascadeCount);
+        const float logarithmicSplit = nearPlane * std::pow(farPlane / nearPlane, splitFraction);
+        const float uniformSplit = nearPlane + (farPlane - nearPlane) * splitFraction;
+        const float sliceFar = (cascadeIndex == cascadeCount - 1) ? farPlane
+                                                                   : splitLogarithmicWeight * logarithmicSplit + (1.0f - splitLogarithmicWeight) * uniformSplit;
+        uniforms.cascadeSplits[cascadeIndex] = sliceFar;
+
+        // the smallest sphere around the slice is centred on the view axis, its radius doesn't change with the camera's direction
+        const float sphereDepth = std::min((sliceNear + sliceFar) * (1.0f + cornerScale) * 0.5f, sliceFar);
+        const float sphereRadius = std::sqrt((sliceFar - sphereDepth) * (sliceFar - sphereDepth) + sliceFar * sliceFar * cornerScale);
+        sliceNear = sliceFar;
+
+        const glm::vec2 sphereCenter{lightViewMatrix * glm::vec4{cameraPosition + cameraForward * sphereDepth, 1.0f}};
+
+        // pixels shaded with this cascade lie in the sphere and in the scene
+        const glm::vec2 requiredMin = glm::max(sphereCenter - sphereRadius, sceneRectMin);
+        const glm::vec2 requiredMax = glm::min(sphereCenter + sphereRadius, sceneRectMax);
+        if (requiredMin.x > requiredMax.x || requiredMin.y > requiredMax.y)
+        {
+            continue;
+        }
+
+        Cascade& cascade = cascades[static_cast<std::size_t>(cascadeIndex)];
+        if (cascade.valid && requiredMin.x >= cascade.center.x - cascade.halfExtent && requiredMin.y >= cascade.center.y - cascade.halfExtent &&
+            requiredMax.x <= cascade.center.x + cascade.halfExtent && requiredMax.y <= cascade.center.y + cascade.halfExtent)
+        {
+            continue;
+        }
+
+        cascade.valid = true;
+        cascade.halfExtent = sphereRadius * cascadeGuardBand;
+
+        const float texelSize = cascade.halfExtent * 2.0f / static_cast<float>(mapSize);
+        cascade.center = glm::floor((requiredMin + requiredMax) * 0.5f / texelSize + 0.5f) * texelSize;
+
+        const glm::mat4 lightProjectionMatrix = glm::ortho(cascade.center.x - cascade.halfExtent, cascade.center.x + cascade.halfExtent,
+                                                           cascade.center.y - cascade.halfExtent, cascade.center.y + cascade.halfExtent, lightNear, lightFar);
+        const glm::mat4 lightViewProjectionMatrix = lightProjectionMatrix * lightViewMatrix;
+        uniforms.cascadeMatrices[cascadeIndex] = textureSpaceMatrix * lightViewProjectionMatrix;
+        uniforms.cascadeTexelSizes[cascadeIndex] = texelSize;
+
+        // only draws whose light space box overlaps the cascade's map can cast into it
+        casterDraws.assign(drawList.size(), 0);
+        const glm::mat3 lightRotation{lightViewMatrix};
+        const glm::mat3 absoluteRotation{glm::abs(lightRotation[0]), glm::abs(lightRotation[1]), glm::abs(lightRotation[2])};
+        for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+        {
+            const DrawCommand& drawCommand = drawList[drawIndex];
+            const glm::vec3 boundsCenter{lightViewMatrix * glm::vec4{(drawCommand.boundsMin + drawCommand.boundsMax) * 0.5f, 1.0f}};
+            const glm::vec3 boundsExtent = absoluteRotation * ((drawCommand.boundsMax - drawCommand.boundsMin) * 0.5f);
+
+            if (std::abs(boundsCenter.x - cascade.center.x) <= boundsExtent.x + cascade.halfExtent &&
+                std::abs(boundsCenter.y - cascade.center.y) <= boundsExtent.y + cascade.halfExtent)
+            {
+                casterDraws[drawIndex] = 1;
+                ++stats.casterDraws;
+            }
+        }
+
+        if (framebufferBound == false)
+        {
+            glGetIntegerv(GL_VIEWPORT, previousViewport);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, mapSize, mapSize);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(polygonOffsetFactor, polygonOffsetUnits);
+            framebufferBound = true;
+        }
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascadeIndex);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        DrawVisibility visibility;
+        visibility.visibleDraws = &casterDraws;
+        depthPrepass.SubmitShadowCasters(drawList, lightViewProjectionMatrix, visibility);
+
+        ++stats.renderedCascades;
+    }
+
+    if (framebufferBound)
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    const StreamingRange range = streamingBuffer.Write(&uniforms, sizeof(ShadowUniforms), streamingBuffer.GetUniformAlignment());
+    glBindBufferRange(GL_UNIFORM_BUFFER, ShadowBlockBinding, range.buffer, static_cast<GLintptr>(range.offset), sizeof(ShadowUniforms));
+
+    glActiveTexture(GL_TEXTURE0 + ShadowMapTextureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void CascadedShadowMaps::Invalidate()
+{
+    for (auto& cascade : cascades)
+    {
+        cascade.valid = false;
+    }
+}
+
+int CascadedShadowMaps::GetMapSize() const
+{
+    return mapSize;
+}
+
+int CascadedShadowMaps::GetCascadeCount() const
+{
+    return cascadeCount;
+}
+
+const ShadowStats& CascadedShadowMaps::GetStats() const
+{
+    return stats;
+}
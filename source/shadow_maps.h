@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "depth_prepass.h"
+#include "streaming_buffer.h"
+
+// uniform block binding point of the Shadows block and texture unit of the shadow map array,
+// programs name the sampler shadowMap
+const unsigned int ShadowBlockBinding = 2;
+const int ShadowMapTextureUnit = 8;
+
+const int MaxShadowCascades = 4;
+
+// std140 layout of the Shadows uniform block
+struct ShadowUniforms
+{
+    glm::mat4 cascadeMatrices[MaxShadowCascades];  // world space to shadow map texture coordinates and depth
+    glm::vec4 cascadeSplits;                       // view depth at which each cascade ends
+    glm::vec4 cascadeTexelSizes;                   // world size of one texel, scales the normal offset
+    glm::uvec4 cascadeCount;                       // x: cascades in use
+};
+
+struct ShadowStats
+{
+    unsigned int renderedCascades = 0;  // cascades drawn this frame, the others were still valid
+    unsigned int casterDraws = 0;       // draws of those cascades after culling against their boxes
+};
+
+// Cascaded shadow maps of the key light, which casts its shadows as a
+// directional light from its position towards the centre of the scene. The
+// view frustum is split into cascades between the near and far plane, closer
+// cascades covering less depth. Each cascade is covered by the bounding sphere
+// of its frustum slice, whose size doesn't change when the camera turns, and
+// its shadow map is placed in a fixed light space with its centre snapped to
+// whole texels, so shadow edges don't shimmer while the camera moves.
+// Cascades are cached: a cascade's map covers a little more than its sphere
+// and is only drawn again when the part of the sphere that overlaps the scene
+// has left it, or when the light or the scene bounds change. A static scene
+// seen from an orbiting camera redraws the far cascades once and the near one
+// every few frames. All cascades live in the layers of one GL_DEPTH_COMPONENT24
+// texture array with hardware depth comparison, which the shaders filter
+// with 3x3 bilinear PCF taps.
+class CascadedShadowMaps
+{
+public:
+    // the Shadows block is streamed through streamingBuffer every update
+    CascadedShadowMaps(StreamingBuffer& streamingBuffer, int mapSize, int cascadeCount);
+    ~CascadedShadowMaps();
+
+    CascadedShadowMaps(const CascadedShadowMaps&) = delete;
+    CascadedShadowMaps& operator=(const CascadedShadowMaps&) = delete;
+
+    // fits the cascades to a glm::perspective frustum and redraws those whose cached map no longer
+    // covers their part of the scene with the pre-pass's position stream, then binds the maps and
+    // the Shadows block for the shading pass
+    void Update(DepthPrepass& depthPrepass, const std::vector<DrawCommand>& drawList, const glm::vec3& lightPos, const glm::vec3& sceneBoundsMin,
+                const glm::vec3& sceneBoundsMax, const glm::mat4& viewMatrix, float fov, float aspectRatio, float nearPlane, float farPlane);
+
+    // redraws every cascade on the next update, after the scene's geometry changed
+    void Invalidate();
+
+    int GetMapSize() const;
+    int GetCascadeCount() const;
+
+    const ShadowStats& GetStats() const;
+
+private:
+    struct Cascade
+    {
+        bool valid;
+        glm::vec2 center;  // light space, a whole number of texels from the origin
+        float halfExtent;
+    };
+
+    StreamingBuffer& streamingBuffer;
+    int mapSize;
+    int cascadeCount;
+
+    glm::vec3 lightDirection;  // towards the light
+    glm::vec3 sceneBoundsMin;
+    glm::vec3 sceneBoundsMax;
+    std::vector<Cascade> cascades;
+    std::vector<unsigned char> casterDraws;
+
+    ShadowUniforms uniforms;
+
+    unsigned int depthTexture;
+    unsigned int framebuffer;
+
+    ShadowStats stats;
+};
@@ -0,0 +1,370 @@
+#include "software_occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include "cpu_features.h"
+#include "screen_bounds.h"
+
+namespace
+{
+
+const int bandHeight = 8;
+const int bandCount = SoftwareOcclusionHeight / bandHeight;
+const int tileSize = 8;
+const int tileCountX = SoftwareOcclusionWidth / tileSize;
+const int tileCountY = SoftwareOcclusionHeight / tileSize;
+
+// triangles transformed and set up per job
+const std::size_t setupChunkSize = 256;
+
+// edge and depth planes are moved by slightly more than half a pixel, so rounding
+// differences between the scalar and the AVX2 evaluation never matter
+const float pixelMargin = 0.5f + 1.0e-3f;
+
+OccluderTriangle RejectedTriangle()
+{
+    OccluderTriangle triangle = OccluderTriangle();
+    triangle.minY = SoftwareOcclusionHeight;
+    triangle.maxY = -1;
+
+    return triangle;
+}
+
+} // namespace
+
+void RasterizeOccludersScalar(const OccluderTriangle* triangles, std::size_t triangleCount, float* depths, int width, int firstRow, int rowCount)
+{
+    const int lastRow = firstRow + rowCount - 1;
+
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const OccluderTriangle& triangle = triangles[i];
+        if (triangle.maxY < firstRow || triangle.minY > lastRow)
+        {
+            continue;
+        }
+
+        for (int y = std::max(triangle.minY, firstRow); y <= std::min(triangle.maxY, lastRow); ++y)
+        {
+            const float centerY = static_cast<float>(y) + 0.5f;
+            const float rowEdge0 = triangle.edgeB[0] * centerY + triangle.edgeC[0];
+            const float rowEdge1 = triangle.edgeB[1] * centerY + triangle.edgeC[1];
+            const float rowEdge2 = triangle.edgeB[2] * centerY + triangle.edgeC[2];
+            const float rowDepth = triangle.depthB * centerY + triangle.depthC;
+
+            float* row = depths + y * width;
+
+            for (int x = triangle.minX; x <= triangle.maxX; ++x)
+            {
+                const float centerX = static_cast<float>(x) + 0.5f;
+                if (triangle.edgeA[0] * centerX + rowEdge0 >= 0.0f && triangle.edgeA[1] * centerX + rowEdge1 >= 0.0f &&
+                    triangle.edgeA[2] * centerX + rowEdge2 >= 0.0f)
+                {
+                    row[x] = std::min(row[x], triangle.depthA * centerX + rowDepth);
+                }
+            }
+        }
+    }
+}
+
+std::vector<glm::vec3> CreateOccluderTriangles(const std::vector<Vertex>& vertices, unsigned int maxTriangles)
+{
+    const std::size_t triangleCount = vertices.size() / 3;
+
+    std::vector<float> areas(triangleCount);
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const glm::vec3& p0 = vertices[i * 3].position;
+        areas[i] = glm::length(glm::cross(vertices[i * 3 + 1].position - p0, vertices[i * 3 + 2].position - p0));
+    }
+
+    std::vector<std::size_t> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0);
+
+    const std::size_t keptCount = std::min<std::size_t>(triangleCount, maxTriangles);
+    std::partial_sort(order.begin(), order.begin() + keptCount, order.end(),
+                      [&areas](std::size_t a, std::size_t b) { return areas[a] > areas[b]; });
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(keptCount * 3);
+    for (std::size_t i = 0; i < keptCount; ++i)
+    {
+        for (std::size_t corner = 0; corner < 3; ++corner)
+        {
+            positions.push_back(vertices[order[i] * 3 + corner].position);
+        }
+    }
+
+    return positions;
+}
+
+SoftwareOcclusionBuffer::SoftwareOcclusionBuffer(std::vector<glm::vec3> occluderTriangles, JobSystem& jobSystem, bool useAvx2)
+    : occluderPositions{std::move(occluderTriangles)},
+      jobSystem(jobSystem),
+      useAvx2{useAvx2 && IsAvx2Supported()},
+      depths(SoftwareOcclusionWidth * SoftwareOcclusionHeight, 1.0f),
+      tileMaxDepths(tileCountX * tileCountY, 1.0f),
+      viewProjectionMatrix{1.0f},
+      triangles(occluderPositions.size() / 3)
+{
+    stats.occluderTriangles = static_cast<unsigned int>(triangles.size());
+}
+
+bool SoftwareOcclusionBuffer::IsUsingAvx2() const
+{
+    return useAvx2;
+}
+
+unsigned int SoftwareOcclusionBuffer::GetThreadCount() const
+{
+    return jobSystem.GetThreadCount();
+}
+
+void SoftwareOcclusionBuffer::RenderOccluders(const glm::mat4& viewProjectionMatrix)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    this->viewProjectionMatrix = viewProjectionMatrix;
+
+    // bands read every triangle, so they wait for the whole setup
+    JobCounter setupJobs;
+    for (std::size_t firstTriangle = 0; firstTriangle < triangles.size(); firstTriangle += setupChunkSize)
+    {
+        const std::size_t triangleCount = std::min(setupChunkSize, triangles.size() - firstTriangle);
+        jobSystem.Run([this, firstTriangle, triangleCount]() { SetupTriangles(firstTriangle, triangleCount); }, setupJobs);
+    }
+
+    JobCounter bandJobs;
+    for (int band = 0; band < bandCount; ++band)
+    {
+        jobSystem.Run([this, band]() { RasterizeBand(band); }, bandJobs, &setupJobs);
+    }
+
+    // setupJobs may still be queueing the bands when they are done, wait on it even when a band threw
+    try
+    {
+        jobSystem.Wait(bandJobs);
+    }
+    catch (...)
+    {
+        jobSystem.Wait(setupJobs);
+        throw;
+    }
+    jobSystem.Wait(setupJobs);
+
+    stats.rasterizedTriangles = 0;
+    for (const auto& triangle : triangles)
+    {
+        stats.rasterizedTriangles += (triangle.minY <= triangle.maxY) ? 1 : 0;
+    }
+    stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+DrawVisibility SoftwareOcclusionBuffer::Cull(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    stats.testedDraws = static_cast<unsigned int>(drawList.size());
+    stats.frustumCulledDraws = 0;
+    stats.occludedDraws = 0;
+
+    visibleDraws.resize(drawList.size());
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        bool frustumCulled = false;
+        const bool occluded = IsOccluded(drawList[drawIndex].boundsMin, drawList[drawIndex].boundsMax, viewProjectionMatrix, frustumCulled);
+
+        visibleDraws[drawIndex] = (frustumCulled || occluded) ? 0 : 1;
+        stats.frustumCulledDraws += frustumCulled ? 1 : 0;
+        stats.occludedDraws += occluded ? 1 : 0;
+    }
+
+    stats.testMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    DrawVisibility visibility;
+    visibility.visibleDraws = &visibleDraws;
+
+    return visibility;
+}
+
+const std::vector<float>& SoftwareOcclusionBuffer::GetDepths() const
+{
+    return depths;
+}
+
+const SoftwareOcclusionStats& SoftwareOcclusionBuffer::GetStats() const
+{
+    return stats;
+}
+
+bool SoftwareOcclusionBuffer::IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& viewProjectionMatrix, bool& frustumCulled) const
+{
+    frustumCulled = false;
+
+    // boxes reaching behind the camera have no usable screen rectangle
+    glm::vec3 ndcMin;
+    glm::vec3 ndcMax;
+    if (ProjectBounds(boundsMin, boundsMax, viewProjectionMatrix, ndcMin, ndcMax) == false)
+    {
+        return false;
+    }
+
+    if (IsOutsideFrustum(ndcMin, ndcMax))
+    {
+        frustumCulled = true;
+        return false;
+    }
+
+    const float boxDepth = ndcMin.z * 0.5f + 0.5f;
+
+    const int pixelMinX = NdcToPixel(ndcMin.x, SoftwareOcclusionWidth);
+    const int pixelMaxX = NdcToPixel(ndcMax.x, SoftwareOcclusionWidth);
+    const int pixelMinY = NdcToPixel(ndcMin.y, SoftwareOcclusionHeight);
+    const int pixelMaxY = NdcToPixel(ndcMax.y, SoftwareOcclusionHeight);
+
+    for (int tileY = pixelMinY / tileSize; tileY <= pixelMaxY / tileSize; ++tileY)
+    {
+        for (int tileX = pixelMinX / tileSize; tileX <= pixelMaxX / tileSize; ++tileX)
+        {
+            // every pixel of the tile is nearer than the box
+            if (tileMaxDepths[tileY * tileCountX + tileX] < boxDepth)
+            {
+                continue;
+            }
+
+            const int minY = std::max(pixelMinY, tileY * tileSize);
+            const int maxY = std::min(pixelMaxY, tileY * tileSize + tileSize - 1);
+            const int minX = std::max(pixelMinX, tileX * tileSize);
+            const int maxX = std::min(pixelMaxX, tileX * tileSize + tileSize - 1);
+
+            for (int y = minY; y <= maxY; ++y)
+            {
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    if (depths[y * SoftwareOcclusionWidth + x] >= boxDepth)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void SoftwareOcclusionBuffer::SetupTriangles(std::size_t firstTriangle, std::size_t triangleCount)
+{
+    const glm::vec2 screenSize{static_cast<float>(SoftwareOcclusionWidth), static_cast<float>(SoftwareOcclusionHeight)};
+
+    for (std::size_t i = firstTriangle; i < firstTriangle + triangleCount; ++i)
+    {
+        triangles[i] = RejectedTriangle();
+
+        // triangles crossing the near plane are left out, fewer occluders only hide less
+        glm::vec3 screen[3];
+        bool inFront = true;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const glm::vec4 clipPosition = viewProjectionMatrix * glm::vec4{occluderPositions[i * 3 + corner], 1.0f};
+            if (clipPosition.w <= 0.0f || clipPosition.z < -clipPosition.w)
+            {
+                inFront = false;
+                break;
+            }
+
+            const glm::vec3 ndcPosition = glm::vec3{clipPosition} / clipPosition.w;
+            screen[corner] = glm::vec3{(glm::vec2{ndcPosition} * 0.5f + 0.5f) * screenSize, ndcPosition.z * 0.5f + 0.5f};
+        }
+        if (inFront == false)
+        {
+            continue;
+        }
+
+        // occluders are not backface culled, both windings are rasterized counter-clockwise
+        float doubleArea = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (doubleArea < 0.0f)
+        {
+            std::swap(screen[1], screen[2]);
+            doubleArea = -doubleArea;
+        }
+
+        // a triangle covering a whole pixel has an area of at least one pixel
+        if (doubleArea < 2.0f)
+        {
+            continue;
+        }
+
+        OccluderTriangle triangle;
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const glm::vec3& from = screen[edge];
+            const glm::vec3& to = screen[(edge + 1) % 3];
+
+            triangle.edgeA[edge] = from.y - to.y;
+            triangle.edgeB[edge] = to.x - from.x;
+            triangle.edgeC[edge] = -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y) -
+                                   pixelMargin * (std::abs(triangle.edgeA[edge]) + std::abs(triangle.edgeB[edge]));
+        }
+
+        const glm::vec3 edge1 = screen[1] - screen[0];
+        const glm::vec3 edge2 = screen[2] - screen[0];
+        triangle.depthA = (edge1.z * edge2.y - edge2.z * edge1.y) / doubleArea;
+        triangle.depthB = (edge1.x * edge2.z - edge2.x * edge1.z) / doubleArea;
+        triangle.depthC = screen[0].z - triangle.depthA * screen[0].x - triangle.depthB * screen[0].y +
+                          pixelMargin * (std::abs(triangle.depthA) + std::abs(triangle.depthB));
+
+        const float minX = std::min(std::min(screen[0].x, screen[1].x), screen[2].x);
+        const float maxX = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+        const float minY = std::min(std::min(screen[0].y, screen[1].y), screen[2].y);
+        const float maxY = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+        if (maxX < 0.0f || maxY < 0.0f || minX >= screenSize.x || minY >= screenSize.y)
+        {
+            continue;
+        }
+
+        // the AVX2 rasterizer walks rows in aligned groups of 8 pixels
+        triangle.minX = static_cast<int>(std::max(minX, 0.0f)) & ~7;
+        triangle.maxX = static_cast<int>(std::min(maxX, screenSize.x - 1.0f));
+        triangle.minY = static_cast<int>(std::max(minY, 0.0f));
+        triangle.maxY = static_cast<int>(std::min(maxY, screenSize.y - 1.0f));
+
+        triangles[i] = triangle;
+    }
+}
+
+void SoftwareOcclusionBuffer::RasterizeBand(int band)
+{
+    const int firstRow = band * bandHeight;
+    float* bandDepths = depths.data() + firstRow * SoftwareOcclusionWidth;
+
+    std::fill(bandDepths, bandDepths + bandHeight * SoftwareOcclusionWidth, 1.0f);
+
+#ifdef RASTER_AVX2
+    if (useAvx2)
+    {
+        RasterizeOccludersAvx2(triangles.data(), triangles.size(), depths.data(), SoftwareOcclusionWidth, firstRow, bandHeight);
+    }
+    else
+#endif
+    {
+        RasterizeOccludersScalar(triangles.data(), triangles.size(), depths.data(), SoftwareOcclusionWidth, firstRow, bandHeight);
+    }
+
+    // bands are one tile high
+    for (int tileX = 0; tileX < tileCountX; ++tileX)
+    {
+        float maxDepth = 0.0f;
+        for (int y = 0; y < tileSize; ++y)
+        {
+            for (int x = tileX * tileSize; x < tileX * tileSize + tileSize; ++x)
+            {
+                maxDepth = std::max(maxDepth, bandDepths[y * SoftwareOcclusionWidth + x]);
+            }
+        }
+        tileMaxDepths[band * tileCountX + tileX] = maxDepth;
+    }
+}
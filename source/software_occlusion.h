@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "draw_list.h"
+#include "job_system.h"
+#include "model.h"
+#include "occlusion_raster.h"
+
+// resolution of the software occlusion buffer, stretched over the whole viewport
+const int SoftwareOcclusionWidth = 256;
+const int SoftwareOcclusionHeight = 128;
+
+struct SoftwareOcclusionStats
+{
+    unsigned int occluderTriangles = 0;
+    unsigned int rasterizedTriangles = 0;  // in front of the near plane and covering at least one whole pixel
+    double rasterMilliseconds = 0.0;       // transform, setup and rasterization of the last frame
+    unsigned int testedDraws = 0;
+    unsigned int frustumCulledDraws = 0;
+    unsigned int occludedDraws = 0;
+    double testMilliseconds = 0.0;
+};
+
+// Picks the occluders of a model: its largest triangles by area, up to maxTriangles.
+// Returns three positions per triangle.
+std::vector<glm::vec3> CreateOccluderTriangles(const std::vector<Vertex>& vertices, unsigned int maxTriangles);
+
+// CPU occlusion culling without any GPU involvement or latency. Occluder
+// triangles are transformed and set up in parallel, then rasterized into a
+// small depth buffer in bands of 8 rows (one job per band, depending on the
+// setup jobs) with AVX2 when the CPU has it. Rasterization is
+// conservative: a triangle only writes pixels it covers completely, with its
+// farthest depth over the pixel. Each band also records the farthest depth of
+// its 8x8 tiles, and a draw's bounding box is occluded when its nearest depth
+// lies behind every covered pixel, whole tiles being accepted from their
+// maximum alone. Works on any thread, so it runs headless.
+class SoftwareOcclusionBuffer
+{
+public:
+    // rasterizes with the jobs of jobSystem, useAvx2 false forces the scalar rasterizer
+    SoftwareOcclusionBuffer(std::vector<glm::vec3> occluderTriangles, JobSystem& jobSystem, bool useAvx2);
+
+    SoftwareOcclusionBuffer(const SoftwareOcclusionBuffer&) = delete;
+    SoftwareOcclusionBuffer& operator=(const SoftwareOcclusionBuffer&) = delete;
+
+    bool IsUsingAvx2() const;
+    unsigned int GetThreadCount() const;
+
+    void RenderOccluders(const glm::mat4& viewProjectionMatrix);
+
+    // tests the draws' bounds against the buffer, the returned visibility refers to
+    // storage of the buffer and stays valid until the next call
+    DrawVisibility Cull(const std::vector<DrawCommand>& drawList, const glm::mat4& viewProjectionMatrix);
+
+    // bottom row first, SoftwareOcclusionWidth floats per row
+    const std::vector<float>& GetDepths() const;
+
+    const SoftwareOcclusionStats& GetStats() const;
+
+private:
+    // true when the box is hidden, frustumCulled reports boxes entirely outside the view
+    bool IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& viewProjectionMatrix, bool& frustumCulled) const;
+
+    void SetupTriangles(std::size_t firstTriangle, std::size_t triangleCount);
+    void RasterizeBand(int band);
+
+    std::vector<glm::vec3> occluderPositions;
+    JobSystem& jobSystem;
+    bool useAvx2;
+
+    std::vector<float> depths;
+    std::vector<float> tileMaxDepths;
+
+    // per-frame state, written by the calling thread before the jobs start
+    glm::mat4 viewProjectionMatrix;
+    std::vector<OccluderTriangle> triangles;  // one per occluder, rejected ones cover no rows
+
+    std::vector<unsigned char> visibleDraws;
+
+    SoftwareOcclusionStats stats;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+
+// edge length of the square screen tiles the software renderer bins triangles into
+const int SoftwareTileSize = 64;
+
+// vertex after the software renderer's vertex stage, the outputs of phong.vert
+struct RasterVertex
+{
+    float clipPosition[4];
+    float worldPosition[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+// one RGBA8 mip level, bottom row first like the levels uploaded by the texture cache
+struct RasterTextureLevel
+{
+    int width;
+    int height;
+    const unsigned char* texels;
+};
+
+struct RasterTexture
+{
+    const RasterTextureLevel* levels;
+    int levelCount;
+};
+
+struct RasterMaterial
+{
+    float ambientColor[3];
+    float diffuseColor[3];
+    float specularColor[3];
+    float shininess;
+    const RasterTexture* diffuseTexture;  // nullptr for untextured materials
+};
+
+struct RasterLight
+{
+    float position[3];
+    float radius;  // 0 for an unbounded light
+    float color[3];
+};
+
+// Screen-space triangle set up for rasterization, rows start at the bottom of
+// the screen. Edge i lies opposite vertex i and a*x + b*y + c is positive
+// inside, so edge i divided by the doubled area is the screen-space
+// barycentric weight of vertex i. Pixels centered exactly on an edge belong to
+// the triangle when it is a top or left edge, shared edges are drawn once.
+struct RasterTriangle
+{
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+    unsigned int topLeftEdges;  // bit i set for a top or left edge i
+
+    float depthA;
+    float depthB;
+    float depthC;
+
+    float inverseDoubleArea;
+    float inverseW[3];  // perspective correction of the barycentric weights
+
+    const RasterVertex* vertices[3];
+    const RasterMaterial* material;
+
+    // inclusive pixel bounds clamped to the screen
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+// Visibility buffer of one tile: the nearest depth per pixel and the triangle
+// that wrote it, nullptr where the clear colour shows through.
+struct RasterTileBuffer
+{
+    float depths[SoftwareTileSize * SoftwareTileSize];
+    const RasterTriangle* triangles[SoftwareTileSize * SoftwareTileSize];
+};
+
+// Placement of a tile on the screen and the image its shaded pixels are written to,
+// RGBA8 with the bottom row first like glReadPixels.
+struct RasterTileTarget
+{
+    int x;
+    int y;
+    int width;   // at most SoftwareTileSize, smaller along the right and top screen edges
+    int height;
+    unsigned char* image;
+    int imageWidth;
+};
+
+struct RasterShading
+{
+    const RasterLight* lights;
+    unsigned int lightCount;
+    float cameraPosition[3];
+    unsigned char clearColor[4];
+};
+
+// Depth tests the listed triangles against the tile buffer in order and keeps
+// the nearest one per pixel (GL_LESS), 8 pixels of a row at a time.
+void RasterizeTileScalar(const RasterTriangle* triangles, const unsigned int* triangleIndices, std::size_t triangleCount,
+                         const RasterTileTarget& target, RasterTileBuffer& buffer);
+
+// Shades every pixel of the tile buffer once with the Phong model of phong.frag,
+// 8 pixels at a time, and writes the result to the target image.
+void ShadeTileScalar(const RasterTileBuffer& buffer, const RasterShading& shading, const RasterTileTarget& target);
+
+// Same results from AVX2 and FMA code in a translation unit of its own (x86-64 only,
+// RASTER_AVX2), call them only when the CPU supports both.
+void RasterizeTileAvx2(const RasterTriangle* triangles, const unsigned int* triangleIndices, std::size_t triangleCount,
+                       const RasterTileTarget& target, RasterTileBuffer& buffer);
+void ShadeTileAvx2(const RasterTileBuffer& buffer, const RasterShading& shading, const RasterTileTarget& target);
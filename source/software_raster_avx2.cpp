@@ -0,0 +1,98 @@
+#include "software_raster.h"
+
+#include <immintrin.h>
+
+// This file is compiled with AVX2 enabled. It must not call inline functions from
+// other headers: the linker may keep this file's AVX2 copy for the whole program.
+
+namespace
+{
+
+struct Avx2Lanes
+{
+    struct Float
+    {
+        __m256 value;
+
+        friend Float operator+(Float a, Float b) { return Float{_mm256_add_ps(a.value, b.value)}; }
+        friend Float operator-(Float a, Float b) { return Float{_mm256_sub_ps(a.value, b.value)}; }
+        friend Float operator*(Float a, Float b) { return Float{_mm256_mul_ps(a.value, b.value)}; }
+        friend Float operator/(Float a, Float b) { return Float{_mm256_div_ps(a.value, b.value)}; }
+    };
+
+    struct Mask
+    {
+        __m256 value;
+    };
+
+    static Float Splat(float value) { return Float{_mm256_set1_ps(value)}; }
+    static Float Load(const float* values) { return Float{_mm256_loadu_ps(values)}; }
+    static void Store(float* values, Float a) { _mm256_storeu_ps(values, a.value); }
+
+    static Float MultiplyAdd(Float a, Float b, Float c) { return Float{_mm256_fmadd_ps(a.value, b.value, c.value)}; }
+    static Float Max(Float a, Float b) { return Float{_mm256_max_ps(a.value, b.value)}; }
+    static Float Sqrt(Float a) { return Float{_mm256_sqrt_ps(a.value)}; }
+
+    static Mask Less(Float a, Float b) { return Mask{_mm256_cmp_ps(a.value, b.value, _CMP_LT_OQ)}; }
+    static Mask Greater(Float a, Float b) { return Mask{_mm256_cmp_ps(a.value, b.value, _CMP_GT_OQ)}; }
+    static Mask GreaterEqual(Float a, Float b) { return Mask{_mm256_cmp_ps(a.value, b.value, _CMP_GE_OQ)}; }
+    static Mask And(Mask a, Mask b) { return Mask{_mm256_and_ps(a.value, b.value)}; }
+    static int Bits(Mask a) { return _mm256_movemask_ps(a.value); }
+    static Float Select(Mask mask, Float ifTrue, Float ifFalse) { return Float{_mm256_blendv_ps(ifFalse.value, ifTrue.value, mask.value)}; }
+
+    // base^exponent as exp2(exponent * log2(base)), 0 where base is not positive; both
+    // polynomials are accurate to about 1e-6, far below what an 8-bit colour can show
+    static Float Pow(Float base, Float exponent)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        // log2: exponent bits plus ln of the mantissa m in [1, 2) from the series of
+        // atanh((m - 1) / (m + 1)), whose argument stays below 1/3
+        const __m256i bits = _mm256_castps_si256(base.value);
+        const __m256 baseExponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        const __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_castps_si256(one)));
+
+        const __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+        const __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 series = _mm256_set1_ps(1.0f / 9.0f);
+        series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(1.0f / 7.0f));
+        series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(1.0f / 5.0f));
+        series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(1.0f / 3.0f));
+        series = _mm256_fmadd_ps(series, t2, one);
+        const __m256 log2Base = _mm256_fmadd_ps(_mm256_mul_ps(t, series), _mm256_set1_ps(2.0f / 0.69314718f), baseExponent);
+
+        // exp2: integer part into the exponent bits, fraction from the Taylor series of e^(f ln 2)
+        const __m256 power = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(exponent.value, log2Base), _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+        const __m256 whole = _mm256_floor_ps(power);
+        const __m256 f = _mm256_sub_ps(power, whole);
+
+        __m256 fraction = _mm256_set1_ps(1.5252733e-5f);
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(1.5403530e-4f));
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(1.3333558e-3f));
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(9.6181291e-3f));
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(5.5504109e-2f));
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(2.4022651e-1f));
+        fraction = _mm256_fmadd_ps(fraction, f, _mm256_set1_ps(6.9314718e-1f));
+        fraction = _mm256_fmadd_ps(fraction, f, one);
+
+        const __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+        const __m256 result = _mm256_mul_ps(fraction, _mm256_castsi256_ps(scale));
+
+        return Float{_mm256_and_ps(result, _mm256_cmp_ps(base.value, _mm256_setzero_ps(), _CMP_GT_OQ))};
+    }
+};
+
+} // namespace
+
+#include "software_raster_kernels.h"
+
+void RasterizeTileAvx2(const RasterTriangle* triangles, const unsigned int* triangleIndices, std::size_t triangleCount,
+                       const RasterTileTarget& target, RasterTileBuffer& buffer)
+{
+    RasterizeTile<Avx2Lanes>(triangles, triangleIndices, triangleCount, target, buffer);
+}
+
+void ShadeTileAvx2(const RasterTileBuffer& buffer, const RasterShading& shading, const RasterTileTarget& target)
+{
+    ShadeTile<Avx2Lanes>(buffer, shading, target);
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include "software_raster.h"
+
+// Tile rasterization and shading kernels of the software renderer, written
+// once against an 8-lane vector type and instantiated by the scalar and the
+// AVX2 translation unit with their own Lanes. Lanes provides Float and Mask
+// types, Float arithmetic operators and the static functions used below.
+// Everything here has internal linkage and calls nothing inline from other
+// headers, so the AVX2 instantiations can never replace the scalar ones.
+
+namespace
+{
+
+const float laneCenterOffsets[8] = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+
+int FloorToInt(float value)
+{
+    const int truncated = static_cast<int>(value);
+    return (value < static_cast<float>(truncated)) ? truncated - 1 : truncated;
+}
+
+// texel coordinate under GL_REPEAT
+int WrapTexel(int coordinate, int size)
+{
+    const int wrapped = coordinate % size;
+    return (wrapped < 0) ? wrapped + size : wrapped;
+}
+
+// perspective-correct barycentric weights of the triangle's vertices at a screen position
+void CalculatePerspectiveWeights(const RasterTriangle& triangle, float x, float y, float* weights)
+{
+    float sum = 0.0f;
+    for (int corner = 0; corner < 3; ++corner)
+    {
+        const float screenWeight = (triangle.edgeA[corner] * x + triangle.edgeB[corner] * y + triangle.edgeC[corner]) * triangle.inverseDoubleArea;
+        weights[corner] = screenWeight * triangle.inverseW[corner];
+        sum += weights[corner];
+    }
+
+    const float inverseSum = 1.0f / sum;
+    for (int corner = 0; corner < 3; ++corner)
+    {
+        weights[corner] *= inverseSum;
+    }
+}
+
+void InterpolateTexCoord(const RasterTriangle& triangle, const float* weights, float* texCoord)
+{
+    for (int component = 0; component < 2; ++component)
+    {
+        texCoord[component] = weights[0] * triangle.vertices[0]->texCoord[component] + weights[1] * triangle.vertices[1]->texCoord[component] +
+                              weights[2] * triangle.vertices[2]->texCoord[component];
+    }
+}
+
+// adds weight times the bilinearly filtered colour of the level to rgb
+void SampleLevelBilinear(const RasterTextureLevel& level, float u, float v, float weight, float* rgb)
+{
+    const float x = u * static_cast<float>(level.width) - 0.5f;
+    const float y = v * static_cast<float>(level.height) - 0.5f;
+    const int x0 = FloorToInt(x);
+    const int y0 = FloorToInt(y);
+    const float fractionX = x - static_cast<float>(x0);
+    const float fractionY = y - static_cast<float>(y0);
+
+    const int columns[2] = {WrapTexel(x0, level.width), WrapTexel(x0 + 1, level.width)};
+    const int rows[2] = {WrapTexel(y0, level.height), WrapTexel(y0 + 1, level.height)};
+    const float cornerWeights[4] = {(1.0f - fractionX) * (1.0f - fractionY), fractionX * (1.0f - fractionY), (1.0f - fractionX) * fractionY,
+                                    fractionX * fractionY};
+
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        const unsigned char* texel = level.texels + (static_cast<std::size_t>(rows[corner >> 1]) * level.width + columns[corner & 1]) * 4;
+        const float scale = weight * cornerWeights[corner] * (1.0f / 255.0f);
+        rgb[0] += static_cast<float>(texel[0]) * scale;
+        rgb[1] += static_cast<float>(texel[1]) * scale;
+        rgb[2] += static_cast<float>(texel[2]) * scale;
+    }
+}
+
+// log2 of a value in [1, 2) from a quadratic fit, within 0.01 of the exact value
+float Log2Fraction(float value)
+{
+    const float step = value - 1.0f;
+    return step + 0.3466f * step * (1.0f - step);
+}
+
+// GL_LINEAR_MIPMAP_LINEAR lookup, squaredFootprint is the larger squared texture coordinate
+// step to the neighbouring pixels, measured in level 0 texels
+void SampleTrilinear(const RasterTexture& texture, float u, float v, float squaredFootprint, float* rgb)
+{
+    rgb[0] = 0.0f;
+    rgb[1] = 0.0f;
+    rgb[2] = 0.0f;
+
+    // the level of detail is log2 of the footprint, half the log2 of its square
+    int level = 0;
+    while (squaredFootprint >= 4.0f && level < texture.levelCount - 1)
+    {
+        squaredFootprint *= 0.25f;
+        ++level;
+    }
+
+    if (squaredFootprint <= 1.0f || level == texture.levelCount - 1)
+    {
+        SampleLevelBilinear(texture.levels[level], u, v, 1.0f, rgb);
+        return;
+    }
+
+    const float fraction = 0.5f * ((squaredFootprint >= 2.0f) ? 1.0f + Log2Fraction(squaredFootprint * 0.5f) : Log2Fraction(squaredFootprint));
+    SampleLevelBilinear(texture.levels[level], u, v, 1.0f - fraction, rgb);
+    SampleLevelBilinear(texture.levels[level + 1], u, v, fraction, rgb);
+}
+
+// per-lane inputs of the lighting, gathered from the lanes' triangles
+struct PixelInputs
+{
+    float worldPosition[3][8];
+    float normal[3][8];
+    float ambientColor[3][8];
+    float diffuseColor[3][8];
+    float specularColor[3][8];
+    float shininess[8];
+};
+
+void GatherPixel(const RasterTriangle& triangle, float x, float y, int lane, PixelInputs& inputs)
+{
+    float weights[3];
+    CalculatePerspectiveWeights(triangle, x, y, weights);
+
+    for (int component = 0; component < 3; ++component)
+    {
+        inputs.worldPosition[component][lane] = weights[0] * triangle.vertices[0]->worldPosition[component] +
+                                                weights[1] * triangle.vertices[1]->worldPosition[component] +
+                                                weights[2] * triangle.vertices[2]->worldPosition[component];
+        inputs.normal[component][lane] = weights[0] * triangle.vertices[0]->normal[component] + weights[1] * triangle.vertices[1]->normal[component] +
+                                         weights[2] * triangle.vertices[2]->normal[component];
+    }
+
+    const RasterMaterial& material = *triangle.material;
+
+    float textureColor[3] = {1.0f, 1.0f, 1.0f};
+    if (material.diffuseTexture != nullptr)
+    {
+        float texCoord[2];
+        InterpolateTexCoord(triangle, weights, texCoord);
+
+        // derivatives from the same triangle one pixel to the right and one pixel up
+        float neighbourWeights[3];
+        float texCoordRight[2];
+        float texCoordUp[2];
+        CalculatePerspectiveWeights(triangle, x + 1.0f, y, neighbourWeights);
+        InterpolateTexCoord(triangle, neighbourWeights, texCoordRight);
+        CalculatePerspectiveWeights(triangle, x, y + 1.0f, neighbourWeights);
+        InterpolateTexCoord(triangle, neighbourWeights, texCoordUp);
+
+        const RasterTextureLevel& baseLevel = material.diffuseTexture->levels[0];
+        const float width = static_cast<float>(baseLevel.width);
+        const float height = static_cast<float>(baseLevel.height);
+        const float stepX[2] = {(texCoordRight[0] - texCoord[0]) * width, (texCoordRight[1] - texCoord[1]) * height};
+        const float stepY[2] = {(texCoordUp[0] - texCoord[0]) * width, (texCoordUp[1] - texCoord[1]) * height};
+        const float squaredStepX = stepX[0] * stepX[0] + stepX[1] * stepX[1];
+        const float squaredStepY = stepY[0] * stepY[0] + stepY[1] * stepY[1];
+
+        const float squaredFootprint = (squaredStepX > squaredStepY) ? squaredStepX : squaredStepY;
+        SampleTrilinear(*material.diffuseTexture, texCoord[0], texCoord[1], squaredFootprint, textureColor);
+    }
+
+    for (int component = 0; component < 3; ++component)
+    {
+        inputs.ambientColor[component][lane] = material.ambientColor[component];
+        inputs.diffuseColor[component][lane] = material.diffuseColor[component] * textureColor[component];
+        inputs.specularColor[component][lane] = material.specularColor[component];
+    }
+    inputs.shininess[lane] = material.shininess;
+}
+
+// lanes without a triangle get harmless inputs, their results are discarded
+void ClearPixel(const RasterShading& shading, int lane, PixelInputs& inputs)
+{
+    for (int component = 0; component < 3; ++component)
+    {
+        inputs.worldPosition[component][lane] = shading.cameraPosition[component] + 1.0f;
+        inputs.normal[component][lane] = 1.0f;
+        inputs.ambientColor[component][lane] = 0.0f;
+        inputs.diffuseColor[component][lane] = 0.0f;
+        inputs.specularColor[component][lane] = 0.0f;
+    }
+    inputs.shininess[lane] = 1.0f;
+}
+
+// clamps like a GL_RGBA8 colour attachment, NaN becomes 0
+unsigned char ToUnorm8(float value)
+{
+    if ((value > 0.0f) == false)
+    {
+        return 0;
+    }
+    if (value >= 1.0f)
+    {
+        return 255;
+    }
+
+    return static_cast<unsigned char>(value * 255.0f + 0.5f);
+}
+
+template <typename Lanes>
+void RasterizeTile(const RasterTriangle* triangles, const unsigned int* triangleIndices, std::size_t triangleCount,
+                   const RasterTileTarget& target, RasterTileBuffer& buffer)
+{
+    typedef typename Lanes::Float Float;
+    typedef typename Lanes::Mask Mask;
+
+    const Float laneCenters = Lanes::Load(laneCenterOffsets);
+    const Float zero = Lanes::Splat(0.0f);
+    const int lastX = target.x + target.width - 1;
+    const int lastY = target.y + target.height - 1;
+
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const RasterTriangle& triangle = triangles[triangleIndices[i]];
+
+        // tiles start at multiples of 8, so rows are walked in aligned groups of 8 pixels
+        const int minX = ((triangle.minX > target.x) ? triangle.minX : target.x) & ~7;
+        const int maxX = (triangle.maxX < lastX) ? triangle.maxX : lastX;
+        const int minY = (triangle.minY > target.y) ? triangle.minY : target.y;
+        const int maxY = (triangle.maxY < lastY) ? triangle.maxY : lastY;
+
+        const Float edgeA0 = Lanes::Splat(triangle.edgeA[0]);
+        const Float edgeA1 = Lanes::Splat(triangle.edgeA[1]);
+        const Float edgeA2 = Lanes::Splat(triangle.edgeA[2]);
+        const Float depthA = Lanes::Splat(triangle.depthA);
+        const bool inclusive0 = (triangle.topLeftEdges & 1u) != 0;
+        const bool inclusive1 = (triangle.topLeftEdges & 2u) != 0;
+        const bool inclusive2 = (triangle.topLeftEdges & 4u) != 0;
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float centerY = static_cast<float>(y) + 0.5f;
+            const Float rowEdge0 = Lanes::Splat(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+            const Float rowEdge1 = Lanes::Splat(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+            const Float rowEdge2 = Lanes::Splat(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+            const Float rowDepth = Lanes::Splat(triangle.depthB * centerY + triangle.depthC);
+
+            const int rowOffset = (y - target.y) * SoftwareTileSize - target.x;
+            bool rowEntered = false;
+
+            for (int x = minX; x <= maxX; x += 8)
+            {
+                const Float centerX = Lanes::Splat(static_cast<float>(x)) + laneCenters;
+                const Float edge0 = Lanes::MultiplyAdd(edgeA0, centerX, rowEdge0);
+                const Float edge1 = Lanes::MultiplyAdd(edgeA1, centerX, rowEdge1);
+                const Float edge2 = Lanes::MultiplyAdd(edgeA2, centerX, rowEdge2);
+
+                const Mask inside0 = inclusive0 ? Lanes::GreaterEqual(edge0, zero) : Lanes::Greater(edge0, zero);
+                const Mask inside1 = inclusive1 ? Lanes::GreaterEqual(edge1, zero) : Lanes::Greater(edge1, zero);
+                const Mask inside2 = inclusive2 ? Lanes::GreaterEqual(edge2, zero) : Lanes::Greater(edge2, zero);
+                const Mask inside = Lanes::And(Lanes::And(inside0, inside1), inside2);
+                if (Lanes::Bits(inside) == 0)
+                {
+                    // triangles are convex, the row is done once it has been left
+                    if (rowEntered)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                rowEntered = true;
+
+                float* depths = buffer.depths + rowOffset + x;
+                const Float depth = Lanes::MultiplyAdd(depthA, centerX, rowDepth);
+                const Float previous = Lanes::Load(depths);
+                const Mask passed = Lanes::And(inside, Lanes::Less(depth, previous));
+
+                const int passedBits = Lanes::Bits(passed);
+                if (passedBits == 0)
+                {
+                    continue;
+                }
+
+                Lanes::Store(depths, Lanes::Select(passed, depth, previous));
+
+                const RasterTriangle** pixelTriangles = buffer.triangles + rowOffset + x;
+                for (int lane = 0; lane < 8; ++lane)
+                {
+                    if ((passedBits & (1 << lane)) != 0)
+                    {
+                        pixelTriangles[lane] = &triangle;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Lanes>
+void ShadePixels(const RasterTriangle* const* pixelTriangles, int coveredBits, float centerX, float centerY, const RasterShading& shading,
+                 int laneCount, unsigned char* pixels)
+{
+    typedef typename Lanes::Float Float;
+    typedef typename Lanes::Mask Mask;
+
+    PixelInputs inputs;
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        if ((coveredBits & (1 << lane)) != 0)
+        {
+            GatherPixel(*pixelTriangles[lane], centerX + static_cast<float>(lane), centerY, lane, inputs);
+        }
+        else
+        {
+            ClearPixel(shading, lane, inputs);
+        }
+    }
+
+    const Float zero = Lanes::Splat(0.0f);
+    const Float one = Lanes::Splat(1.0f);
+    const Float two = Lanes::Splat(2.0f);
+
+    const Float positionX = Lanes::Load(inputs.worldPosition[0]);
+    const Float positionY = Lanes::Load(inputs.worldPosition[1]);
+    const Float positionZ = Lanes::Load(inputs.worldPosition[2]);
+
+    Float normalX = Lanes::Load(inputs.normal[0]);
+    Float normalY = Lanes::Load(inputs.normal[1]);
+    Float normalZ = Lanes::Load(inputs.normal[2]);
+    const Float inverseNormalLength = one / Lanes::Sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+    normalX = normalX * inverseNormalLength;
+    normalY = normalY * inverseNormalLength;
+    normalZ = normalZ * inverseNormalLength;
+
+    Float viewX = Lanes::Splat(shading.cameraPosition[0]) - positionX;
+    Float viewY = Lanes::Splat(shading.cameraPosition[1]) - positionY;
+    Float viewZ = Lanes::Splat(shading.cameraPosition[2]) - positionZ;
+    const Float inverseViewLength = one / Lanes::Sqrt(viewX * viewX + viewY * viewY + viewZ * viewZ);
+    viewX = viewX * inverseViewLength;
+    viewY = viewY * inverseViewLength;
+    viewZ = viewZ * inverseViewLength;
+
+    const Float diffuseR = Lanes::Load(inputs.diffuseColor[0]);
+    const Float diffuseG = Lanes::Load(inputs.diffuseColor[1]);
+    const Float diffuseB = Lanes::Load(inputs.diffuseColor[2]);
+    const Float specularR = Lanes::Load(inputs.specularColor[0]);
+    const Float specularG = Lanes::Load(inputs.specularColor[1]);
+    const Float specularB = Lanes::Load(inputs.specularColor[2]);
+    const Float shininess = Lanes::Load(inputs.shininess);
+
+    const Float ambientScale = Lanes::Splat(0.1f);
+    Float colorR = ambientScale * Lanes::Load(inputs.ambientColor[0]);
+    Float colorG = ambientScale * Lanes::Load(inputs.ambientColor[1]);
+    Float colorB = ambientScale * Lanes::Load(inputs.ambientColor[2]);
+
+    for (unsigned int lightIndex = 0; lightIndex < shading.lightCount; ++lightIndex)
+    {
+        const RasterLight& light = shading.lights[lightIndex];
+
+        const Float toLightX = Lanes::Splat(light.position[0]) - positionX;
+        const Float toLightY = Lanes::Splat(light.position[1]) - positionY;
+        const Float toLightZ = Lanes::Splat(light.position[2]) - positionZ;
+        const Float squaredDistance = toLightX * toLightX + toLightY * toLightY + toLightZ * toLightZ;
+
+        Float attenuation = one;
+        if (light.radius > 0.0f)
+        {
+            // lanes beyond the radius get no light at all, most bounded lights miss the whole group
+            const float squaredRadius = light.radius * light.radius;
+            const Mask reached = Lanes::Less(squaredDistance, Lanes::Splat(squaredRadius));
+            if ((Lanes::Bits(reached) & coveredBits) == 0)
+            {
+                continue;
+            }
+
+            const Float squaredRatio = squaredDistance * Lanes::Splat(1.0f / squaredRadius);
+            const Float falloff = Lanes::Max(one - squaredRatio * squaredRatio, zero);
+            attenuation = falloff * falloff;
+        }
+
+        const Float inverseDistance = one / Lanes::Sqrt(squaredDistance);
+        const Float lightDirX = toLightX * inverseDistance;
+        const Float lightDirY = toLightY * inverseDistance;
+        const Float lightDirZ = toLightZ * inverseDistance;
+
+        const Float normalDotLight = normalX * lightDirX + normalY * lightDirY + normalZ * lightDirZ;
+        const Float diffuseTerm = Lanes::Max(normalDotLight, zero) * attenuation;
+
+        // reflect(-lightDir, normal)
+        const Float reflectX = two * normalDotLight * normalX - lightDirX;
+        const Float reflectY = two * normalDotLight * normalY - lightDirY;
+        const Float reflectZ = two * normalDotLight * normalZ - lightDirZ;
+        const Float viewDotReflect = Lanes::Max(viewX * reflectX + viewY * reflectY + viewZ * reflectZ, zero);
+        const Float specularTerm = Lanes::Pow(viewDotReflect, shininess) * attenuation;
+
+        const Float lightR = Lanes::Splat(light.color[0]);
+        const Float lightG = Lanes::Splat(light.color[1]);
+        const Float lightB = Lanes::Splat(light.color[2]);
+        colorR = colorR + lightR * (diffuseTerm * diffuseR + specularTerm * specularR);
+        colorG = colorG + lightG * (diffuseTerm * diffuseG + specularTerm * specularG);
+        colorB = colorB + lightB * (diffuseTerm * diffuseB + specularTerm * specularB);
+    }
+
+    float red[8];
+    float green[8];
+    float blue[8];
+    Lanes::Store(red, colorR);
+    Lanes::Store(green, colorG);
+    Lanes::Store(blue, colorB);
+
+    for (int lane = 0; lane < laneCount; ++lane)
+    {
+        unsigned char* pixel = pixels + lane * 4;
+        if ((coveredBits & (1 << lane)) != 0)
+        {
+            pixel[0] = ToUnorm8(red[lane]);
+            pixel[1] = ToUnorm8(green[lane]);
+            pixel[2] = ToUnorm8(blue[lane]);
+            pixel[3] = 255;
+        }
+        else
+        {
+            pixel[0] = shading.clearColor[0];
+            pixel[1] = shading.clearColor[1];
+            pixel[2] = shading.clearColor[2];
+            pixel[3] = shading.clearColor[3];
+        }
+    }
+}
+
+template <typename Lanes>
+void ShadeTile(const RasterTileBuffer& buffer, const RasterShading& shading, const RasterTileTarget& target)
+{
+    for (int y = 0; y < target.height; ++y)
+    {
+        unsigned char* row = target.image + (static_cast<std::size_t>(target.y + y) * target.imageWidth + target.x) * 4;
+
+        for (int x = 0; x < target.width; x += 8)
+        {
+            const int laneCount = (target.width - x < 8) ? target.width - x : 8;
+            const RasterTriangle* const* pixelTriangles = buffer.triangles + y * SoftwareTileSize + x;
+
+            int coveredBits = 0;
+            for (int lane = 0; lane < laneCount; ++lane)
+            {
+                coveredBits |= (pixelTriangles[lane] != nullptr) ? (1 << lane) : 0;
+            }
+
+            if (coveredBits == 0)
+            {
+                for (int lane = 0; lane < laneCount; ++lane)
+                {
+                    for (int channel = 0; channel < 4; ++channel)
+                    {
+                        row[(x + lane) * 4 + channel] = shading.clearColor[channel];
+                    }
+                }
+                continue;
+            }
+
+            ShadePixels<Lanes>(pixelTriangles, coveredBits, static_cast<float>(target.x + x) + 0.5f, static_cast<float>(target.y + y) + 0.5f, shading,
+                               laneCount, row + x * 4);
+        }
+    }
+}
+
+} // namespace
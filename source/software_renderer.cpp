@@ -0,0 +1,778 @@
+#include "software_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+
+#include <stb_image.h>
+
+#include "cpu_features.h"
+#include "texture_cache.h"
+
+namespace
+{
+
+// vertices transformed and triangles set up per task
+const std::size_t transformChunkSize = 4096;
+const std::size_t setupChunkSize = 4096;
+
+// 8 float lanes for the shared kernels, plain loops the compiler may vectorize on its own
+struct ScalarLanes
+{
+    struct Float
+    {
+        float lane[8];
+
+        friend Float operator+(const Float& a, const Float& b)
+        {
+            Float result;
+            for (int i = 0; i < 8; ++i)
+            {
+                result.lane[i] = a.lane[i] + b.lane[i];
+            }
+            return result;
+        }
+
+        friend Float operator-(const Float& a, const Float& b)
+        {
+            Float result;
+            for (int i = 0; i < 8; ++i)
+            {
+                result.lane[i] = a.lane[i] - b.lane[i];
+            }
+            return result;
+        }
+
+        friend Float operator*(const Float& a, const Float& b)
+        {
+            Float result;
+            for (int i = 0; i < 8; ++i)
+            {
+                result.lane[i] = a.lane[i] * b.lane[i];
+            }
+            return result;
+        }
+
+        friend Float operator/(const Float& a, const Float& b)
+        {
+            Float result;
+            for (int i = 0; i < 8; ++i)
+            {
+                result.lane[i] = a.lane[i] / b.lane[i];
+            }
+            return result;
+        }
+    };
+
+    // one bit per lane
+    typedef int Mask;
+
+    static Float Splat(float value)
+    {
+        Float result;
+        std::fill(result.lane, result.lane + 8, value);
+        return result;
+    }
+
+    static Float Load(const float* values)
+    {
+        Float result;
+        std::copy(values, values + 8, result.lane);
+        return result;
+    }
+
+    static void Store(float* values, const Float& a)
+    {
+        std::copy(a.lane, a.lane + 8, values);
+    }
+
+    static Float MultiplyAdd(const Float& a, const Float& b, const Float& c)
+    {
+        return a * b + c;
+    }
+
+    static Float Max(const Float& a, const Float& b)
+    {
+        Float result;
+        for (int i = 0; i < 8; ++i)
+        {
+            result.lane[i] = std::max(a.lane[i], b.lane[i]);
+        }
+        return result;
+    }
+
+    static Float Sqrt(const Float& a)
+    {
+        Float result;
+        for (int i = 0; i < 8; ++i)
+        {
+            result.lane[i] = std::sqrt(a.lane[i]);
+        }
+        return result;
+    }
+
+    // 0 where base is not positive
+    static Float Pow(const Float& base, const Float& exponent)
+    {
+        Float result;
+        for (int i = 0; i < 8; ++i)
+        {
+            result.lane[i] = (base.lane[i] > 0.0f) ? std::pow(base.lane[i], exponent.lane[i]) : 0.0f;
+        }
+        return result;
+    }
+
+    static Mask Less(const Float& a, const Float& b)
+    {
+        Mask bits = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            bits |= (a.lane[i] < b.lane[i]) ? (1 << i) : 0;
+        }
+        return bits;
+    }
+
+    static Mask Greater(const Float& a, const Float& b)
+    {
+        return Less(b, a);
+    }
+
+    static Mask GreaterEqual(const Float& a, const Float& b)
+    {
+        Mask bits = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            bits |= (a.lane[i] >= b.lane[i]) ? (1 << i) : 0;
+        }
+        return bits;
+    }
+
+    static Mask And(Mask a, Mask b)
+    {
+        return a & b;
+    }
+
+    static int Bits(Mask a)
+    {
+        return a;
+    }
+
+    static Float Select(Mask mask, const Float& ifTrue, const Float& ifFalse)
+    {
+        Float result;
+        for (int i = 0; i < 8; ++i)
+        {
+            result.lane[i] = ((mask & (1 << i)) != 0) ? ifTrue.lane[i] : ifFalse.lane[i];
+        }
+        return result;
+    }
+};
+
+unsigned char ToByte(float value)
+{
+    return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+RasterVertex InterpolateVertex(const RasterVertex& a, const RasterVertex& b, float t)
+{
+    RasterVertex vertex;
+    for (int i = 0; i < 4; ++i)
+    {
+        vertex.clipPosition[i] = a.clipPosition[i] + (b.clipPosition[i] - a.clipPosition[i]) * t;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        vertex.worldPosition[i] = a.worldPosition[i] + (b.worldPosition[i] - a.worldPosition[i]) * t;
+        vertex.normal[i] = a.normal[i] + (b.normal[i] - a.normal[i]) * t;
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        vertex.texCoord[i] = a.texCoord[i] + (b.texCoord[i] - a.texCoord[i]) * t;
+    }
+
+    return vertex;
+}
+
+// signed distance to the near plane in clip space, negative behind it
+float NearPlaneDistance(const RasterVertex& vertex)
+{
+    return vertex.clipPosition[2] + vertex.clipPosition[3];
+}
+
+// first and last pixel whose center lies within [min, max], clamped to the screen
+bool ToPixelRange(float min, float max, int size, int& first, int& last)
+{
+    const float clampedMin = std::min(std::max(min - 0.5f, -1.0f), static_cast<float>(size));
+    const float clampedMax = std::min(std::max(max - 0.5f, -1.0f), static_cast<float>(size));
+    first = std::max(static_cast<int>(std::ceil(clampedMin)), 0);
+    last = std::min(static_cast<int>(std::floor(clampedMax)), size - 1);
+
+    return first <= last;
+}
+
+// false when one edge is negative at every pixel center of the tile
+bool TriangleTouchesTile(const RasterTriangle& triangle, int tileX, int tileY)
+{
+    const float minX = static_cast<float>(tileX * SoftwareTileSize) + 0.5f;
+    const float minY = static_cast<float>(tileY * SoftwareTileSize) + 0.5f;
+    const float maxX = minX + static_cast<float>(SoftwareTileSize - 1);
+    const float maxY = minY + static_cast<float>(SoftwareTileSize - 1);
+
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        const float x = (triangle.edgeA[edge] >= 0.0f) ? maxX : minX;
+        const float y = (triangle.edgeB[edge] >= 0.0f) ? maxY : minY;
+        if (triangle.edgeA[edge] * x + triangle.edgeB[edge] * y + triangle.edgeC[edge] < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+#include "software_raster_kernels.h"
+
+void RasterizeTileScalar(const RasterTriangle* triangles, const unsigned int* triangleIndices, std::size_t triangleCount,
+                         const RasterTileTarget& target, RasterTileBuffer& buffer)
+{
+    RasterizeTile<ScalarLanes>(triangles, triangleIndices, triangleCount, target, buffer);
+}
+
+void ShadeTileScalar(const RasterTileBuffer& buffer, const RasterShading& shading, const RasterTileTarget& target)
+{
+    ShadeTile<ScalarLanes>(buffer, shading, target);
+}
+
+ImageDifference CompareImages(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference, int tolerance)
+{
+    ImageDifference difference;
+
+    const std::size_t pixelCount = std::min(image.size(), reference.size()) / 4;
+    if (pixelCount == 0)
+    {
+        return difference;
+    }
+
+    unsigned long long differenceSum = 0;
+    std::size_t differingPixels = 0;
+    for (std::size_t pixel = 0; pixel < pixelCount; ++pixel)
+    {
+        int pixelDifference = 0;
+        for (std::size_t channel = 0; channel < 3; ++channel)
+        {
+            const int channelDifference = std::abs(static_cast<int>(image[pixel * 4 + channel]) - static_cast<int>(reference[pixel * 4 + channel]));
+            pixelDifference = std::max(pixelDifference, channelDifference);
+            differenceSum += static_cast<unsigned long long>(channelDifference);
+        }
+
+        difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+        differingPixels += (pixelDifference > tolerance) ? 1 : 0;
+    }
+
+    difference.meanDifference = static_cast<double>(differenceSum) / static_cast<double>(pixelCount * 3);
+    difference.differingPixelFraction = static_cast<double>(differingPixels) / static_cast<double>(pixelCount);
+
+    return difference;
+}
+
+SoftwareRenderer::SoftwareRenderer(const Model& model, JobSystem& jobSystem, bool useAvx2)
+    : vertices{model.vertices},
+      jobSystem(jobSystem),
+      useAvx2{useAvx2 && IsAvx2Supported()},
+      width{0},
+      height{0},
+      tileCountX{0},
+      tileCountY{0},
+      drawList{nullptr},
+      viewProjectionMatrix{1.0f},
+      shading()
+{
+    // the same path is decoded once, like the texture cache does
+    std::vector<std::pair<std::string, std::size_t>> textureSources;  // path and offset of every loaded texture
+    for (const auto& material : model.materials)
+    {
+        RasterMaterial rasterMaterial;
+        for (int component = 0; component < 3; ++component)
+        {
+            rasterMaterial.ambientColor[component] = material.ambientColor[component];
+            rasterMaterial.diffuseColor[component] = material.diffuseColor[component];
+            rasterMaterial.specularColor[component] = material.specularColor[component];
+        }
+        rasterMaterial.shininess = material.shininessValue;
+        rasterMaterial.diffuseTexture = nullptr;
+
+        if (material.diffuseTexturePath.empty() == false)
+        {
+            const auto source = std::make_pair(material.diffuseTexturePath, material.diffuseTextureOffset);
+            const auto existing = std::find(textureSources.begin(), textureSources.end(), source);
+            if (existing != textureSources.end())
+            {
+                rasterMaterial.diffuseTexture = &textures[existing - textureSources.begin()]->texture;
+            }
+            else
+            {
+                textures.emplace_back(new Texture{});
+                textureSources.push_back(source);
+                LoadTexture(material, *textures.back());
+                rasterMaterial.diffuseTexture = &textures.back()->texture;
+            }
+        }
+
+        materials.push_back(rasterMaterial);
+    }
+}
+
+bool SoftwareRenderer::IsUsingAvx2() const
+{
+    return useAvx2;
+}
+
+unsigned int SoftwareRenderer::GetThreadCount() const
+{
+    return jobSystem.GetThreadCount();
+}
+
+void SoftwareRenderer::Render(const std::vector<DrawCommand>& drawList, const FrameUniforms& frameUniforms, const std::vector<PointLight>& lights,
+                              const glm::vec4& clearColor)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    width = std::max(static_cast<int>(frameUniforms.viewportSize.x), 1);
+    height = std::max(static_cast<int>(frameUniforms.viewportSize.y), 1);
+    tileCountX = (width + SoftwareTileSize - 1) / SoftwareTileSize;
+    tileCountY = (height + SoftwareTileSize - 1) / SoftwareTileSize;
+    image.resize(static_cast<std::size_t>(width) * height * 4);
+
+    this->drawList = &drawList;
+    viewProjectionMatrix = frameUniforms.projectionMatrix * frameUniforms.viewMatrix;
+
+    this->lights.resize(lights.size());
+    for (std::size_t i = 0; i < lights.size(); ++i)
+    {
+        RasterLight& light = this->lights[i];
+        for (int component = 0; component < 3; ++component)
+        {
+            light.position[component] = lights[i].position[component];
+            light.color[component] = lights[i].color[component];
+        }
+        light.radius = lights[i].radius;
+    }
+
+    shading.lights = this->lights.data();
+    shading.lightCount = static_cast<unsigned int>(this->lights.size());
+    for (int component = 0; component < 3; ++component)
+    {
+        shading.cameraPosition[component] = frameUniforms.cameraPos[component];
+    }
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        shading.clearColor[channel] = ToByte(clearColor[channel]);
+    }
+
+    // split the draws into transform tasks and setup chunks
+    drawVertexOffsets.resize(drawList.size());
+    transformTasks.clear();
+    std::size_t chunkCount = 0;
+    std::size_t vertexCount = 0;
+    stats.triangles = 0;
+    for (std::size_t drawIndex = 0; drawIndex < drawList.size(); ++drawIndex)
+    {
+        const std::size_t drawVertexCount = static_cast<std::size_t>(drawList[drawIndex].vertexCount);
+        const std::size_t drawTriangleCount = drawVertexCount / 3;
+
+        drawVertexOffsets[drawIndex] = vertexCount;
+        for (std::size_t first = 0; first < drawVertexCount; first += transformChunkSize)
+        {
+            transformTasks.push_back(TransformTask{drawIndex, first, std::min(transformChunkSize, drawVertexCount - first)});
+        }
+
+        for (std::size_t first = 0; first < drawTriangleCount; first += setupChunkSize)
+        {
+            if (chunkCount == setupChunks.size())
+            {
+                setupChunks.emplace_back();
+            }
+
+            SetupChunk& chunk = setupChunks[chunkCount++];
+            chunk.drawIndex = drawIndex;
+            chunk.firstVertex = vertexCount + first * 3;
+            chunk.triangleCount = std::min(setupChunkSize, drawTriangleCount - first);
+        }
+
+        vertexCount += drawVertexCount;
+        stats.triangles += static_cast<unsigned int>(drawTriangleCount);
+    }
+    setupChunks.resize(chunkCount);
+    transformedVertices.resize(vertexCount);
+
+    jobSystem.ParallelFor(transformTasks.size(), 1, [this](std::size_t first, std::size_t end)
+    {
+        for (std::size_t task = first; task < end; ++task)
+        {
+            TransformVertices(transformTasks[task]);
+        }
+    });
+    const auto transformEndTime = std::chrono::steady_clock::now();
+
+    jobSystem.ParallelFor(setupChunks.size(), 1, [this](std::size_t first, std::size_t end)
+    {
+        for (std::size_t chunk = first; chunk < end; ++chunk)
+        {
+            SetupTriangles(setupChunks[chunk]);
+        }
+    });
+    const auto setupEndTime = std::chrono::steady_clock::now();
+
+    // one job per tile, tiles vary too much in cost for larger pieces to balance
+    jobSystem.ParallelFor(static_cast<std::size_t>(tileCountX * tileCountY), 1, [this](std::size_t first, std::size_t end)
+    {
+        RasterTileBuffer* buffer = AcquireTileBuffer();
+        for (std::size_t tile = first; tile < end; ++tile)
+        {
+            RenderTile(static_cast<unsigned int>(tile), *buffer);
+        }
+        ReleaseTileBuffer(buffer);
+    });
+    const auto endTime = std::chrono::steady_clock::now();
+
+    stats.rasterizedTriangles = 0;
+    stats.binnedTriangles = 0;
+    for (const auto& chunk : setupChunks)
+    {
+        stats.rasterizedTriangles += static_cast<unsigned int>(chunk.triangles.size());
+        for (const auto& bin : chunk.tileBins)
+        {
+            stats.binnedTriangles += static_cast<unsigned int>(bin.size());
+        }
+    }
+    stats.vertexMilliseconds = std::chrono::duration<double, std::milli>(transformEndTime - startTime).count();
+    stats.setupMilliseconds = std::chrono::duration<double, std::milli>(setupEndTime - transformEndTime).count();
+    stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(endTime - setupEndTime).count();
+    stats.milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+const std::vector<unsigned char>& SoftwareRenderer::GetImage() const
+{
+    return image;
+}
+
+int SoftwareRenderer::GetWidth() const
+{
+    return width;
+}
+
+int SoftwareRenderer::GetHeight() const
+{
+    return height;
+}
+
+const SoftwareRenderStats& SoftwareRenderer::GetStats() const
+{
+    return stats;
+}
+
+void SoftwareRenderer::LoadTexture(const Material& material, Texture& texture)
+{
+    // levels are flipped like the texture cache's, so texture coordinates address the same texels
+    stbi_set_flip_vertically_on_load(true);
+
+    int textureWidth = 0;
+    int textureHeight = 0;
+    std::string failureReason;
+    unsigned char* pixels = LoadImageRgba(material.diffuseTexturePath, material.diffuseTextureOffset, material.diffuseTextureSize, textureWidth,
+                                          textureHeight, failureReason);
+    if (pixels == nullptr)
+    {
+        // the texture cache's fallback is white, which leaves the diffuse colour as it is
+        std::cerr << "failed to load texture " << material.diffuseTexturePath << ": " << failureReason << std::endl;
+
+        textureWidth = 1;
+        textureHeight = 1;
+        texture.levelTexels.push_back(std::vector<unsigned char>(4, 255));
+    }
+    else
+    {
+        texture.levelTexels.push_back(std::vector<unsigned char>(pixels, pixels + static_cast<std::size_t>(textureWidth) * textureHeight * 4));
+        stbi_image_free(pixels);
+    }
+
+    texture.levels.push_back(RasterTextureLevel{textureWidth, textureHeight, nullptr});
+    while (texture.levels.back().width > 1 || texture.levels.back().height > 1)
+    {
+        const RasterTextureLevel& source = texture.levels.back();
+
+        RasterTextureLevel level{std::max(1, source.width / 2), std::max(1, source.height / 2), nullptr};
+        std::vector<unsigned char> levelTexels;
+        DownsampleLevel(texture.levelTexels.back(), source.width, source.height, levelTexels, level.width, level.height);
+
+        texture.levelTexels.push_back(std::move(levelTexels));
+        texture.levels.push_back(level);
+    }
+
+    for (std::size_t level = 0; level < texture.levels.size(); ++level)
+    {
+        texture.levels[level].texels = texture.levelTexels[level].data();
+    }
+    texture.texture.levels = texture.levels.data();
+    texture.texture.levelCount = static_cast<int>(texture.levels.size());
+}
+
+void SoftwareRenderer::TransformVertices(const TransformTask& task)
+{
+    const DrawCommand& draw = (*drawList)[task.drawIndex];
+    const glm::mat4 modelViewProjectionMatrix = viewProjectionMatrix * draw.modelMatrix;
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3{draw.modelMatrix}));
+
+    const Vertex* source = vertices.data() + draw.firstVertex + task.firstVertex;
+    RasterVertex* destination = transformedVertices.data() + drawVertexOffsets[task.drawIndex] + task.firstVertex;
+
+    for (std::size_t i = 0; i < task.vertexCount; ++i)
+    {
+        const glm::vec4 position{source[i].position, 1.0f};
+        const glm::vec4 clipPosition = modelViewProjectionMatrix * position;
+        const glm::vec4 worldPosition = draw.modelMatrix * position;
+        const glm::vec3 normal = normalMatrix * source[i].normal;
+
+        RasterVertex& vertex = destination[i];
+        for (int component = 0; component < 4; ++component)
+        {
+            vertex.clipPosition[component] = clipPosition[component];
+        }
+        for (int component = 0; component < 3; ++component)
+        {
+            vertex.worldPosition[component] = worldPosition[component];
+            vertex.normal[component] = normal[component];
+        }
+        vertex.texCoord[0] = source[i].texCoord.x;
+        vertex.texCoord[1] = source[i].texCoord.y;
+    }
+}
+
+void SoftwareRenderer::SetupTriangles(SetupChunk& chunk)
+{
+    chunk.triangles.clear();
+    chunk.clippedVertices.clear();
+    chunk.clippedVertices.reserve(chunk.triangleCount * 2);
+    chunk.tileBins.resize(static_cast<std::size_t>(tileCountX * tileCountY));
+    for (auto& bin : chunk.tileBins)
+    {
+        bin.clear();
+    }
+
+    const RasterMaterial* material = &materials[(*drawList)[chunk.drawIndex].materialIndex];
+
+    for (std::size_t i = 0; i < chunk.triangleCount; ++i)
+    {
+        const RasterVertex* corners[3];
+        int cornersInFront = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            corners[corner] = &transformedVertices[chunk.firstVertex + i * 3 + corner];
+            cornersInFront += (NearPlaneDistance(*corners[corner]) >= 0.0f) ? 1 : 0;
+        }
+
+        if (cornersInFront == 3)
+        {
+            SetupTriangle(corners, material, chunk);
+            continue;
+        }
+        if (cornersInFront == 0)
+        {
+            continue;
+        }
+
+        // clip against the near plane, the far plane is left to the depth test; at most
+        // two new vertices make a quad, which is drawn as a fan of two triangles
+        const RasterVertex* polygon[4];
+        int polygonSize = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const RasterVertex& from = *corners[corner];
+            const RasterVertex& to = *corners[(corner + 1) % 3];
+            const float fromDistance = NearPlaneDistance(from);
+            const float toDistance = NearPlaneDistance(to);
+
+            if (fromDistance >= 0.0f)
+            {
+                polygon[polygonSize++] = &from;
+            }
+            if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+            {
+                chunk.clippedVertices.push_back(InterpolateVertex(from, to, fromDistance / (fromDistance - toDistance)));
+                polygon[polygonSize++] = &chunk.clippedVertices.back();
+            }
+        }
+
+        for (int corner = 1; corner + 1 < polygonSize; ++corner)
+        {
+            const RasterVertex* fan[3] = {polygon[0], polygon[corner], polygon[corner + 1]};
+            SetupTriangle(fan, material, chunk);
+        }
+    }
+}
+
+void SoftwareRenderer::SetupTriangle(const RasterVertex* const* corners, const RasterMaterial* material, SetupChunk& chunk)
+{
+    const glm::vec2 screenSize{static_cast<float>(width), static_cast<float>(height)};
+
+    glm::vec3 screen[3];
+    float inverseW[3];
+    for (int corner = 0; corner < 3; ++corner)
+    {
+        const float* clipPosition = corners[corner]->clipPosition;
+        if (clipPosition[3] <= 0.0f)
+        {
+            return;
+        }
+
+        inverseW[corner] = 1.0f / clipPosition[3];
+        screen[corner] = glm::vec3{(clipPosition[0] * inverseW[corner] * 0.5f + 0.5f) * screenSize.x,
+                                   (clipPosition[1] * inverseW[corner] * 0.5f + 0.5f) * screenSize.y,
+                                   clipPosition[2] * inverseW[corner] * 0.5f + 0.5f};
+    }
+
+    // nothing is backface culled, like the GL renderers; clockwise triangles are set up counter-clockwise
+    int order[3] = {0, 1, 2};
+    float doubleArea = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+    if (doubleArea < 0.0f)
+    {
+        std::swap(order[1], order[2]);
+        doubleArea = -doubleArea;
+    }
+    if ((doubleArea > 0.0f) == false)
+    {
+        return;
+    }
+
+    RasterTriangle triangle;
+    if (ToPixelRange(std::min(std::min(screen[0].x, screen[1].x), screen[2].x), std::max(std::max(screen[0].x, screen[1].x), screen[2].x), width,
+                     triangle.minX, triangle.maxX) == false ||
+        ToPixelRange(std::min(std::min(screen[0].y, screen[1].y), screen[2].y), std::max(std::max(screen[0].y, screen[1].y), screen[2].y), height,
+                     triangle.minY, triangle.maxY) == false)
+    {
+        return;
+    }
+
+    triangle.topLeftEdges = 0;
+    for (int edge = 0; edge < 3; ++edge)
+    {
+        const glm::vec3& from = screen[order[(edge + 1) % 3]];
+        const glm::vec3& to = screen[order[(edge + 2) % 3]];
+
+        triangle.edgeA[edge] = from.y - to.y;
+        triangle.edgeB[edge] = to.x - from.x;
+        triangle.edgeC[edge] = -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y);
+
+        // rows run upwards, so counter-clockwise left edges point down and top edges point left
+        if (triangle.edgeA[edge] > 0.0f || (triangle.edgeA[edge] == 0.0f && triangle.edgeB[edge] < 0.0f))
+        {
+            triangle.topLeftEdges |= 1u << edge;
+        }
+    }
+
+    const glm::vec3 edge1 = screen[order[1]] - screen[order[0]];
+    const glm::vec3 edge2 = screen[order[2]] - screen[order[0]];
+    triangle.depthA = (edge1.z * edge2.y - edge2.z * edge1.y) / doubleArea;
+    triangle.depthB = (edge1.x * edge2.z - edge2.x * edge1.z) / doubleArea;
+    triangle.depthC = screen[order[0]].z - triangle.depthA * screen[order[0]].x - triangle.depthB * screen[order[0]].y;
+
+    triangle.inverseDoubleArea = 1.0f / doubleArea;
+    for (int corner = 0; corner < 3; ++corner)
+    {
+        triangle.vertices[corner] = corners[order[corner]];
+        triangle.inverseW[corner] = inverseW[order[corner]];
+    }
+    triangle.material = material;
+
+    const unsigned int triangleIndex = static_cast<unsigned int>(chunk.triangles.size());
+    chunk.triangles.push_back(triangle);
+
+    // triangles within one tile skip the corner tests
+    const int firstTileX = triangle.minX / SoftwareTileSize;
+    const int lastTileX = triangle.maxX / SoftwareTileSize;
+    const int firstTileY = triangle.minY / SoftwareTileSize;
+    const int lastTileY = triangle.maxY / SoftwareTileSize;
+    const bool singleTile = firstTileX == lastTileX && firstTileY == lastTileY;
+
+    for (int tileY = firstTileY; tileY <= lastTileY; ++tileY)
+    {
+        for (int tileX = firstTileX; tileX <= lastTileX; ++tileX)
+        {
+            if (singleTile || TriangleTouchesTile(triangle, tileX, tileY))
+            {
+                chunk.tileBins[tileY * tileCountX + tileX].push_back(triangleIndex);
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::RenderTile(unsigned int tile, RasterTileBuffer& buffer)
+{
+    RasterTileTarget target;
+    target.x = static_cast<int>(tile % tileCountX) * SoftwareTileSize;
+    target.y = static_cast<int>(tile / tileCountX) * SoftwareTileSize;
+    target.width = std::min(SoftwareTileSize, width - target.x);
+    target.height = std::min(SoftwareTileSize, height - target.y);
+    target.image = image.data();
+    target.imageWidth = width;
+
+    std::fill(buffer.depths, buffer.depths + SoftwareTileSize * SoftwareTileSize, 1.0f);
+    std::fill(buffer.triangles, buffer.triangles + SoftwareTileSize * SoftwareTileSize, nullptr);
+
+    for (const auto& chunk : setupChunks)
+    {
+        const std::vector<unsigned int>& bin = chunk.tileBins[tile];
+        if (bin.empty())
+        {
+            continue;
+        }
+
+#ifdef RASTER_AVX2
+        if (useAvx2)
+        {
+            RasterizeTileAvx2(chunk.triangles.data(), bin.data(), bin.size(), target, buffer);
+        }
+        else
+#endif
+        {
+            RasterizeTileScalar(chunk.triangles.data(), bin.data(), bin.size(), target, buffer);
+        }
+    }
+
+#ifdef RASTER_AVX2
+    if (useAvx2)
+    {
+        ShadeTileAvx2(buffer, shading, target);
+    }
+    else
+#endif
+    {
+        ShadeTileScalar(buffer, shading, target);
+    }
+}
+
+RasterTileBuffer* SoftwareRenderer::AcquireTileBuffer()
+{
+    std::lock_guard<std::mutex> lock{tileBufferMutex};
+    if (freeTileBuffers.empty())
+    {
+        tileBuffers.emplace_back(new RasterTileBuffer);
+        return tileBuffers.back().get();
+    }
+
+    RasterTileBuffer* buffer = freeTileBuffers.back();
+    freeTileBuffers.pop_back();
+    return buffer;
+}
+
+void SoftwareRenderer::ReleaseTileBuffer(RasterTileBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock{tileBufferMutex};
+    freeTileBuffers.push_back(buffer);
+}
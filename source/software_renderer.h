@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "draw_list.h"
+#include "frame_uniforms.h"
+#include "job_system.h"
+#include "light_rig.h"
+#include "model.h"
+#include "software_raster.h"
+
+struct SoftwareRenderStats
+{
+    unsigned int triangles = 0;            // submitted by the draw list
+    unsigned int rasterizedTriangles = 0;  // after near plane clipping, each covering at least one pixel center
+    unsigned int binnedTriangles = 0;      // triangle references in all tile bins
+    double vertexMilliseconds = 0.0;
+    double setupMilliseconds = 0.0;        // clipping, triangle setup and binning
+    double rasterMilliseconds = 0.0;       // rasterization and shading of every tile
+    double milliseconds = 0.0;
+};
+
+// how far two RGBA8 images of the same size are apart, per colour channel
+struct ImageDifference
+{
+    int maxDifference = 0;
+    double meanDifference = 0.0;
+    double differingPixelFraction = 0.0;  // pixels with a channel off by more than the tolerance
+};
+
+ImageDifference CompareImages(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference, int tolerance);
+
+// Draws a draw list on the CPU with the Phong model of phong.frag, for machines
+// without a usable GPU. Vertices are transformed and triangles clipped, set up
+// and binned into 64x64 screen tiles in parallel chunks, then the tiles are
+// rendered as jobs of their own, which idle threads of the job system steal
+// from busy ones. A tile is rasterized into a visibility buffer
+// first, keeping the nearest triangle per pixel, and then every pixel is
+// shaded exactly once; both steps work on 8 pixels at a time, with AVX2 when
+// the CPU has it. The image matches the GL forward renderer within a few
+// levels per channel: depth precision, texture filtering and rounding differ.
+class SoftwareRenderer
+{
+public:
+    // decodes the model's textures right away and renders with the jobs of jobSystem;
+    // useAvx2 false forces the scalar kernels
+    SoftwareRenderer(const Model& model, JobSystem& jobSystem, bool useAvx2);
+
+    SoftwareRenderer(const SoftwareRenderer&) = delete;
+    SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+    bool IsUsingAvx2() const;
+    unsigned int GetThreadCount() const;
+
+    // renders at the size in frameUniforms.viewportSize, every light reaches every pixel like the forward renderer
+    void Render(const std::vector<DrawCommand>& drawList, const FrameUniforms& frameUniforms, const std::vector<PointLight>& lights,
+                const glm::vec4& clearColor);
+
+    // RGBA8 of the last frame, bottom row first like glReadPixels
+    const std::vector<unsigned char>& GetImage() const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    const SoftwareRenderStats& GetStats() const;
+
+private:
+    struct Texture
+    {
+        std::vector<std::vector<unsigned char>> levelTexels;
+        std::vector<RasterTextureLevel> levels;
+        RasterTexture texture;
+    };
+
+    // vertices of one draw transformed per task
+    struct TransformTask
+    {
+        std::size_t drawIndex;
+        std::size_t firstVertex;  // relative to the draw
+        std::size_t vertexCount;
+    };
+
+    // triangles of one draw set up per chunk, each chunk bins its own triangles so
+    // no locks are needed and tiles still see every triangle in submission order
+    struct SetupChunk
+    {
+        std::size_t drawIndex;
+        std::size_t firstVertex;  // in the transformed vertex stream
+        std::size_t triangleCount;
+        std::vector<RasterVertex> clippedVertices;  // reserved up front, triangles point into it
+        std::vector<RasterTriangle> triangles;
+        std::vector<std::vector<unsigned int>> tileBins;
+    };
+
+    void LoadTexture(const Material& material, Texture& texture);
+
+    void TransformVertices(const TransformTask& task);
+    void SetupTriangles(SetupChunk& chunk);
+    void SetupTriangle(const RasterVertex* const* corners, const RasterMaterial* material, SetupChunk& chunk);
+    void RenderTile(unsigned int tile, RasterTileBuffer& buffer);
+    RasterTileBuffer* AcquireTileBuffer();
+    void ReleaseTileBuffer(RasterTileBuffer* buffer);
+
+    std::vector<Vertex> vertices;
+    std::vector<std::unique_ptr<Texture>> textures;
+    std::vector<RasterMaterial> materials;
+    JobSystem& jobSystem;
+    bool useAvx2;
+
+    int width;
+    int height;
+    int tileCountX;
+    int tileCountY;
+    std::vector<unsigned char> image;
+
+    // per-frame state, written by the calling thread before the jobs start
+    const std::vector<DrawCommand>* drawList;
+    glm::mat4 viewProjectionMatrix;
+    std::vector<RasterLight> lights;
+    RasterShading shading;
+    std::vector<std::size_t> drawVertexOffsets;  // start of each draw in the transformed vertex stream
+    std::vector<RasterVertex> transformedVertices;
+    std::vector<TransformTask> transformTasks;
+    std::vector<SetupChunk> setupChunks;
+
+    // one buffer per tile job running at the same time, created as jobs need them
+    std::mutex tileBufferMutex;
+    std::vector<std::unique_ptr<RasterTileBuffer>> tileBuffers;
+    std::vector<RasterTileBuffer*> freeTileBuffers;
+
+    SoftwareRenderStats stats;
+};
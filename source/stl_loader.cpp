@@ -0,0 +1,305 @@
+#include "stl_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "job_system.h"
+#include "mapped_file.h"
+
+namespace
+{
+
+// 80 byte header and a 32 bit triangle count, then per triangle a facet normal,
+// three corners and a 16 bit attribute; little endian like every platform the viewer builds for
+const std::size_t StlHeaderSize = 84;
+const std::size_t StlTriangleSize = 50;
+
+// corners closer than this share a vertex, relative to the diagonal of the model's bounds
+const float WeldTolerance = 1.0e-6f;
+
+// grid cells are much larger than the tolerance, so a corner's tolerance box nearly always lies in one cell
+const float WeldCellsPerTolerance = 64.0f;
+
+const unsigned int NoVertex = 0xffffffffu;
+
+// triangles whose smooth normals are averaged per job
+const std::size_t NormalGrainSize = 4096;
+
+glm::vec3 ReadVector(const unsigned char* data)
+{
+    glm::vec3 vector;
+    std::memcpy(&vector.x, data, 3 * sizeof(float));
+    return vector;
+}
+
+// Welds positions into unique vertices. An open-addressing hash table maps
+// the occupied grid cells to a list of the vertices inside them, and a new
+// position is compared against the vertices of the cells its tolerance box
+// touches.
+class WeldGrid
+{
+public:
+    WeldGrid(const glm::vec3& origin, float tolerance, std::size_t expectedVertexCount)
+        : origin{origin},
+          tolerance{tolerance},
+          inverseCellSize{1.0f / (tolerance * WeldCellsPerTolerance)},
+          cellCount{0}
+    {
+        std::size_t tableSize = 1024;
+        while (tableSize < 2 * expectedVertexCount)
+        {
+            tableSize *= 2;
+        }
+        cells.resize(tableSize, Cell{0, 0, 0, NoVertex});
+
+        positions.reserve(expectedVertexCount);
+        nextInCell.reserve(expectedVertexCount);
+    }
+
+    // index of the vertex within the tolerance of position, added when there is none yet
+    unsigned int Weld(const glm::vec3& position)
+    {
+        const glm::vec3 cellPosition = (position - origin) * inverseCellSize;
+        const glm::vec3 cellTolerance{tolerance * inverseCellSize};
+        const glm::ivec3 firstCell{glm::floor(cellPosition - cellTolerance)};
+        const glm::ivec3 lastCell{glm::floor(cellPosition + cellTolerance)};
+
+        for (int z = firstCell.z; z <= lastCell.z; ++z)
+        {
+            for (int y = firstCell.y; y <= lastCell.y; ++y)
+            {
+                for (int x = firstCell.x; x <= lastCell.x; ++x)
+                {
+                    for (unsigned int vertex = FindCell(x, y, z).firstVertex; vertex != NoVertex; vertex = nextInCell[vertex])
+                    {
+                        const glm::vec3 offset = glm::abs(positions[vertex] - position);
+                        if (offset.x <= tolerance && offset.y <= tolerance && offset.z <= tolerance)
+                        {
+                            return vertex;
+                        }
+                    }
+                }
+            }
+        }
+
+        const glm::ivec3 homeCell{glm::floor(cellPosition)};
+        Cell& cell = FindCell(homeCell.x, homeCell.y, homeCell.z);
+        if (cell.firstVertex == NoVertex)
+        {
+            cell.x = homeCell.x;
+            cell.y = homeCell.y;
+            cell.z = homeCell.z;
+            ++cellCount;
+        }
+
+        const unsigned int vertex = static_cast<unsigned int>(positions.size());
+        positions.push_back(position);
+        nextInCell.push_back(cell.firstVertex);
+        cell.firstVertex = vertex;
+
+        if (2 * cellCount > cells.size())
+        {
+            Grow();
+        }
+
+        return vertex;
+    }
+
+    const std::vector<glm::vec3>& GetPositions() const
+    {
+        return positions;
+    }
+
+private:
+    struct Cell
+    {
+        int x;
+        int y;
+        int z;
+        unsigned int firstVertex;  // NoVertex while the slot is empty
+    };
+
+    // the slot holding the cell, or the empty slot where it would go
+    Cell& FindCell(int x, int y, int z)
+    {
+        const std::size_t mask = cells.size() - 1;
+        std::size_t slot = (static_cast<std::uint32_t>(x) * 73856093u ^ static_cast<std::uint32_t>(y) * 19349663u ^
+                            static_cast<std::uint32_t>(z) * 83492791u) & mask;
+        while (cells[slot].firstVertex != NoVertex && (cells[slot].x != x || cells[slot].y != y || cells[slot].z != z))
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        return cells[slot];
+    }
+
+    void Grow()
+    {
+        std::vector<Cell> oldCells(cells.size() * 2, Cell{0, 0, 0, NoVertex});
+        oldCells.swap(cells);
+
+        for (const auto& oldCell : oldCells)
+        {
+            if (oldCell.firstVertex != NoVertex)
+            {
+                FindCell(oldCell.x, oldCell.y, oldCell.z) = oldCell;
+            }
+        }
+    }
+
+    glm::vec3 origin;
+    float tolerance;
+    float inverseCellSize;
+
+    std::vector<Cell> cells;
+    std::size_t cellCount;
+
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> nextInCell;
+};
+
+} // namespace
+
+Model LoadStlFile(const std::string& filepath)
+{
+    const MappedFile file{filepath};
+    const unsigned char* const data = file.GetData();
+    const std::size_t size = file.GetSize();
+
+    std::uint32_t triangleCount = 0;
+    if (size >= StlHeaderSize)
+    {
+        std::memcpy(&triangleCount, data + 80, sizeof(triangleCount));
+    }
+
+    // ASCII files start with "solid", but so do the headers of some binary exporters, the size decides
+    if (size < StlHeaderSize || size < StlHeaderSize + static_cast<std::size_t>(triangleCount) * StlTriangleSize)
+    {
+        if (size >= 5 && std::memcmp(data, "solid", 5) == 0)
+        {
+            throw std::runtime_error{"Only binary STL files are supported"};
+        }
+
+        throw std::runtime_error{"STL file is truncated"};
+    }
+    if (triangleCount == 0)
+    {
+        throw std::runtime_error{"STL file has no triangles"};
+    }
+
+    const unsigned char* const triangles = data + StlHeaderSize;
+
+    glm::vec3 boundsMin = ReadVector(triangles + 12);
+    glm::vec3 boundsMax = boundsMin;
+    for (std::uint32_t i = 0; i < triangleCount; ++i)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const glm::vec3 position = ReadVector(triangles + i * StlTriangleSize + 12 + corner * 12);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+    }
+
+    // closed meshes have about half as many vertices as triangles
+    const float tolerance = std::max(WeldTolerance * glm::length(boundsMax - boundsMin), 1.0e-12f);
+    WeldGrid weldGrid{boundsMin, tolerance, triangleCount / 2 + 1};
+
+    std::vector<unsigned int> cornerVertices(static_cast<std::size_t>(triangleCount) * 3);
+    std::vector<glm::vec3> faceNormals(triangleCount);  // length twice the triangle's area
+    for (std::uint32_t i = 0; i < triangleCount; ++i)
+    {
+        const unsigned char* const triangle = triangles + i * StlTriangleSize;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            cornerVertices[i * 3 + corner] = weldGrid.Weld(ReadVector(triangle + 12 + corner * 12));
+        }
+
+        const std::vector<glm::vec3>& positions = weldGrid.GetPositions();
+        const glm::vec3& a = positions[cornerVertices[i * 3]];
+        faceNormals[i] = glm::cross(positions[cornerVertices[i * 3 + 1]] - a, positions[cornerVertices[i * 3 + 2]] - a);
+    }
+
+    const std::vector<glm::vec3>& positions = weldGrid.GetPositions();
+
+    // the faces around every vertex, as ranges of one array
+    std::vector<unsigned int> vertexFaceOffsets(positions.size() + 1, 0);
+    for (const unsigned int vertex : cornerVertices)
+    {
+        ++vertexFaceOffsets[vertex + 1];
+    }
+    for (std::size_t i = 1; i < vertexFaceOffsets.size(); ++i)
+    {
+        vertexFaceOffsets[i] += vertexFaceOffsets[i - 1];
+    }
+
+    std::vector<unsigned int> vertexFaces(cornerVertices.size());
+    {
+        std::vector<unsigned int> fillOffsets(vertexFaceOffsets.begin(), vertexFaceOffsets.end() - 1);
+        for (std::size_t corner = 0; corner < cornerVertices.size(); ++corner)
+        {
+            vertexFaces[fillOffsets[cornerVertices[corner]]++] = static_cast<unsigned int>(corner / 3);
+        }
+    }
+
+    const float cosCreaseAngle = std::cos(glm::radians(StlCreaseAngleDegrees));
+
+    Model model;
+    model.materials.push_back(MakeDefaultMaterial("default"));
+    model.vertices.resize(cornerVertices.size());
+
+    // every corner only reads the shared arrays and writes its own vertex
+    GetSharedJobSystem().ParallelFor(triangleCount, NormalGrainSize, [&](std::size_t firstTriangle, std::size_t endTriangle)
+    {
+        for (std::size_t i = firstTriangle; i < endTriangle; ++i)
+        {
+            const float faceNormalLength = glm::length(faceNormals[i]);
+
+            // degenerate triangles keep the file's facet normal
+            glm::vec3 flatNormal = ReadVector(triangles + i * StlTriangleSize);
+            if (faceNormalLength > 0.0f)
+            {
+                flatNormal = faceNormals[i] / faceNormalLength;
+            }
+            else if (glm::length(flatNormal) > 0.0f)
+            {
+                flatNormal = glm::normalize(flatNormal);
+            }
+            else
+            {
+                flatNormal = glm::vec3{0.0f, 1.0f, 0.0f};
+            }
+
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const unsigned int vertex = cornerVertices[i * 3 + corner];
+
+                // area-weighted average of the faces around the vertex that are within the crease angle of this face
+                glm::vec3 normal{0.0f, 0.0f, 0.0f};
+                if (faceNormalLength > 0.0f)
+                {
+                    for (unsigned int j = vertexFaceOffsets[vertex]; j < vertexFaceOffsets[vertex + 1]; ++j)
+                    {
+                        const glm::vec3& adjacentNormal = faceNormals[vertexFaces[j]];
+                        if (glm::dot(adjacentNormal, flatNormal) >= cosCreaseAngle * glm::length(adjacentNormal))
+                        {
+                            normal += adjacentNormal;
+                        }
+                    }
+                }
+
+                Vertex& modelVertex = model.vertices[i * 3 + corner];
+                modelVertex.position = positions[vertex];
+                modelVertex.normal = (glm::length(normal) > 0.0f) ? glm::normalize(normal) : flatNormal;
+                modelVertex.texCoord = glm::vec2{0.0f, 0.0f};
+            }
+        }
+    });
+
+    model.submeshes.push_back(MakeSubmesh(model.vertices, 0, 0, static_cast<unsigned int>(model.vertices.size())));
+
+    return model;
+}
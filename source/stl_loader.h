@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "model.h"
+
+// Loads a binary STL file, the format CAD tools export. The file is mapped
+// into memory and its triangles are read in place. STL repeats every corner
+// of every triangle and stores only flat facet normals, so corners closer
+// than a millionth of the model's size are welded into shared vertices with a
+// spatial hash. The welded positions close hairline cracks, and each corner's
+// normal averages the faces around its vertex that meet at less than
+// StlCreaseAngleDegrees, so curved surfaces shade smoothly while CAD edges stay
+// sharp. The model has one submesh with the default material. ASCII STL files
+// throw.
+Model LoadStlFile(const std::string& filepath);
+
+const float StlCreaseAngleDegrees = 30.0f;
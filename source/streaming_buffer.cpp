@@ -0,0 +1,230 @@
+#include "streaming_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+namespace
+{
+
+const unsigned int RegionCount = 3;
+
+std::size_t AlignUp(std::size_t offset, std::size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+StreamingBuffer::StreamingBuffer(std::size_t regionSize)
+    : persistent{GLAD_GL_ARB_buffer_storage != 0},
+      uniformAlignment{256},
+      buffer{0},
+      mappedRing{nullptr},
+      regionSize{0},
+      fences{nullptr, nullptr, nullptr},
+      region{RegionCount - 1},
+      writeOffset{0}
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+    {
+        uniformAlignment = static_cast<std::size_t>(alignment);
+    }
+
+    CreateRing(AlignUp(std::max<std::size_t>(regionSize, 1), uniformAlignment));
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    for (void* fence : fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(fence));
+        }
+    }
+
+    // deleting a buffer unmaps it
+    glDeleteBuffers(1, &buffer);
+    if (retiredBuffers.empty() == false)
+    {
+        glDeleteBuffers(static_cast<GLsizei>(retiredBuffers.size()), retiredBuffers.data());
+    }
+}
+
+bool StreamingBuffer::IsPersistent() const
+{
+    return persistent;
+}
+
+std::size_t StreamingBuffer::GetRegionSize() const
+{
+    return regionSize;
+}
+
+std::size_t StreamingBuffer::GetUniformAlignment() const
+{
+    return uniformAlignment;
+}
+
+void StreamingBuffer::BeginFrame()
+{
+    region = (region + 1) % RegionCount;
+    writeOffset = region * regionSize;
+    ++stats.frames;
+
+    void*& fence = fences[region];
+    if (fence == nullptr)
+    {
+        return;
+    }
+
+    const GLsync sync = static_cast<GLsync>(fence);
+    if (glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        const auto stallBeginTime = std::chrono::steady_clock::now();
+
+        // the GPU is three frames behind, this frame can't start writing before it catches up
+        while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+
+        ++stats.stalls;
+        stats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stallBeginTime).count();
+    }
+
+    glDeleteSync(sync);
+    fence = nullptr;
+}
+
+StreamingRange StreamingBuffer::Write(const void* data, std::size_t size, std::size_t alignment)
+{
+    std::size_t offset = AlignUp(writeOffset, alignment);
+    if (offset + size > (region + 1) * regionSize)
+    {
+        Grow(writeOffset - region * regionSize + size + alignment);
+        offset = AlignUp(writeOffset, alignment);
+    }
+
+    if (mappedRing != nullptr)
+    {
+        std::memcpy(mappedRing + offset, data, size);
+    }
+    else if (size > 0)
+    {
+        // the region's fence has signalled, nothing in flight reads this range
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size),
+                                        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (mapped == nullptr)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            throw std::runtime_error{"failed to map the streaming buffer"};
+        }
+
+        std::memcpy(mapped, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    writeOffset = offset + size;
+    stats.bytes += size;
+
+    return StreamingRange{buffer, offset, size};
+}
+
+void StreamingBuffer::EndFrame()
+{
+    // draws already issued keep the storage of a deleted buffer alive until they are done
+    if (retiredBuffers.empty() == false)
+    {
+        glDeleteBuffers(static_cast<GLsizei>(retiredBuffers.size()), retiredBuffers.data());
+        retiredBuffers.clear();
+    }
+
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+StreamingBufferStats StreamingBuffer::ConsumeStats()
+{
+    const StreamingBufferStats consumedStats = stats;
+    stats = StreamingBufferStats{};
+
+    return consumedStats;
+}
+
+void StreamingBuffer::CreateRing(std::size_t regionSize)
+{
+    this->regionSize = regionSize;
+    const GLsizeiptr ringSize = static_cast<GLsizeiptr>(regionSize * RegionCount);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, ringSize, nullptr, flags);
+        mappedRing = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, ringSize, flags));
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, ringSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (persistent && mappedRing == nullptr)
+    {
+        throw std::runtime_error{"failed to map the streaming buffer persistently"};
+    }
+}
+
+void StreamingBuffer::Grow(std::size_t minimumRegionSize)
+{
+    // the frame may have bound ranges of the old ring already, it is deleted once the frame is submitted
+    retiredBuffers.push_back(buffer);
+    mappedRing = nullptr;
+
+    // the new ring is not read by any frame in flight
+    for (void*& fence : fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(fence));
+            fence = nullptr;
+        }
+    }
+
+    const std::size_t writtenBytes = writeOffset - region * regionSize;
+    CreateRing(AlignUp(std::max(2 * regionSize, minimumRegionSize), uniformAlignment));
+    writeOffset = region * regionSize + writtenBytes;
+
+    ++stats.growths;
+}
+
+void CopyStreamedRange(const StreamingRange& range, unsigned int buffer, std::size_t& bufferSize)
+{
+    if (range.size > bufferSize)
+    {
+        bufferSize = std::max(range.size, 2 * bufferSize);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(bufferSize), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    if (range.size == 0)
+    {
+        return;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, range.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range.offset), 0, static_cast<GLsizeiptr>(range.size));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct StreamingBufferStats
+{
+    unsigned int frames = 0;
+    unsigned long long bytes = 0;   // written into the ring
+    unsigned int stalls = 0;        // frames that waited for the GPU to finish reading their region
+    double stallMilliseconds = 0.0;
+    unsigned int growths = 0;       // frames that outgrew their region and moved to a larger ring
+};
+
+// where a write landed, valid until the frame's region comes around again
+struct StreamingRange
+{
+    unsigned int buffer;
+    std::size_t offset;
+    std::size_t size;
+};
+
+// Ring buffer for the data uploaded anew every frame: uniforms, light lists and
+// the like. The ring is split into three regions and frame N writes region
+// N % 3, so the GPU can still read the two frames before while the CPU writes.
+// A fence placed after the last draw of a frame guards its region; a frame
+// only waits when the GPU is three frames behind. With ARB_buffer_storage the
+// ring is mapped once, persistently and coherently, and writes are plain
+// copies. Without it each write maps its own range with glMapBufferRange,
+// unsynchronized and invalidating, which the fences make safe. Either way no
+// upload makes the driver wait for draws still reading the previous data.
+// A frame writing more than a region holds moves to a ring twice the size.
+class StreamingBuffer
+{
+public:
+    // the ring starts out with regionSize bytes per frame
+    explicit StreamingBuffer(std::size_t regionSize);
+    ~StreamingBuffer();
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    bool IsPersistent() const;
+    std::size_t GetRegionSize() const;
+
+    // offset alignment of uniform block ranges, for Write
+    std::size_t GetUniformAlignment() const;
+
+    // moves to the next frame's region, waiting for the GPU while it still reads it
+    void BeginFrame();
+
+    // copies size bytes into the frame's region at a multiple of alignment
+    StreamingRange Write(const void* data, std::size_t size, std::size_t alignment);
+
+    // fences the frame's region, call after the last draw reading it
+    void EndFrame();
+
+    // counts since the last call
+    StreamingBufferStats ConsumeStats();
+
+private:
+    void CreateRing(std::size_t regionSize);
+    void Grow(std::size_t minimumRegionSize);
+
+    bool persistent;
+    std::size_t uniformAlignment;
+
+    unsigned int buffer;
+    unsigned char* mappedRing;  // the whole ring while persistently mapped, otherwise null
+    std::size_t regionSize;
+
+    void* fences[3];  // GLsync of the frame that last wrote each region, null once it was waited on
+    unsigned int region;
+    std::size_t writeOffset;  // next free byte of the region, from the start of the ring
+
+    std::vector<unsigned int> retiredBuffers;  // smaller rings the current frame may still bind, deleted at its end
+
+    StreamingBufferStats stats;
+};
+
+// Copies a written range to the start of buffer on the GPU, first growing buffer
+// (whose size is bufferSize) when the range doesn't fit. For buffer textures,
+// which GL 3.3 can only attach to a whole buffer, not to a range of the ring.
+void CopyStreamedRange(const StreamingRange& range, unsigned int buffer, std::size_t& bufferSize);
@@ -0,0 +1,519 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "mapped_file.h"
+
+namespace
+{
+
+const std::size_t pixelBufferCount = 3;
+
+// widest row the GL implementations we target accept (16384 RGBA8 texels)
+const std::size_t maxRowBytes = 16384 * 4;
+
+int CalculateMipLevelCount(int width, int height)
+{
+    int levelCount = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++levelCount;
+    }
+
+    return levelCount;
+}
+
+std::size_t CalculateMipChainBytes(int width, int height)
+{
+    std::size_t bytes = 0;
+    for (int level = 0; level < CalculateMipLevelCount(width, height); ++level)
+    {
+        bytes += static_cast<std::size_t>(std::max(1, width >> level)) * std::max(1, height >> level) * 4;
+    }
+
+    return bytes;
+}
+
+} // namespace
+
+unsigned char* LoadImageRgba(const std::string& filepath, std::size_t offset, std::size_t size, int& width, int& height, std::string& failureReason)
+{
+    int channelCount = 0;
+    unsigned char* pixels = nullptr;
+    if (size == 0)
+    {
+        pixels = stbi_load(filepath.c_str(), &width, &height, &channelCount, 4);
+    }
+    else
+    {
+        // embedded images are decoded straight from the mapped model file
+        try
+        {
+            const MappedFile file{filepath};
+            if (offset > file.GetSize() || size > file.GetSize() - offset)
+            {
+                failureReason = "image range lies outside the file";
+                return nullptr;
+            }
+
+            pixels = stbi_load_from_memory(file.GetData() + offset, static_cast<int>(size), &width, &height, &channelCount, 4);
+        }
+        catch (const std::exception& exception)
+        {
+            failureReason = exception.what();
+            return nullptr;
+        }
+    }
+
+    if (pixels == nullptr)
+    {
+        const char* reason = stbi_failure_reason();
+        failureReason = (reason != nullptr) ? reason : "unknown error";
+    }
+
+    return pixels;
+}
+
+void DownsampleLevel(const std::vector<unsigned char>& source, int sourceWidth, int sourceHeight, std::vector<unsigned char>& destination, int width, int height)
+{
+    destination.resize(static_cast<std::size_t>(width) * height * 4);
+
+    for (int y = 0; y < height; ++y)
+    {
+        const int y0 = std::min(y * 2, sourceHeight - 1);
+        const int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const int x0 = std::min(x * 2, sourceWidth - 1);
+            const int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+
+            for (int channel = 0; channel < 4; ++channel)
+            {
+                const unsigned int sum = source[(static_cast<std::size_t>(y0) * sourceWidth + x0) * 4 + channel]
+                                       + source[(static_cast<std::size_t>(y0) * sourceWidth + x1) * 4 + channel]
+                                       + source[(static_cast<std::size_t>(y1) * sourceWidth + x0) * 4 + channel]
+                                       + source[(static_cast<std::size_t>(y1) * sourceWidth + x1) * 4 + channel];
+
+                destination[(static_cast<std::size_t>(y) * width + x) * 4 + channel] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+TextureCache::TextureCache(const TextureCacheSettings& settings)
+    : settings{settings},
+      residentBytes{0},
+      frameIndex{0},
+      fallbackTexture{0},
+      nextPixelBuffer{0},
+      stopDecoding{false}
+{
+    // every row must fit in a single pixel buffer
+    this->settings.uploadBytesPerFrame = std::max(this->settings.uploadBytesPerFrame, maxRowBytes);
+
+    const unsigned char white[4] = {255, 255, 255, 255};
+
+    glGenTextures(1, &fallbackTexture);
+    glBindTexture(GL_TEXTURE_2D, fallbackTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    pixelBuffers.resize(pixelBufferCount);
+    for (auto& pixelBuffer : pixelBuffers)
+    {
+        glGenBuffers(1, &pixelBuffer.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, this->settings.uploadBytesPerFrame, nullptr, GL_STREAM_DRAW);
+
+        pixelBuffer.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // OBJ texture coordinates have their origin at the bottom left
+    stbi_set_flip_vertically_on_load(true);
+
+    for (unsigned int i = 0; i < std::max(1u, this->settings.decodeThreadCount); ++i)
+    {
+        decodeThreads.emplace_back(&TextureCache::DecodeThreadMain, this);
+    }
+}
+
+TextureCache::~TextureCache()
+{
+    {
+        std::lock_guard<std::mutex> lock{decodeMutex};
+        stopDecoding = true;
+    }
+    decodeCondition.notify_all();
+
+    for (auto& decodeThread : decodeThreads)
+    {
+        decodeThread.join();
+    }
+
+    for (const auto& entry : entries)
+    {
+        if (entry.texture != 0)
+        {
+            glDeleteTextures(1, &entry.texture);
+        }
+    }
+
+    for (const auto& pixelBuffer : pixelBuffers)
+    {
+        if (pixelBuffer.fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(pixelBuffer.fence));
+        }
+        glDeleteBuffers(1, &pixelBuffer.buffer);
+    }
+
+    glDeleteTextures(1, &fallbackTexture);
+}
+
+TextureHandle TextureCache::Request(const std::string& filepath, std::size_t offset, std::size_t size)
+{
+    const auto handleIt = handlesBySource.find(std::make_pair(filepath, offset));
+    if (handleIt != handlesBySource.end())
+    {
+        return handleIt->second;
+    }
+
+    TextureEntry entry;
+    entry.filepath = filepath;
+    entry.fileOffset = offset;
+    entry.fileSize = size;
+    entry.state = TextureState::Decoding;
+    entry.texture = 0;
+    entry.usable = false;
+    entry.residentBytes = 0;
+    entry.lastUsedFrame = frameIndex;
+    entry.uploadLevel = -1;
+    entry.uploadRow = 0;
+
+    entries.push_back(entry);
+
+    const TextureHandle handle = static_cast<TextureHandle>(entries.size());
+    entries.back().lruPosition = lruOrder.insert(lruOrder.begin(), handle);
+    handlesBySource[std::make_pair(filepath, offset)] = handle;
+
+    QueueDecode(handle);
+
+    return handle;
+}
+
+unsigned int TextureCache::Use(TextureHandle handle)
+{
+    if (handle == InvalidTextureHandle || handle > entries.size())
+    {
+        return fallbackTexture;
+    }
+
+    TextureEntry& entry = entries[handle - 1];
+    entry.lastUsedFrame = frameIndex;
+    lruOrder.splice(lruOrder.begin(), lruOrder, entry.lruPosition);
+
+    if (entry.state == TextureState::Evicted)
+    {
+        entry.state = TextureState::Decoding;
+        QueueDecode(handle);
+    }
+
+    return entry.usable ? entry.texture : fallbackTexture;
+}
+
+void TextureCache::Update()
+{
+    ++frameIndex;
+
+    std::vector<DecodedImage> images;
+    {
+        std::lock_guard<std::mutex> lock{decodeMutex};
+        images.swap(decodedImages);
+    }
+
+    for (auto& image : images)
+    {
+        if (image.failureReason.empty() == false)
+        {
+            TextureEntry& entry = entries[image.handle - 1];
+            entry.state = TextureState::Failed;
+
+            std::cerr << "failed to load texture " << entry.filepath << ": " << image.failureReason << std::endl;
+            continue;
+        }
+
+        BeginUpload(image);
+    }
+
+    UploadPendingLevels();
+
+    EvictToBudget();
+}
+
+std::size_t TextureCache::GetResidentBytes() const
+{
+    return residentBytes;
+}
+
+void TextureCache::DecodeThreadMain()
+{
+    while (true)
+    {
+        DecodeRequest request;
+        {
+            std::unique_lock<std::mutex> lock{decodeMutex};
+            decodeCondition.wait(lock, [this]() { return stopDecoding || decodeRequests.empty() == false; });
+
+            if (stopDecoding)
+            {
+                return;
+            }
+
+            request = decodeRequests.front();
+            decodeRequests.pop_front();
+        }
+
+        DecodedImage image;
+        image.handle = request.handle;
+
+        int width;
+        int height;
+        unsigned char* pixels = LoadImageRgba(request.filepath, request.fileOffset, request.fileSize, width, height, image.failureReason);
+        if (pixels != nullptr && static_cast<std::size_t>(width) * 4 > maxRowBytes)
+        {
+            // a row that never fits into the upload budget would block the upload queue forever
+            stbi_image_free(pixels);
+            pixels = nullptr;
+            image.failureReason = "image is " + std::to_string(width) + " texels wide, wider than the supported " + std::to_string(maxRowBytes / 4);
+        }
+
+        if (pixels != nullptr)
+        {
+            MipLevel baseLevel;
+            baseLevel.width = width;
+            baseLevel.height = height;
+            baseLevel.pixels.assign(pixels, pixels + static_cast<std::size_t>(width) * height * 4);
+            stbi_image_free(pixels);
+
+            image.levels.push_back(std::move(baseLevel));
+
+            if (settings.generateMipmapsOnCpu)
+            {
+                while (image.levels.back().width > 1 || image.levels.back().height > 1)
+                {
+                    const MipLevel& source = image.levels.back();
+
+                    MipLevel level;
+                    level.width = std::max(1, source.width / 2);
+                    level.height = std::max(1, source.height / 2);
+                    DownsampleLevel(source.pixels, source.width, source.height, level.pixels, level.width, level.height);
+
+                    image.levels.push_back(std::move(level));
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{decodeMutex};
+        decodedImages.push_back(std::move(image));
+    }
+}
+
+void TextureCache::QueueDecode(TextureHandle handle)
+{
+    {
+        std::lock_guard<std::mutex> lock{decodeMutex};
+        const TextureEntry& entry = entries[handle - 1];
+        decodeRequests.push_back(DecodeRequest{handle, entry.filepath, entry.fileOffset, entry.fileSize});
+    }
+    decodeCondition.notify_one();
+}
+
+void TextureCache::BeginUpload(DecodedImage& image)
+{
+    TextureEntry& entry = entries[image.handle - 1];
+
+    const int width = image.levels.front().width;
+    const int height = image.levels.front().height;
+    const int levelCount = CalculateMipLevelCount(width, height);
+
+    // allocate every level up front, the base level is raised as smaller levels arrive
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    for (int level = 0; level < levelCount; ++level)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(1, width >> level), std::max(1, height >> level), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry.state = TextureState::Uploading;
+    entry.usable = false;
+    entry.levels = std::move(image.levels);
+    entry.uploadLevel = static_cast<int>(entry.levels.size()) - 1;
+    entry.uploadRow = 0;
+    entry.residentBytes = CalculateMipChainBytes(width, height);
+
+    residentBytes += entry.residentBytes;
+
+    uploadQueue.push_back(image.handle);
+}
+
+void TextureCache::UploadPendingLevels()
+{
+    if (uploadQueue.empty())
+    {
+        return;
+    }
+
+    PixelBuffer& pixelBuffer = pixelBuffers[nextPixelBuffer];
+
+    // the GPU may still be reading this buffer, try again next frame instead of waiting
+    if (pixelBuffer.fence != nullptr)
+    {
+        const GLenum waitResult = glClientWaitSync(static_cast<GLsync>(pixelBuffer.fence), 0, 0);
+        if (waitResult == GL_TIMEOUT_EXPIRED)
+        {
+            return;
+        }
+
+        glDeleteSync(static_cast<GLsync>(pixelBuffer.fence));
+        pixelBuffer.fence = nullptr;
+    }
+
+    struct PendingCopy
+    {
+        TextureHandle handle;
+        int level;
+        int levelWidth;
+        int levelHeight;
+        int firstRow;
+        int rowCount;
+        std::size_t bufferOffset;
+    };
+
+    std::vector<PendingCopy> copies;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+    unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, settings.uploadBytesPerFrame,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (mapped == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    std::size_t bufferOffset = 0;
+    while (uploadQueue.empty() == false)
+    {
+        const TextureHandle handle = uploadQueue.front();
+        TextureEntry& entry = entries[handle - 1];
+        MipLevel& level = entry.levels[entry.uploadLevel];
+
+        const std::size_t rowBytes = static_cast<std::size_t>(level.width) * 4;
+        const std::size_t rowsThatFit = (settings.uploadBytesPerFrame - bufferOffset) / rowBytes;
+        if (rowsThatFit == 0)
+        {
+            break;
+        }
+
+        const int rowCount = static_cast<int>(std::min(rowsThatFit, static_cast<std::size_t>(level.height - entry.uploadRow)));
+
+        std::memcpy(mapped + bufferOffset, level.pixels.data() + entry.uploadRow * rowBytes, rowCount * rowBytes);
+        copies.push_back(PendingCopy{handle, entry.uploadLevel, level.width, level.height, entry.uploadRow, rowCount, bufferOffset});
+
+        bufferOffset += rowCount * rowBytes;
+        entry.uploadRow += rowCount;
+
+        if (entry.uploadRow == level.height)
+        {
+            std::vector<unsigned char>().swap(level.pixels);
+
+            --entry.uploadLevel;
+            entry.uploadRow = 0;
+
+            if (entry.uploadLevel < 0)
+            {
+                entry.levels.clear();
+                uploadQueue.pop_front();
+            }
+        }
+    }
+
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (const auto& copy : copies)
+    {
+        TextureEntry& entry = entries[copy.handle - 1];
+
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, copy.level, 0, copy.firstRow, copy.levelWidth, copy.rowCount, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(copy.bufferOffset));
+
+        // once a level is complete the texture can be sampled down to it
+        if (copy.firstRow + copy.rowCount == copy.levelHeight)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, copy.level);
+            entry.usable = true;
+
+            if (copy.level == 0)
+            {
+                if (settings.generateMipmapsOnCpu == false)
+                {
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                }
+
+                entry.state = TextureState::Resident;
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    nextPixelBuffer = (nextPixelBuffer + 1) % pixelBuffers.size();
+}
+
+void TextureCache::EvictToBudget()
+{
+    auto candidate = lruOrder.end();
+    while (residentBytes > settings.memoryBudgetBytes && candidate != lruOrder.begin())
+    {
+        --candidate;
+
+        TextureEntry& entry = entries[*candidate - 1];
+
+        // textures drawn this frame or still streaming in are never evicted
+        if (entry.state != TextureState::Resident || entry.lastUsedFrame + 1 >= frameIndex)
+        {
+            continue;
+        }
+
+        glDeleteTextures(1, &entry.texture);
+
+        residentBytes -= entry.residentBytes;
+
+        entry.texture = 0;
+        entry.usable = false;
+        entry.residentBytes = 0;
+        entry.state = TextureState::Evicted;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using TextureHandle = unsigned int;
+
+const TextureHandle InvalidTextureHandle = 0;
+
+struct TextureCacheSettings
+{
+    // total size of all resident mip levels, least recently used textures are evicted above it
+    std::size_t memoryBudgetBytes = 256 * 1024 * 1024;
+
+    // bytes copied into pixel buffer objects per frame, larger levels are uploaded in row chunks
+    std::size_t uploadBytesPerFrame = 4 * 1024 * 1024;
+
+    unsigned int decodeThreadCount = 2;
+
+    // when false the base level is uploaded alone and glGenerateMipmap builds the chain on the GPU
+    bool generateMipmapsOnCpu = true;
+};
+
+// decodes an image file, or the byte range [offset, offset + size) of a file when size isn't 0, to RGBA8;
+// free the result with stbi_image_free, null on failure
+unsigned char* LoadImageRgba(const std::string& filepath, std::size_t offset, std::size_t size, int& width, int& height, std::string& failureReason);
+
+// halves an RGBA8 level with a 2x2 box filter, odd edges reuse their last row/column
+void DownsampleLevel(const std::vector<unsigned char>& source, int sourceWidth, int sourceHeight, std::vector<unsigned char>& destination, int width, int height);
+
+// Streams textures from disk to the GPU without stalling the render loop.
+// Images are decoded and mip-mapped on worker threads, then uploaded a few
+// rows at a time through a ring of pixel buffer objects, smallest mip first,
+// so a texture becomes usable at low resolution and sharpens as levels arrive.
+// All methods must be called on the thread that owns the GL context.
+class TextureCache
+{
+public:
+    explicit TextureCache(const TextureCacheSettings& settings);
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // starts loading the texture in the background, repeated requests for an image share one handle;
+    // a size other than 0 loads an image embedded at that byte range of the file
+    TextureHandle Request(const std::string& filepath, std::size_t offset = 0, std::size_t size = 0);
+
+    // returns the GL texture to sample for this handle (a white fallback until it is resident)
+    // and marks it as used this frame for LRU eviction
+    unsigned int Use(TextureHandle handle);
+
+    // advances pending uploads and evicts textures over the memory budget, call once per frame
+    void Update();
+
+    std::size_t GetResidentBytes() const;
+
+private:
+    enum class TextureState
+    {
+        Decoding,
+        Uploading,
+        Resident,
+        Evicted,
+        Failed
+    };
+
+    struct MipLevel
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;  // tightly packed RGBA8
+    };
+
+    struct DecodedImage
+    {
+        TextureHandle handle;
+        std::vector<MipLevel> levels;
+        std::string failureReason;  // empty when decoding succeeded
+    };
+
+    struct TextureEntry
+    {
+        std::string filepath;
+        std::size_t fileOffset;
+        std::size_t fileSize;
+        TextureState state;
+        unsigned int texture;
+        bool usable;  // at least the smallest mip level has been uploaded
+        std::size_t residentBytes;
+        unsigned long long lastUsedFrame;
+        std::list<TextureHandle>::iterator lruPosition;
+
+        // upload progress, levels are uploaded from the last (smallest) to the first
+        std::vector<MipLevel> levels;
+        int uploadLevel;
+        int uploadRow;
+    };
+
+    struct DecodeRequest
+    {
+        TextureHandle handle;
+        std::string filepath;
+        std::size_t fileOffset;
+        std::size_t fileSize;
+    };
+
+    struct PixelBuffer
+    {
+        unsigned int buffer;
+        void* fence;  // GLsync of the last upload sourced from this buffer
+    };
+
+    void DecodeThreadMain();
+    void QueueDecode(TextureHandle handle);
+    void BeginUpload(DecodedImage& image);
+    void UploadPendingLevels();
+    void EvictToBudget();
+
+    TextureCacheSettings settings;
+
+    std::vector<TextureEntry> entries;  // indexed by handle - 1
+    std::map<std::pair<std::string, std::size_t>, TextureHandle> handlesBySource;  // path and offset
+    std::list<TextureHandle> lruOrder;  // most recently used at the front
+    std::deque<TextureHandle> uploadQueue;
+
+    std::size_t residentBytes;
+    unsigned long long frameIndex;
+
+    unsigned int fallbackTexture;
+
+    std::vector<PixelBuffer> pixelBuffers;
+    std::size_t nextPixelBuffer;
+
+    std::vector<std::thread> decodeThreads;
+    std::mutex decodeMutex;
+    std::condition_variable decodeCondition;
+    std::deque<DecodeRequest> decodeRequests;
+    std::vector<DecodedImage> decodedImages;
+    bool stopDecoding;
+};
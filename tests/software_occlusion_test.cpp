@@ -0,0 +1,138 @@
+// Checks the software occlusion buffer without a window or a GL context: a
+// fixed set of occluders is rasterized with the scalar and, when the CPU has
+// it, the AVX2 rasterizer, both must produce the same depths and cull the
+// same occludees as expected.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cpu_features.h"
+#include "job_system.h"
+#include "software_occlusion.h"
+
+namespace
+{
+
+int failureCount = 0;
+
+void Check(bool condition, const char* description)
+{
+    if (condition == false)
+    {
+        std::printf("FAILED: %s\n", description);
+        ++failureCount;
+    }
+}
+
+void AddQuad(std::vector<glm::vec3>& triangles, const glm::vec3& corner, const glm::vec3& edgeU, const glm::vec3& edgeV)
+{
+    triangles.push_back(corner);
+    triangles.push_back(corner + edgeU);
+    triangles.push_back(corner + edgeU + edgeV);
+
+    triangles.push_back(corner);
+    triangles.push_back(corner + edgeU + edgeV);
+    triangles.push_back(corner + edgeV);
+}
+
+// A wall across the middle of the view, with small triangles of both windings in front of it.
+// Pixels on the wall's diagonal are covered by neither of its triangles completely, so they stay empty.
+std::vector<glm::vec3> CreateOccluders()
+{
+    std::vector<glm::vec3> triangles;
+    AddQuad(triangles, glm::vec3{-2.0f, -1.5f, 0.0f}, glm::vec3{4.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 3.0f, 0.0f});
+
+    unsigned int randomState = 12345;
+    const auto nextRandom = [&randomState]()
+    {
+        randomState = randomState * 1664525u + 1013904223u;
+        return static_cast<float>(randomState >> 8) / static_cast<float>(1u << 24);
+    };
+
+    for (int i = 0; i < 200; ++i)
+    {
+        const glm::vec3 center{nextRandom() * 3.6f - 1.8f, nextRandom() * 2.6f - 1.3f, nextRandom()};
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            triangles.push_back(center + glm::vec3{nextRandom() * 0.6f - 0.3f, nextRandom() * 0.6f - 0.3f, nextRandom() * 0.2f});
+        }
+    }
+
+    return triangles;
+}
+
+DrawCommand CreateOccludee(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    DrawCommand drawCommand = DrawCommand();
+    drawCommand.modelMatrix = glm::mat4{1.0f};
+    drawCommand.boundsMin = boundsMin;
+    drawCommand.boundsMax = boundsMax;
+
+    return drawCommand;
+}
+
+} // namespace
+
+int main()
+{
+    const glm::mat4 viewMatrix = glm::lookAt(glm::vec3{0.0f, 0.0f, 5.0f}, glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    const glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.0f), static_cast<float>(SoftwareOcclusionWidth) / SoftwareOcclusionHeight, 0.1f, 100.0f);
+    const glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+
+    const std::vector<DrawCommand> drawList = {
+        CreateOccludee(glm::vec3{-1.5f, 0.3f, -3.0f}, glm::vec3{-1.0f, 0.8f, -2.0f}),    // behind the wall
+        CreateOccludee(glm::vec3{-0.3f, -0.3f, 2.0f}, glm::vec3{0.3f, 0.3f, 2.5f}),      // in front of everything
+        CreateOccludee(glm::vec3{20.0f, -0.5f, -0.5f}, glm::vec3{21.0f, 0.5f, 0.5f}),    // outside the view
+        CreateOccludee(glm::vec3{-0.5f, -0.5f, 6.0f}, glm::vec3{0.5f, 0.5f, 7.0f}),      // behind the camera
+        CreateOccludee(glm::vec3{1.5f, -0.2f, -1.0f}, glm::vec3{3.5f, 0.2f, -0.5f}),     // reaching past the wall's edge
+    };
+    const std::vector<unsigned char> expectedVisibility = {0, 1, 0, 1, 1};
+
+    JobSystem jobSystem{4};
+    const std::vector<glm::vec3> occluders = CreateOccluders();
+
+    SoftwareOcclusionBuffer scalarBuffer{occluders, jobSystem, false};
+    scalarBuffer.RenderOccluders(viewProjectionMatrix);
+    const std::vector<unsigned char> scalarVisibility = *scalarBuffer.Cull(drawList, viewProjectionMatrix).visibleDraws;
+
+    Check(scalarBuffer.IsUsingAvx2() == false, "the scalar buffer uses the scalar rasterizer");
+    Check(scalarBuffer.GetStats().rasterizedTriangles > 2, "the occluders are rasterized");
+    Check(scalarVisibility == expectedVisibility, "the scalar rasterizer culls the expected occludees");
+    Check(scalarBuffer.GetStats().frustumCulledDraws == 1, "one occludee is outside the view");
+
+    if (IsAvx2Supported())
+    {
+        SoftwareOcclusionBuffer avx2Buffer{occluders, jobSystem, true};
+        avx2Buffer.RenderOccluders(viewProjectionMatrix);
+        const std::vector<unsigned char> avx2Visibility = *avx2Buffer.Cull(drawList, viewProjectionMatrix).visibleDraws;
+
+        Check(avx2Buffer.IsUsingAvx2(), "the AVX2 buffer uses the AVX2 rasterizer");
+        Check(avx2Visibility == scalarVisibility, "both rasterizers cull the same occludees");
+
+        // FMA rounds differently, coverage must match exactly and depths closely
+        const std::vector<float>& scalarDepths = scalarBuffer.GetDepths();
+        const std::vector<float>& avx2Depths = avx2Buffer.GetDepths();
+        bool depthsMatch = scalarDepths.size() == avx2Depths.size();
+        for (std::size_t i = 0; depthsMatch && i < scalarDepths.size(); ++i)
+        {
+            depthsMatch = (scalarDepths[i] == 1.0f) == (avx2Depths[i] == 1.0f) && std::fabs(scalarDepths[i] - avx2Depths[i]) <= 1.0e-5f;
+        }
+        Check(depthsMatch, "both rasterizers write the same depths");
+    }
+    else
+    {
+        std::printf("AVX2 is not supported, only the scalar rasterizer was tested\n");
+    }
+
+    if (failureCount > 0)
+    {
+        return 1;
+    }
+
+    std::printf("software occlusion test passed\n");
+    return 0;
+}